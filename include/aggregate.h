@@ -0,0 +1,50 @@
+/**
+ * @file aggregate.h
+ *
+ * @brief Declaration of the aggregation of repeated measurements
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+
+/* Project includes */
+#include <dataset.h>
+
+
+/* Public interface */
+/**
+ * @brief Reduce the points measured at the same @e x to a single point
+ *
+ * Sorts the points by @e x (see @a xindex_argsort()) and scans them:
+ * consecutive points whose @e x is within @p tol of the first @e x of
+ * the run form a group (@p tol = 0 groups only identical @e x).  Each
+ * group becomes one point with:
+ *   - @e x: mean of the @e x values of the group,
+ *   - @e y: inverse-variance weighted mean if every point has a
+ *     positive @e ey, or plain mean otherwise,
+ *   - @e ey: standard error of that mean, i.e., @e 1/sqrt(Sum(w)) for
+ *     the weighted mean, or @e s/sqrt(m) with the sample standard
+ *     deviation @e s of the @e m values of the group.
+ *
+ * Groups whose error cannot be estimated that way (a single point
+ * without error, or identical values) get the pooled within-group
+ * standard deviation divided by @e sqrt(m), so that every point takes
+ * part in the weighted fit of @a regres_linear().
+ *
+ * @param src Pointer to the dataset to reduce
+ * @param tol Tolerance on @e x (0 for exact matches)
+ * @param dst Pointer to an uninitialized dataset where the reduced
+ *            points are stored
+ *
+ * @return 0 on success,
+ *         1 if @p src is empty,
+ *         2 on memory allocation failure
+ *
+ * @note Group keys are not carried over: the reduced dataset is not
+ *       grouped
+ */
+int aggregate_x(const dataset_td *src, double tol, dataset_td *dst);
+
+
+#endif  /* ! AGGREGATE_H */
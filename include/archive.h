@@ -0,0 +1,94 @@
+/**
+ * @file archive.h
+ *
+ * @brief Declaration of the compressed columnar format of a dataset
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+
+
+#define ARCHIVE_MAGIC "RGRSZC01"    /**< First bytes of an archive */
+#define ARCHIVE_EXT ".rgz"          /**< Extension of archive files */
+#define ARCHIVE_BLOCK (4096)        /**< Points per compressed block */
+#define ARCHIVE_MAX_THREADS (8)     /**< Maximum decoding threads */
+#define ARCHIVE_MIN_BLOCKS (16)     /**< Minimum blocks per thread */
+
+
+/* Public interface */
+/**
+ * @brief Save a dataset to a compressed archive
+ *
+ * Points are cut in blocks of @c ARCHIVE_BLOCK, and every column of a
+ * block (@e x, @e y, @e ey if any is not zero, and the group keys if
+ * any) is compressed on its own: floating point values are XORed with
+ * the previous one and only the bits that changed are stored (as in
+ * Facebook's Gorilla), and keys are stored as variable length deltas.
+ * Blocks do not depend on each other, so they can be decoded in
+ * parallel, and each one carries a checksum.
+ *
+ * @param filename Path to the archive
+ * @param ds       Pointer to the dataset to save
+ *
+ * @return 0 on success,
+ *         1 on failure (could not open or write the file),
+ *         2 on memory allocation failure
+ *
+ * @note Derived columns are not saved, as in @a fileio_save()
+ */
+int archive_save(const char *filename, const dataset_td *ds);
+
+/**
+ * @brief Load a dataset from a compressed archive
+ *
+ * Blocks are checked and decoded in parallel, straight into the
+ * points of the dataset, which get the storage mode they were saved
+ * with (see @e dataset_mode_e).
+ *
+ * @param filename Path to the archive
+ * @param ds       Pointer to the dataset to populate
+ *
+ * @return 0 on success,
+ *         1 on failure (could not open the file, or not an archive),
+ *         2 on memory allocation failure,
+ *         3 if the archive is corrupted (a checksum does not match);
+ *         the dataset is left as it was on failure
+ *
+ * @note On successful load the dataset's @e is_modified flag is cleared
+ */
+int archive_load(const char *filename, dataset_td *ds);
+
+/**
+ * @brief Accumulate the points of a compressed archive into moment sums
+ *
+ * Same as @a archive_load() followed by @a moments_accumulate(), but
+ * every thread accumulates the blocks it decodes while they are still
+ * in cache, and no dataset is built: memory use does not grow with the
+ * number of points.
+ *
+ * @param filename Path to the archive
+ * @param m        Pointer to the moments where the sums are stored,
+ *                 about the first point of the archive and weighted
+ *                 as @a regres_linear() would (see
+ *                 @a regres_from_moments())
+ *
+ * @return 0 on success, or 1, 2 or 3 as @a archive_load()
+ */
+int archive_moments(const char *filename, moments_td *m);
+
+/**
+ * @brief Tell if a file is a compressed archive
+ *
+ * @param filename Path to the file
+ *
+ * @return 1 if the file starts with @c ARCHIVE_MAGIC, or 0 otherwise
+ */
+int archive_check(const char *filename);
+
+
+#endif  /* ! ARCHIVE_H */
@@ -0,0 +1,122 @@
+/**
+ * @file arena.h
+ *
+ * @brief Declaration of the allocator of large, growing buffers
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+
+#define ARENA_MMAP_MIN (1UL << 21)  /**< Smallest buffer mapped directly
+                                         from the system (2 MiB) */
+#define ARENA_HUGE_PAGE (1UL << 21) /**< Size of a huge page (2 MiB) */
+#define ARENA_FILE_EXTENT (1UL << 26)   /**< Growth step of buffers
+                                             mapped from a file (64 MiB) */
+#define ARENA_MAP_OFFSET (32)   /**< Bytes a region of a file mapped with
+                                     @a arena_map() holds before its
+                                     buffer */
+
+
+/* Public interface */
+/**
+ * @brief Allocate a buffer
+ *
+ * Buffers of at least @c ARENA_MMAP_MIN bytes are mapped directly from
+ * the system, on explicit huge pages if any are reserved, or else on
+ * regular pages marked as candidates for transparent huge pages, so
+ * that the columns of large datasets need fewer TLB entries.  Smaller
+ * buffers, or any buffer if mapping fails, come from @a malloc().
+ *
+ * @param size Size of the buffer, in bytes
+ *
+ * @return Pointer to the buffer, suitably aligned for any type, or
+ *         @c NULL on memory allocation failure
+ */
+void *arena_alloc(size_t size);
+
+/**
+ * @brief Allocate a buffer mapped from a file
+ *
+ * The buffer lives in the file, which is grown in extents of
+ * @c ARENA_FILE_EXTENT bytes, so it can be larger than the physical
+ * memory: the system writes pages back to the file and drops them as
+ * needed.  The mapping is advised for sequential access, which is how
+ * the fitting kernels stream through the points.
+ *
+ * @param size Size of the buffer, in bytes
+ * @param fd   Descriptor of the file, open for reading and writing,
+ *             and not used for anything else (see @a arena_scratch())
+ *
+ * @return Pointer to the buffer, or @c NULL if the file cannot be
+ *         grown or mapped
+ *
+ * @note The descriptor is not closed by @a arena_free()
+ */
+void *arena_alloc_file(size_t size, int fd);
+
+/**
+ * @brief Map a buffer from a region of a file, copied on write
+ *
+ * The region is mapped privately: its pages are read from the file
+ * only when the buffer is first read, so mapping it costs the same
+ * whatever its size, and writing to the buffer changes a copy of the
+ * pages written, never the file.  Growing the buffer (see
+ * @a arena_realloc()) moves it to memory.
+ *
+ * @param fd     Descriptor of the file, open for reading (it can be
+ *               closed once mapped)
+ * @param offset Offset of the region, a multiple of the page size
+ * @param size   Size of the buffer, in bytes; the region holds
+ *               @c ARENA_MAP_OFFSET bytes (overwritten in the copy)
+ *               followed by the buffer
+ *
+ * @return Pointer to the buffer, or @c NULL if the region cannot be
+ *         mapped
+ *
+ * @note The file must not be truncated while the buffer is mapped
+ */
+void *arena_map(int fd, size_t offset, size_t size);
+
+/**
+ * @brief Create a scratch file for buffers mapped from a file
+ *
+ * The file is unlinked as soon as it is created, so it goes away with
+ * its descriptor (and with the program) whatever happens.
+ *
+ * @param dir Directory of the file, or @c NULL for @c TMPDIR (or
+ *            @c /tmp if not set)
+ *
+ * @return Descriptor of the file, or -1 if it cannot be created
+ */
+int arena_scratch(const char *dir);
+
+/**
+ * @brief Resize a buffer
+ *
+ * Mapped buffers are grown by remapping their pages where the system
+ * allows it, without copying the contents nor needing twice their
+ * memory.  Buffers mapped from a file stay in their file.
+ *
+ * @param p    Pointer to the buffer (from @a arena_alloc()), or
+ *             @c NULL to allocate a new one
+ * @param size New size of the buffer, in bytes
+ *
+ * @return Pointer to the resized buffer, or @c NULL on memory
+ *         allocation failure, in which case @p p is left untouched
+ */
+void *arena_realloc(void *p, size_t size);
+
+/**
+ * @brief Free a buffer
+ *
+ * @param p Pointer to the buffer (from @a arena_alloc()), or @c NULL
+ */
+void arena_free(void *p);
+
+
+#endif  /* ! ARENA_H */
@@ -0,0 +1,84 @@
+/**
+ * @file arrow.h
+ *
+ * @brief Declaration of the Apache Arrow IPC file format of a dataset
+ */
+
+#ifndef ARROW_H
+#define ARROW_H
+
+
+/* Project includes */
+#include <dataset.h>
+
+
+#define ARROW_MAGIC "ARROW1"    /**< First and last bytes of a file */
+#define ARROW_EXT ".arrow"      /**< Extension of Arrow IPC files */
+#define ARROW_BATCH (65536)     /**< Points per record batch written */
+#define ARROW_COLS (3)          /**< Columns of a point (x, y, ey) */
+
+
+/* Public interface */
+/**
+ * @brief Save a dataset to an Arrow IPC file
+ *
+ * The points are written as float64 columns named @e x, @e y and
+ * @e ey (the latter only if the dataset stores errors), in record
+ * batches of @c ARROW_BATCH points, without compression, so that any
+ * Arrow implementation (pyarrow, arrow-rs, DuckDB, Polars, ...) reads
+ * them as they are.  The format is written here, with no dependency.
+ *
+ * @param filename Path to the file
+ * @param ds       Pointer to the dataset to save
+ *
+ * @return 0 on success,
+ *         1 on failure (could not open or write the file),
+ *         2 on memory allocation failure
+ *
+ * @note Group keys and derived columns are not saved
+ */
+int arrow_save(const char *filename, const dataset_td *ds);
+
+/**
+ * @brief Load a dataset from an Arrow IPC file
+ *
+ * The file is mapped in memory and the float64 columns chosen are
+ * read straight from its buffers into the points, in a single pass,
+ * with no intermediate copy.  Rows whose @e x or @e y is null are
+ * skipped, and null errors are taken as 0.  The points get the most
+ * compact storage mode that holds them exactly (see
+ * @e dataset_mode_e).
+ *
+ * @param filename Path to the file
+ * @param ds       Pointer to the dataset to populate
+ * @param names    Names of the fields of @e x, @e y and @e ey; any of
+ *                 them, or @p names itself, may be @c NULL to take the
+ *                 field named @e x, @e y or @e ey if there is one, or
+ *                 else the next float64 field
+ *
+ * @return 0 on success,
+ *         1 on failure (could not open the file, not an Arrow file, or
+ *           the columns before those chosen are nested),
+ *         2 on memory allocation failure,
+ *         3 if the file is corrupted (its metadata is out of bounds),
+ *         4 if a field named in @p names is not a float64 field of the
+ *           file,
+ *         5 if the record batches are compressed;
+ *         the dataset is left as it was on failure
+ *
+ * @note On successful load the dataset's @e is_modified flag is cleared
+ */
+int arrow_load(const char *filename, dataset_td *ds,
+        const char *const *names);
+
+/**
+ * @brief Tell if a file is an Arrow IPC file
+ *
+ * @param filename Path to the file
+ *
+ * @return 1 if the file starts with @c ARROW_MAGIC, or 0 otherwise
+ */
+int arrow_check(const char *filename);
+
+
+#endif  /* ! ARROW_H */
@@ -0,0 +1,133 @@
+/**
+ * @file bins.h
+ *
+ * @brief Declaration of the binning engine for very large datasets
+ */
+
+#ifndef BINS_H
+#define BINS_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+
+#define BINS_DEFAULT     (1000)     /**< Default number of bins */
+#define BINS_MAX_THREADS (8)        /**< Maximum worker threads */
+#define BINS_MIN_CHUNK   (65536)    /**< Minimum points per thread */
+#define BINS_BLOCK       (256)      /**< Points whose bin is computed at
+                                         once */
+
+
+/**
+ * @typedef bin_td
+ *
+ * @brief Summary of the points falling in a bin of @e x
+ *
+ * Moment sums are taken about the center of the bin, which keeps them
+ * accurate, and give the count, means, variances and covariance of the
+ * points of the bin.
+ */
+typedef struct {
+    moments_td plain;       /**< Unweighted sums */
+    moments_td weighted;    /**< Sums weighted by 1/ey^2 */
+    double x_min;           /**< Smallest @e x of the bin */
+    double x_max;           /**< Largest @e x of the bin */
+    double sum_e;           /**< Sum(ey), with negative errors as 0 */
+    double sum_ue;          /**< Sum((x - center)*ey), idem */
+} bin_td;
+
+
+/**
+ * @typedef bins_td
+ *
+ * @brief Dataset summarized in bins of equal width in @e x
+ */
+typedef struct {
+    size_t n_bins;  /**< Number of bins */
+    size_t n;       /**< Number of points binned */
+    double lo;      /**< Lower end of the first bin (smallest @e x) */
+    double width;   /**< Width of every bin */
+    int weighted;   /**< If non-zero, fits use the weighted sums */
+    bin_td *bins;   /**< Summary of every bin */
+} bins_td;
+
+
+/**
+ * @typedef bins_bounds_td
+ *
+ * @brief Intervals holding the exact propagation errors of a fit
+ */
+typedef struct {
+    double ea_lo;   /**< Lower bound of @e e(a) */
+    double ea_hi;   /**< Upper bound of @e e(a) */
+    double eb_lo;   /**< Lower bound of @e e(b) */
+    double eb_hi;   /**< Upper bound of @e e(b) */
+} bins_bounds_td;
+
+
+/* Public interface */
+/**
+ * @brief Summarize a dataset in bins of equal width in @e x
+ *
+ * Bin indices are computed a block of @c BINS_BLOCK points at a time
+ * in a branch-free loop, then every point is accumulated into its bin.
+ * Large datasets are split in chunks processed by worker threads, each
+ * one with its own bins, merged at the end.
+ *
+ * @param b      Pointer to the bins to build
+ * @param ds     Pointer to the dataset to summarize
+ * @param n_bins Number of bins (at least 1)
+ *
+ * @return 0 on success,
+ *         1 if the dataset is empty or @p n_bins is zero,
+ *         2 on memory allocation failure
+ */
+int bins_build(bins_td *b, const dataset_td *ds, size_t n_bins);
+
+/**
+ * @brief Free the memory used by the bins
+ *
+ * @param b Pointer to the bins to destroy
+ */
+void bins_destroy(bins_td *b);
+
+/**
+ * @brief Get the moment sums of the whole binned dataset
+ *
+ * The result is exactly the sums of the raw points (up to rounding),
+ * so any fit or statistic built on them matches the one of the raw
+ * data.
+ *
+ * @param b        Pointer to the bins
+ * @param weighted If non-zero, get the sums weighted by @e 1/ey^2
+ * @param m        Pointer to where the sums are stored
+ */
+void bins_moments(const bins_td *b, int weighted, moments_td *m);
+
+/**
+ * @brief Fit the binned dataset
+ *
+ * Parameters @e a, @e b, their standard errors and @e r are exactly the
+ * ones of @a regres_linear() on the raw data, because bins keep their
+ * co-moments.  Propagation errors depend on the absolute position of
+ * each point with respect to a pivot: they are exact for every bin
+ * lying on one side of it, and bounded for the (at most one) bin that
+ * holds the pivot.  The returned @e ea and @e eb are the midpoints of
+ * those bounds.
+ *
+ * @param b      Pointer to the bins
+ * @param bounds If not @c NULL, where to store the bounds of @e ea and
+ *               @e eb
+ *
+ * @return A regression_td structure (see @a regres_linear())
+ */
+regression_td bins_fit(const bins_td *b, bins_bounds_td *bounds);
+
+
+#endif  /* ! BINS_H */
@@ -0,0 +1,64 @@
+/**
+ * @file cli.h
+ *
+ * @brief Declaration of the command-line mode, for scripted batch fits
+ */
+
+#ifndef CLI_H
+#define CLI_H
+
+
+#define CLI_STDIN "-"   /**< File name that stands for the standard
+                             input */
+
+
+/**
+ * @brief Formats the results can be written in
+ */
+typedef enum {
+    CLI_JSON,   /**< An object per line (JSON Lines) */
+    CLI_CSV     /**< A header line, and a row per file */
+} cli_format_e;
+
+
+/* Public interface */
+/**
+ * @brief Run a command given on the command line, without the TUI
+ *
+ * Commands are:
+ *   - @e fit: linear regression (@e regression_td) of every file
+ *   - @e stats: statistics (@e stats_td) of every file
+ *
+ * followed by their options and files:
+ *   - @e -f @e json|csv: format of the results (JSON by default)
+ *   - @e -d @e DELIM: character between columns (@e tab for a
+ *     tabulator), to read delimited files (see @a fileio_load_opts())
+ *   - @e -x, @e -y, @e -e @e COL: column of @e x, @e y and @e ey, by
+ *     number (from 1) or by name in the header line of the file (see
+ *     @e fileio_opts_td)
+ *   - @e -i: index every file as it is read (see @a fileio_summary()),
+ *     so that the next fit of it reads its index alone; fits of
+ *     indexed files come from the summaries of their blocks, without
+ *     the propagated errors @e ea and @e eb
+ *   - files, read as the TUI would load them; the standard input if
+ *     none is given, or the name is @c CLI_STDIN
+ *
+ * The results of every file are written to the standard output, along
+ * with its name and number of points, as soon as it is read; files that
+ * cannot be read, that give fewer than two points, or (for @e fit)
+ * whose points all share the same @e x are reported to the standard
+ * error and skipped.  The TUI is never started, so it can be run on
+ * many files at once, or in a pipeline.
+ *
+ * @param argc Number of arguments, the name of the program included
+ * @param argv Arguments, as given to @e main()
+ *
+ * @return 0 on success,
+ *         1 if any file cannot be read, or cannot be fitted,
+ *         2 if the command or its options are not valid (the usage is
+ *           written to the standard error)
+ */
+int cli_run(int argc, char *argv[]);
+
+
+#endif  /* ! CLI_H */
@@ -10,6 +10,25 @@
 
 /* System includes */
 #include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+
+
+#define DATASET_MIN_CAPACITY 64 /**< Points allocated by the first add */
+
+
+/**
+ * @brief Storage modes of the points of a dataset, combined as flags
+ *
+ * Compact modes hold exactly the same values with fewer bytes per
+ * point, so they are only kept while the values fit: storing a value
+ * they cannot hold (a non-zero error, or a value that is not exact in
+ * single precision) widens the storage first.
+ */
+typedef enum {
+    DATASET_FULL = 0,   /**< @e (x, y, ey) in double (24 bytes) */
+    DATASET_NO_EY = 1,  /**< No @e ey stored: it is 0 for every point */
+    DATASET_SINGLE = 2  /**< Values stored in single precision */
+} dataset_mode_e;
 
 
 /**
@@ -26,10 +45,28 @@ typedef struct {
  * @brief Structure representing a dataseta
  */
 typedef struct {
-    data_point_td *points;  /**< Pointer to the array of data points */
+    void *points;           /**< Pointer to the array of data points,
+                                 laid out as given by @e mode (read them
+                                 with @a dataset_block()) */
+    int mode;               /**< Storage mode (@e dataset_mode_e flags) */
+    long *keys;             /**< Group key of every point, or @c NULL if
+                                 the dataset is not grouped */
+    char **key_names;       /**< Name of every string key (keys are then
+                                 indices), or @c NULL for integer keys */
+    size_t n_key_names;     /**< Number of entries in @e key_names */
+    double **cols;          /**< Derived columns, one value per point */
+    char **col_names;       /**< Name of every derived column */
+    size_t n_cols;          /**< Number of derived columns */
     size_t capacity;        /**< Maximum points that can be stored */
+    int fd;                 /**< Scratch file the points are mapped
+                                 from, or -1 if they are in memory */
     size_t size;            /**< Current number of points in the dataset */
     int is_modified;        /**< Flag to tell if dataset has been modified */
+    size_t n_saved;         /**< Leading points that are already in the
+                                 file last loaded or saved, unchanged */
+    uint64_t saved_id;      /**< State of that file and its journal (see
+                                 @a journal_state()), or 0 if the points
+                                 are not known to be in any file */
 } dataset_td;
 
 
@@ -37,13 +74,31 @@ typedef struct {
 /**
  * @brief Initialize a dataset structure
  *
- * Set the initial size and capacity of the dataset, allocates memory
- * for the data points, and marks the dataset as unmodified.
+ * Set the initial size and capacity of the dataset, and marks the
+ * dataset as unmodified.  No memory is allocated until points are
+ * added or reserved (see @a dataset_reserve()), so this cannot fail.
  *
  * @param ds Pointer to the dataset structure to be initialized
  */
 void dataset_init(dataset_td *ds);
 
+/**
+ * @brief Initialize a dataset structure whose points live in a file
+ *
+ * Same as @a dataset_init(), but the points are mapped from a scratch
+ * file (see @a arena_alloc_file()) rather than kept in memory, so the
+ * dataset can be larger than the physical memory.  Group keys and
+ * derived columns, if any, are still kept in memory.
+ *
+ * @param ds  Pointer to the dataset structure to be initialized
+ * @param dir Directory of the scratch file, or @c NULL for the default
+ *            (see @a arena_scratch())
+ *
+ * @return 0 on success, or 1 if the scratch file cannot be created
+ *         (the dataset is then initialized in memory)
+ */
+int dataset_init_mapped(dataset_td *ds, const char *dir);
+
 /**
  * @brief Destroy a dataset structure
  *
@@ -54,12 +109,90 @@ void dataset_init(dataset_td *ds);
  */
 void dataset_destroy(dataset_td *ds);
 
+/**
+ * @brief Make room for a number of points in the dataset
+ *
+ * Grows every buffer (points, keys, derived columns) at once to hold
+ * at least @p n points, so that adding them later does not reallocate.
+ * Buffers are allocated with @a arena_alloc(), so large datasets are
+ * mapped on huge pages where possible and grow without copies.
+ *
+ * @param ds Pointer to the dataset structure
+ * @param n  Number of points to make room for, in total
+ *
+ * @return 0 on success, or 2 on memory allocation failure (the dataset
+ *         is left as it was)
+ */
+int dataset_reserve(dataset_td *ds, size_t n);
+
+/**
+ * @brief Change the storage mode of the points of a dataset
+ *
+ * Going to a wider mode never changes a value.  Going to a narrower
+ * one rounds the values to single precision (@c DATASET_SINGLE) or
+ * drops the errors (@c DATASET_NO_EY), so it is meant to be done on an
+ * empty dataset, before adding its points.
+ *
+ * @param ds   Pointer to the dataset structure
+ * @param mode New storage mode (@e dataset_mode_e flags)
+ *
+ * @return 0 on success, or 2 on memory allocation failure (the dataset
+ *         is left as it was)
+ */
+int dataset_set_mode(dataset_td *ds, int mode);
+
+/**
+ * @brief Read a block of points of the dataset
+ *
+ * Points stored in a compact mode are widened into @p buf, so kernels
+ * read the same @e data_point_td (and accumulate in double) whatever
+ * the storage.  Points stored in full are not copied.
+ *
+ * @param ds    Pointer to the dataset structure
+ * @param begin First point of the block
+ * @param len   Number of points of the block
+ * @param buf   Buffer of at least @p len points
+ *
+ * @return Pointer to the points of the block, either in the dataset
+ *         or in @p buf; valid until the dataset is modified
+ */
+const data_point_td *dataset_block(const dataset_td *ds, size_t begin,
+        size_t len, data_point_td *buf);
+
+/**
+ * @brief Write a block of points of the dataset
+ *
+ * The storage is widened first if the mode of the dataset cannot hold
+ * some of the values exactly (see @e dataset_mode_e).
+ *
+ * @param ds    Pointer to the dataset structure
+ * @param begin First point of the block
+ * @param len   Number of points of the block
+ * @param p     New values of the points
+ *
+ * @return 0 on success, or 2 on memory allocation failure (the points
+ *         are then left as they were)
+ */
+int dataset_store(dataset_td *ds, size_t begin, size_t len,
+        const data_point_td *p);
+
+/**
+ * @brief Get a point of the dataset
+ *
+ * @param ds Pointer to the dataset structure
+ * @param i  Index of the point
+ *
+ * @return Values of the point, in double
+ */
+data_point_td dataset_get(const dataset_td *ds, size_t i);
+
 /**
  * @brief Add a new data point to the dataset
  *
  * This function adds a new data point with the specified @e x, @e y,
  * and @e ey values to the dataset.  If the dataset's capacity is
- * reached, it reallocates memory to accommodate more points.
+ * reached, it doubles it to accommodate more points.  If the storage
+ * mode cannot hold the values exactly, the points are widened first.
  *
  * @param ds Pointer to the dataset structure where the point will be
  *           added
@@ -67,8 +200,69 @@ void dataset_destroy(dataset_td *ds);
  * @param x  The @e x value of the new data point
  * @param y  The @e y value of the new data point
  * @param ey The @e y error value of the new data point
+ *
+ * @return 0 on success, or 2 on memory allocation failure (the point
+ *         is not added, and the dataset is left as it was)
+ */
+int dataset_add(dataset_td *ds, double x, double y, double ey);
+
+/**
+ * @brief Add a new data point with a group key to the dataset
+ *
+ * Same as @a dataset_add(), but the point is also given a group key.
+ * The first keyed point turns the dataset into a grouped one: points
+ * already stored get key 0.
+ *
+ * @param ds  Pointer to the dataset structure where the point will be
+ *            added
+ * @param x   The @e x value of the new data point
+ * @param y   The @e y value of the new data point
+ * @param ey  The @e y error value of the new data point
+ * @param key The group key of the new data point
+ *
+ * @return 0 on success, or 2 on memory allocation failure (the point
+ *         is not added)
  */
-void dataset_add(dataset_td *ds, double x, double y, double ey);
+int dataset_add_keyed(dataset_td *ds, double x, double y, double ey,
+        long key);
+
+/**
+ * @brief Get a printable label for a group key
+ *
+ * @param ds  Pointer to the dataset the key belongs to
+ * @param key Group key
+ * @param buf Buffer where integer keys are printed
+ * @param len Size of @p buf
+ *
+ * @return The name of the key if it is a string key, or @p buf holding
+ *         the key printed as an integer
+ */
+const char *dataset_key_label(const dataset_td *ds, long key,
+        char *buf, size_t len);
+
+/**
+ * @brief Add a named derived column to the dataset
+ *
+ * Every point gets @c NAN in the new column until it is computed (see
+ * @a expr_run()), and so do points added later.
+ *
+ * @param ds   Pointer to the dataset structure
+ * @param name Name of the column
+ *
+ * @return Index of the column in @e cols, or -1 on memory allocation
+ *         failure
+ */
+int dataset_add_col(dataset_td *ds, const char *name);
+
+/**
+ * @brief Find a derived column by name
+ *
+ * @param ds   Pointer to the dataset structure
+ * @param name Name of the column
+ *
+ * @return Index of the column in @e cols, or -1 if there is none
+ */
+int dataset_find_col(const dataset_td *ds, const char *name);
 
 /**
  * @brief Apply the logarithm transformation to a specified column
@@ -78,8 +272,10 @@ void dataset_add(dataset_td *ds, double x, double y, double ey);
  *
  * @param ds  Pointer to the dataset structure.
  * @param col Column index to apply the logarithm transformation
+ *
+ * @return 0 on success, or 2 on memory allocation failure
  */
-void dataset_log_col(dataset_td *ds, int col);
+int dataset_log_col(dataset_td *ds, int col);
 
 /**
  * @brief Apply the antilogarithm transformation to a specified column
@@ -89,8 +285,10 @@ void dataset_log_col(dataset_td *ds, int col);
  *
  * @param ds  Pointer to the dataset structure.
  * @param col Column index to apply the antilogarithm transformation
+ *
+ * @return 0 on success, or 2 on memory allocation failure
  */
-void dataset_antilog_col(dataset_td *ds, int col);
+int dataset_antilog_col(dataset_td *ds, int col);
 
 /**
  * @brief Invert the values in a specified column
@@ -101,8 +299,10 @@ void dataset_antilog_col(dataset_td *ds, int col);
  *
  * @param ds  Pointer to the dataset structure
  * @param col Column index to invert values
+ *
+ * @return 0 on success, or 2 on memory allocation failure
  */
-void dataset_inv_col(dataset_td *ds, int col);
+int dataset_inv_col(dataset_td *ds, int col);
 
 /**
  * @brief Multiply the values in a specified column by a factor
@@ -113,8 +313,10 @@ void dataset_inv_col(dataset_td *ds, int col);
  * @param ds     Pointer to the dataset structure
  * @param col    Column index to multiply values
  * @param factor Factor by which to multiply the values
+ *
+ * @return 0 on success, or 2 on memory allocation failure
  */
-void dataset_mult_col(dataset_td *ds, int col, double factor);
+int dataset_mult_col(dataset_td *ds, int col, double factor);
 
 /**
  * @brief Macro that evaluates to the modified flag of the dataset
@@ -131,5 +333,22 @@ void dataset_mult_col(dataset_td *ds, int col, double factor);
  */
 #define dataset_is_empty(d) (((d)->size) == 0)
 
+/**
+ * @brief Macro that evaluates to non-zero if points live in a file
+ */
+#define dataset_is_mapped(d) (((d)->fd) >= 0)
+
+/**
+ * @brief Macro that evaluates to the bytes taken by a point in a mode
+ */
+#define dataset_point_size(mode) \
+    ((((mode) & DATASET_NO_EY) ? 2 : 3) * \
+     (((mode) & DATASET_SINGLE) ? sizeof(float) : sizeof(double)))
+
+/**
+ * @brief Macro that evaluates to non-zero if points carry group keys
+ */
+#define dataset_has_keys(d) (((d)->keys) != NULL)
+
 
 #endif  /* ! DATASET_H */
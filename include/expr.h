@@ -0,0 +1,132 @@
+/**
+ * @file expr.h
+ *
+ * @brief Declaration of the column expression engine
+ */
+
+#ifndef EXPR_H
+#define EXPR_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+
+
+#define EXPR_BLOCK      (1024)  /**< Points evaluated at once */
+#define EXPR_MAX_CODE   (256)   /**< Maximum number of instructions */
+#define EXPR_MAX_REGS   (64)    /**< Maximum number of registers */
+#define EXPR_MAX_COLS   (16)    /**< Maximum columns in an expression */
+#define EXPR_MAX_NAME   (32)    /**< Maximum length of a name, plus 1 */
+
+
+/**
+ * @brief Instructions of the bytecode
+ */
+typedef enum {
+    EXPR_OP_MOV,    /**< dst = a */
+    EXPR_OP_NEG,    /**< dst = -a */
+    EXPR_OP_ADD,    /**< dst = a + b */
+    EXPR_OP_SUB,    /**< dst = a - b */
+    EXPR_OP_MUL,    /**< dst = a * b */
+    EXPR_OP_DIV,    /**< dst = a / b */
+    EXPR_OP_POW,    /**< dst = a ^ b */
+    EXPR_OP_MIN,    /**< dst = min(a, b) */
+    EXPR_OP_MAX,    /**< dst = max(a, b) */
+    EXPR_OP_ABS,    /**< dst = abs(a) */
+    EXPR_OP_SQRT,   /**< dst = sqrt(a) */
+    EXPR_OP_LOG,    /**< dst = log(a) */
+    EXPR_OP_LOG10,  /**< dst = log10(a) */
+    EXPR_OP_EXP,    /**< dst = exp(a) */
+    EXPR_OP_SIN,    /**< dst = sin(a) */
+    EXPR_OP_COS,    /**< dst = cos(a) */
+    EXPR_OP_TAN,    /**< dst = tan(a) */
+    EXPR_OP_ATAN,   /**< dst = atan(a) */
+    EXPR_OP_MAX_OP
+} expr_op_e;
+
+
+/**
+ * @typedef expr_insn_td
+ *
+ * @brief Single instruction: operation on whole registers
+ */
+typedef struct {
+    expr_op_e op;   /**< Operation */
+    int dst;        /**< Destination register */
+    int a;          /**< First operand register */
+    int b;          /**< Second operand register (if any) */
+} expr_insn_td;
+
+
+/**
+ * @typedef expr_td
+ *
+ * @brief Compiled expression
+ *
+ * Registers hold a block of values each: the first @e n_cols hold the
+ * columns read or written, the next @e n_consts hold constants, and
+ * the rest are temporaries.
+ */
+typedef struct {
+    expr_insn_td code[EXPR_MAX_CODE];       /**< Instructions */
+    size_t n_code;                          /**< Number of instructions */
+    char cols[EXPR_MAX_COLS][EXPR_MAX_NAME];/**< Name of every column */
+    int col_written[EXPR_MAX_COLS];         /**< Non-zero if assigned */
+    size_t n_cols;                          /**< Number of columns */
+    double consts[EXPR_MAX_REGS];           /**< Value of every constant */
+    size_t n_consts;                        /**< Number of constants */
+    size_t n_regs;                          /**< Number of registers */
+} expr_td;
+
+
+/* Public interface */
+/**
+ * @brief Compile an expression to bytecode
+ *
+ * The language is a list of assignments separated by @c ';':
+ *
+ *     name = expression; name = expression; ...
+ *
+ * Names are @e x, @e y, @e ey or derived columns.  Assigning to @e x,
+ * @e y or @e ey replaces the column; assigning to any other name adds a
+ * derived column to the dataset (or replaces it, if it already exists),
+ * that later assignments can read.  Expressions use numbers, names,
+ * @c + @c - @c * @c / @c ^ (power), parentheses and the functions
+ * @e abs, @e sqrt, @e log, @e log10, @e exp, @e sin, @e cos, @e tan,
+ * @e atan, @e pow(a,b), @e min(a,b) and @e max(a,b).  Constant
+ * subexpressions are folded.  Example:
+ *
+ *     ey = ey / (2*sqrt(y)); y = sqrt(y); w = y / (1 + 0.003*x)
+ *
+ * @param e       Pointer to where the compiled expression is stored
+ * @param src     Source text
+ * @param ds      Dataset the expression will run on (to check names)
+ * @param err     Buffer where an error message is stored on failure
+ * @param err_len Size of @p err
+ *
+ * @return 0 on success, or 1 on a syntax error, unknown name or an
+ *         expression too large (see @p err)
+ */
+int expr_compile(expr_td *e, const char *src, const dataset_td *ds,
+        char *err, size_t err_len);
+
+/**
+ * @brief Run a compiled expression over every point of a dataset
+ *
+ * Points are processed a block of @c EXPR_BLOCK at a time: columns are
+ * loaded into registers, every instruction runs over the whole block
+ * in a tight loop (so the interpreter overhead is paid once per block
+ * and the loops vectorize), and assigned columns are stored back.
+ *
+ * @param e  Pointer to the compiled expression
+ * @param ds Pointer to the dataset
+ *
+ * @return 0 on success, or 2 on memory allocation failure
+ */
+int expr_run(const expr_td *e, dataset_td *ds);
+
+
+#endif  /* ! EXPR_H */
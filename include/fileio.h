@@ -8,11 +8,80 @@
 #define FILEIO_H
 
 
+/* System includes */
+#include <stdio.h>      /* FILE */
+
 /* Project includes */
 #include <dataset.h>
+#include <summary.h>
+
+
+#define FILEIO_NUM_MAX (32)     /**< Longest text of a formatted value,
+                                     null character included */
+#define FILEIO_MAX_LINE (4096)  /**< Longest line read from a file */
+
+
+/**
+ * @brief Values of a point read from the columns of a file
+ */
+typedef enum {
+    FILEIO_COL_X,   /**< Column of @e x */
+    FILEIO_COL_Y,   /**< Column of @e y */
+    FILEIO_COL_EY,  /**< Column of @e ey */
+    FILEIO_COL_MAX
+} fileio_col_e;
+
+
+/**
+ * @typedef fileio_opts_td
+ *
+ * @brief Options to load a data file (see @a fileio_opts_init())
+ */
+typedef struct {
+    int key_col;    /**< Column (from 0) holding a group key, or -1 if
+                         the file has no key column */
+    int mapped;     /**< 1 to keep the points in a scratch file (see
+                         @a dataset_init_mapped()), 0 to do so only if
+                         the file is larger than half the memory */
+    int single;     /**< 1 to round the values to single precision, so
+                         that they are stored in half the memory, 0 to
+                         do so only if no value changes */
+    char delim;     /**< Character between columns (e.g., ',' or '\t'),
+                         or '\0' for runs of blanks */
+    int cols[FILEIO_COL_MAX];   /**< Column (from 0) of every value
+                                     (see @e fileio_col_e), or -1 to
+                                     take the first columns that are
+                                     not the key, in order */
+    const char *names[FILEIO_COL_MAX];  /**< Name of the column of every
+                                             value in the first line of
+                                             the file (the header), or
+                                             @c NULL to use @e cols */
+    int tag_files;  /**< 1 to take the index of the file every point
+                         comes from as its group key, when several
+                         files are loaded (see @a fileio_load_many()) */
+    int summary;    /**< 1 to write the index of a text file as it is
+                         loaded, unless it is up to date (see
+                         @a fileio_summary()), 0 to leave it as it is */
+    int stale_journal;  /**< 1 to load a file whose journal was written
+                             for other contents without the points of
+                             the journal, 0 to fail (see
+                             @a journal_replay()) */
+} fileio_opts_td;
 
 
 /* Public interface */
+/**
+ * @brief Set the default options to load a data file
+ *
+ * No key column, points in memory unless the file is too large,
+ * values rounded to single precision only if none changes, and
+ * @e (x, y, [ey]) in the first columns, separated by blanks; files
+ * whose journal does not match them are not loaded.
+ *
+ * @param opts Pointer to the options to set
+ */
+void fileio_opts_init(fileio_opts_td *opts);
+
 /**
  * @brief Load data points from a text file into a dataset
  *
@@ -27,27 +96,225 @@
  *
  * @return 0 on success (file opened and read)
  *         1 on failure (could not open file)
+ *         2 on memory allocation failure (the dataset is left as it
+ *           was)
+ *         3 if the file is a compressed archive, or gzip or Zstandard
+ *           text, and it is corrupted or truncated
+ *         5 if the file is compressed in a format this build cannot read
+ *         6 if the file has a journal with points that was written for
+ *           other contents of the file (see @a journal_replay()); it
+ *           is loaded without them if @e opts->stale_journal is set
  *
- * @note The function reinitializes the dataset before loading (previous
- *       contents are destroyed)
+ * @note Compressed archives (see @a archive_save()) are told by their
+ *       first bytes, and loaded with @a archive_load()
+ * @note Apache Arrow IPC files are told by their first bytes too, and
+ *       loaded with @a arrow_load()
+ * @note Text files (not compressed) get an index next to them if
+ *       @e opts->summary is set, written as they are loaded unless it
+ *       is up to date (see @a fileio_summary())
+ * @note Text files compressed with gzip or Zstandard are told by their
+ *       first bytes too, and decompressed while they are parsed, by a
+ *       thread of their own (see @a stream_open()), with no temporary
+ *       file; whether they are loaded out of core is decided from
+ *       their compressed size
+ * @note The previous contents of the dataset are destroyed once the
+ *       whole file has been read
+ * @note Room for the points is reserved once, from the size of the
+ *       file and the length of its first lines (see
+ *       @a dataset_reserve())
+ * @note Files larger than half the physical memory are loaded out of
+ *       core: the points are mapped from a scratch file
+ * @note Points are stored in the most compact mode that holds their
+ *       values exactly (see @e dataset_mode_e): without @e ey if it is
+ *       0 everywhere, and in single precision if every value is exact
+ *       in it (e.g., small integers)
  * @note On successful load the dataset's @e is_modified flag is cleared
  */
 int fileio_load(const char *filename, dataset_td *ds);
 
+/**
+ * @brief Load data points from a text file into a dataset, with options
+ *
+ * Same as @a fileio_load(), but if @e opts->key_col is not negative,
+ * that column is read as the group key of every point: the other
+ * columns, in order, are @e (x, y, [ey]).  Keys are stored as integers
+ * if every key in the file is an integer literal, or as names
+ * otherwise (see @e dataset_td).
+ *
+ * Delimited files (CSV, TSV) are read if @e opts->delim is set, and
+ * the values can be taken from any column, by number or by its name
+ * in the header.  Columns that are not used are skipped while the
+ * line is split, without converting them, and the rest of the line is
+ * not even split once the last column used is read: wide files load
+ * about as fast as narrow ones.  Fields may be quoted.  As in any
+ * file, lines whose @e x or @e y is not a number (such as a header)
+ * are ignored, and so are lines longer than @c FILEIO_MAX_LINE.
+ * The names in @e opts->names choose the fields of Arrow files too.
+ *
+ * @param filename Path to the input text file
+ * @param ds       Pointer to the dataset to populate
+ * @param opts     Pointer to the load options, or @c NULL for defaults
+ *
+ * @return 0 on success (file opened and read)
+ *         1 on failure (could not open file)
+ *         2 on memory allocation failure (the dataset is left as it
+ *           was)
+ *         3 if the file is a compressed archive, or gzip or Zstandard
+ *           text, and it is corrupted or truncated
+ *         4 if a column named in @e opts->names is not in the header
+ *         5 if the file is compressed in a format this build cannot read
+ *         6 if the file has a journal with points that was written for
+ *           other contents of the file (see @a journal_replay()); it
+ *           is loaded without them if @e opts->stale_journal is set
+ */
+int fileio_load_opts(const char *filename, dataset_td *ds,
+        const fileio_opts_td *opts);
+
+/**
+ * @brief Load data points from an open text stream into a dataset
+ *
+ * Same as @a fileio_load_opts(), for a stream that may not be a file
+ * (e.g., the standard input).  Text compressed with gzip or Zstandard
+ * is told by its first bytes as in a file; a stream that cannot be
+ * rewound (a pipe) is parsed as it comes all the same, with no
+ * temporary file (see @a stream_open()).
+ *
+ * @param fp   Stream, at the beginning of the text (closed on return)
+ * @param ds   Pointer to the dataset to populate
+ * @param opts Pointer to the load options, or @c NULL for defaults
+ *
+ * @return 0 on success, or the error of @a fileio_load_opts()
+ *
+ * @note Compressed archives and Apache Arrow files are only read from
+ *       files (see @a fileio_load())
+ * @note The points belong to no file: the dataset's @e is_modified
+ *       flag is set, as if they had been entered
+ */
+int fileio_load_stream(FILE *fp, dataset_td *ds,
+        const fileio_opts_td *opts);
+
+/**
+ * @brief Load data points from several files into a single dataset
+ *
+ * Every file is read as @a fileio_load_opts() would, on a pool of up
+ * to @c FILEIO_MAX_THREADS threads, each one taking the next file
+ * left; their points are then appended in the order of the files to a
+ * dataset sized for all of them at once, in the widest storage mode
+ * any of them needs.  Group keys of the files are merged by their
+ * label, or, if @e opts->tag_files is set, replaced by the index of
+ * the file (the keys are then named after the files), so that
+ * @a group_fit() fits every file on its own.
+ *
+ * @param filenames Paths to the files, in order
+ * @param n         Number of files
+ * @param ds        Pointer to the dataset to populate
+ * @param opts      Pointer to the load options of every file, or
+ *                  @c NULL for defaults
+ * @param failed    Where to store the index of the first file that
+ *                  fails to load, or @c NULL
+ *
+ * @return 0 on success, or the error of @a fileio_load_opts() for the
+ *         first file that fails (1 also if @p n is 0); the dataset is
+ *         left as it was on failure
+ *
+ * @note The merged points are not those of any single file, so the
+ *       dataset is flagged as modified
+ */
+int fileio_load_many(const char *const *filenames, size_t n,
+        dataset_td *ds, const fileio_opts_td *opts, size_t *failed);
+
+/**
+ * @brief Load data points from every file matching a pattern
+ *
+ * The pattern is expanded as the shell would (see @a glob()), sorted
+ * by name, and the files are loaded with @a fileio_load_many().
+ *
+ * @param pattern Pattern of the paths, such as @c "runs/run*.txt"
+ * @param ds      Pointer to the dataset to populate
+ * @param opts    Pointer to the load options, or @c NULL for defaults
+ * @param n_files Where to store the number of files matched, or
+ *                @c NULL
+ *
+ * @return 0 on success, 1 if no file matches the pattern, or the error
+ *         of @a fileio_load_many()
+ */
+int fileio_load_glob(const char *pattern, dataset_td *ds,
+        const fileio_opts_td *opts, size_t *n_files);
+
 /**
  * @brief Save dataset points to a text file
  *
  * Writes each data point in the dataset to the specified file as three
- * floating-point columns: @e (x, y, ey).  After a successful save the
- * dataset's @e is_modified flag is cleared.
+ * floating-point columns: @e (x, y, ey), followed by the group key if
+ * the dataset has keys.  After a successful save the dataset's
+ * @e is_modified flag is cleared.
+ *
+ * Values are written with the fewest digits that read back exactly
+ * (see @a fileio_format()), so a saved dataset loads back bit for bit.
+ * Chunks of points are formatted in parallel into large buffers,
+ * which are written out in order.
+ *
+ * Text files that have an index get a new one, written along with
+ * them (see @a fileio_summary()); others are never indexed here.
+ *
+ * If @p filename ends in @c ARCHIVE_EXT, the dataset is saved as a
+ * compressed archive instead (see @a archive_save()), and if it ends
+ * in @c ARROW_EXT, as an Arrow IPC file (see @a arrow_save()).
  *
  * @param filename Path to the output text file
  * @param ds       Pointer to the dataset to save
  *
  * @return 0 on success (file opened and written),
- *         1 on failure (could not open file)
+ *         1 on failure (could not open or write file),
+ *         2 on memory allocation failure,
+ *         6 if the file would be rewritten while its journal holds
+ *           points the dataset may not have (it was not loaded along
+ *           with them): nothing is written, until the journal is
+ *           removed (see @a journal_remove())
  */
 int fileio_save(const char *filename, dataset_td *ds);
 
+/**
+ * @brief Get the summaries of the blocks of points of a data file
+ *
+ * Fits of the whole file, or of any run of whole blocks, are then
+ * merges of their moment sums (see @a summary_fit()).  If the file has
+ * an index written for the same options, and it is up to date (see
+ * @a summary_read()), the summaries are read from it, and the file is
+ * not parsed at all.  Otherwise the file is loaded as
+ * @a fileio_load_opts() would, and indexed on the way if
+ * @e opts->summary is set, so that the next call is instant.
+ *
+ * @param filename Path to the file
+ * @param opts     Pointer to the load options, or @c NULL for defaults
+ * @param sm       Pointer to the summaries to populate
+ *
+ * @return 0 on success, or the error of @a fileio_load_opts()
+ *
+ * @note Only text files that are not compressed are indexed: other
+ *       files, and files with points journaled since they were last
+ *       rewritten (see @a journal_append()), are loaded every time
+ */
+int fileio_summary(const char *filename, const fileio_opts_td *opts,
+        summary_td *sm);
+
+/**
+ * @brief Format a value with the fewest digits that read back exactly
+ *
+ * Digits are the fewest that @a strtod() reads back into the same
+ * bits, and the closest to the value when several are; they are found
+ * by Grisu3, or by trying precisions for the few values it cannot
+ * tell.  Values that are an integer below 2^53 divided by up to 17
+ * powers of ten, as most values read from text are, and those @e "%g"
+ * would print so, are printed in fixed notation; others, in scientific
+ * notation.
+ *
+ * @param v   Value to format
+ * @param buf Where to store the text, at least @c FILEIO_NUM_MAX bytes
+ *
+ * @return Length of the text, without the null character
+ */
+size_t fileio_format(double v, char *buf);
+
 
 #endif  /* ! FILEIO_H */
@@ -0,0 +1,124 @@
+/**
+ * @file follow.h
+ *
+ * @brief Declaration of the following of a growing data file
+ */
+
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+#include <sys/types.h>  /* off_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+
+
+#define FOLLOW_POLL_MS (250)        /**< Interval between checks of a
+                                         file that cannot be watched */
+#define FOLLOW_READ_SIZE (65536)    /**< Bytes read from the file at once */
+#define FOLLOW_BATCH (1UL << 24)    /**< Most bytes parsed by a single
+                                         call to @a follow_read() */
+#define FOLLOW_MAX_LINE (256)       /**< Longest line that is parsed */
+
+
+/**
+ * @typedef follow_td
+ *
+ * @brief State of a data file being followed as it grows
+ */
+typedef struct {
+    int fd;                 /**< Descriptor of the file */
+    int watch;              /**< Descriptor notified when the file is
+                                 written (inotify), or -1 if the file
+                                 is polled instead */
+    off_t offset;           /**< Bytes of the file already read */
+    int pending;            /**< Non-zero if the last read stopped
+                                 before the end of the file */
+    char line[FOLLOW_MAX_LINE]; /**< Last line read, not finished yet */
+    size_t line_len;        /**< Characters in @e line */
+    int line_long;          /**< Non-zero if the line does not fit in
+                                 @e line (it is then skipped) */
+    moments_td plain;       /**< Running sums of the points, unweighted */
+    moments_td weighted;    /**< Running sums weighted by @e 1/ey^2 */
+    int use_weights;        /**< Non-zero once a point has @e ey > 0,
+                                 as @a moments_use_weights() tells */
+} follow_td;
+
+
+/* Public interface */
+/**
+ * @brief Start following a data file
+ *
+ * The file is read from its first byte by @a follow_read().  It is
+ * watched with inotify where the system has it, so that
+ * @a follow_wait() wakes up as soon as it is written; otherwise it is
+ * checked every @c FOLLOW_POLL_MS milliseconds.
+ *
+ * @param f        Pointer to the state to initialize
+ * @param filename Path to the file, with whitespace-separated columns
+ *                 @e (x, y, [ey]) as @a fileio_load() reads them
+ *
+ * @return 0 on success, or 1 if the file cannot be opened
+ */
+int follow_open(follow_td *f, const char *filename);
+
+/**
+ * @brief Read what was appended to a followed file
+ *
+ * Only the bytes after the last ones read are parsed: every complete
+ * line with at least two numeric values is added to the dataset, and
+ * to the running moment sums, so that statistics and fits of all the
+ * points read so far are had in O(1) (see @a follow_moments()).  An
+ * unfinished last line is kept until its end is written.  At most
+ * @c FOLLOW_BATCH bytes are parsed per call, and @e f->pending tells
+ * if there are more.  A file that shrinks is taken as truncated: the
+ * running sums are cleared, and the file is read again from its start
+ * by the next call.
+ *
+ * @param f  Pointer to the state of the followed file
+ * @param ds Pointer to the dataset where the points are added (it
+ *           should hold only points read by this function)
+ *
+ * @return 0 on success, 1 on read failure, 2 on memory allocation
+ *         failure, or 3 if the file was truncated: nothing is read,
+ *         and the caller must empty @p ds before the next call
+ */
+int follow_read(follow_td *f, dataset_td *ds);
+
+/**
+ * @brief Wait until a followed file is written, or for another input
+ *
+ * @param f          Pointer to the state of the followed file
+ * @param fd         Another descriptor to wait for (e.g., the
+ *                   terminal), or -1 for none
+ * @param timeout_ms Most milliseconds to wait; files that are polled
+ *                   wait @c FOLLOW_POLL_MS at most
+ *
+ * @return 1 if @p fd can be read, or 0 otherwise
+ */
+int follow_wait(const follow_td *f, int fd, int timeout_ms);
+
+/**
+ * @brief Get the running moment sums of a followed file
+ *
+ * @param f Pointer to the state of the followed file
+ *
+ * @return Pointer to the sums to fit (weighted if any point read so far
+ *         has an error, as @a regres_linear() would), for
+ *         @a regres_from_moments()
+ */
+const moments_td *follow_moments(const follow_td *f);
+
+/**
+ * @brief Stop following a data file
+ *
+ * @param f Pointer to the state of the followed file
+ */
+void follow_close(follow_td *f);
+
+
+#endif  /* ! FOLLOW_H */
@@ -0,0 +1,62 @@
+/**
+ * @file group.h
+ *
+ * @brief Declaration of grouped (per key) regression
+ */
+
+#ifndef GROUP_H
+#define GROUP_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <regres.h>
+
+
+#define GROUP_MAX_THREADS (8)       /**< Maximum worker threads */
+#define GROUP_MIN_CHUNK   (65536)   /**< Minimum points per thread */
+
+
+/**
+ * @typedef group_fit_td
+ *
+ * @brief Structure with the regression of the points of a group
+ */
+typedef struct {
+    long key;           /**< Group key (see @e dataset_td) */
+    size_t n;           /**< Number of points in the group */
+    regression_td reg;  /**< Fit of the points of the group */
+} group_fit_td;
+
+
+/* Public interface */
+/**
+ * @brief Fit a straight line to the points of every group
+ *
+ * Accumulates the moment sums of every key into an open-addressing
+ * hash table in a single pass, then solves each group's fit from its
+ * sums.  Large datasets are split in chunks processed by worker
+ * threads, each one with its own table, and the tables are merged at
+ * the end.  Each group is weighted on its own, following the rule of
+ * @a regres_linear() for its points.
+ *
+ * @param ds     Pointer to the dataset, that must have group keys
+ * @param fits   Where to store a newly allocated array with the fit of
+ *               every group, sorted by key
+ * @param n_fits Where to store the number of groups
+ *
+ * @return 0 on success,
+ *         1 if the dataset has no group keys,
+ *         2 on memory allocation failure
+ *
+ * @note The caller must free the array stored in @p fits
+ * @note As in @a regres_from_moments(), propagation errors @e ea and
+ *       @e eb are set to 0
+ */
+int group_fit(const dataset_td *ds, group_fit_td **fits, size_t *n_fits);
+
+
+#endif  /* ! GROUP_H */
@@ -0,0 +1,141 @@
+/**
+ * @file journal.h
+ *
+ * @brief Declaration of the append-only journal of a saved dataset
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+
+/* Project includes */
+#include <dataset.h>
+
+
+#define JOURNAL_MAGIC "RGRSJN02"    /**< First bytes of a journal */
+#define JOURNAL_EXT ".jnl"          /**< Appended to the name of the file
+                                         a journal belongs to */
+#define JOURNAL_MIN_POINTS (4096)   /**< Points a journal may always hold
+                                         before it is compacted */
+#define JOURNAL_RATIO (4)           /**< A journal is compacted once it
+                                         holds more than 1/JOURNAL_RATIO
+                                         of the points of its file */
+
+
+/* Public interface */
+/**
+ * @brief Get the state of a file together with its journal
+ *
+ * The state changes whenever either of them is written, replaced or
+ * removed (it is made of their device, inode, size and modification
+ * time), so a dataset that remembers it can tell whether the file
+ * still holds what it last loaded or saved.
+ *
+ * @param filename Path to the file (not to the journal)
+ *
+ * @return State of the file, or 0 if the file does not exist
+ */
+uint64_t journal_state(const char *filename);
+
+/**
+ * @brief Append points of a dataset to the journal of a file
+ *
+ * Every point is stored as a record with its own checksum, and the
+ * journal is synced to disk before returning, so a crash leaves at
+ * worst a torn last record, which is dropped when the journal is read.
+ * The journal is created if the file has none, and is refused (so that
+ * the file is rewritten instead, see @a fileio_save()) once it would
+ * hold too many points: more than @c JOURNAL_MIN_POINTS and more than
+ * 1/@c JOURNAL_RATIO of the points of the file.
+ *
+ * @param filename Path to the file the points belong to
+ * @param ds       Pointer to the dataset
+ * @param begin    First point to append; points before it must be
+ *                 in the file or its journal already
+ *
+ * @return 0 on success, or 1 if the journal cannot be used (it is
+ *         stale, too large, or cannot be written; it is left as it was)
+ */
+int journal_append(const char *filename, const dataset_td *ds,
+        size_t begin);
+
+/**
+ * @brief Add the points journaled for a file to a dataset
+ *
+ * Reads the records of the journal of a file, if it has one that was
+ * written for the contents the file has now, and adds their points to
+ * a dataset just loaded from that file.  A journal is matched to its
+ * file by the size of the file and the checksum of its last bytes, so
+ * it still belongs to a copy of the file, or to the file once touched.
+ * Records after the first one that is torn or does not match its
+ * checksum are dropped, and cut off the journal, so that later appends
+ * follow the last good one.
+ *
+ * @param filename Path to the file the journal belongs to
+ * @param ds       Pointer to the dataset loaded from the file
+ *
+ * @return 0 on success (or if there is no journal to read),
+ *         1 if the journal was written for another number of points
+ *           (none is added), or its torn tail cannot be cut off: the
+ *           dataset then cannot be saved by appending to it,
+ *         2 on memory allocation failure (the points read so far are
+ *           kept),
+ *         3 if the journal holds records but was written for other
+ *           contents of the file (it was edited, or rewritten by an
+ *           older version): none is added, and the journal is kept
+ *           until removed (see @a journal_remove())
+ */
+int journal_replay(const char *filename, dataset_td *ds);
+
+/**
+ * @brief Tell if a file has points journaled since it was last
+ *        rewritten
+ *
+ * @param filename Path to the file (not to the journal)
+ *
+ * @return 1 if the file has a journal with records, whether or not it
+ *         was written for the contents the file has now (see
+ *         @a journal_replay()), or 0 otherwise
+ */
+int journal_pending(const char *filename);
+
+/**
+ * @brief Start a new, empty journal for a file
+ *
+ * Meant to be called right after the file is rewritten with every
+ * point of the dataset: the journal it had, if any, is removed, and a
+ * new one with no records is created, so that later saves can append
+ * to it.  The directory of the file is synced afterwards, so that the
+ * new journal, and the file if it was just renamed there, are durable.
+ *
+ * @param filename Path to the file
+ * @param n_points Number of points in the file
+ *
+ * @return 0 on success, or 1 if the journal cannot be created (later
+ *         saves then rewrite the file)
+ *
+ * @note The records of the journal are lost: the caller must make sure
+ *       that the file was rewritten with their points, or that the user
+ *       agreed to drop them (see @a journal_pending())
+ */
+int journal_reset(const char *filename, size_t n_points);
+
+/**
+ * @brief Remove the journal of a file, with the points it holds
+ *
+ * Meant to be called once the user agrees to drop the points of a
+ * journal that was written for other contents of its file (see
+ * @a journal_replay()).
+ *
+ * @param filename Path to the file (not to the journal)
+ *
+ * @return 0 on success (or if there is no journal), or 1 on failure
+ */
+int journal_remove(const char *filename);
+
+
+#endif  /* ! JOURNAL_H */
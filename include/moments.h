@@ -0,0 +1,145 @@
+/**
+ * @file moments.h
+ *
+ * @brief Declaration of moment sums used to build least squares fits
+ */
+
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <slice.h>
+
+
+/**
+ * @typedef moments_td
+ *
+ * @brief Sufficient statistics of a (weighted) straight line fit
+ *
+ * Sums are taken about an origin @e (x0, y0) to reduce cancellation
+ * when data has a large offset.  Two sets of sums that share the same
+ * origin and weighting can be merged or subtracted, which makes
+ * partial fits (folds, ranges, groups) cost O(1) once their sums are
+ * known.
+ */
+typedef struct {
+    double x0;      /**< Origin of the @e x values */
+    double y0;      /**< Origin of the @e y values */
+    double s;       /**< Sum(w) */
+    double sx;      /**< Sum(w*u), with u = x - x0 */
+    double sy;      /**< Sum(w*v), with v = y - y0 */
+    double sxx;     /**< Sum(w*u^2) */
+    double sxy;     /**< Sum(w*u*v) */
+    double syy;     /**< Sum(w*v^2) */
+    size_t n;       /**< Number of points accumulated */
+    int weighted;   /**< If non-zero, w = 1/ey^2 (0 if ey <= 0) */
+} moments_td;
+
+
+/* Public interface */
+/**
+ * @brief Initialize an empty set of moment sums
+ *
+ * @param m        Pointer to the moments to initialize
+ * @param x0       Origin of the @e x values
+ * @param y0       Origin of the @e y values
+ * @param weighted If non-zero, points are weighted by @e 1/ey^2
+ */
+void moments_init(moments_td *m, double x0, double y0, int weighted);
+
+/**
+ * @brief Add a single point to the moment sums
+ *
+ * @param m  Pointer to the moments to update
+ * @param x  The @e x value of the point
+ * @param y  The @e y value of the point
+ * @param ey The @e y error of the point (ignored if not weighted)
+ */
+void moments_add(moments_td *m, double x, double y, double ey);
+
+/**
+ * @brief Accumulate a range of dataset points into the moment sums
+ *
+ * @param m     Pointer to the moments to update
+ * @param ds    Pointer to the dataset to read
+ * @param begin Index of the first point to accumulate
+ * @param end   Index one past the last point to accumulate
+ */
+void moments_accumulate(moments_td *m, const dataset_td *ds,
+        size_t begin, size_t end);
+
+/**
+ * @brief Accumulate the points of a slice into the moment sums
+ *
+ * Reads the points in place, 64 at a time, with vectorized loops:
+ * points left out by the selection bitmap are masked with selects
+ * rather than branches.  The order of the additions differs from
+ * @a moments_accumulate(), so results may differ in the last bits.
+ *
+ * @param m Pointer to the moments to update
+ * @param s Pointer to the slice to read
+ */
+void moments_accumulate_slice(moments_td *m, const slice_td *s);
+
+/**
+ * @brief Merge two sets of moment sums @e (m += o)
+ *
+ * @param m Pointer to the moments to update
+ * @param o Pointer to the moments to add
+ *
+ * @warning Both sets must share the same origin and weighting
+ */
+void moments_merge(moments_td *m, const moments_td *o);
+
+/**
+ * @brief Subtract a subset of moment sums @e (m -= o)
+ *
+ * @param m Pointer to the moments to update
+ * @param o Pointer to the moments of a subset of @p m to remove
+ *
+ * @warning Both sets must share the same origin and weighting
+ */
+void moments_sub(moments_td *m, const moments_td *o);
+
+/**
+ * @brief Move the origin of a set of moment sums
+ *
+ * Rewrites the sums about a new origin @e (x0, y0) exactly, so that
+ * sums taken about different origins can then be merged.
+ *
+ * @param m  Pointer to the moments to update
+ * @param x0 New origin of the @e x values
+ * @param y0 New origin of the @e y values
+ */
+void moments_shift(moments_td *m, double x0, double y0);
+
+/**
+ * @brief Tell if a dataset has to be fitted with weights
+ *
+ * Applies the same rule as @a regres_linear(): the fit is weighted as
+ * soon as any point has a positive error @e ey.
+ *
+ * @param ds Pointer to the dataset to check
+ *
+ * @return 1 if the fit must be weighted, 0 otherwise
+ */
+int moments_use_weights(const dataset_td *ds);
+
+/**
+ * @brief Tell if a slice has to be fitted with weights
+ *
+ * Same as @a moments_use_weights(), for the points of a slice only.
+ *
+ * @param s Pointer to the slice to check
+ *
+ * @return 1 if the fit must be weighted, 0 otherwise
+ */
+int moments_slice_use_weights(const slice_td *s);
+
+
+#endif  /* ! MOMENTS_H */
@@ -0,0 +1,74 @@
+/**
+ * @file piecewise.h
+ *
+ * @brief Declaration of segmented (piecewise linear) regression
+ */
+
+#ifndef PIECEWISE_H
+#define PIECEWISE_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <regres.h>
+#include <xindex.h>
+
+
+#define PIECEWISE_MAX_BREAKS     (8)    /**< Maximum breakpoints */
+#define PIECEWISE_MIN_POINTS     (3)    /**< Minimum points per segment */
+#define PIECEWISE_MAX_CANDIDATES (2048) /**< Breakpoint candidates kept
+                                             for multi-break searches */
+
+
+/**
+ * @typedef piecewise_td
+ *
+ * @brief Structure with the result of a segmented regression
+ */
+typedef struct {
+    size_t n_breaks;                        /**< Number of breakpoints */
+    double breaks[PIECEWISE_MAX_BREAKS];    /**< Breakpoint locations,
+                                                 in increasing order */
+    regression_td seg[PIECEWISE_MAX_BREAKS + 1];    /**< Segment fits */
+    size_t seg_n[PIECEWISE_MAX_BREAKS + 1]; /**< Points per segment */
+    double chisq;                           /**< Total (weighted) sum of
+                                                 squared residuals */
+} piecewise_td;
+
+
+/* Public interface */
+/**
+ * @brief Fit independent straight lines to consecutive ranges of @e x
+ *
+ * Looks for the breakpoints that minimize the total (weighted) sum of
+ * squared residuals when every segment gets its own line.  The cost of
+ * any candidate segment is computed in O(1) from the prefix sums of
+ * the index, so a single breakpoint is found in O(n).  Several
+ * breakpoints are placed by dynamic programming over the candidate
+ * positions, O(k m^2) with @e m candidates; for more than one
+ * breakpoint, candidates are thinned to @c PIECEWISE_MAX_CANDIDATES
+ * evenly spaced positions.
+ *
+ * Breakpoints are only placed between distinct @e x values, and every
+ * segment holds at least @c PIECEWISE_MIN_POINTS points.  Each
+ * breakpoint is reported at the midpoint between the last @e x of a
+ * segment and the first @e x of the next one.
+ *
+ * @param idx Pointer to the prefix-sum index of the dataset
+ * @param k   Number of breakpoints (1 to @c PIECEWISE_MAX_BREAKS)
+ * @param pw  Pointer to the structure where results are stored
+ *
+ * @return 0 on success,
+ *         1 if @p k is out of range or there are too few distinct
+ *           @e x values for @p k breakpoints,
+ *         2 on memory allocation failure
+ *
+ * @note Segments are fitted independently: lines are not forced to
+ *       meet at the breakpoints
+ */
+int piecewise_fit(const xindex_td *idx, size_t k, piecewise_td *pw);
+
+
+#endif  /* ! PIECEWISE_H */
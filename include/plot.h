@@ -9,7 +9,9 @@
 
 
 /* Project includes */
+#include <bins.h>
 #include <dataset.h>
+#include <slice.h>
 
 
 #define PLOT_MAX_TEMP_FILES (256)   /**< Maximum number of temporary
@@ -36,5 +38,34 @@
  */
 void plot_data(const dataset_td *ds, double a, double b);
 
+/**
+ * @brief Plot the points of a slice of a dataset and the regression
+ *        line using @c gnuplot
+ *
+ * Same as @a plot_data(), for the points of a range or selection of
+ * the dataset (see @a slice_masked()).
+ *
+ * @param s Pointer to the slice to plot (must not be @c NULL)
+ * @param a Intercept of the regression line @e (y = a + b*x)
+ * @param b Slope of the regression line @e (y = a + b*x)
+ */
+void plot_data_slice(const slice_td *s, double a, double b);
+
+/**
+ * @brief Plot the bins of a dataset and the regression line using
+ *        @c gnuplot
+ *
+ * Plots one point per non-empty bin, at the mean @e x and mean @e y of
+ * the bin, with the standard deviation of @e y as error bar, so that
+ * datasets too large to draw point by point can still be inspected.
+ *
+ * @param bins Pointer to the bins to plot (must not be @c NULL)
+ * @param a    Intercept of the regression line @e (y = a + b*x)
+ * @param b    Slope of the regression line @e (y = a + b*x)
+ *
+ * @note Same temporary-file handling as @a plot_data()
+ */
+void plot_bins(const bins_td *bins, double a, double b);
+
 
 #endif  /* ! PLOT_H  */
@@ -8,8 +8,13 @@
 #define REGRES_H
 
 
+/* System includes */
+#include <stddef.h>     /* size_t */
+
 /* Project includes */
 #include <dataset.h>
+#include <moments.h>
+#include <slice.h>
 
 
 /**
@@ -28,6 +33,37 @@ typedef struct {
 } regression_td;
 
 
+/**
+ * @typedef influence_td
+ *
+ * @brief Structure with leave-one-out diagnostics of a single point
+ */
+typedef struct {
+    double h;       /**< Leverage (diagonal of the hat matrix) */
+    double rstud;   /**< Externally studentized residual */
+    double cook;    /**< Cook's distance */
+    double da;      /**< Change in 'a' when the point is dropped */
+    double db;      /**< Change in 'b' when the point is dropped */
+} influence_td;
+
+
+/**
+ * @typedef crossval_td
+ *
+ * @brief Structure with the out-of-sample error of a linear fit
+ */
+typedef struct {
+    size_t k;       /**< Number of folds used */
+    size_t n_pred;  /**< Number of held-out points predicted */
+    double rmse;    /**< Root mean squared error of held-out points
+                         (weighted by 1/ey^2 if the fit is) */
+    double b_mean;  /**< Mean slope of the training fits */
+    double b_sd;    /**< Standard deviation of the slope across folds */
+    double b_min;   /**< Smallest slope of the training fits */
+    double b_max;   /**< Largest slope of the training fits */
+} crossval_td;
+
+
 /* Public interface */
 /**
  * @brief Compute simple linear regression @e (y = a + b*x) for a data set
@@ -53,5 +89,91 @@ typedef struct {
  */
 regression_td regres_linear(const dataset_td *ds);
 
+/**
+ * @brief Compute simple linear regression @e (y = a + b*x) for a slice
+ *        of a data set
+ *
+ * Same as @a regres_linear(), for the points of a range or selection
+ * of the dataset (see @a slice_masked()), which are read in place: no
+ * point is copied and nothing is allocated.
+ *
+ * @param s Pointer to the slice to fit
+ *
+ * @return A regression_td structure, as for @a regres_linear()
+ */
+regression_td regres_linear_slice(const slice_td *s);
+
+/**
+ * @brief Compute leave-one-out diagnostics for every point of a data set
+ *
+ * Evaluates, for each point, its leverage, its externally studentized
+ * residual, its Cook's distance and the change in the fitted @e a and
+ * @e b if that point were removed from the fit.  All quantities follow
+ * in closed form from the sums @e S, @e Sx, @e Sxx, ... of the full
+ * fit, so the whole set is computed in O(n) without refitting.
+ *
+ * Weighting follows @a regres_linear(): if any @e ey is positive,
+ * weights are @e 1/ey^2 (zero for points without error).
+ *
+ * @param ds  Pointer to the dataset to analyze
+ * @param out Array of at least @e ds->size elements where the
+ *            diagnostics are stored, in dataset order
+ *
+ * @return 0 on success,
+ *         1 if the dataset has fewer than three points or all @e x
+ *         values are identical (nothing is written to @p out)
+ *
+ * @note Quantities that are undefined for a point (leverage equal to
+ *       one, i.e., the fit cannot be done without it) are set to
+ *       @c NAN
+ */
+int regres_influence(const dataset_td *ds, influence_td *out);
+
+/**
+ * @brief Compute a linear regression from its moment sums
+ *
+ * Gives the same @e a, @e b, @e sa, @e sb and @e r as
+ * @a regres_linear() would for the points accumulated in @p m, in O(1).
+ *
+ * @param m Pointer to the moment sums of the points to fit
+ *
+ * @return A regression_td structure (see @a regres_linear())
+ *
+ * @note Propagation errors @e ea and @e eb depend on every single
+ *       point and cannot be recovered from the sums: they are set to 0
+ * @note Fewer than two points or zero variance in @e x give all fields
+ *       set to zero, as in @a regres_linear()
+ */
+regression_td regres_from_moments(const moments_td *m);
+
+/**
+ * @brief Estimate the out-of-sample error of the linear fit
+ *
+ * Performs a @e k-fold cross-validation: point @e i belongs to fold
+ * @e (i mod k), every fold is predicted by the fit of the other ones,
+ * and the held-out residuals give the cross-validated RMSE (weighted
+ * by @e 1/ey^2 if the fit is, see @a regres_linear()).  The moment
+ * sums of each fold are computed once and every training fit is the
+ * total minus its fold, so the cost is two passes over the data
+ * whatever the value of @e k.  If @e k is equal to or larger than the
+ * number of points, leave-one-out cross-validation is done.
+ *
+ * @param ds Pointer to the dataset to validate
+ * @param k  Number of folds (at least 2)
+ * @param cv Pointer to the structure where results are stored
+ *
+ * @return 0 on success,
+ *         1 if the dataset has fewer than three points, @p k is less
+ *           than two, or no training fit could be done,
+ *         2 on memory allocation failure
+ *
+ * @note Folds whose training fit is degenerate (all remaining @e x
+ *       values identical) are skipped
+ * @note In a weighted fit, held-out points without a positive @e ey
+ *       weigh nothing, as in the fit; if no point predicted has one,
+ *       1 is returned
+ */
+int regres_crossval(const dataset_td *ds, size_t k, crossval_td *cv);
+
 
 #endif  /* ! REGRES_H */
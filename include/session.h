@@ -0,0 +1,140 @@
+/**
+ * @file session.h
+ *
+ * @brief Declaration of the snapshot of a session, to restart from it
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+
+/* Project includes */
+#include <bins.h>
+#include <dataset.h>
+#include <regres.h>
+#include <stats.h>
+#include <summary.h>
+#include <view.h>
+
+
+#define SESSION_MAGIC "RGRSSN02"    /**< First bytes of a snapshot */
+#define SESSION_FILE ".regres_session"  /**< Name of the snapshot, in the
+                                             home directory */
+#define SESSION_ALIGN (65536)       /**< Alignment of the columns in a
+                                         snapshot (a multiple of the page
+                                         size) */
+
+
+/**
+ * @typedef session_cache_td
+ *
+ * @brief Results computed for the data of a session, until it changes
+ */
+typedef struct {
+    int has_stats;          /**< Non-zero if @e stats is up to date */
+    stats_td stats;         /**< Statistics of the data */
+    int has_fit;            /**< Non-zero if @e reg, and the
+                                 cross-validations, are up to date */
+    regression_td reg;      /**< Linear regression of the data */
+    int has_kfold;          /**< Non-zero if @e kfold could be done */
+    crossval_td kfold;      /**< @e k-fold cross-validation */
+    int has_loo;            /**< Non-zero if @e loo could be done */
+    crossval_td loo;        /**< Leave-one-out cross-validation */
+    summary_td *summary;    /**< Summaries of the blocks of the file the
+                                 data was loaded from, point for point
+                                 (see @a fileio_summary()), or @c NULL;
+                                 never stored in a snapshot */
+    bins_td *bins;          /**< Bins of the data, once a large dataset
+                                 is plotted or summarized from them (see
+                                 @a bins_build()), or @c NULL; never
+                                 stored in a snapshot */
+} session_cache_td;
+
+
+/* Public interface */
+/**
+ * @brief Initialize the results computed for the data of a session,
+ *        as none
+ *
+ * @param cache Pointer to the results
+ */
+void session_cache_init(session_cache_td *cache);
+
+/**
+ * @brief Forget the results computed for the data of a session
+ *
+ * @param cache Pointer to the results, initialized
+ */
+void session_cache_clear(session_cache_td *cache);
+
+/**
+ * @brief Get the path of the snapshot of the last session
+ *
+ * @return Path of @c SESSION_FILE in the directory given by @c HOME (or
+ *         in the current one, if not set), to be freed, or @c NULL on
+ *         memory allocation failure
+ */
+char *session_path(void);
+
+/**
+ * @brief Save a snapshot of a session
+ *
+ * Stores the points of the dataset, its group keys and derived
+ * columns as they are laid out in memory, each one at an offset
+ * aligned to @c SESSION_ALIGN, so that they can be mapped back as they
+ * are; and along with them, the rest of the dataset, the transform
+ * stacks of the view, the current file name and the results computed.
+ * The snapshot is written to a temporary file renamed over the
+ * previous one, so a session that maps it is not disturbed.
+ *
+ * @param path     Path to the snapshot
+ * @param ds       Pointer to the dataset
+ * @param view     Pointer to the view of the dataset
+ * @param filename Current file name, or @c NULL
+ * @param cache    Pointer to the results computed, or @c NULL
+ *
+ * @return 0 on success, or 1 on failure (the previous snapshot, if
+ *         any, is left as it was)
+ */
+int session_save(const char *path, const dataset_td *ds,
+        const view_td *view, const char *filename,
+        const session_cache_td *cache);
+
+/**
+ * @brief Tell the number of points in a snapshot
+ *
+ * @param path Path to the snapshot
+ *
+ * @return Number of points, or 0 if there is no valid snapshot
+ */
+size_t session_points(const char *path);
+
+/**
+ * @brief Restore a session from a snapshot
+ *
+ * The columns are mapped from the snapshot (see @a arena_map()), not
+ * read: restoring a session takes the same time whatever the number of
+ * points, and their pages are only read from disk as they are used.
+ * Only the description of the columns is checked against corruption,
+ * not the columns themselves.
+ *
+ * @param path     Path to the snapshot
+ * @param ds       Pointer to the dataset to replace
+ * @param view     Pointer to the view of @p ds, whose stacks are
+ *                 replaced
+ * @param filename Where to store the current file name (to be freed),
+ *                 or @c NULL if there was none
+ * @param cache    Pointer to where the results computed are stored
+ *
+ * @return 0 on success,
+ *         1 if there is no snapshot, or it cannot be mapped,
+ *         2 on memory allocation failure,
+ *         3 if the snapshot is corrupted, or was written by a machine
+ *           of another byte order;
+ *         nothing is changed on failure
+ */
+int session_load(const char *path, dataset_td *ds, view_td *view,
+        char **filename, session_cache_td *cache);
+
+
+#endif  /* ! SESSION_H */
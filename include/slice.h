@@ -0,0 +1,145 @@
+/**
+ * @file slice.h
+ *
+ * @brief Declaration of non-owning slices of a dataset
+ */
+
+#ifndef SLICE_H
+#define SLICE_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+
+/* Project includes */
+#include <dataset.h>
+
+
+#define SLICE_WORD_BITS 64  /**< Points per word of a selection bitmap */
+#define SLICE_LANES 4       /**< Partial sums kept by slice kernels */
+
+
+/**
+ * @typedef slice_td
+ *
+ * @brief Subset of the points of a dataset, without copying them
+ *
+ * A slice is a range of point indices, optionally narrowed by a
+ * selection bitmap where bit @e i (of word @e i/64) selects point
+ * @e i of the dataset.  The bitmap is indexed like the dataset, not
+ * like the range, so a single mask (e.g., points excluded by hand) can
+ * be shared by several ranges.  Neither the dataset nor the bitmap are
+ * owned by the slice, and both must outlive it.
+ */
+typedef struct {
+    const dataset_td *ds;   /**< Dataset the points belong to */
+    size_t begin;           /**< First point of the range */
+    size_t end;             /**< One past the last point of the range */
+    const uint64_t *mask;   /**< Selection bitmap, with at least
+                                 @e slice_mask_words(end) words, or
+                                 @c NULL to select the whole range */
+} slice_td;
+
+
+/* Public interface */
+/**
+ * @brief Make a slice with every point of a dataset
+ *
+ * @param ds Pointer to the dataset
+ *
+ * @return Slice over all the points of @p ds
+ */
+slice_td slice_all(const dataset_td *ds);
+
+/**
+ * @brief Make a slice with a range of points of a dataset
+ *
+ * @param ds    Pointer to the dataset
+ * @param begin First point of the range
+ * @param end   One past the last point of the range
+ *
+ * @return Slice over the range, clamped to the size of @p ds
+ */
+slice_td slice_range(const dataset_td *ds, size_t begin, size_t end);
+
+/**
+ * @brief Make a slice with the selected points of a range of a dataset
+ *
+ * @param ds    Pointer to the dataset
+ * @param begin First point of the range
+ * @param end   One past the last point of the range
+ * @param mask  Selection bitmap, indexed like the points of @p ds
+ *
+ * @return Slice over the selected points of the range, clamped to the
+ *         size of @p ds
+ */
+slice_td slice_masked(const dataset_td *ds, size_t begin, size_t end,
+        const uint64_t *mask);
+
+/**
+ * @brief Get the selected points of a word of a slice
+ *
+ * @param s Pointer to the slice
+ * @param w Index of the word, covering points @e 64*w to @e 64*w+63
+ *
+ * @return Bit @e j set if point @e 64*w+j is in the range and selected
+ */
+uint64_t slice_bits(const slice_td *s, size_t w);
+
+/**
+ * @brief Count the points of a slice
+ *
+ * @param s Pointer to the slice
+ *
+ * @return Number of selected points in the range
+ */
+size_t slice_count(const slice_td *s);
+
+/**
+ * @brief Count the bits set in a word
+ *
+ * @param bits Word of a selection bitmap
+ *
+ * @return Number of bits set in @p bits
+ */
+unsigned slice_popcount(uint64_t bits);
+
+/**
+ * @brief Expand a word of a selection bitmap into selection flags
+ *
+ * Kernels test the flags with floating point compares, which vectorize
+ * where per-point shifts of a 64-bit word do not.
+ *
+ * @param bits Word of a selection bitmap
+ * @param len  Number of flags to write (at most 64)
+ * @param on   Where to store 1.0 for every bit set, and 0.0 otherwise
+ */
+void slice_expand(uint64_t bits, size_t len, double *on);
+
+/**
+ * @brief Macro that evaluates to the words of a bitmap of @p n points
+ */
+#define slice_mask_words(n) (((n) + SLICE_WORD_BITS - 1) / SLICE_WORD_BITS)
+
+/**
+ * @brief Macro that evaluates to non-zero if point @p i is selected
+ */
+#define slice_mask_get(mask, i) \
+    ((int) (((mask)[(i) / SLICE_WORD_BITS] >> ((i) % SLICE_WORD_BITS)) & 1u))
+
+/**
+ * @brief Macro that selects point @p i in a bitmap
+ */
+#define slice_mask_set(mask, i) \
+    ((mask)[(i) / SLICE_WORD_BITS] |= (uint64_t) 1 << ((i) % SLICE_WORD_BITS))
+
+/**
+ * @brief Macro that deselects point @p i in a bitmap
+ */
+#define slice_mask_clear(mask, i) \
+    ((mask)[(i) / SLICE_WORD_BITS] &= \
+        ~((uint64_t) 1 << ((i) % SLICE_WORD_BITS)))
+
+
+#endif  /* ! SLICE_H */
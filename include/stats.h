@@ -16,6 +16,8 @@
 
 /* Project includes */
 #include <dataset.h>
+#include <moments.h>
+#include <slice.h>
 
 
 /**
@@ -54,5 +56,29 @@ typedef struct {
  */
 stats_td stats_compute(const dataset_td *ds);
 
+/**
+ * @brief Compute statistics from a slice of a dataset
+ *
+ * Same as @a stats_compute(), for the points of a range or selection
+ * of the dataset (see @a slice_masked()), read in place.
+ *
+ * @param s Pointer to the slice
+ *
+ * @return Structure containing the computed statistics
+ */
+stats_td stats_compute_slice(const slice_td *s);
+
+/**
+ * @brief Compute statistics from unweighted moment sums
+ *
+ * Gives the same values as @a stats_compute() for the points
+ * accumulated in @p m, in O(1).
+ *
+ * @param m Pointer to unweighted moment sums (@e m->weighted = 0)
+ *
+ * @return Structure containing the computed statistics
+ */
+stats_td stats_from_moments(const moments_td *m);
+
 
 #endif  /* ! STATS_H */
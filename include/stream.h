@@ -0,0 +1,140 @@
+/**
+ * @file stream.h
+ *
+ * @brief Declaration of the reading of text files that may be compressed
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+
+/* System includes */
+#include <pthread.h>    /* pthread_cond_t, pthread_mutex_t, pthread_t */
+#include <stddef.h>     /* size_t */
+#include <stdio.h>      /* FILE */
+
+
+#define STREAM_SLOTS (4)            /**< Buffers in the ring between the
+                                         decompressing thread and the
+                                         reader */
+#define STREAM_SLOT_SIZE (1UL << 20)    /**< Bytes of text per buffer */
+#define STREAM_IN_SIZE (1UL << 18)  /**< Compressed bytes read at once */
+#define STREAM_MAGIC_LEN (4)        /**< Bytes looked at to tell the
+                                         compression */
+
+
+/**
+ * @brief Compression of a file, as told by its first bytes
+ */
+typedef enum {
+    STREAM_PLAIN,   /**< Not compressed */
+    STREAM_GZIP,    /**< gzip (RFC 1952), one member or more */
+    STREAM_ZSTD     /**< Zstandard (RFC 8878), one frame or more */
+} stream_kind_e;
+
+
+/**
+ * @typedef stream_td
+ *
+ * @brief Text file being read, decompressed on the fly if needed
+ */
+typedef struct {
+    FILE *fp;               /**< File being read */
+    int kind;               /**< Compression of the file
+                                 (@e stream_kind_e) */
+    unsigned char back[STREAM_MAGIC_LEN];   /**< First bytes of a file
+                                                 that cannot seek back
+                                                 to them (a pipe), read
+                                                 again from here */
+    size_t n_back;          /**< Bytes in @e back */
+    size_t back_pos;        /**< Bytes of @e back already read again */
+    int threaded;           /**< Non-zero if a thread decompresses the
+                                 file into @e slots */
+    pthread_t thread;       /**< Decompressing thread */
+    pthread_mutex_t lock;   /**< Guards the fields below */
+    pthread_cond_t filled;  /**< Signaled when a slot is filled */
+    pthread_cond_t emptied; /**< Signaled when a slot is read */
+    char *slots[STREAM_SLOTS];  /**< Ring of buffers of text */
+    size_t lens[STREAM_SLOTS];  /**< Bytes of text in every slot */
+    size_t head;            /**< Slot being read */
+    size_t count;           /**< Slots filled and not read yet */
+    size_t pos;             /**< Bytes already read of the slot at
+                                 @e head */
+    int done;               /**< Non-zero once the thread has ended */
+    int stop;               /**< Non-zero to make the thread end early */
+    int err;                /**< Error of the thread (see
+                                 @a stream_close()) */
+} stream_td;
+
+
+/* Public interface */
+/**
+ * @brief Start reading a text file, decompressing it if needed
+ *
+ * gzip and Zstandard files are told by their first bytes, whatever
+ * their name.  They are decompressed by a thread of their own, in
+ * buffers of @c STREAM_SLOT_SIZE bytes, into a ring of @c STREAM_SLOTS
+ * of them that @a stream_gets() reads from: the text is parsed while
+ * the next buffers are being decompressed, and no more than the ring
+ * is ever held in memory, nor written to disk.  Other files are read
+ * as they are.
+ *
+ * The first bytes are read again from the file if it can seek back to
+ * them, and kept in the stream otherwise, so that a pipe is read as it
+ * comes too.
+ *
+ * @param s  Pointer to the stream to initialize
+ * @param fp File open for reading, at the start of the text (it
+ *           belongs to the stream from then on, even on failure)
+ *
+ * @return 0 on success,
+ *         1 if the decompressing thread cannot be started,
+ *         2 on memory allocation failure,
+ *         5 if the file is compressed in a format this build cannot
+ *           read (see the Makefile);
+ *         the file is closed on failure
+ */
+int stream_open(stream_td *s, FILE *fp);
+
+/**
+ * @brief Read a line of text from a stream
+ *
+ * Same as @a fgets(): reads up to the end of the line (included), or
+ * up to @p size - 1 characters, and null-terminates them.
+ *
+ * @param buf  Buffer for the line
+ * @param size Size of @p buf (at least 2)
+ * @param s    Pointer to the stream
+ *
+ * @return @p buf, or @c NULL at the end of the text (or if the file
+ *         cannot be decompressed any further, as @a stream_close()
+ *         then tells)
+ */
+char *stream_gets(char *buf, size_t size, stream_td *s);
+
+/**
+ * @brief Tell how far a stream has been read
+ *
+ * @param s Pointer to the stream
+ *
+ * @return Bytes of the file read so far, or -1 if it is compressed
+ *         (the bytes of text it holds are not known until the end), or
+ *         it cannot tell (a pipe)
+ */
+long stream_tell(stream_td *s);
+
+/**
+ * @brief Stop reading a stream, and close its file
+ *
+ * @param s Pointer to the stream
+ *
+ * @return 0 if the text was read without errors (or the reading was
+ *           stopped before its end),
+ *         1 if the file cannot be read,
+ *         2 on memory allocation failure while decompressing,
+ *         3 if the compressed data is corrupted or truncated
+ */
+int stream_close(stream_td *s);
+
+
+#endif  /* ! STREAM_H */
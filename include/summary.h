@@ -0,0 +1,210 @@
+/**
+ * @file summary.h
+ *
+ * @brief Declaration of the block-summary index of a data file
+ */
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+
+#define SUMMARY_MAGIC "RGRSIX01"    /**< First bytes of an index */
+#define SUMMARY_EXT ".idx"          /**< Appended to the name of the file
+                                         an index belongs to */
+#define SUMMARY_BLOCK (65536)       /**< Points per block */
+
+
+/**
+ * @typedef summary_block_td
+ *
+ * @brief Summary of a block of consecutive points of a file
+ *
+ * Moment sums are taken about the first point of the block, and can be
+ * moved to any other origin (see @a moments_shift()) to be merged with
+ * those of other blocks.
+ */
+typedef struct {
+    moments_td plain;       /**< Unweighted sums */
+    moments_td weighted;    /**< Sums weighted by 1/ey^2 */
+    double x_min;           /**< Smallest @e x of the block */
+    double x_max;           /**< Largest @e x of the block */
+    double y_min;           /**< Smallest @e y of the block */
+    double y_max;           /**< Largest @e y of the block */
+    int has_ey;             /**< Non-zero if any @e ey is positive */
+    uint64_t end;           /**< Offset in the file one past the last
+                                 byte the block was read from */
+    uint64_t hash;          /**< Checksum of the bytes of the block, from
+                                 the end of the previous one */
+} summary_block_td;
+
+
+/**
+ * @typedef summary_td
+ *
+ * @brief Points of a file summarized in blocks of @c SUMMARY_BLOCK
+ *
+ * Block @e k holds points @e [k*SUMMARY_BLOCK, (k+1)*SUMMARY_BLOCK) of
+ * the file (the last one may hold fewer), so the fit of the whole file,
+ * or of any run of whole blocks, is a merge of their sums.
+ */
+typedef struct {
+    size_t n;               /**< Number of points summarized */
+    size_t n_blocks;        /**< Number of blocks */
+    uint64_t options;       /**< Identity of the options the file was
+                                 read with */
+    int has_bytes;          /**< Non-zero if the blocks know the bytes of
+                                 the file they were read from */
+    summary_block_td *blocks;   /**< Summary of every block */
+} summary_td;
+
+
+/* Public interface */
+/**
+ * @brief Summarize the points of a dataset in blocks
+ *
+ * @param sm       Pointer to the summary to build
+ * @param ds       Pointer to the dataset
+ * @param n        Number of points to summarize, from the first one
+ * @param filename Path to the text file the points were read from, or
+ *                 @c NULL if they do not map to its bytes
+ * @param ends     Offset in the file one past the last byte every
+ *                 block was read from (@e n_blocks of them), or
+ *                 @c NULL along with @p filename
+ * @param options  Identity of the options the file was read with
+ *
+ * @return 0 on success,
+ *         1 if the bytes of a block cannot be read from the file,
+ *         2 on memory allocation failure
+ */
+int summary_build(summary_td *sm, const dataset_td *ds, size_t n,
+        const char *filename, const uint64_t *ends, uint64_t options);
+
+/**
+ * @brief Free the memory used by a summary
+ *
+ * @param sm Pointer to the summary to destroy
+ */
+void summary_destroy(summary_td *sm);
+
+/**
+ * @brief Write a summary as the index of a file
+ *
+ * The index is written next to the file (its name ending in
+ * @c SUMMARY_EXT), through a temporary file renamed over the previous
+ * one, and records the state of the file (its inode, size and
+ * modification time) along with the checksum of every block.
+ *
+ * @param sm       Pointer to the summary, built with the bytes of the
+ *                 file (see @a summary_build())
+ * @param filename Path to the file (not to the index)
+ *
+ * @return 0 on success, or 1 on failure (the summary does not know the
+ *         bytes of the file, or the index cannot be written)
+ */
+int summary_write(const summary_td *sm, const char *filename);
+
+/**
+ * @brief Read the index of a file, if it is up to date
+ *
+ * If the file is in the state the index recorded, the index is taken
+ * as it is, without reading the file.  Otherwise (the file was copied,
+ * touched, or maybe rewritten) the checksum of every block is checked
+ * against the bytes of the file, which are hashed but not parsed: if
+ * they all match, the index is stamped with the new state of the file,
+ * so that the next check is instant again.
+ *
+ * @param sm       Pointer to the summary to populate
+ * @param filename Path to the file (not to the index)
+ * @param options  Identity of the options the file is read with
+ *
+ * @return 0 on success,
+ *         1 if the file has no index (or it is not readable),
+ *         2 on memory allocation failure,
+ *         3 if the index is corrupted, or stale: it was written with
+ *           other options, or a block no longer matches the file, which
+ *           must then be read again
+ */
+int summary_read(summary_td *sm, const char *filename, uint64_t options);
+
+/**
+ * @brief Tell if a file has an index, up to date or not
+ *
+ * @param filename Path to the file (not to the index)
+ *
+ * @return Non-zero if the index of the file exists
+ */
+int summary_exists(const char *filename);
+
+/**
+ * @brief Remove the index of a file, if it has one
+ *
+ * @param filename Path to the file (not to the index)
+ */
+void summary_remove(const char *filename);
+
+/**
+ * @brief Get the moment sums of a run of blocks
+ *
+ * @param sm       Pointer to the summary
+ * @param begin    First block
+ * @param end      One past the last block
+ * @param weighted If non-zero, get the sums weighted by @e 1/ey^2
+ * @param m        Pointer to where the sums are stored, about the
+ *                 origin of block @p begin
+ */
+void summary_moments(const summary_td *sm, size_t begin, size_t end,
+        int weighted, moments_td *m);
+
+/**
+ * @brief Fit the points of a run of blocks
+ *
+ * Weighting follows @a regres_linear(): the fit is weighted as soon as
+ * any point of the blocks has a positive error.
+ *
+ * @param sm    Pointer to the summary
+ * @param begin First block
+ * @param end   One past the last block
+ *
+ * @return The regression of the points, as given by
+ *         @a regres_from_moments() (in O(@p end - @p begin))
+ */
+regression_td summary_fit(const summary_td *sm, size_t begin, size_t end);
+
+/**
+ * @brief Fit the points whose @e x lies in a closed range
+ *
+ * Blocks whose @e x all lie within the range are merged from their
+ * sums, blocks wholly out of it are skipped, and only the points of the
+ * blocks across an end of the range are read, from the dataset the
+ * summary was built from; so the points need not be sorted, as
+ * @a xindex_fit() sorts them, and a range of data that grows with
+ * @e x reads at most two blocks.
+ *
+ * Weighting follows @a regres_linear() on the whole summary, as
+ * @a xindex_fit() does.
+ *
+ * @param sm    Pointer to the summary
+ * @param ds    Pointer to the dataset it summarizes, point for point
+ * @param xa    Lower end of the range
+ * @param xb    Upper end of the range
+ * @param n_out Where to store the number of points in the range, or
+ *              @c NULL
+ *
+ * @return The regression of the points in the range, as given by
+ *         @a regres_from_moments()
+ */
+regression_td summary_fit_range(const summary_td *sm, const dataset_td *ds,
+        double xa, double xb, size_t *n_out);
+
+
+#endif  /* ! SUMMARY_H */
@@ -0,0 +1,141 @@
+/**
+ * @file transform.h
+ *
+ * @brief Declaration of the column-transform pipeline
+ */
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+
+
+#define TRANSFORM_MAX_STEPS (16)    /**< Maximum queued steps per column */
+#define TRANSFORM_BLOCK     (1024)  /**< Points transformed at once */
+
+
+/**
+ * @brief Operations of the pipeline
+ */
+typedef enum {
+    TRANSFORM_LOG,      /**< v = log(v) */
+    TRANSFORM_EXP,      /**< v = exp(v) */
+    TRANSFORM_INV,      /**< v = 1/v (zeros are left unchanged) */
+    TRANSFORM_SCALE,    /**< v = v*arg */
+    TRANSFORM_OFFSET,   /**< v = v + arg */
+    TRANSFORM_POW,      /**< v = v^arg */
+    TRANSFORM_MAX
+} transform_op_e;
+
+
+/**
+ * @typedef transform_step_td
+ *
+ * @brief Single operation queued on a column
+ */
+typedef struct {
+    transform_op_e op;  /**< Operation */
+    double arg;         /**< Argument of @c SCALE, @c OFFSET and @c POW */
+} transform_step_td;
+
+
+/**
+ * @typedef transform_td
+ *
+ * @brief Operations queued on the @e x (0) and @e y (1) columns
+ */
+typedef struct {
+    transform_step_td steps[2][TRANSFORM_MAX_STEPS];   /**< Queues */
+    size_t n_steps[2];                                  /**< Lengths */
+} transform_td;
+
+
+/* Public interface */
+/**
+ * @brief Initialize an empty pipeline
+ *
+ * @param t Pointer to the pipeline to initialize
+ */
+void transform_init(transform_td *t);
+
+/**
+ * @brief Queue an operation on a column
+ *
+ * @param t   Pointer to the pipeline
+ * @param col Column (0 for @e x, 1 for @e y)
+ * @param op  Operation
+ * @param arg Argument of the operation (ignored if it takes none)
+ *
+ * @return 0 on success, or 1 if @p col or @p op are not valid or the
+ *         queue of the column is full
+ */
+int transform_push(transform_td *t, int col, transform_op_e op,
+        double arg);
+
+/**
+ * @brief Apply every queued operation in a single pass over the data
+ *
+ * Points are copied a block of @c TRANSFORM_BLOCK at a time into
+ * contiguous buffers, every step of a column runs over the whole block
+ * in a branch-free loop (with polynomial @e log and @e exp kernels
+ * that the compiler vectorizes), and results are written back once.
+ *
+ * The @e ey of each point follows the steps queued on @e y to first
+ * order, @e ey' = |df/dy|*ey, so weighted fits stay meaningful.
+ *
+ * @param t  Pointer to the pipeline
+ * @param ds Pointer to the dataset to transform
+ *
+ * @return 0 on success, or 2 on memory allocation failure (the dataset
+ *         is left as it was)
+ *
+ * @note Domain errors give the same values as the C library (e.g.,
+ *       @e log(0) = -inf, @e log(-1) = NaN)
+ * @note Points stored in single precision are widened to double
+ *       first (see @a dataset_set_mode()), as transformed values are
+ *       seldom exact in single precision
+ */
+int transform_apply(const transform_td *t, dataset_td *ds);
+
+/**
+ * @brief Natural logarithm of every value of a block
+ *
+ * Splits @e v = 2^e*m with @e m in [sqrt(2)/2, sqrt(2)), so that
+ * @e log(m) = 2*atanh(s), @e s = (m-1)/(m+1), |s| < 0.172, is given
+ * by a short odd minimax polynomial.  The loop has no branches and
+ * vectorizes.  Accurate to a couple of ulps.
+ *
+ * @param v Values, overwritten by their logarithm
+ * @param n Number of values
+ */
+void transform_log_block(double *v, size_t n);
+
+/**
+ * @brief Exponential of every value of a block
+ *
+ * Splits @e v = k*ln(2) + r with |r| <= ln(2)/2, so that @e exp(r) is
+ * given by a degree 13 Taylor polynomial, and scales it by @e 2^k.
+ * The loop has no branches and vectorizes.  Accurate to a couple of
+ * ulps.
+ *
+ * @param v Values, overwritten by their exponential
+ * @param n Number of values
+ */
+void transform_exp_block(double *v, size_t n);
+
+/**
+ * @brief Get the name of an operation
+ *
+ * @param op Operation
+ *
+ * @return Name of the operation (e.g., @c "log")
+ */
+const char *transform_op_name(transform_op_e op);
+
+
+#endif  /* ! TRANSFORM_H */
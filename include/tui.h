@@ -33,7 +33,8 @@ int tui_start(void);
  *
  * Runs the main event loop of the TUI, handling user interactions, menu
  * navigation, and executing selected actions until the TUI is
- * terminated.
+ * terminated.  It offers to restore the last session first, and saves
+ * a snapshot of the session on leaving (see @a session_save()).
  *
  * @return 0 when the event loop ends, or otherwise
  */
@@ -16,12 +16,23 @@
 
 /* Project includes */
 #include <dataset.h>
+#include <session.h>
+#include <summary.h>
+#include <view.h>
 
 
 #ifndef PATH_MAX
 #define PATH_MAX (4096)
 #endif  /* ! PATH_MAX */
 
+#define TUI_ACTION_CV_FOLDS (10)    /**< Folds of the cross-validation
+                                         shown with the regression */
+#define TUI_ACTION_BIN_MIN  (100000)    /**< Datasets larger than this are
+                                             plotted and summarized from
+                                             bins */
+#define TUI_ACTION_FOLLOW_MS (1000) /**< Longest wait for a followed file
+                                         to grow before checking it */
+
 
 /* Public interface */
 /**
@@ -41,10 +52,32 @@ void tui_action_input(dataset_td *dataset);
  * It prompts the user for the filename and attempts to load the data
  * into the dataset.
  *
+ * A single file can be indexed as it is loaded (see
+ * @a fileio_summary()), and the summaries of its blocks are then kept
+ * in @p cache, for range fits.
+ *
  * @param dataset  Pointer to the dataset structure to be loaded
  * @param filename Pointer to the current filename string
+ * @param cache    Pointer to the results computed for the dataset,
+ *                 cleared
  */
-void tui_action_load(dataset_td *dataset, char **filename);
+void tui_action_load(dataset_td *dataset, char **filename,
+        session_cache_td *cache);
+
+/**
+ * @brief Follow a data file as it grows
+ *
+ * Prompts for a file (the current one if none is given), and reads it
+ * into a new dataset like @c tail @c -f: only the bytes appended since
+ * the last read are parsed, and the statistics and the fit shown are
+ * updated from running moment sums (see @a follow_read()), until the
+ * user stops.  The dataset then holds every point read, and the file
+ * becomes the current one.
+ *
+ * @param dataset  Pointer to the dataset structure to be replaced
+ * @param filename Pointer to the current filename string
+ */
+void tui_action_follow(dataset_td *dataset, char **filename);
 
 /**
  * @brief Handle save action for the dataset
@@ -74,7 +107,8 @@ void tui_action_saveas(dataset_td *dataset, char **filename);
  * @brief Show the data in the dataset
  *
  * Creates a new window to display the data points contained in the
- * dataset.
+ * dataset.  Datasets out of core (see @a dataset_init_mapped()) are
+ * paged through without the leverage diagnostics.
  *
  * @param dataset Pointer to the dataset structure to be displayed
  */
@@ -84,33 +118,87 @@ void tui_action_show_data(const dataset_td *dataset);
  * @brief Plot the data from the dataset
  *
  * Performs linear regression on the dataset and plots the resulting
- * data.
+ * data.  Datasets larger than @c TUI_ACTION_BIN_MIN points are plotted
+ * as @c BINS_DEFAULT bins, fitted from the bin sums; the bins are taken
+ * from @p cache if it has them, and stored in it otherwise.
  *
  * @param dataset Pointer to the dataset structure to be plotted
+ * @param cache   Pointer to the results computed for the dataset
  */
-void tui_action_plot(const dataset_td *dataset);
+void tui_action_plot(const dataset_td *dataset, session_cache_td *cache);
 
 /**
  * @brief Compute and show statistics for the dataset
  *
  * Computes statistics for the dataset and displays the results in a new
- * window.
+ * window.  Datasets larger than @c TUI_ACTION_BIN_MIN points are
+ * summarized from their bins, in parallel.  The statistics, and the
+ * bins, are taken from @p cache if it has them, and stored in it
+ * otherwise.
  *
  * @param dataset Pointer to the dataset structure for which statistics
  *                are computed
+ * @param cache   Pointer to the results computed for the dataset
  */
-void tui_action_stats(const dataset_td *dataset);
+void tui_action_stats(const dataset_td *dataset, session_cache_td *cache);
 
 /**
  * @brief Show regression analysis for the dataset
  *
  * Performs linear regression on the dataset and displays the regression
- * results in a new window.
+ * results in a new window.  The fit and its cross-validations are taken
+ * from @p cache if it has them, and stored in it otherwise.
+ *
+ * Range fits are taken from @p summary if given (see
+ * @a summary_fit_range()), and from an index of the points sorted by
+ * @e x otherwise (see @a xindex_fit()).
  *
  * @param dataset Pointer to the dataset structure for regression
  *                analysis
+ * @param summary Pointer to the summaries of the blocks of the file
+ *                @p dataset was loaded from, point for point, or
+ *                @c NULL
+ * @param cache   Pointer to the results computed for the dataset
+ */
+void tui_action_regres(const dataset_td *dataset, const summary_td *summary,
+        session_cache_td *cache);
+
+/**
+ * @brief Show the regression of every group of the dataset
+ *
+ * Fits every group of points sharing a key in a single pass and
+ * displays a table with a row per group in a new window.
+ *
+ * @param dataset Pointer to the dataset, that must have group keys
+ */
+void tui_action_groups(const dataset_td *dataset);
+
+/**
+ * @brief Merge the points measured at the same @e x
+ *
+ * Prompts for a tolerance on @e x and replaces the dataset by one point
+ * per group of repeated measurements (mean @e y, with its standard
+ * error as @e ey), so the regression runs on the weighted path.
+ *
+ * @param dataset Pointer to the dataset to reduce
+ */
+void tui_action_aggregate(dataset_td *dataset);
+
+/**
+ * @brief Transform the columns of the dataset
+ *
+ * Lets the user stack operations (log, exp, inverse, scale, offset,
+ * power) on @e x and @e y of the view, and turn them on and off: the
+ * raw data is kept, and the analysis actions read the transformed
+ * values.  The stacks can also be applied to the data for good, in a
+ * single pass (see @a transform_apply()).  Expressions computing @e x,
+ * @e y, @e ey or derived columns (see @a expr_compile()) change the
+ * raw data as soon as entered.
+ *
+ * @param dataset Pointer to the dataset to transform
+ * @param view    Pointer to the view of the dataset
  */
-void tui_action_regres(const dataset_td *dataset);
+void tui_action_transform(dataset_td *dataset, view_td *view);
 
 /**
  * @brief Show information about the program
@@ -12,6 +12,11 @@
 #include <menu.h>
 #include <ncurses.h>
 
+/* Project includes */
+#include <dataset.h>
+#include <session.h>
+#include <view.h>
+
 
 /**
  * @brief Main menu item labels
@@ -19,12 +24,16 @@
 typedef enum {
     TUI_MENU_INPUT_DATA,
     TUI_MENU_LOAD_DATA,
+    TUI_MENU_FOLLOW,
     TUI_MENU_SAVE_DATA,
     TUI_MENU_SAVEAS_DATA,
     TUI_MENU_SHOW_TABLE,
     TUI_MENU_PLOT,
     TUI_MENU_STATISTICS,
     TUI_MENU_REGRESSION,
+    TUI_MENU_GROUPS,
+    TUI_MENU_AGGREGATE,
+    TUI_MENU_TRANSFORM,
     TUI_MENU_ABOUT,
     TUI_MENU_QUIT,
     TUI_MENU_MAX
@@ -96,12 +105,17 @@ int tui_menu_navigate_and_get_index(MENU *menu, WINDOW *menu_win);
  *
  * @param index        Index of the selected menu item
  * @param dataset      Pointer to the dataset structure used in actions
+ * @param view         Pointer to the transformed view of the dataset,
+ *                     read by the analysis actions
  * @param cur_filename Pointer to the current filename string
+ * @param cache        Pointer to the results computed for the view,
+ *                     forgotten when the data or the view change
  * @param is_running   Pointer to an integer indicating if the TUI
  *                     should continue running
  */
 void tui_menu_execute_choice(int index, dataset_td *dataset,
-        char **cur_filename, int *is_running);
+        view_td *view, char **cur_filename, session_cache_td *cache,
+        int *is_running);
 
 
 #endif  /* ! TUI_MENU_H */
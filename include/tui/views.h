@@ -8,13 +8,20 @@
 #define TUI_VIEWS_H
 
 
+/* System includes */
+#include <stddef.h>     /* size_t */
+
 /* Library includes */
 #include <ncurses.h>
 
 /* Project includes */
 #include <dataset.h>
+#include <group.h>
+#include <piecewise.h>
 #include <regres.h>
 #include <stats.h>
+#include <transform.h>
+#include <view.h>
 
 
 /* Public interface */
@@ -39,10 +46,17 @@ void tui_view_input_data(dataset_td *ds, WINDOW *win);
 /**
  * @brief View for showing data tables
  *
- * @param ds  Data set where to read the data
- * @param win Window where to print
+ * If leave-one-out diagnostics are given, they are shown as extra
+ * columns (or on a toggled page if the window is too narrow), and rows
+ * can be sorted by influence (Cook's distance).
+ *
+ * @param ds   Data set where to read the data
+ * @param diag Diagnostics for every point, in dataset order, or
+ *             @c NULL if not available
+ * @param win  Window where to print
  */
-void tui_view_show_data(const dataset_td *ds, WINDOW *win);
+void tui_view_show_data(const dataset_td *ds, const influence_td *diag,
+        WINDOW *win);
 
 /**
  * @brief Statistics view
@@ -56,9 +70,110 @@ void tui_view_stats(const stats_td stats, WINDOW *win);
  * @brief Regression analysis view
  *
  * @param stats Regression structure populated with all values
+ * @param kfold K-fold cross-validation results, or @c NULL if not
+ *              available
+ * @param loo   Leave-one-out cross-validation results, or @c NULL if
+ *              not available
  * @param win   Window where to print
+ *
+ * @return 'r' if the user asked for a range fit, 's' for a segmented
+ *         regression, 'q' otherwise
+ */
+int tui_view_regression(const regression_td regression,
+        const crossval_td *kfold, const crossval_td *loo, WINDOW *win);
+
+/**
+ * @brief Prompt for a range of @e x values
+ *
+ * @param win Window where to print
+ * @param xa  Where to store the lower end of the range
+ * @param xb  Where to store the upper end of the range
+ *
+ * @return 0 if both values were read (swapped if given in reverse
+ *         order), 1 otherwise
+ */
+int tui_view_prompt_range(WINDOW *win, double *xa, double *xb);
+
+/**
+ * @brief Regression analysis view of a range of @e x values
+ *
+ * @param regression Regression structure of the points in the range
+ * @param xa         Lower end of the range
+ * @param xb         Upper end of the range
+ * @param n          Number of points in the range
+ * @param win        Window where to print
+ *
+ * @return 'r' if the user asked for another range, 'q' otherwise
+ */
+int tui_view_range_regression(const regression_td regression,
+        double xa, double xb, size_t n, WINDOW *win);
+
+
+/**
+ * @brief Prompt for a number of breakpoints
+ *
+ * @param win Window where to print
+ * @param max Largest number of breakpoints allowed
+ * @param k   Where to store the number read
+ *
+ * @return 0 if a number between 1 and @p max was read, 1 otherwise
+ */
+int tui_view_prompt_breaks(WINDOW *win, size_t max, size_t *k);
+
+/**
+ * @brief Segmented regression view
+ *
+ * @param pw  Segmented regression populated with all values
+ * @param win Window where to print
+ *
+ * @return 's' if the user asked for other breakpoints, 'q' otherwise
+ */
+int tui_view_piecewise(const piecewise_td *pw, WINDOW *win);
+
+
+/**
+ * @brief Grouped regression view
+ *
+ * Shows a paginated table with the number of points, @e a, @e b,
+ * @e s(b) and @e r of every group.
+ *
+ * @param ds     Data set the groups belong to (for key names)
+ * @param fits   Fit of every group
+ * @param n_fits Number of groups
+ * @param win    Window where to print
+ */
+void tui_view_groups(const dataset_td *ds, const group_fit_td *fits,
+        size_t n_fits, WINDOW *win);
+
+
+/**
+ * @brief Live view of a followed file
+ *
+ * Draws the number of points read so far, their main statistics and
+ * their linear fit, and returns at once: it is redrawn as the file
+ * grows.
+ *
+ * @param filename Name of the followed file
+ * @param n        Number of points read so far
+ * @param stats    Statistics of the points
+ * @param reg      Regression of the points
+ * @param watched  Non-zero if the file is watched, 0 if it is polled
+ * @param win      Window where to print
+ */
+void tui_view_follow(const char *filename, size_t n, const stats_td stats,
+        const regression_td reg, int watched, WINDOW *win);
+
+
+/**
+ * @brief Transform view
+ *
+ * Shows the operations stacked on every column of the view, numbered
+ * from 1 (those of @e x first); the ones turned off are marked.
+ *
+ * @param view View to show
+ * @param win  Window where to print
  */
-void tui_view_regression(const regression_td regression, WINDOW *win);
+void tui_view_transform(const view_td *view, WINDOW *win);
 
 
 #endif  /* ! TUI_VIEWS_H */
@@ -0,0 +1,140 @@
+/**
+ * @file view.h
+ *
+ * @brief Declaration of lazily transformed views of a dataset
+ */
+
+#ifndef VIEW_H
+#define VIEW_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <transform.h>
+
+
+/**
+ * @typedef view_layer_td
+ *
+ * @brief Operation of the transform stack of a column
+ */
+typedef struct {
+    transform_step_td step; /**< Operation */
+    int enabled;            /**< Non-zero if it takes part in the view */
+} view_layer_td;
+
+
+/**
+ * @typedef view_td
+ *
+ * @brief Dataset seen through a stack of transforms per column
+ *
+ * The raw data is never modified: transformed values are computed
+ * when the view is read, and cached per column (@e x, and @e y with
+ * its @e ey) until the stack of that column changes.
+ */
+typedef struct {
+    const dataset_td *src;  /**< Raw data */
+    view_layer_td layers[2][TRANSFORM_MAX_STEPS];   /**< Stacks of @e x
+                                                         and @e y */
+    size_t n_layers[2];     /**< Lengths of the stacks */
+    dataset_td cache;       /**< Transformed points (group keys and
+                                 derived columns are those of @e src) */
+    int dirty[2];           /**< Non-zero if the cache of @e x or @e y
+                                 is out of date */
+} view_td;
+
+
+/* Public interface */
+/**
+ * @brief Initialize a view with no transforms
+ *
+ * @param v   Pointer to the view to initialize
+ * @param src Pointer to the raw data, that must outlive the view
+ */
+void view_init(view_td *v, const dataset_td *src);
+
+/**
+ * @brief Free the memory used by the cache of a view
+ *
+ * @param v Pointer to the view to destroy
+ */
+void view_destroy(view_td *v);
+
+/**
+ * @brief Stack an operation on a column, enabled
+ *
+ * @param v   Pointer to the view
+ * @param col Column (0 for @e x, 1 for @e y)
+ * @param op  Operation
+ * @param arg Argument of the operation (ignored if it takes none)
+ *
+ * @return 0 on success, or 1 if @p col or @p op are not valid or the
+ *         stack of the column is full
+ */
+int view_push(view_td *v, int col, transform_op_e op, double arg);
+
+/**
+ * @brief Turn an operation of a stack on or off
+ *
+ * Only marks the column as out of date: the cost is O(1) until the
+ * view is read.
+ *
+ * @param v   Pointer to the view
+ * @param col Column (0 for @e x, 1 for @e y)
+ * @param i   Position of the operation in the stack of the column
+ *
+ * @return 0 on success, or 1 if there is no such operation
+ */
+int view_toggle(view_td *v, int col, size_t i);
+
+/**
+ * @brief Remove every operation of both stacks
+ *
+ * @param v Pointer to the view
+ */
+void view_clear(view_td *v);
+
+/**
+ * @brief Tell the view that the raw data has changed
+ *
+ * @param v Pointer to the view
+ */
+void view_invalidate(view_td *v);
+
+/**
+ * @brief Tell if any operation of the view is enabled
+ *
+ * @param v Pointer to the view
+ *
+ * @return Non-zero if the view differs from the raw data
+ */
+int view_is_active(const view_td *v);
+
+/**
+ * @brief Get the enabled operations of the view as a pipeline
+ *
+ * @param v Pointer to the view
+ * @param t Pointer to where the pipeline is stored
+ */
+void view_pipeline(const view_td *v, transform_td *t);
+
+/**
+ * @brief Read the data seen through the view
+ *
+ * Recomputes the columns whose stack changed since the last read (in
+ * a single pass, see @a transform_apply()), or none if nothing
+ * changed.  Without enabled operations, the raw data is returned.
+ *
+ * @param v Pointer to the view
+ *
+ * @return Pointer to the transformed data, valid until the view or the
+ *         raw data change, or @c NULL on memory allocation failure
+ */
+const dataset_td *view_data(view_td *v);
+
+
+#endif  /* ! VIEW_H */
@@ -0,0 +1,133 @@
+/**
+ * @file xindex.h
+ *
+ * @brief Declaration of the prefix-sum index over @e x-sorted data
+ */
+
+#ifndef XINDEX_H
+#define XINDEX_H
+
+
+/* System includes */
+#include <stddef.h>     /* size_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+
+/**
+ * @typedef xindex_td
+ *
+ * @brief Dataset sorted by @e x with prefix arrays of moment sums
+ *
+ * Entry @e i of every prefix array holds the sum over the first @e i
+ * points in @e x order, so the sums of any run of consecutive points
+ * are the difference of two entries.  All sums are taken about the same
+ * origin @e (x0, y0) and with the same weighting as
+ * @a regres_linear().
+ */
+typedef struct {
+    size_t n;       /**< Number of points indexed */
+    double x0;      /**< Origin of the @e x values of the sums */
+    double y0;      /**< Origin of the @e y values of the sums */
+    int weighted;   /**< If non-zero, weights are 1/ey^2 */
+    double *x;      /**< Sorted @e x values (@e n) */
+    double *s;      /**< Prefix Sum(w) (@e n+1) */
+    double *sx;     /**< Prefix Sum(w*u), with u = x - x0 (@e n+1) */
+    double *sy;     /**< Prefix Sum(w*v), with v = y - y0 (@e n+1) */
+    double *sxx;    /**< Prefix Sum(w*u^2) (@e n+1) */
+    double *sxy;    /**< Prefix Sum(w*u*v) (@e n+1) */
+    double *syy;    /**< Prefix Sum(w*v^2) (@e n+1) */
+} xindex_td;
+
+
+/* Public interface */
+/**
+ * @brief Sort the points of a dataset by @e x
+ *
+ * Performs a stable LSD radix sort on the bit pattern of the @e x
+ * values (mapped so that unsigned order equals numeric order), skipping
+ * the digits every key has in common.
+ *
+ * @param ds Pointer to the dataset to sort
+ *
+ * @return Newly allocated permutation of @e ds->size indices, such that
+ *         the @e x values of @e ds->points[perm[i]] are non-decreasing,
+ *         or @c NULL on failure or if the dataset is empty
+ *
+ * @note The caller must free the returned array
+ */
+size_t *xindex_argsort(const dataset_td *ds);
+
+/**
+ * @brief Build the prefix-sum index of a dataset
+ *
+ * @param idx Pointer to the index to build
+ * @param ds  Pointer to the dataset to index
+ *
+ * @return 0 on success,
+ *         1 if the dataset is empty,
+ *         2 on memory allocation failure
+ *
+ * @note The index is a snapshot: it has to be rebuilt if the dataset
+ *       changes
+ */
+int xindex_build(xindex_td *idx, const dataset_td *ds);
+
+/**
+ * @brief Free the memory used by a prefix-sum index
+ *
+ * @param idx Pointer to the index to destroy
+ */
+void xindex_destroy(xindex_td *idx);
+
+/**
+ * @brief Find the first sorted position whose @e x is not below a value
+ *
+ * @param idx Pointer to the index
+ * @param x   Value to look for
+ *
+ * @return Position in @e [0, n] (binary search, O(log n))
+ */
+size_t xindex_lower(const xindex_td *idx, double x);
+
+/**
+ * @brief Find the first sorted position whose @e x is above a value
+ *
+ * @param idx Pointer to the index
+ * @param x   Value to look for
+ *
+ * @return Position in @e [0, n] (binary search, O(log n))
+ */
+size_t xindex_upper(const xindex_td *idx, double x);
+
+/**
+ * @brief Get the moment sums of a run of sorted points
+ *
+ * @param idx   Pointer to the index
+ * @param begin Sorted position of the first point
+ * @param end   Sorted position one past the last point
+ * @param m     Pointer to where the sums are stored (O(1))
+ */
+void xindex_moments(const xindex_td *idx, size_t begin, size_t end,
+        moments_td *m);
+
+/**
+ * @brief Fit the points whose @e x lies in a closed range
+ *
+ * @param idx   Pointer to the index
+ * @param xa    Lower end of the range
+ * @param xb    Upper end of the range
+ * @param n_out If not @c NULL, where to store the number of points in
+ *              the range
+ *
+ * @return The regression of the points with @e xa <= x <= xb, as given
+ *         by @a regres_from_moments()
+ */
+regression_td xindex_fit(const xindex_td *idx, double xa, double xb,
+        size_t *n_out);
+
+
+#endif  /* ! XINDEX_H */
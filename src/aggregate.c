@@ -0,0 +1,118 @@
+/**
+ * @file aggregate.c
+ *
+ * @brief Implementation of the aggregation of repeated measurements
+ */
+
+/* System includes */
+#include <math.h>       /* sqrt */
+#include <stdlib.h>     /* free, malloc */
+
+/* Project includes */
+#include <dataset.h>
+#include <xindex.h>
+
+/* Local includes */
+#include <aggregate.h>
+
+
+/* Reduce the points measured at the same 'x' to a single point */
+int aggregate_x(const dataset_td *src, double tol, dataset_td *dst)
+{
+    size_t n = src->size;
+
+    if (n == 0) {
+        return 1;
+    }
+
+    size_t *perm = xindex_argsort(src);
+    size_t *counts = malloc(n * sizeof(*counts));
+    if (perm == NULL || counts == NULL) {
+        free(perm);
+        free(counts);
+        return 2;
+    }
+
+    dataset_init(dst);
+
+    /* Pooled within-group variance, for groups without an error */
+    double pooled_ss = 0.0;
+    size_t pooled_dof = 0;
+
+    size_t begin = 0;
+    while (begin < n) {
+        data_point_td first = dataset_get(src, perm[begin]);
+        size_t end = begin + 1;
+        while (end < n && dataset_get(src, perm[end]).x - first.x <= tol) {
+            end++;
+        }
+
+        size_t m = end - begin;
+        int all_err = 1;
+        double sx = 0.0, sy = 0.0, sw = 0.0, swy = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            data_point_td p = dataset_get(src, perm[i]);
+            sx += p.x;
+            sy += p.y;
+            if (p.ey > 0.0) {
+                sw += 1.0 / (p.ey * p.ey);
+                swy += p.y / (p.ey * p.ey);
+            } else {
+                all_err = 0;
+            }
+        }
+
+        double ymean = sy / (double) m;
+        double ss = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            double d = dataset_get(src, perm[i]).y - ymean;
+            ss += d * d;
+        }
+        pooled_ss += ss;
+        pooled_dof += m - 1;
+
+        double y, ey;
+        if (all_err) {
+            y = swy / sw;
+            ey = 1.0 / sqrt(sw);
+        } else if (m > 1) {
+            y = ymean;
+            ey = sqrt(ss / (double) (m - 1) / (double) m);
+        } else {
+            y = first.y;
+            ey = 0.0;
+        }
+
+        counts[dst->size] = m;
+        if (dataset_add(dst, sx / (double) m, y, ey) != 0) {
+            free(perm);
+            free(counts);
+            dataset_destroy(dst);
+            return 2;
+        }
+        begin = end;
+    }
+
+    if (pooled_dof > 0) {
+        double sp = sqrt(pooled_ss / (double) pooled_dof);
+        for (size_t i = 0; i < dst->size; ++i) {
+            data_point_td p = dataset_get(dst, i);
+            if (p.ey > 0.0) {
+                continue;
+            }
+            p.ey = sp / sqrt((double) counts[i]);
+            if (dataset_store(dst, i, 1, &p) != 0) {
+                free(perm);
+                free(counts);
+                dataset_destroy(dst);
+                return 2;
+            }
+        }
+    }
+
+    free(perm);
+    free(counts);
+    dst->is_modified = 1;
+
+    return 0;
+}
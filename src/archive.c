@@ -0,0 +1,1072 @@
+/**
+ * @file archive.c
+ *
+ * @brief Implementation of the compressed columnar format of a dataset
+ */
+
+#define _POSIX_C_SOURCE 200809L /* sysconf */
+
+
+/* System includes */
+#include <math.h>       /* fabs, floor */
+#include <pthread.h>    /* pthread_create, pthread_join */
+#include <stdint.h>     /* uint32_t, uint64_t */
+#include <stdio.h>      /* fclose, fopen, fread, fseek, ftell, fwrite */
+#include <stdlib.h>     /* free, malloc */
+#include <string.h>     /* memcmp, memcpy, memset */
+#include <unistd.h>     /* sysconf */
+
+/* Project includes */
+#include <arena.h>
+#include <dataset.h>
+#include <moments.h>
+#include <slice.h>
+
+/* Local includes */
+#include <archive.h>
+
+
+#define S_HEADER_SIZE (96)      /**< Bytes of the header */
+#define S_ENTRY_SIZE (24)       /**< Bytes of an entry of the directory */
+#define S_VALUE_BOUND (10)      /**< Bytes a value may take, at most */
+#define S_TAG_XOR (255)         /**< Tag of columns compressed bitwise */
+#define S_MAX_DECIMALS (18)     /**< Most decimal digits of a column
+                                     stored as integers */
+#define S_MAX_EXACT (9007199254740992.0)    /**< 2^53 */
+
+#define S_HAS_EY   (1u)         /**< Flag: the @e ey column is stored */
+#define S_HAS_KEYS (2u)         /**< Flag: the key column is stored */
+#define S_WEIGHTED (4u)         /**< Flag: some @e ey is positive */
+
+
+/*
+ * Layout of an archive (integers are little endian):
+ *
+ *   - header, S_HEADER_SIZE bytes:
+ *       0 magic, 8 points, 16 points per block, 20 flags, 24 storage
+ *       mode, 28 key names, 32 x0, 40 y0, 48 offset of the key names,
+ *       56 bytes of the key names, 64 checksum of the key names, 72
+ *       checksum of the directory, 80 reserved, 88 checksum of the
+ *       header (of its first 88 bytes)
+ *   - directory: offset, length and checksum of every block
+ *   - blocks: columns x, y, [ey], [keys], one after the other in a
+ *     single bit stream
+ *   - key names: length (4 bytes) and characters of each one
+ */
+
+
+/** Powers of ten, all of them exact in double */
+static const double s_pow10[S_MAX_DECIMALS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+
+/**
+ * @brief Compressed archive read in memory
+ */
+typedef struct {
+    unsigned char *data;    /**< Contents of the file */
+    size_t size;            /**< Bytes of the file */
+    size_t n;               /**< Number of points */
+    size_t n_blocks;        /**< Number of blocks */
+    unsigned flags;         /**< Columns stored (S_HAS_* flags) */
+    int mode;               /**< Storage mode the dataset had */
+    size_t n_names;         /**< Number of key names */
+    double x0;              /**< First @e x, origin of the sums */
+    double y0;              /**< First @e y, origin of the sums */
+    size_t names_offset;    /**< Where the key names start */
+    size_t names_len;       /**< Bytes of the key names */
+} s_archive_td;
+
+
+/**
+ * @brief Writer of a stream of bits, most significant bit first
+ */
+typedef struct {
+    unsigned char *buf;     /**< Where full bytes are stored */
+    size_t pos;             /**< Bytes stored */
+    uint64_t acc;           /**< Bits not stored yet */
+    unsigned fill;          /**< Number of bits in @e acc (< 8) */
+} s_writer_td;
+
+
+/**
+ * @brief Reader of a stream of bits, most significant bit first
+ */
+typedef struct {
+    const unsigned char *buf;   /**< Bytes of the stream */
+    size_t len;                 /**< Number of bytes of the stream */
+    size_t pos;                 /**< Bytes read */
+    uint64_t acc;               /**< Bits read but not used yet */
+    unsigned fill;              /**< Number of bits in @e acc */
+    int bad;                    /**< Non-zero if read past the end */
+} s_reader_td;
+
+
+/**
+ * @brief Work of a thread: decode a range of blocks
+ */
+typedef struct {
+    const s_archive_td *a;  /**< Archive to decode */
+    size_t first;           /**< First block of the range */
+    size_t last;            /**< One past the last block of the range */
+    data_point_td *points;  /**< Where the points go, or @c NULL to
+                                 accumulate them into @e m instead */
+    long *keys;             /**< Where the keys go, or @c NULL */
+    moments_td m;           /**< Sums of the points of the range */
+    int err;                /**< 0, or 2 or 3 as @a archive_load() */
+} s_archive_job_td;
+
+
+/**
+ * @brief Checksum of a range of bytes (FNV-1a)
+ *
+ * @param p   Bytes to hash
+ * @param len Number of bytes
+ *
+ * @return Checksum of the bytes
+ */
+static uint64_t s_checksum(const unsigned char *p, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Store an integer of @p n bytes, little endian
+ *
+ * @param p Where to store it
+ * @param v Value to store
+ * @param n Number of bytes
+ */
+static void s_put_le(unsigned char *p, uint64_t v, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+
+/**
+ * @brief Read an integer of @p n bytes, little endian
+ *
+ * @param p Where to read it from
+ * @param n Number of bytes
+ *
+ * @return Value read
+ */
+static uint64_t s_get_le(const unsigned char *p, int n)
+{
+    uint64_t v = 0;
+
+    for (int i = n - 1; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+
+/**
+ * @brief Get the bits of a double
+ *
+ * @param v Value
+ *
+ * @return The IEEE 754 representation of @p v
+ */
+static uint64_t s_bits(double v)
+{
+    uint64_t u;
+
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+
+/**
+ * @brief Get a double from its bits
+ *
+ * @param u The IEEE 754 representation of a value
+ *
+ * @return The value
+ */
+static double s_double(uint64_t u)
+{
+    double v;
+
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+
+/**
+ * @brief Count the leading zero bits of a non-zero word
+ *
+ * @param x Word, not 0
+ *
+ * @return Number of zero bits above the highest bit set
+ */
+static unsigned s_clz(uint64_t x)
+{
+    unsigned n = 0;
+
+    /* Halves, quarters... of the word, from the top */
+    for (unsigned half = 32; half > 0; half /= 2) {
+        if ((x >> (64 - half)) == 0) {
+            n += half;
+            x <<= half;
+        }
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Count the trailing zero bits of a non-zero word
+ *
+ * @param x Word, not 0
+ *
+ * @return Number of zero bits below the lowest bit set
+ */
+static unsigned s_ctz(uint64_t x)
+{
+    return slice_popcount((x & (~x + 1)) - 1);
+}
+
+
+/**
+ * @brief Append bits to a stream
+ *
+ * @param w Pointer to the writer
+ * @param v Value whose @p n lowest bits are appended
+ * @param n Number of bits (at most 64)
+ */
+static void s_put_bits(s_writer_td *w, uint64_t v, unsigned n)
+{
+    if (n > 32) {
+        s_put_bits(w, v >> 32, n - 32);
+        n = 32;
+    }
+
+    w->acc = (w->acc << n) | (v & (((uint64_t) 1 << n) - 1));
+    w->fill += n;
+    while (w->fill >= 8) {
+        w->fill -= 8;
+        w->buf[w->pos++] = (unsigned char) (w->acc >> w->fill);
+    }
+    w->acc &= ((uint64_t) 1 << w->fill) - 1;
+}
+
+
+/**
+ * @brief Store the bits left in the writer, padded to a byte
+ *
+ * @param w Pointer to the writer
+ */
+static void s_flush_bits(s_writer_td *w)
+{
+    if (w->fill > 0) {
+        w->buf[w->pos++] = (unsigned char) (w->acc << (8 - w->fill));
+        w->acc = 0;
+        w->fill = 0;
+    }
+}
+
+
+/**
+ * @brief Read bits from a stream
+ *
+ * @param r Pointer to the reader
+ * @param n Number of bits (at most 64)
+ *
+ * @return The bits read, or 0 past the end of the stream (and then
+ *         @e r->bad is set)
+ */
+static uint64_t s_get_bits(s_reader_td *r, unsigned n)
+{
+    uint64_t v;
+
+    if (n > 32) {
+        v = s_get_bits(r, n - 32) << 32;
+        return v | s_get_bits(r, 32);
+    }
+
+    while (r->fill < n) {
+        unsigned byte = 0;
+        if (r->pos < r->len) {
+            byte = r->buf[r->pos++];
+        } else {
+            r->bad = 1;
+        }
+        r->acc = (r->acc << 8) | byte;
+        r->fill += 8;
+    }
+    r->fill -= n;
+    v = (r->acc >> r->fill) & (((uint64_t) 1 << n) - 1);
+    r->acc &= ((uint64_t) 1 << r->fill) - 1;
+
+    return v;
+}
+
+
+/**
+ * @brief Compress a column of floating point values
+ *
+ * Each value is XORed with the previous one: if equal, a single bit is
+ * stored; otherwise only the bits between the leading and the trailing
+ * zeros of the XOR are, reusing the window of the previous value when
+ * they fit in it.
+ *
+ * @param w Pointer to the writer
+ * @param v Values of the column
+ * @param n Number of values (at least 1)
+ */
+static void s_encode_xor(s_writer_td *w, const double *v, size_t n)
+{
+    uint64_t prev = s_bits(v[0]);
+    unsigned lead = 64, trail = 0;
+
+    s_put_bits(w, prev, 64);
+    for (size_t i = 1; i < n; ++i) {
+        uint64_t cur = s_bits(v[i]);
+        uint64_t x = cur ^ prev;
+
+        prev = cur;
+        if (x == 0) {
+            s_put_bits(w, 0, 1);
+            continue;
+        }
+
+        unsigned l = s_clz(x);
+        unsigned t = s_ctz(x);
+        if (l > 31) {
+            l = 31;
+        }
+        if (lead < 64 && l >= lead && t >= trail) {
+            s_put_bits(w, 2, 2);
+            s_put_bits(w, x >> trail, 64 - lead - trail);
+        } else {
+            lead = l;
+            trail = t;
+            s_put_bits(w, 3, 2);
+            s_put_bits(w, lead, 5);
+            s_put_bits(w, 64 - lead - trail - 1, 6);
+            s_put_bits(w, x >> trail, 64 - lead - trail);
+        }
+    }
+}
+
+
+/**
+ * @brief Decompress a column of floating point values
+ *
+ * @param r Pointer to the reader
+ * @param v Where to store the values
+ * @param n Number of values (at least 1)
+ *
+ * @return 0 on success, or 1 if the stream is not valid
+ */
+static int s_decode_xor(s_reader_td *r, double *v, size_t n)
+{
+    uint64_t prev = s_get_bits(r, 64);
+    unsigned lead = 64, trail = 0;
+
+    v[0] = s_double(prev);
+    for (size_t i = 1; i < n; ++i) {
+        if (s_get_bits(r, 1) != 0) {
+            if (s_get_bits(r, 1) != 0) {
+                unsigned len;
+
+                lead = (unsigned) s_get_bits(r, 5);
+                len = (unsigned) s_get_bits(r, 6) + 1;
+                if (lead + len > 64) {
+                    return 1;
+                }
+                trail = 64 - lead - len;
+            } else if (lead >= 64) {
+                return 1;
+            }
+            prev ^= s_get_bits(r, 64 - lead - trail) << trail;
+        }
+        v[i] = s_double(prev);
+    }
+
+    return r->bad;
+}
+
+
+/**
+ * @brief Append the difference of an integer and the previous one
+ *
+ * The difference is zigzag encoded (small negative and positive
+ * values both give small codes), and stored 7 bits per byte.
+ *
+ * @param w    Pointer to the writer
+ * @param cur  Integer to append
+ * @param prev Pointer to the previous integer, set to @p cur
+ */
+static void s_put_delta(s_writer_td *w, uint64_t cur, uint64_t *prev)
+{
+    uint64_t d = cur - *prev;
+    uint64_t z = (d << 1) ^ (0 - (d >> 63));
+
+    *prev = cur;
+    while (z >= 0x80) {
+        s_put_bits(w, (z & 0x7f) | 0x80, 8);
+        z >>= 7;
+    }
+    s_put_bits(w, z, 8);
+}
+
+
+/**
+ * @brief Read an integer stored as a difference with the previous one
+ *
+ * @param r    Pointer to the reader
+ * @param prev Pointer to the previous integer, set to the one read
+ *
+ * @return 0 on success, or 1 if the stream is not valid
+ */
+static int s_get_delta(s_reader_td *r, uint64_t *prev)
+{
+    uint64_t z = 0, byte;
+    unsigned shift = 0;
+
+    do {
+        if (shift > 63) {
+            return 1;
+        }
+        byte = s_get_bits(r, 8);
+        z |= (byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && !r->bad);
+
+    *prev += (z >> 1) ^ (0 - (z & 1));
+    return r->bad;
+}
+
+
+/**
+ * @brief Find the decimal digits that make a column integer
+ *
+ * @param v Values of the column
+ * @param n Number of values
+ *
+ * @return The least @e e such that every value is exactly an integer
+ *         (below 2^53) divided by @e 10^e, or -1 if there is none
+ */
+static int s_decimal_exp(const double *v, size_t n)
+{
+    for (int e = 0; e <= S_MAX_DECIMALS; ++e) {
+        size_t i;
+
+        for (i = 0; i < n; ++i) {
+            double t = v[i] * s_pow10[e];
+            double k = floor(t + 0.5);
+
+            /* Bits compared, so that -0.0 is not taken for 0.0 */
+            if (!(fabs(t) < S_MAX_EXACT) ||
+                    s_bits(k / s_pow10[e]) != s_bits(v[i])) {
+                break;
+            }
+        }
+        if (i == n) {
+            return e;
+        }
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Compress a column of floating point values
+ *
+ * Values written with a few decimal digits (as read from text files)
+ * are stored as integers, as differences with the previous one; the
+ * others, bit by bit (see @a s_encode_xor()).
+ *
+ * @param w Pointer to the writer
+ * @param v Values of the column
+ * @param n Number of values (at least 1)
+ */
+static void s_encode_col(s_writer_td *w, const double *v, size_t n)
+{
+    int e = s_decimal_exp(v, n);
+    uint64_t prev = 0;
+
+    if (e < 0) {
+        s_put_bits(w, S_TAG_XOR, 8);
+        s_encode_xor(w, v, n);
+        return;
+    }
+
+    s_put_bits(w, (uint64_t) e, 8);
+    for (size_t i = 0; i < n; ++i) {
+        int64_t k = (int64_t) floor(v[i] * s_pow10[e] + 0.5);
+        s_put_delta(w, (uint64_t) k, &prev);
+    }
+}
+
+
+/**
+ * @brief Decompress a column of floating point values
+ *
+ * @param r Pointer to the reader
+ * @param v Where to store the values
+ * @param n Number of values (at least 1)
+ *
+ * @return 0 on success, or 1 if the stream is not valid
+ */
+static int s_decode_col(s_reader_td *r, double *v, size_t n)
+{
+    unsigned e = (unsigned) s_get_bits(r, 8);
+    uint64_t prev = 0;
+
+    if (e == S_TAG_XOR) {
+        return s_decode_xor(r, v, n);
+    }
+    if (e > S_MAX_DECIMALS) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (s_get_delta(r, &prev) != 0) {
+            return 1;
+        }
+        v[i] = (double) (int64_t) prev / s_pow10[e];
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Check and decompress a block of an archive
+ *
+ * @param a    Pointer to the archive
+ * @param b    Index of the block
+ * @param cols Scratch columns, @c ARCHIVE_BLOCK values each, for
+ *             @e x, @e y and @e ey
+ * @param p    Where to store the points of the block
+ * @param keys Where to store the keys of the block, or @c NULL
+ *
+ * @return Number of points of the block, or 0 if it is corrupted
+ */
+static size_t s_decode_block(const s_archive_td *a, size_t b, double *cols,
+        data_point_td *p, long *keys)
+{
+    const unsigned char *e = a->data + S_HEADER_SIZE + b * S_ENTRY_SIZE;
+    uint64_t offset = s_get_le(e, 8);
+    uint64_t len = s_get_le(e + 8, 8);
+    size_t n = (b + 1 < a->n_blocks) ? ARCHIVE_BLOCK
+        : a->n - b * ARCHIVE_BLOCK;
+    double *x = cols;
+    double *y = cols + ARCHIVE_BLOCK;
+    double *ey = cols + 2 * ARCHIVE_BLOCK;
+    s_reader_td r;
+
+    if (offset > a->size || len > a->size - offset ||
+            s_checksum(a->data + offset, len) != s_get_le(e + 16, 8)) {
+        return 0;
+    }
+
+    r.buf = a->data + offset;
+    r.len = len;
+    r.pos = 0;
+    r.acc = 0;
+    r.fill = 0;
+    r.bad = 0;
+    if (s_decode_col(&r, x, n) != 0 || s_decode_col(&r, y, n) != 0) {
+        return 0;
+    }
+    if (a->flags & S_HAS_EY) {
+        if (s_decode_col(&r, ey, n) != 0) {
+            return 0;
+        }
+    } else {
+        memset(ey, 0, n * sizeof(*ey));
+    }
+    uint64_t prev = 0;
+    for (size_t j = 0; keys != NULL && j < n; ++j) {
+        if (s_get_delta(&r, &prev) != 0) {
+            return 0;
+        }
+        keys[j] = (long) prev;
+    }
+
+    for (size_t j = 0; j < n; ++j) {
+        p[j].x = x[j];
+        p[j].y = y[j];
+        p[j].ey = ey[j];
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Decode a range of blocks of an archive
+ *
+ * @param arg Pointer to a @e s_archive_job_td
+ *
+ * @return Always @c NULL
+ */
+static void *s_archive_worker(void *arg)
+{
+    s_archive_job_td *job = arg;
+    double *cols = malloc(3 * ARCHIVE_BLOCK * sizeof(*cols));
+    data_point_td *buf = NULL;
+
+    if (job->points == NULL) {
+        buf = malloc(ARCHIVE_BLOCK * sizeof(*buf));
+    }
+    if (cols == NULL || (job->points == NULL && buf == NULL)) {
+        free(cols);
+        free(buf);
+        job->err = 2;
+        return NULL;
+    }
+
+    for (size_t b = job->first; b < job->last; ++b) {
+        size_t base = b * ARCHIVE_BLOCK;
+        data_point_td *p = (buf != NULL) ? buf : job->points + base;
+        long *keys = (job->keys != NULL) ? job->keys + base : NULL;
+        size_t n = s_decode_block(job->a, b, cols, p, keys);
+
+        if (n == 0) {
+            job->err = 3;
+            break;
+        }
+
+        /* Accumulated while the block is still in cache, with the
+         * kernel of slices over a dataset made of the block */
+        if (buf != NULL) {
+            dataset_td block;
+            slice_td s;
+
+            dataset_init(&block);
+            block.points = buf;
+            block.size = block.capacity = n;
+            s = slice_all(&block);
+            moments_accumulate_slice(&job->m, &s);
+        }
+    }
+
+    free(cols);
+    free(buf);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Read and check the header and directory of an archive
+ *
+ * @param filename Path to the archive
+ * @param a        Where to store the archive, read in memory
+ *
+ * @return 0 on success, or 1, 2 or 3 as @a archive_load()
+ */
+static int s_open(const char *filename, s_archive_td *a)
+{
+    FILE *fp = fopen(filename, "rb");
+    long size = -1;
+
+    a->data = NULL;
+    if (fp == NULL) {
+        return 1;
+    }
+    if (fseek(fp, 0L, SEEK_END) == 0) {
+        size = ftell(fp);
+    }
+    if (size < S_HEADER_SIZE || fseek(fp, 0L, SEEK_SET) != 0) {
+        fclose(fp);
+        return 1;
+    }
+
+    /* Compressed blocks are small: the whole file is read at once */
+    a->size = (size_t) size;
+    if ((a->data = malloc(a->size)) == NULL) {
+        fclose(fp);
+        return 2;
+    }
+    if (fread(a->data, 1, a->size, fp) != a->size) {
+        fclose(fp);
+        free(a->data);
+        return 1;
+    }
+    fclose(fp);
+
+    const unsigned char *h = a->data;
+    if (memcmp(h, ARCHIVE_MAGIC, 8) != 0) {
+        free(a->data);
+        return 1;
+    }
+    if (s_checksum(h, 88) != s_get_le(h + 88, 8) ||
+            s_get_le(h + 16, 4) != ARCHIVE_BLOCK) {
+        free(a->data);
+        return 3;
+    }
+
+    a->n = (size_t) s_get_le(h + 8, 8);
+    a->n_blocks = (a->n + ARCHIVE_BLOCK - 1) / ARCHIVE_BLOCK;
+    a->flags = (unsigned) s_get_le(h + 20, 4);
+    a->mode = (int) s_get_le(h + 24, 4) & (DATASET_NO_EY | DATASET_SINGLE);
+    a->n_names = (size_t) s_get_le(h + 28, 4);
+    a->x0 = s_double(s_get_le(h + 32, 8));
+    a->y0 = s_double(s_get_le(h + 40, 8));
+    a->names_offset = (size_t) s_get_le(h + 48, 8);
+    a->names_len = (size_t) s_get_le(h + 56, 8);
+
+    size_t dir_len = a->n_blocks * S_ENTRY_SIZE;
+    if (a->n_blocks > (a->size - S_HEADER_SIZE) / S_ENTRY_SIZE ||
+            s_checksum(h + S_HEADER_SIZE, dir_len) != s_get_le(h + 72, 8) ||
+            a->names_offset > a->size ||
+            a->names_len > a->size - a->names_offset ||
+            s_checksum(h + a->names_offset, a->names_len)
+                != s_get_le(h + 64, 8)) {
+        free(a->data);
+        return 3;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Decode every block of an archive, in parallel
+ *
+ * @param a      Pointer to the archive
+ * @param points Where the points go, or @c NULL to accumulate them
+ *               into @p m instead
+ * @param keys   Where the keys go, or @c NULL
+ * @param m      Where the sums are stored if @p points is @c NULL
+ *
+ * @return 0 on success, or 2 or 3 as @a archive_load()
+ */
+static int s_decode(const s_archive_td *a, data_point_td *points,
+        long *keys, moments_td *m)
+{
+    /* One range of blocks per thread, but never ranges too small to
+     * pay off */
+    long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_jobs = (n_cpu > 0) ? (size_t) n_cpu : 1;
+    if (n_jobs > ARCHIVE_MAX_THREADS) {
+        n_jobs = ARCHIVE_MAX_THREADS;
+    }
+    if (n_jobs > a->n_blocks / ARCHIVE_MIN_BLOCKS) {
+        n_jobs = (a->n_blocks / ARCHIVE_MIN_BLOCKS > 0)
+            ? a->n_blocks / ARCHIVE_MIN_BLOCKS : 1;
+    }
+
+    s_archive_job_td jobs[ARCHIVE_MAX_THREADS];
+    pthread_t threads[ARCHIVE_MAX_THREADS];
+    int started[ARCHIVE_MAX_THREADS];
+
+    for (size_t j = 0; j < n_jobs; ++j) {
+        jobs[j].a = a;
+        jobs[j].first = j * a->n_blocks / n_jobs;
+        jobs[j].last = (j + 1) * a->n_blocks / n_jobs;
+        jobs[j].points = points;
+        jobs[j].keys = keys;
+        moments_init(&jobs[j].m, a->x0, a->y0, (a->flags & S_WEIGHTED));
+        jobs[j].err = 0;
+    }
+
+    /* Range 0 is done by this thread, and so is any range whose
+     * thread could not be started */
+    for (size_t j = 1; j < n_jobs; ++j) {
+        started[j] = (pthread_create(&threads[j], NULL, s_archive_worker,
+                    &jobs[j]) == 0);
+    }
+    s_archive_worker(&jobs[0]);
+    for (size_t j = 1; j < n_jobs; ++j) {
+        if (started[j]) {
+            pthread_join(threads[j], NULL);
+        } else {
+            s_archive_worker(&jobs[j]);
+        }
+    }
+
+    int err = 0;
+    moments_init(m, a->x0, a->y0, (a->flags & S_WEIGHTED));
+    for (size_t j = 0; j < n_jobs; ++j) {
+        if (jobs[j].err > err) {
+            err = jobs[j].err;
+        }
+        moments_merge(m, &jobs[j].m);
+    }
+
+    return err;
+}
+
+
+/**
+ * @brief Read the key names of an archive into a dataset
+ *
+ * @param a  Pointer to the archive
+ * @param ds Pointer to the dataset
+ *
+ * @return 0 on success, or 2 or 3 as @a archive_load()
+ */
+static int s_read_names(const s_archive_td *a, dataset_td *ds)
+{
+    const unsigned char *p = a->data + a->names_offset;
+    size_t left = a->names_len;
+
+    if (a->n_names > left / 4) {
+        return 3;
+    }
+    if ((ds->key_names = malloc(a->n_names * sizeof(char *))) == NULL) {
+        return 2;
+    }
+
+    for (size_t i = 0; i < a->n_names; ++i) {
+        size_t len;
+        char *name;
+
+        if (left < 4 || (len = (size_t) s_get_le(p, 4)) > left - 4) {
+            return 3;
+        }
+        if ((name = malloc(len + 1)) == NULL) {
+            return 2;
+        }
+        memcpy(name, p + 4, len);
+        name[len] = '\0';
+        ds->key_names[ds->n_key_names++] = name;
+        p += 4 + len;
+        left -= 4 + len;
+    }
+
+    return 0;
+}
+
+
+/* Save a dataset to a compressed archive */
+int archive_save(const char *filename, const dataset_td *ds)
+{
+    size_t n = ds->size;
+    size_t n_blocks = (n + ARCHIVE_BLOCK - 1) / ARCHIVE_BLOCK;
+    size_t dir_len = n_blocks * S_ENTRY_SIZE;
+    unsigned flags = 0;
+
+    for (size_t i = 0; i < n && !(ds->mode & DATASET_NO_EY); ++i) {
+        double ey = dataset_get(ds, i).ey;
+        flags |= (ey != 0.0) ? S_HAS_EY : 0;
+        flags |= (ey > 0.0) ? S_WEIGHTED : 0;
+    }
+    flags |= dataset_has_keys(ds) ? S_HAS_KEYS : 0;
+
+    unsigned char *dir = malloc(dir_len + S_HEADER_SIZE);
+    unsigned char *out = malloc(4 * S_VALUE_BOUND * ARCHIVE_BLOCK);
+    double *cols = malloc(3 * ARCHIVE_BLOCK * sizeof(*cols));
+    data_point_td *buf = malloc(ARCHIVE_BLOCK * sizeof(*buf));
+    unsigned char *names = NULL;
+    FILE *fp = NULL;
+    int err = 2;
+
+    if (dir == NULL || out == NULL || cols == NULL || buf == NULL) {
+        goto done;
+    }
+    err = 1;
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        goto done;
+    }
+
+    /* Header and directory are written last, once they are known */
+    memset(dir, 0, dir_len + S_HEADER_SIZE);
+    if (fwrite(dir, 1, dir_len + S_HEADER_SIZE, fp)
+            != dir_len + S_HEADER_SIZE) {
+        goto done;
+    }
+
+    uint64_t offset = S_HEADER_SIZE + dir_len;
+    for (size_t b = 0; b < n_blocks; ++b) {
+        size_t base = b * ARCHIVE_BLOCK;
+        size_t len = (n - base < ARCHIVE_BLOCK) ? n - base : ARCHIVE_BLOCK;
+        const data_point_td *p = dataset_block(ds, base, len, buf);
+        unsigned char *e = dir + S_HEADER_SIZE + b * S_ENTRY_SIZE;
+        s_writer_td w = { out, 0, 0, 0 };
+
+        for (size_t j = 0; j < len; ++j) {
+            cols[j] = p[j].x;
+            cols[ARCHIVE_BLOCK + j] = p[j].y;
+            cols[2 * ARCHIVE_BLOCK + j] = p[j].ey;
+        }
+        s_encode_col(&w, cols, len);
+        s_encode_col(&w, cols + ARCHIVE_BLOCK, len);
+        if (flags & S_HAS_EY) {
+            s_encode_col(&w, cols + 2 * ARCHIVE_BLOCK, len);
+        }
+        uint64_t prev = 0;
+        for (size_t j = 0; (flags & S_HAS_KEYS) && j < len; ++j) {
+            s_put_delta(&w, (uint64_t) ds->keys[base + j], &prev);
+        }
+        s_flush_bits(&w);
+
+        s_put_le(e, offset, 8);
+        s_put_le(e + 8, w.pos, 8);
+        s_put_le(e + 16, s_checksum(out, w.pos), 8);
+        if (fwrite(out, 1, w.pos, fp) != w.pos) {
+            goto done;
+        }
+        offset += w.pos;
+    }
+
+    /* Key names */
+    size_t n_names = (ds->key_names != NULL) ? ds->n_key_names : 0;
+    size_t names_len = 0;
+    for (size_t i = 0; i < n_names; ++i) {
+        names_len += 4 + strlen(ds->key_names[i]);
+    }
+    if ((names = malloc(names_len + 1)) == NULL) {
+        err = 2;
+        goto done;
+    }
+    for (size_t i = 0, pos = 0; i < n_names; ++i) {
+        size_t len = strlen(ds->key_names[i]);
+        s_put_le(names + pos, len, 4);
+        memcpy(names + pos + 4, ds->key_names[i], len);
+        pos += 4 + len;
+    }
+    if (fwrite(names, 1, names_len, fp) != names_len) {
+        goto done;
+    }
+
+    unsigned char *h = dir;
+    data_point_td first = { 0.0, 0.0, 0.0 };
+    if (n > 0) {
+        first = dataset_get(ds, 0);
+    }
+    memcpy(h, ARCHIVE_MAGIC, 8);
+    s_put_le(h + 8, n, 8);
+    s_put_le(h + 16, ARCHIVE_BLOCK, 4);
+    s_put_le(h + 20, flags, 4);
+    s_put_le(h + 24, (uint64_t) ds->mode, 4);
+    s_put_le(h + 28, n_names, 4);
+    s_put_le(h + 32, s_bits(first.x), 8);
+    s_put_le(h + 40, s_bits(first.y), 8);
+    s_put_le(h + 48, offset, 8);
+    s_put_le(h + 56, names_len, 8);
+    s_put_le(h + 64, s_checksum(names, names_len), 8);
+    s_put_le(h + 72, s_checksum(h + S_HEADER_SIZE, dir_len), 8);
+    s_put_le(h + 88, s_checksum(h, 88), 8);
+    if (fseek(fp, 0L, SEEK_SET) != 0 ||
+            fwrite(dir, 1, dir_len + S_HEADER_SIZE, fp)
+                != dir_len + S_HEADER_SIZE) {
+        goto done;
+    }
+    err = 0;
+
+done:
+    if (fp != NULL && fclose(fp) != 0 && err == 0) {
+        err = 1;
+    }
+    free(dir);
+    free(out);
+    free(cols);
+    free(buf);
+    free(names);
+
+    return err;
+}
+
+
+/* Load a dataset from a compressed archive */
+int archive_load(const char *filename, dataset_td *ds)
+{
+    s_archive_td a;
+    dataset_td loaded;
+    moments_td m;
+    int err = s_open(filename, &a);
+
+    if (err != 0) {
+        return err;
+    }
+
+    /* Decoded in full, then narrowed in place to the mode the points
+     * were saved with, which holds them exactly */
+    dataset_init(&loaded);
+    if (a.n > 0 && dataset_reserve(&loaded, a.n) != 0) {
+        free(a.data);
+        return 2;
+    }
+    if (a.flags & S_HAS_KEYS) {
+        loaded.keys = arena_alloc((a.n + 1) * sizeof(*loaded.keys));
+        if (loaded.keys == NULL) {
+            free(a.data);
+            dataset_destroy(&loaded);
+            return 2;
+        }
+    }
+    loaded.size = a.n;
+
+    if (a.n > 0) {
+        err = s_decode(&a, loaded.points, loaded.keys, &m);
+    }
+    if (err == 0 && a.n_names > 0) {
+        err = s_read_names(&a, &loaded);
+    }
+    if (err == 0) {
+        err = dataset_set_mode(&loaded, a.mode);
+    }
+    free(a.data);
+    if (err != 0) {
+        dataset_destroy(&loaded);
+        return err;
+    }
+
+    dataset_destroy(ds);
+    *ds = loaded;
+    ds->is_modified = 0;
+
+    return 0;
+}
+
+
+/* Accumulate the points of a compressed archive into moment sums */
+int archive_moments(const char *filename, moments_td *m)
+{
+    s_archive_td a;
+    int err = s_open(filename, &a);
+
+    if (err != 0) {
+        return err;
+    }
+
+    moments_init(m, a.x0, a.y0, (a.flags & S_WEIGHTED));
+    if (a.n > 0) {
+        err = s_decode(&a, NULL, NULL, m);
+    }
+    free(a.data);
+
+    return err;
+}
+
+
+/* Tell if a file is a compressed archive */
+int archive_check(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    char magic[8];
+    int is_archive;
+
+    if (fp == NULL) {
+        return 0;
+    }
+    is_archive = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+            memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0);
+    fclose(fp);
+
+    return is_archive;
+}
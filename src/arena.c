@@ -0,0 +1,293 @@
+/**
+ * @file arena.c
+ *
+ * @brief Implementation of the allocator of large, growing buffers
+ */
+
+#define _GNU_SOURCE /* mremap, MAP_ANONYMOUS, MAP_HUGETLB */
+
+
+/* System includes */
+#include <stdio.h>      /* snprintf */
+#include <stdlib.h>     /* free, getenv, malloc, mkstemp, realloc */
+#include <string.h>     /* memcpy */
+#include <sys/mman.h>   /* madvise, mmap, mremap, munmap */
+#include <unistd.h>     /* ftruncate, sysconf, unlink */
+
+/* Local includes */
+#include <arena.h>
+
+
+/**
+ * @brief Header stored right before every buffer
+ *
+ * Padded so that the buffer that follows is aligned for any type.
+ */
+typedef union {
+    struct {
+        size_t size;    /**< Usable size of the buffer */
+        size_t length;  /**< Bytes mapped, header included, or 0 if the
+                             block comes from @a malloc() */
+        int huge;       /**< Non-zero if mapped on explicit huge pages */
+        int fd;         /**< File the block is mapped from, or -1 */
+        int copied;     /**< Non-zero if mapped privately from a file
+                             (see @a arena_map()) */
+    } info;
+    long double align;
+    unsigned char pad[ARENA_MAP_OFFSET];
+} s_header_td;
+
+
+/**
+ * @brief Map a buffer directly from the system
+ *
+ * @param size Size of the buffer, in bytes
+ *
+ * @return Header of the mapped block, or @c NULL if mapping fails
+ */
+static s_header_td *s_map(size_t size)
+{
+    size_t length = sizeof(s_header_td) + size;
+    void *base = MAP_FAILED;
+    int huge = 0;
+
+    /* Whole huge pages, so that the mapping can use them and be grown
+     * in place by the same amounts */
+    length = (length + ARENA_HUGE_PAGE - 1) / ARENA_HUGE_PAGE
+        * ARENA_HUGE_PAGE;
+
+#ifdef MAP_HUGETLB
+    base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge = (base != MAP_FAILED);
+#endif
+    if (base == MAP_FAILED) {
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(base, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    s_header_td *h = base;
+    h->info.size = size;
+    h->info.length = length;
+    h->info.huge = huge;
+    h->info.fd = -1;
+    h->info.copied = 0;
+
+    return h;
+}
+
+
+/**
+ * @brief Map (or map again, larger) a block from a file
+ *
+ * @param h    Header of the block already mapped, or @c NULL
+ * @param size Size of the buffer, in bytes
+ * @param fd   Descriptor of the file
+ *
+ * @return Header of the mapped block, or @c NULL on failure (@p h is
+ *         then left mapped as it was)
+ */
+static s_header_td *s_map_file(s_header_td *h, size_t size, int fd)
+{
+    size_t length = (sizeof(s_header_td) + size + ARENA_FILE_EXTENT - 1)
+        / ARENA_FILE_EXTENT * ARENA_FILE_EXTENT;
+    void *base = MAP_FAILED;
+
+    if (h != NULL && length <= h->info.length) {
+        h->info.size = size;
+        return h;
+    }
+    if (ftruncate(fd, (off_t) length) != 0) {
+        return NULL;
+    }
+
+#ifdef MREMAP_MAYMOVE
+    if (h != NULL) {
+        base = mremap(h, h->info.length, length, MREMAP_MAYMOVE);
+    }
+#endif
+    if (base == MAP_FAILED) {
+        /* The contents are in the file: a new mapping sees them */
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+        if (h != NULL) {
+            munmap(h, h->info.length);
+        }
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(base, length, MADV_SEQUENTIAL);
+#endif
+
+    h = base;
+    h->info.size = size;
+    h->info.length = length;
+    h->info.huge = 0;
+    h->info.fd = fd;
+    h->info.copied = 0;
+
+    return h;
+}
+
+
+/* Allocate a buffer */
+void *arena_alloc(size_t size)
+{
+    s_header_td *h = NULL;
+
+    if (size >= ARENA_MMAP_MIN) {
+        h = s_map(size);
+    }
+    if (h == NULL) {
+        if ((h = malloc(sizeof(*h) + size)) == NULL) {
+            return NULL;
+        }
+        h->info.size = size;
+        h->info.length = 0;
+        h->info.huge = 0;
+        h->info.fd = -1;
+        h->info.copied = 0;
+    }
+
+    return h + 1;
+}
+
+
+/* Allocate a buffer mapped from a file */
+void *arena_alloc_file(size_t size, int fd)
+{
+    s_header_td *h = s_map_file(NULL, size, fd);
+
+    return (h != NULL) ? h + 1 : NULL;
+}
+
+
+/* Map a buffer from a region of a file, copied on write */
+void *arena_map(int fd, size_t offset, size_t size)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t length = sizeof(s_header_td) + size;
+
+    if (page <= 0 || offset % (size_t) page != 0) {
+        return NULL;
+    }
+
+    /* Whole pages, which all hold bytes of the file */
+    length = (length + (size_t) page - 1) / (size_t) page * (size_t) page;
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fd, (off_t) offset);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    s_header_td *h = base;
+    h->info.size = size;
+    h->info.length = length;
+    h->info.huge = 0;
+    h->info.fd = -1;
+    h->info.copied = 1;
+
+    return h + 1;
+}
+
+
+/* Create a scratch file for buffers mapped from a file */
+int arena_scratch(const char *dir)
+{
+    char path[4096];
+    int fd;
+
+    if (dir == NULL || *dir == '\0') {
+        dir = getenv("TMPDIR");
+    }
+    if (dir == NULL || *dir == '\0') {
+        dir = "/tmp";
+    }
+
+    snprintf(path, sizeof(path), "%s/regres_map_XXXXXX", dir);
+    if ((fd = mkstemp(path)) != -1) {
+        unlink(path);
+    }
+
+    return fd;
+}
+
+
+/* Resize a buffer */
+void *arena_realloc(void *p, size_t size)
+{
+    if (p == NULL) {
+        return arena_alloc(size);
+    }
+
+    s_header_td *h = (s_header_td *) p - 1;
+
+    if (h->info.fd >= 0) {
+        h = s_map_file(h, size, h->info.fd);
+        return (h != NULL) ? h + 1 : NULL;
+    }
+    if (h->info.length == 0 && size < ARENA_MMAP_MIN) {
+        if ((h = realloc(h, sizeof(*h) + size)) == NULL) {
+            return NULL;
+        }
+        h->info.size = size;
+        return h + 1;
+    }
+
+    /* Pages past those of the file cannot be mapped from it */
+    if (h->info.length != 0 && !h->info.copied) {
+        size_t length = (sizeof(*h) + size + ARENA_HUGE_PAGE - 1)
+            / ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+
+        if (length == h->info.length) {
+            h->info.size = size;
+            return p;
+        }
+#ifdef MREMAP_MAYMOVE
+        /* Moves page table entries, not the contents */
+        if (!h->info.huge) {
+            void *base = mremap(h, h->info.length, length, MREMAP_MAYMOVE);
+            if (base != MAP_FAILED) {
+                h = base;
+                h->info.size = size;
+                h->info.length = length;
+                return h + 1;
+            }
+        }
+#endif
+    }
+
+    /* From the heap to a mapping, or remapping not available */
+    void *q = arena_alloc(size);
+    if (q == NULL) {
+        return NULL;
+    }
+    memcpy(q, p, (size < h->info.size) ? size : h->info.size);
+    arena_free(p);
+
+    return q;
+}
+
+
+/* Free a buffer */
+void arena_free(void *p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    s_header_td *h = (s_header_td *) p - 1;
+    if (h->info.length != 0) {
+        munmap(h, h->info.length);
+    } else {
+        free(h);
+    }
+}
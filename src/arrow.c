@@ -0,0 +1,1043 @@
+/**
+ * @file arrow.c
+ *
+ * @brief Implementation of the Apache Arrow IPC file format of a dataset
+ *
+ * An Arrow IPC file is its magic, a stream of messages (the schema,
+ * then the record batches, then an end marker) and a footer that
+ * indexes them.  The metadata of every message, and the footer, are
+ * FlatBuffers tables; the few of them used here are built and read by
+ * hand.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* mmap, munmap */
+
+
+/* System includes */
+#include <fcntl.h>      /* open, O_RDONLY */
+#include <stdint.h>     /* uint16_t, uint32_t, uint64_t */
+#include <stdio.h>      /* fclose, fopen, fread, fwrite */
+#include <stdlib.h>     /* free, malloc, realloc */
+#include <string.h>     /* memcmp, memcpy, memset, strlen */
+#include <sys/mman.h>   /* mmap, munmap */
+#include <sys/stat.h>   /* fstat */
+#include <unistd.h>     /* close */
+
+/* Project includes */
+#include <dataset.h>
+
+/* Local includes */
+#include <arrow.h>
+
+
+#define S_PREFIX_SIZE (8)       /**< Magic and padding at the start */
+#define S_SUFFIX_SIZE (10)      /**< Footer length and magic at the end */
+#define S_VERSION_V5 (4)        /**< MetadataVersion written */
+#define S_HEADER_SCHEMA (1)     /**< MessageHeader of a schema */
+#define S_HEADER_BATCH (3)      /**< MessageHeader of a record batch */
+#define S_TYPE_FLOAT (3)        /**< Type of a floating point field */
+#define S_DOUBLE (2)            /**< Precision of a float64 field */
+#define S_CONTINUATION (0xffffffffUL)   /**< Marker before a message */
+#define S_BLOCK_SIZE (24)       /**< Bytes of a Block in the footer */
+#define S_NODE_SIZE (16)        /**< Bytes of a FieldNode */
+#define S_BUFFER_SIZE (16)      /**< Bytes of a Buffer */
+
+
+/**
+ * @brief FlatBuffers buffer being built, front to back
+ *
+ * Every object is appended after the ones that refer to it, whose
+ * offsets are patched once it is placed (FlatBuffers offsets only
+ * point forward).
+ */
+typedef struct {
+    unsigned char *buf;     /**< Bytes built so far */
+    size_t len;             /**< Number of bytes in @e buf */
+    size_t cap;             /**< Capacity of @e buf */
+    int failed;             /**< Non-zero on memory allocation failure */
+} s_builder_td;
+
+/**
+ * @brief Field of a FlatBuffers table being built
+ */
+typedef struct {
+    int size;           /**< Bytes of the field (1, 2, 4 or 8, and 4
+                             for an offset), or 0 if it is absent */
+    uint64_t value;     /**< Value of the field (an offset is patched
+                             later, see @a s_ref()) */
+    size_t at;          /**< Where the field was stored */
+} s_field_td;
+
+/**
+ * @brief FlatBuffers buffer being read
+ *
+ * Reads out of bounds return 0 and set @e bad, so that the metadata
+ * is checked once it has been walked, rather than at every step.
+ */
+typedef struct {
+    const unsigned char *buf;   /**< Bytes of the buffer */
+    size_t len;                 /**< Number of bytes in @e buf */
+    int bad;                    /**< Non-zero once a read failed */
+} s_reader_td;
+
+/**
+ * @brief Columns of an Arrow file chosen as the values of the points
+ */
+typedef struct {
+    int field[ARROW_COLS];      /**< Field of every value, or -1 */
+    size_t buffer[ARROW_COLS];  /**< First buffer (validity) of the
+                                     field in every record batch */
+} s_columns_td;
+
+
+/**
+ * @brief Store an integer of @p n bytes, little endian
+ *
+ * @param p Where to store it
+ * @param v Value to store
+ * @param n Number of bytes
+ */
+static void s_put_le(unsigned char *p, uint64_t v, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+
+/**
+ * @brief Read an integer of @p n bytes, little endian
+ *
+ * @param p Where to read it from
+ * @param n Number of bytes
+ *
+ * @return Value read
+ */
+static uint64_t s_get_le(const unsigned char *p, int n)
+{
+    uint64_t v = 0;
+
+    for (int i = n - 1; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+
+/**
+ * @brief Tell the byte order of the values in memory
+ *
+ * @return 1 if big endian, or 0 if little endian (as the @e Endianness
+ *         of a schema)
+ */
+static int s_big_endian(void)
+{
+    const uint16_t one = 1;
+
+    return *(const unsigned char *) &one == 0;
+}
+
+
+/**
+ * @brief Append zeroed bytes to a buffer being built
+ *
+ * @param b Pointer to the buffer
+ * @param n Number of bytes
+ *
+ * @return Position of the first byte appended
+ */
+static size_t s_grow(s_builder_td *b, size_t n)
+{
+    size_t at = b->len;
+
+    if (b->failed) {
+        return 0;
+    }
+    if (b->len + n > b->cap) {
+        size_t cap = (b->cap) ? 2 * b->cap : 256;
+        while (cap < b->len + n) {
+            cap *= 2;
+        }
+        unsigned char *buf = realloc(b->buf, cap);
+        if (buf == NULL) {
+            b->failed = 1;
+            return 0;
+        }
+        b->buf = buf;
+        b->cap = cap;
+    }
+    memset(b->buf + at, 0, n);
+    b->len += n;
+
+    return at;
+}
+
+
+/**
+ * @brief Store an integer in a buffer being built
+ *
+ * @param b  Pointer to the buffer
+ * @param at Where to store it
+ * @param v  Value to store
+ * @param n  Number of bytes
+ */
+static void s_put(s_builder_td *b, size_t at, uint64_t v, int n)
+{
+    if (!b->failed) {
+        s_put_le(b->buf + at, v, n);
+    }
+}
+
+
+/**
+ * @brief Pad a buffer being built to a multiple of some bytes
+ *
+ * @param b     Pointer to the buffer
+ * @param align Number of bytes
+ */
+static void s_align(s_builder_td *b, size_t align)
+{
+    while (!b->failed && b->len % align != 0) {
+        s_grow(b, 1);
+    }
+}
+
+
+/**
+ * @brief Point an offset of a buffer being built to an object
+ *
+ * @param b      Pointer to the buffer
+ * @param at     Where the offset is stored
+ * @param target Position of the object, after @p at
+ */
+static void s_ref(s_builder_td *b, size_t at, size_t target)
+{
+    s_put(b, at, target - at, 4);
+}
+
+
+/**
+ * @brief Append a table to a buffer being built
+ *
+ * The vtable of the table is stored right before it, and the table
+ * starts 8-aligned, with every field aligned to its size.
+ *
+ * @param b Pointer to the buffer
+ * @param f Fields of the table, in order of their ids; their @e at is
+ *          set here
+ * @param n Number of fields
+ *
+ * @return Position of the table
+ */
+static size_t s_table(s_builder_td *b, s_field_td *f, int n)
+{
+    size_t vt_len = 4 + 2 * (size_t) n;
+
+    while (!b->failed && (b->len + vt_len) % 8 != 0) {
+        s_grow(b, 1);
+    }
+    size_t vt = s_grow(b, vt_len);
+    size_t table = s_grow(b, 4);
+    s_put(b, table, table - vt, 4);
+
+    for (int i = 0; i < n; ++i) {
+        if (f[i].size == 0) {
+            continue;
+        }
+        s_align(b, (size_t) f[i].size);
+        f[i].at = s_grow(b, (size_t) f[i].size);
+        s_put(b, f[i].at, f[i].value, f[i].size);
+        s_put(b, vt + 4 + 2 * (size_t) i, f[i].at - table, 2);
+    }
+    s_put(b, vt, vt_len, 2);
+    s_put(b, vt + 2, b->len - table, 2);
+
+    return table;
+}
+
+
+/**
+ * @brief Append a string to a buffer being built
+ *
+ * @param b Pointer to the buffer
+ * @param s Null-terminated string
+ *
+ * @return Position of the string
+ */
+static size_t s_string(s_builder_td *b, const char *s)
+{
+    size_t len = strlen(s);
+
+    s_align(b, 4);
+    size_t at = s_grow(b, 4);
+    size_t text = s_grow(b, len + 1);
+    s_put(b, at, len, 4);
+    if (!b->failed) {
+        memcpy(b->buf + text, s, len);
+    }
+
+    return at;
+}
+
+
+/**
+ * @brief Append a vector to a buffer being built
+ *
+ * @param b     Pointer to the buffer
+ * @param n     Number of elements
+ * @param size  Bytes of every element (zeroed, to be stored later)
+ * @param align Alignment of the elements (4 or 8)
+ *
+ * @return Position of the vector; its elements follow 4 bytes after
+ */
+static size_t s_vector(s_builder_td *b, size_t n, size_t size,
+        size_t align)
+{
+    while (!b->failed && (b->len + 4) % align != 0) {
+        s_grow(b, 1);
+    }
+    size_t at = s_grow(b, 4);
+    s_grow(b, n * size);
+    s_put(b, at, n, 4);
+
+    return at;
+}
+
+
+/**
+ * @brief Append the schema of the columns to a buffer being built
+ *
+ * @param b      Pointer to the buffer
+ * @param names  Names of the columns
+ * @param n_cols Number of columns, all of them float64 and not null
+ *
+ * @return Position of the @e Schema table
+ */
+static size_t s_schema(s_builder_td *b, const char *const *names,
+        int n_cols)
+{
+    /* endianness, fields */
+    s_field_td schema[2] = { { 2, 0, 0 }, { 4, 0, 0 } };
+    schema[0].value = (uint64_t) s_big_endian();
+
+    size_t table = s_table(b, schema, 2);
+    size_t fields = s_vector(b, (size_t) n_cols, 4, 4);
+    s_ref(b, schema[1].at, fields);
+
+    for (int c = 0; c < n_cols; ++c) {
+        /* name, nullable, type_type, type, dictionary, children */
+        s_field_td field[6] = {
+            { 4, 0, 0 }, { 1, 0, 0 }, { 1, S_TYPE_FLOAT, 0 }, { 4, 0, 0 },
+            { 0, 0, 0 }, { 4, 0, 0 }
+        };
+        s_field_td precision[1] = { { 2, S_DOUBLE, 0 } };
+
+        s_ref(b, fields + 4 + 4 * (size_t) c, s_table(b, field, 6));
+        s_ref(b, field[0].at, s_string(b, names[c]));
+        s_ref(b, field[3].at, s_table(b, precision, 1));
+        s_ref(b, field[5].at, s_vector(b, 0, 4, 4));
+    }
+
+    return table;
+}
+
+
+/**
+ * @brief Start the metadata of a message in an empty buffer
+ *
+ * @param b        Pointer to the buffer
+ * @param header   Type of the message (@c S_HEADER_SCHEMA or
+ *                 @c S_HEADER_BATCH)
+ * @param body_len Bytes of the body of the message
+ *
+ * @return Where the offset of the header table is to be stored
+ */
+static size_t s_message(s_builder_td *b, int header, uint64_t body_len)
+{
+    /* version, header_type, header, bodyLength */
+    s_field_td msg[4] = {
+        { 2, S_VERSION_V5, 0 }, { 1, 0, 0 }, { 4, 0, 0 }, { 8, 0, 0 }
+    };
+    msg[1].value = (uint64_t) header;
+    msg[3].value = body_len;
+
+    b->len = 0;
+    size_t root = s_grow(b, 4);
+    s_ref(b, root, s_table(b, msg, 4));
+
+    return msg[2].at;
+}
+
+
+/**
+ * @brief Write the metadata of a message to a file
+ *
+ * @param fp Pointer to the file
+ * @param b  Pointer to the metadata (padded here to 8 bytes)
+ *
+ * @return Bytes written (the length of the metadata in the footer), or
+ *         0 on failure
+ */
+static size_t s_write_message(FILE *fp, s_builder_td *b)
+{
+    unsigned char prefix[8];
+
+    s_align(b, 8);
+    if (b->failed) {
+        return 0;
+    }
+    s_put_le(prefix, S_CONTINUATION, 4);
+    s_put_le(prefix + 4, b->len, 4);
+    if (fwrite(prefix, 1, sizeof(prefix), fp) != sizeof(prefix) ||
+            fwrite(b->buf, 1, b->len, fp) != b->len) {
+        return 0;
+    }
+
+    return sizeof(prefix) + b->len;
+}
+
+
+/* Save a dataset to an Arrow IPC file */
+int arrow_save(const char *filename, const dataset_td *ds)
+{
+    static const char *const names[ARROW_COLS] = { "x", "y", "ey" };
+    int n_cols = (ds->mode & DATASET_NO_EY) ? 2 : 3;
+    size_t n_batches = (ds->size + ARROW_BATCH - 1) / ARROW_BATCH;
+    uint64_t *blocks = malloc((n_batches + 1) * 3 * sizeof(*blocks));
+    data_point_td *buf = malloc(ARROW_BATCH * sizeof(*buf));
+    double *cols = malloc(ARROW_COLS * ARROW_BATCH * sizeof(*cols));
+    s_builder_td b = { NULL, 0, 0, 0 };
+    unsigned char word[8] = { 0 };
+    uint64_t pos = S_PREFIX_SIZE;
+    int err = 0;
+
+    if (blocks == NULL || buf == NULL || cols == NULL) {
+        free(blocks);
+        free(buf);
+        free(cols);
+        return 2;
+    }
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        free(blocks);
+        free(buf);
+        free(cols);
+        return 1;
+    }
+
+    memcpy(word, ARROW_MAGIC, strlen(ARROW_MAGIC));
+    err = (fwrite(word, 1, S_PREFIX_SIZE, fp) != S_PREFIX_SIZE);
+
+    size_t len;
+    if (err == 0) {
+        s_ref(&b, s_message(&b, S_HEADER_SCHEMA, 0),
+                s_schema(&b, names, n_cols));
+        len = s_write_message(fp, &b);
+        err = (len == 0);
+        pos += len;
+    }
+
+    /* Every batch is a column after another, each one 8-aligned (as
+     * their lengths are) */
+    for (size_t k = 0; err == 0 && k < n_batches; ++k) {
+        size_t begin = k * ARROW_BATCH;
+        size_t n = (ds->size - begin < ARROW_BATCH)
+            ? ds->size - begin : ARROW_BATCH;
+        const data_point_td *p = dataset_block(ds, begin, n, buf);
+        uint64_t col_len = n * sizeof(double);
+        uint64_t body_len = (uint64_t) n_cols * col_len;
+
+        for (size_t i = 0; i < n; ++i) {
+            cols[i] = p[i].x;
+            cols[ARROW_BATCH + i] = p[i].y;
+            cols[2 * ARROW_BATCH + i] = p[i].ey;
+        }
+
+        /* length, nodes, buffers (validity and values of every
+         * column: no validity, as no value is null) */
+        s_field_td batch[3] = { { 8, 0, 0 }, { 4, 0, 0 }, { 4, 0, 0 } };
+        batch[0].value = n;
+        size_t header = s_message(&b, S_HEADER_BATCH, body_len);
+        s_ref(&b, header, s_table(&b, batch, 3));
+
+        size_t nodes = s_vector(&b, (size_t) n_cols, S_NODE_SIZE, 8);
+        size_t buffers = s_vector(&b, 2 * (size_t) n_cols,
+                S_BUFFER_SIZE, 8);
+        s_ref(&b, batch[1].at, nodes);
+        s_ref(&b, batch[2].at, buffers);
+        for (int c = 0; c < n_cols; ++c) {
+            size_t node = nodes + 4 + S_NODE_SIZE * (size_t) c;
+            size_t validity = buffers + 4 + 2 * S_BUFFER_SIZE * (size_t) c;
+            s_put(&b, node, n, 8);
+            s_put(&b, validity, c * col_len, 8);
+            s_put(&b, validity + S_BUFFER_SIZE, c * col_len, 8);
+            s_put(&b, validity + S_BUFFER_SIZE + 8, col_len, 8);
+        }
+
+        len = s_write_message(fp, &b);
+        err = (len == 0);
+        for (int c = 0; err == 0 && c < n_cols; ++c) {
+            err = (fwrite(cols + c * ARROW_BATCH, 1, col_len, fp)
+                    != col_len);
+        }
+        blocks[3 * k] = pos;
+        blocks[3 * k + 1] = len;
+        blocks[3 * k + 2] = body_len;
+        pos += len + body_len;
+    }
+
+    /* End of the stream, then the footer, which repeats the schema */
+    if (err == 0) {
+        s_put_le(word, S_CONTINUATION, 4);
+        s_put_le(word + 4, 0, 4);
+        err = (fwrite(word, 1, 8, fp) != 8);
+    }
+    if (err == 0) {
+        /* version, schema, dictionaries, recordBatches */
+        s_field_td footer[4] = {
+            { 2, S_VERSION_V5, 0 }, { 4, 0, 0 }, { 4, 0, 0 }, { 4, 0, 0 }
+        };
+
+        b.len = 0;
+        size_t root = s_grow(&b, 4);
+        s_ref(&b, root, s_table(&b, footer, 4));
+        s_ref(&b, footer[1].at, s_schema(&b, names, n_cols));
+        s_ref(&b, footer[2].at, s_vector(&b, 0, S_BLOCK_SIZE, 8));
+
+        size_t records = s_vector(&b, n_batches, S_BLOCK_SIZE, 8);
+        s_ref(&b, footer[3].at, records);
+        for (size_t k = 0; k < n_batches; ++k) {
+            size_t block = records + 4 + S_BLOCK_SIZE * k;
+            s_put(&b, block, blocks[3 * k], 8);
+            s_put(&b, block + 8, blocks[3 * k + 1], 4);
+            s_put(&b, block + 16, blocks[3 * k + 2], 8);
+        }
+
+        s_put_le(word, b.len, 4);
+        err = (b.failed || fwrite(b.buf, 1, b.len, fp) != b.len ||
+                fwrite(word, 1, 4, fp) != 4 ||
+                fwrite(ARROW_MAGIC, 1, strlen(ARROW_MAGIC), fp)
+                    != strlen(ARROW_MAGIC));
+    }
+    if (b.failed) {
+        err = 2;
+    }
+
+    if (fclose(fp) != 0 && err == 0) {
+        err = 1;
+    }
+    free(b.buf);
+    free(blocks);
+    free(buf);
+    free(cols);
+
+    return err;
+}
+
+
+/**
+ * @brief Read an integer of a buffer being read
+ *
+ * @param r  Pointer to the buffer
+ * @param at Where to read it from
+ * @param n  Number of bytes
+ *
+ * @return Value read, or 0 if out of bounds
+ */
+static uint64_t s_get(s_reader_td *r, size_t at, int n)
+{
+    if (at > r->len || (size_t) n > r->len - at) {
+        r->bad = 1;
+        return 0;
+    }
+
+    return s_get_le(r->buf + at, n);
+}
+
+
+/**
+ * @brief Find a field of a table of a buffer being read
+ *
+ * @param r     Pointer to the buffer
+ * @param table Position of the table, or 0 if there is none
+ * @param id    Id of the field
+ *
+ * @return Position of the field, or 0 if it is absent
+ */
+static size_t s_find(s_reader_td *r, size_t table, int id)
+{
+    if (table == 0) {
+        return 0;
+    }
+
+    /* The vtable is at a signed distance from the table */
+    uint64_t soffset = s_get(r, table, 4);
+    int negative = (soffset & 0x80000000UL) != 0;
+    if (!negative && soffset > table) {
+        r->bad = 1;
+        return 0;
+    }
+    uint64_t vt = (negative) ? table + (0x100000000ULL - soffset)
+        : table - soffset;
+
+    size_t slot = 4 + 2 * (size_t) id;
+    if (slot + 2 > s_get(r, (size_t) vt, 2)) {
+        return 0;
+    }
+    size_t off = (size_t) s_get(r, (size_t) vt + slot, 2);
+
+    return (off == 0) ? 0 : table + off;
+}
+
+
+/**
+ * @brief Get a scalar field of a table of a buffer being read
+ *
+ * @param r     Pointer to the buffer
+ * @param table Position of the table
+ * @param id    Id of the field
+ * @param n     Bytes of the field
+ * @param value Value of the field if it is absent
+ *
+ * @return Value of the field
+ */
+static uint64_t s_scalar(s_reader_td *r, size_t table, int id, int n,
+        uint64_t value)
+{
+    size_t at = s_find(r, table, id);
+
+    return (at != 0) ? s_get(r, at, n) : value;
+}
+
+
+/**
+ * @brief Find the root table of a buffer being read
+ *
+ * @param r Pointer to the buffer
+ *
+ * @return Position of the root table, or 0 if it is out of bounds
+ */
+static size_t s_root(s_reader_td *r)
+{
+    uint64_t off = s_get(r, 0, 4);
+
+    if (off == 0 || off >= r->len) {
+        r->bad = 1;
+        return 0;
+    }
+
+    return (size_t) off;
+}
+
+
+/**
+ * @brief Follow an offset of a buffer being read
+ *
+ * @param r  Pointer to the buffer
+ * @param at Where the offset is, or 0 if there is none
+ *
+ * @return Position of the object, or 0 if there is none
+ */
+static size_t s_deref(s_reader_td *r, size_t at)
+{
+    if (at == 0) {
+        return 0;
+    }
+
+    uint64_t off = s_get(r, at, 4);
+    if (off == 0 || off >= r->len - at) {
+        r->bad = 1;
+        return 0;
+    }
+
+    return at + (size_t) off;
+}
+
+
+/**
+ * @brief Tell if a string of a buffer being read is a given one
+ *
+ * @param r  Pointer to the buffer
+ * @param at Position of the string, or 0 if there is none
+ * @param s  Null-terminated string to compare with
+ *
+ * @return Non-zero if they are equal
+ */
+static int s_string_is(s_reader_td *r, size_t at, const char *s)
+{
+    size_t len = strlen(s);
+
+    if (at == 0 || s_get(r, at, 4) != len || r->bad) {
+        return 0;
+    }
+
+    return len <= r->len - at - 4 && memcmp(r->buf + at + 4, s, len) == 0;
+}
+
+
+/**
+ * @brief Get the number of buffers of a field in a record batch
+ *
+ * @param r     Pointer to the buffer
+ * @param field Position of the @e Field table
+ *
+ * @return Number of buffers, or 0 if the field is nested or of a type
+ *         whose buffers are not known here
+ */
+static size_t s_buffers_of(s_reader_td *r, size_t field)
+{
+    size_t children = s_deref(r, s_find(r, field, 5));
+
+    if (children != 0 && s_get(r, children, 4) != 0) {
+        return 0;
+    }
+    switch (s_scalar(r, field, 2, 1, 0)) {
+        case 2: case 3: case 6: case 7: case 8: case 9: case 10: case 11:
+        case 15: case 18:
+            /* Int, FloatingPoint, Bool, Decimal, Date, Time, Timestamp,
+             * Interval, FixedSizeBinary, Duration */
+            return 2;
+        case 4: case 5: case 19: case 20:
+            /* Binary, Utf8, LargeBinary, LargeUtf8 */
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * @brief Choose the fields of the values of the points
+ *
+ * @param r      Pointer to the footer
+ * @param schema Position of the @e Schema table
+ * @param names  Names of the fields, as @a arrow_load() takes them
+ * @param cols   Where to store the columns chosen
+ *
+ * @return 0 on success, or 1, 3 or 4 as @a arrow_load()
+ */
+static int s_choose(s_reader_td *r, size_t schema,
+        const char *const *names, s_columns_td *cols)
+{
+    static const char *const defaults[ARROW_COLS] = { "x", "y", "ey" };
+    size_t fields = s_deref(r, s_find(r, schema, 1));
+    size_t n = (size_t) s_get(r, fields, 4);
+    int by_name = 0;
+
+    if (r->bad || n > (r->len - fields) / 4) {
+        return 3;
+    }
+
+    /* Named fields first, then the default names, then the float64
+     * fields left, in order (for ey, only if x and y were) */
+    for (int pass = 0; pass < 3; ++pass) {
+        for (int k = 0; k < ARROW_COLS; ++k) {
+            const char *name = (names != NULL) ? names[k] : NULL;
+            if ((pass == 0) != (name != NULL) || cols->field[k] >= 0) {
+                continue;
+            }
+            if (pass == 1) {
+                name = defaults[k];
+            }
+            if (pass == 2 && k == 2 && by_name) {
+                continue;
+            }
+
+            for (size_t i = 0; i < n && cols->field[k] < 0; ++i) {
+                size_t field = s_deref(r, fields + 4 + 4 * i);
+                size_t type = s_deref(r, s_find(r, field, 3));
+                int used = 0;
+                for (int j = 0; j < ARROW_COLS; ++j) {
+                    used |= (cols->field[j] == (int) i);
+                }
+                if (used || s_scalar(r, field, 2, 1, 0) != S_TYPE_FLOAT ||
+                        s_scalar(r, type, 0, 2, 0) != S_DOUBLE) {
+                    continue;
+                }
+                if (pass == 2 ||
+                        s_string_is(r, s_deref(r, s_find(r, field, 0)),
+                            name)) {
+                    cols->field[k] = (int) i;
+                }
+            }
+            if (pass == 0 && cols->field[k] < 0) {
+                return (r->bad) ? 3 : 4;
+            }
+            by_name |= (pass < 2 && k < 2 && cols->field[k] >= 0);
+        }
+    }
+    if (cols->field[0] < 0 || cols->field[1] < 0) {
+        return (r->bad) ? 3 : 1;
+    }
+
+    /* Buffers of the fields before those chosen */
+    for (int k = 0; k < ARROW_COLS; ++k) {
+        cols->buffer[k] = 0;
+        for (int i = 0; i < cols->field[k]; ++i) {
+            size_t field = s_deref(r, fields + 4 + 4 * (size_t) i);
+            size_t n_buffers = s_buffers_of(r, field);
+            if (n_buffers == 0) {
+                return (r->bad) ? 3 : 1;
+            }
+            cols->buffer[k] += n_buffers;
+        }
+    }
+
+    return (r->bad) ? 3 : 0;
+}
+
+
+/**
+ * @brief Read the points of a record batch
+ *
+ * @param data   Mapped file
+ * @param size   Bytes of the file
+ * @param block  Position of the @e Block of the batch in the footer
+ * @param footer Pointer to the footer
+ * @param cols   Pointer to the columns chosen
+ * @param points Where the points go, or @c NULL to count them only
+ * @param n      Number of points read so far, updated here
+ * @param mode   Storage mode that holds the points so far, narrowed
+ *               here
+ *
+ * @return 0 on success, or 3 or 5 as @a arrow_load()
+ */
+static int s_read_batch(const unsigned char *data, size_t size,
+        size_t block, s_reader_td *footer, const s_columns_td *cols,
+        data_point_td *points, size_t *n, int *mode)
+{
+    uint64_t offset = s_get(footer, block, 8);
+    uint64_t meta_len = s_get(footer, block + 8, 4);
+    uint64_t body_len = s_get(footer, block + 16, 8);
+
+    if (footer->bad || offset > size || meta_len > size - offset ||
+            body_len > size - offset - meta_len || meta_len < 8) {
+        return 3;
+    }
+
+    /* Messages start with a continuation marker, but for old files */
+    s_reader_td r = { data + offset, (size_t) meta_len, 0 };
+    size_t skip = (s_get(&r, 0, 4) == S_CONTINUATION) ? 8 : 4;
+    r.buf += skip;
+    r.len -= skip;
+
+    size_t msg = s_root(&r);
+    size_t batch = s_deref(&r, s_find(&r, msg, 2));
+    if (s_scalar(&r, msg, 1, 1, 0) != S_HEADER_BATCH || batch == 0) {
+        return 3;
+    }
+    if (s_find(&r, batch, 3) != 0) {
+        return 5;
+    }
+
+    uint64_t rows = s_scalar(&r, batch, 0, 8, 0);
+    size_t buffers = s_deref(&r, s_find(&r, batch, 2));
+    size_t n_buffers = (size_t) s_get(&r, buffers, 4);
+    if (r.bad || rows > size / sizeof(double) ||
+            n_buffers > (r.len - buffers - 4) / S_BUFFER_SIZE) {
+        return 3;
+    }
+    if (points == NULL) {
+        *n += (size_t) rows;
+        return 0;
+    }
+
+    /* Values and validity bits of every column, checked in bounds */
+    const unsigned char *body = data + offset + meta_len;
+    const unsigned char *values[ARROW_COLS] = { NULL, NULL, NULL };
+    const unsigned char *valid[ARROW_COLS] = { NULL, NULL, NULL };
+    for (int k = 0; k < ARROW_COLS; ++k) {
+        if (cols->field[k] < 0) {
+            continue;
+        }
+        if (cols->buffer[k] + 1 >= n_buffers) {
+            return 3;
+        }
+
+        size_t at = buffers + 4 + S_BUFFER_SIZE * cols->buffer[k];
+        uint64_t v_off = s_get(&r, at, 8);
+        uint64_t v_len = s_get(&r, at + 8, 8);
+        uint64_t d_off = s_get(&r, at + S_BUFFER_SIZE, 8);
+        uint64_t d_len = s_get(&r, at + S_BUFFER_SIZE + 8, 8);
+        if (d_off > body_len || d_len > body_len - d_off ||
+                d_len < rows * sizeof(double) || v_off > body_len ||
+                v_len > body_len - v_off) {
+            return 3;
+        }
+        values[k] = body + d_off;
+        if (v_len > 0) {
+            if (v_len < (rows + 7) / 8) {
+                return 3;
+            }
+            valid[k] = body + v_off;
+        }
+    }
+
+    /* One pass from the mapped columns into the points */
+    for (size_t i = 0; i < rows; ++i) {
+        double v[ARROW_COLS] = { 0.0, 0.0, 0.0 };
+        int skip_row = 0;
+
+        for (int k = 0; k < ARROW_COLS; ++k) {
+            if (values[k] == NULL) {
+                continue;
+            }
+            if (valid[k] != NULL && !((valid[k][i / 8] >> (i % 8)) & 1)) {
+                skip_row |= (k < 2);
+                continue;
+            }
+            memcpy(&v[k], values[k] + i * sizeof(double), sizeof(double));
+            if ((double) (float) v[k] != v[k]) {
+                *mode &= ~DATASET_SINGLE;
+            }
+        }
+        if (skip_row) {
+            continue;
+        }
+        if (v[2] != 0.0) {
+            *mode &= ~DATASET_NO_EY;
+        }
+        points[*n].x = v[0];
+        points[*n].y = v[1];
+        points[*n].ey = v[2];
+        (*n)++;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Read the points of every record batch of a mapped file
+ *
+ * @param data   Mapped file
+ * @param size   Bytes of the file
+ * @param names  Names of the fields, as @a arrow_load() takes them
+ * @param ds     Pointer to the dataset where the points go,
+ *               initialized here on success
+ *
+ * @return 0 on success, or an error as @a arrow_load()
+ */
+static int s_read(const unsigned char *data, size_t size,
+        const char *const *names, dataset_td *ds)
+{
+    size_t prefix = strlen(ARROW_MAGIC);
+    s_columns_td cols = { { -1, -1, -1 }, { 0, 0, 0 } };
+
+    if (size < S_PREFIX_SIZE + S_SUFFIX_SIZE ||
+            memcmp(data, ARROW_MAGIC, prefix) != 0 ||
+            memcmp(data + size - prefix, ARROW_MAGIC, prefix) != 0) {
+        return 1;
+    }
+
+    uint64_t footer_len = s_get_le(data + size - S_SUFFIX_SIZE, 4);
+    if (footer_len > size - S_PREFIX_SIZE - S_SUFFIX_SIZE) {
+        return 3;
+    }
+    s_reader_td footer = {
+        data + size - S_SUFFIX_SIZE - footer_len, (size_t) footer_len, 0
+    };
+    size_t root = s_root(&footer);
+    size_t schema = s_deref(&footer, s_find(&footer, root, 1));
+    size_t blocks = s_deref(&footer, s_find(&footer, root, 3));
+    size_t n_blocks = (size_t) s_get(&footer, blocks, 4);
+    if (footer.bad || schema == 0 ||
+            n_blocks > (footer.len - blocks - 4) / S_BLOCK_SIZE) {
+        return 3;
+    }
+    if (s_scalar(&footer, schema, 0, 2, 0) != (uint64_t) s_big_endian()) {
+        return 1;
+    }
+
+    int err = s_choose(&footer, schema, names, &cols);
+    if (err != 0) {
+        return err;
+    }
+
+    /* Rows counted first, to allocate the points once */
+    size_t total = 0;
+    int mode = DATASET_NO_EY | DATASET_SINGLE;
+    for (size_t k = 0; err == 0 && k < n_blocks; ++k) {
+        err = s_read_batch(data, size, blocks + 4 + S_BLOCK_SIZE * k,
+                &footer, &cols, NULL, &total, &mode);
+    }
+    if (err != 0) {
+        return err;
+    }
+
+    dataset_init(ds);
+    if (total > 0 && dataset_reserve(ds, total) != 0) {
+        return 2;
+    }
+    for (size_t k = 0; err == 0 && k < n_blocks; ++k) {
+        err = s_read_batch(data, size, blocks + 4 + S_BLOCK_SIZE * k,
+                &footer, &cols, ds->points, &ds->size, &mode);
+    }
+
+    /* Read in full, then narrowed to the mode that holds them */
+    if (err == 0) {
+        err = dataset_set_mode(ds, mode);
+    }
+    if (err != 0) {
+        dataset_destroy(ds);
+    }
+
+    return err;
+}
+
+
+/* Load a dataset from an Arrow IPC file */
+int arrow_load(const char *filename, dataset_td *ds,
+        const char *const *names)
+{
+    struct stat st;
+    dataset_td loaded;
+    int fd = open(filename, O_RDONLY);
+    int err;
+
+    if (fd < 0) {
+        return 1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return 1;
+    }
+
+    void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 1;
+    }
+
+    err = s_read(data, (size_t) st.st_size, names, &loaded);
+    munmap(data, (size_t) st.st_size);
+    if (err != 0) {
+        return err;
+    }
+
+    dataset_destroy(ds);
+    *ds = loaded;
+    ds->is_modified = 0;
+
+    return 0;
+}
+
+
+/* Tell if a file is an Arrow IPC file */
+int arrow_check(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    char magic[sizeof(ARROW_MAGIC) - 1];
+    int is_arrow;
+
+    if (fp == NULL) {
+        return 0;
+    }
+    is_arrow = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+            memcmp(magic, ARROW_MAGIC, sizeof(magic)) == 0);
+    fclose(fp);
+
+    return is_arrow;
+}
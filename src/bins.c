@@ -0,0 +1,344 @@
+/**
+ * @file bins.c
+ *
+ * @brief Implementation of the binning engine for very large datasets
+ */
+
+#define _POSIX_C_SOURCE 200809L /* sysconf */
+
+
+/* System includes */
+#include <math.h>       /* fabs, fmax, isnan, sqrt */
+#include <pthread.h>    /* pthread_create, pthread_join */
+#include <stdlib.h>     /* free, malloc, realloc */
+#include <unistd.h>     /* sysconf */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+/* Local includes */
+#include <bins.h>
+
+
+/**
+ * @brief Work of a thread: accumulate a chunk of points into bins
+ */
+typedef struct {
+    const dataset_td *ds;   /**< Dataset to read */
+    const bins_td *layout;  /**< Bins to fill (only the layout is read) */
+    size_t begin;           /**< First point of the chunk */
+    size_t end;             /**< One past the last point of the chunk */
+    bin_td *bins;           /**< Bins of the chunk */
+} s_bins_job_td;
+
+
+/**
+ * @brief Set up empty bins, with the sums of each about its center
+ *
+ * @param bins Bins to initialize
+ * @param b    Layout of the bins
+ * @param y0   Origin of the @e y values
+ */
+static void s_bins_clear(bin_td *bins, const bins_td *b, double y0)
+{
+    for (size_t k = 0; k < b->n_bins; ++k) {
+        double center = b->lo + ((double) k + 0.5) * b->width;
+
+        moments_init(&bins[k].plain, center, y0, 0);
+        moments_init(&bins[k].weighted, center, y0, 1);
+        bins[k].x_min = bins[k].x_max = center;
+        bins[k].sum_e = bins[k].sum_ue = 0.0;
+    }
+}
+
+
+/**
+ * @brief Accumulate a chunk of points into the bins of the job
+ *
+ * @param arg Pointer to a @e s_bins_job_td
+ *
+ * @return Always @c NULL
+ */
+static void *s_bins_worker(void *arg)
+{
+    s_bins_job_td *job = arg;
+    data_point_td buf[BINS_BLOCK];
+    double lo = job->layout->lo;
+    double inv_w = 1.0 / job->layout->width;
+    double top = (double) (job->layout->n_bins - 1);
+    size_t idx[BINS_BLOCK];
+
+    for (size_t i = job->begin; i < job->end; i += BINS_BLOCK) {
+        size_t m = (job->end - i < BINS_BLOCK) ? job->end - i : BINS_BLOCK;
+        const data_point_td *points = dataset_block(job->ds, i, m, buf);
+
+        /* No branches nor stores to shared data: this loop vectorizes
+         * (a NaN 'x' falls into the first bin) */
+        for (size_t j = 0; j < m; ++j) {
+            double t = (points[j].x - lo) * inv_w;
+            t = (t >= 0.0) ? t : 0.0;
+            t = (t <= top) ? t : top;
+            idx[j] = (size_t) t;
+        }
+
+        for (size_t j = 0; j < m; ++j) {
+            const data_point_td *p = &points[j];
+            bin_td *bin = &job->bins[idx[j]];
+            double ey = (p->ey > 0.0) ? p->ey : 0.0;
+
+            if (bin->plain.n == 0 || p->x < bin->x_min) {
+                bin->x_min = p->x;
+            }
+            if (bin->plain.n == 0 || p->x > bin->x_max) {
+                bin->x_max = p->x;
+            }
+            moments_add(&bin->plain, p->x, p->y, p->ey);
+            moments_add(&bin->weighted, p->x, p->y, p->ey);
+            bin->sum_e += ey;
+            bin->sum_ue += (p->x - bin->plain.x0) * ey;
+        }
+    }
+
+    return NULL;
+}
+
+
+/* Summarize a dataset in bins of equal width in 'x' */
+int bins_build(bins_td *b, const dataset_td *ds, size_t n_bins)
+{
+    size_t n = ds->size;
+
+    b->bins = NULL;
+    b->n_bins = b->n = 0;
+    if (n == 0 || n_bins == 0) {
+        return 1;
+    }
+
+    /* Range of 'x' */
+    double lo = 0.0, hi = 0.0;
+    int found = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double x = dataset_get(ds, i).x;
+        if (isnan(x)) {
+            continue;
+        }
+        if (!found || x < lo) {
+            lo = x;
+        }
+        if (!found || x > hi) {
+            hi = x;
+        }
+        found = 1;
+    }
+
+    b->n_bins = n_bins;
+    b->n = n;
+    b->lo = lo;
+    b->width = (hi > lo) ? (hi - lo) / (double) n_bins : 1.0;
+    b->weighted = moments_use_weights(ds);
+
+    /* One chunk per thread, but never chunks too small to pay off */
+    long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_jobs = (n_cpu > 0) ? (size_t) n_cpu : 1;
+    if (n_jobs > BINS_MAX_THREADS) {
+        n_jobs = BINS_MAX_THREADS;
+    }
+    if (n_jobs > n / BINS_MIN_CHUNK) {
+        n_jobs = (n / BINS_MIN_CHUNK > 0) ? n / BINS_MIN_CHUNK : 1;
+    }
+
+    bin_td *all = malloc(n_jobs * n_bins * sizeof(*all));
+    if (all == NULL) {
+        b->n_bins = b->n = 0;
+        return 2;
+    }
+
+    s_bins_job_td jobs[BINS_MAX_THREADS];
+    pthread_t threads[BINS_MAX_THREADS];
+    int started[BINS_MAX_THREADS];
+    double y0 = dataset_get(ds, 0).y;
+
+    for (size_t j = 0; j < n_jobs; ++j) {
+        jobs[j].ds = ds;
+        jobs[j].layout = b;
+        jobs[j].begin = j * n / n_jobs;
+        jobs[j].end = (j + 1) * n / n_jobs;
+        jobs[j].bins = all + j * n_bins;
+        s_bins_clear(jobs[j].bins, b, y0);
+    }
+
+    /* Chunk 0 is done by this thread, and so is any chunk whose thread
+     * could not be started */
+    for (size_t j = 1; j < n_jobs; ++j) {
+        started[j] = (pthread_create(&threads[j], NULL, s_bins_worker,
+                    &jobs[j]) == 0);
+    }
+    s_bins_worker(&jobs[0]);
+    for (size_t j = 1; j < n_jobs; ++j) {
+        if (started[j]) {
+            pthread_join(threads[j], NULL);
+        } else {
+            s_bins_worker(&jobs[j]);
+        }
+    }
+
+    /* Merge every chunk into the first one (same centers) */
+    for (size_t j = 1; j < n_jobs; ++j) {
+        for (size_t k = 0; k < n_bins; ++k) {
+            bin_td *dst = &all[k];
+            const bin_td *src = &jobs[j].bins[k];
+
+            if (src->plain.n == 0) {
+                continue;
+            }
+            if (dst->plain.n == 0 || src->x_min < dst->x_min) {
+                dst->x_min = src->x_min;
+            }
+            if (dst->plain.n == 0 || src->x_max > dst->x_max) {
+                dst->x_max = src->x_max;
+            }
+            moments_merge(&dst->plain, &src->plain);
+            moments_merge(&dst->weighted, &src->weighted);
+            dst->sum_e += src->sum_e;
+            dst->sum_ue += src->sum_ue;
+        }
+    }
+
+    /* Give back the memory of the other chunks */
+    bin_td *bins = all;
+    if (n_jobs > 1) {
+        bins = realloc(all, n_bins * sizeof(*all));
+        if (bins == NULL) {
+            bins = all;
+        }
+    }
+    b->bins = bins;
+
+    return 0;
+}
+
+
+/* Free the memory used by the bins */
+void bins_destroy(bins_td *b)
+{
+    free(b->bins);
+    b->bins = NULL;
+    b->n_bins = b->n = 0;
+}
+
+
+/* Get the moment sums of the whole binned dataset */
+void bins_moments(const bins_td *b, int weighted, moments_td *m)
+{
+    double y0 = (b->n_bins > 0) ? b->bins[0].plain.y0 : 0.0;
+
+    moments_init(m, b->lo + 0.5 * (double) b->n_bins * b->width, y0,
+            weighted);
+    for (size_t k = 0; k < b->n_bins; ++k) {
+        moments_td bin = (weighted) ? b->bins[k].weighted
+            : b->bins[k].plain;
+
+        moments_shift(&bin, m->x0, m->y0);
+        moments_merge(m, &bin);
+    }
+}
+
+
+/**
+ * @brief Add the propagation term of a bin to the running bounds
+ *
+ * The term is Sum |c*(x - pivot)| * e over the points of the bin.  It
+ * is exact if the bin lies on one side of the pivot; otherwise it lies
+ * between the absolute value of the signed sum and the largest
+ * distance to the pivot times Sum e.
+ *
+ * @param bin   Bin whose term is added
+ * @param c     Factor of the term
+ * @param pivot Value of @e x where the term changes sign
+ * @param e     Sum of the errors of the points of the bin
+ * @param xe    Sum of @e x times the errors of the points of the bin
+ * @param lo    Where the lower bound is accumulated
+ * @param hi    Where the upper bound is accumulated
+ */
+static void s_bins_term(const bin_td *bin, double c, double pivot,
+        double e, double xe, double *lo, double *hi)
+{
+    double exact = fabs(c * (xe - pivot * e));
+
+    *lo += exact;
+    if (bin->x_min >= pivot || bin->x_max <= pivot) {
+        *hi += exact;
+    } else {
+        double d = fmax(pivot - bin->x_min, bin->x_max - pivot);
+        *hi += fabs(c) * d * e;
+    }
+}
+
+
+/* Fit the binned dataset */
+regression_td bins_fit(const bins_td *b, bins_bounds_td *bounds)
+{
+    moments_td m;
+    regression_td reg;
+    bins_bounds_td bd = {0.0, 0.0, 0.0, 0.0};
+
+    bins_moments(b, b->weighted, &m);
+    reg = regres_from_moments(&m);
+
+    /* Raw sums, as used by the propagation formulas */
+    moments_td raw = m;
+    moments_shift(&raw, 0.0, m.y0);
+    double S = raw.s, Sx = raw.sx, Sxx = raw.sxx;
+    double den = S * Sxx - Sx * Sx;
+
+    /* Unweighted fits use sqrt(s2) as the error of every point */
+    double sigma = 0.0;
+    if (!b->weighted && m.n > 2) {
+        double dyy = m.syy - m.sy * m.sy / m.s;
+        double dxy = m.sxy - m.sx * m.sy / m.s;
+        double chisq = dyy - reg.b * dxy;
+        sigma = (chisq > 0.0) ? sqrt(chisq / (double) (m.n - 2)) : 0.0;
+    }
+
+    if (m.n >= 2 && den > 0.0 && S > 0.0) {
+        for (size_t k = 0; k < b->n_bins; ++k) {
+            const bin_td *bin = &b->bins[k];
+            double center = bin->plain.x0;
+            double e, xe;
+
+            if (bin->plain.n == 0) {
+                continue;
+            }
+            if (b->weighted) {
+                e = bin->sum_e;
+                xe = center * e + bin->sum_ue;
+            } else {
+                e = sigma * (double) bin->plain.n;
+                xe = sigma * (center * (double) bin->plain.n
+                        + bin->plain.sx);
+            }
+
+            /* |S*x - Sx| = S*|x - Sx/S| */
+            s_bins_term(bin, S / den, Sx / S, e, xe, &bd.ea_lo, &bd.ea_hi);
+
+            /* |Sxx - x*Sx| = |Sx|*|x - Sxx/Sx|, constant if Sx = 0 */
+            if (Sx != 0.0) {
+                s_bins_term(bin, Sx / den, Sxx / Sx, e, xe,
+                        &bd.eb_lo, &bd.eb_hi);
+            } else {
+                bd.eb_lo += fabs(Sxx / den) * e;
+                bd.eb_hi += fabs(Sxx / den) * e;
+            }
+        }
+    }
+
+    reg.ea = 0.5 * (bd.ea_lo + bd.ea_hi);
+    reg.eb = 0.5 * (bd.eb_lo + bd.eb_hi);
+    if (bounds != NULL) {
+        *bounds = bd;
+    }
+
+    return reg;
+}
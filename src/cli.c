@@ -0,0 +1,496 @@
+/**
+ * @file cli.c
+ *
+ * @brief Implementation of the command-line mode, for scripted batch fits
+ */
+
+#define _POSIX_C_SOURCE 200809L /* getopt */
+
+
+/* System includes */
+#include <limits.h>     /* INT_MAX */
+#include <math.h>       /* isfinite, NAN */
+#include <stdio.h>      /* fprintf, fputc, fputs, printf, stdin, ... */
+#include <stdlib.h>     /* strtol */
+#include <string.h>     /* strcmp, strlen, strpbrk, strspn */
+#include <unistd.h>     /* getopt, optarg, optind */
+
+/* Project includes */
+#include <dataset.h>
+#include <fileio.h>
+#include <global.h>
+#include <regres.h>
+#include <stats.h>
+#include <summary.h>
+
+/* Local includes */
+#include <cli.h>
+
+
+#define S_BLOCK (256)   /**< Points read at once from a dataset */
+
+
+/**
+ * @brief Commands of the command-line mode
+ */
+typedef enum {
+    S_CMD_FIT,      /**< Linear regression */
+    S_CMD_STATS     /**< Statistics */
+} s_cmd_e;
+
+
+/**
+ * @brief Write the usage of the command-line mode
+ *
+ * @param fp Stream to write it to
+ */
+static void s_usage(FILE *fp)
+{
+    fprintf(fp,
+            "Usage: %s                    start the TUI\n"
+            "       %s fit [OPTIONS] [FILE...]\n"
+            "       %s stats [OPTIONS] [FILE...]\n"
+            "\n"
+            "Fit, or summarize, every FILE (the standard input if none,"
+            " or '%s').\n"
+            "\n"
+            "Options:\n"
+            "  -f FORMAT   json (an object per line, default) or csv\n"
+            "  -d DELIM    character between columns ('tab' for a"
+            " tabulator)\n"
+            "  -x COL      column of x, by number (from 1) or by name"
+            " in the header\n"
+            "  -y COL      column of y, likewise\n"
+            "  -e COL      column of ey, likewise\n"
+            "  -i          index every FILE, and fit it from its index"
+            " (no ea, eb)\n"
+            "  -h          show this help and exit\n"
+            "  -v          show the version and exit\n",
+            REGRES_EXEC_NAME, REGRES_EXEC_NAME, REGRES_EXEC_NAME,
+            CLI_STDIN);
+}
+
+
+/**
+ * @brief Get the reason a file cannot be loaded
+ *
+ * @param err Error returned by @a fileio_load_opts()
+ *
+ * @return Description of the error
+ */
+static const char *s_load_error(int err)
+{
+    switch (err) {
+        case 2:
+            return "insufficient memory";
+        case 3:
+            return "corrupted or truncated file";
+        case 4:
+            return "column name not in the header";
+        case 5:
+            return "compression not supported by this build";
+        case 6:
+            return "journal written for other contents of the file";
+        default:
+            return "cannot be read";
+    }
+}
+
+
+/**
+ * @brief Set the column of a value, given by number or by name
+ *
+ * @param opts Pointer to the load options
+ * @param k    Value the column is read for (@e fileio_col_e)
+ * @param col  Number of the column (from 1), or its name in the header
+ *
+ * @return 0 on success, or 1 if the number is not valid
+ */
+static int s_set_column(fileio_opts_td *opts, int k, const char *col)
+{
+    if (col[0] != '\0' && col[strspn(col, "0123456789")] == '\0') {
+        long c = strtol(col, NULL, 10);
+
+        if (c < 1 || c > INT_MAX) {
+            return 1;
+        }
+        opts->cols[k] = (int) c - 1;
+        opts->names[k] = NULL;
+    } else {
+        opts->names[k] = col;
+        opts->cols[k] = -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Tell whether every @e x of a dataset is the same
+ *
+ * @param ds Pointer to the dataset
+ *
+ * @return 1 if it is (no line can be fitted), or 0 otherwise
+ */
+static int s_same_x(const dataset_td *ds)
+{
+    data_point_td buf[S_BLOCK];
+    double x0 = 0.0;
+
+    for (size_t i = 0; i < ds->size; i += S_BLOCK) {
+        size_t len = (ds->size - i < S_BLOCK) ? ds->size - i
+            : S_BLOCK;
+        const data_point_td *p = dataset_block(ds, i, len, buf);
+
+        if (i == 0) {
+            x0 = p[0].x;
+        }
+        for (size_t j = 0; j < len; ++j) {
+            if (p[j].x != x0) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * @brief Get the reason the points of a file cannot be fitted
+ *
+ * @param n      Number of points of the file
+ * @param same_x Non-zero if every @e x of the file is the same
+ * @param reg    Pointer to the regression of the points, or @c NULL if
+ *               only the points are checked
+ *
+ * @return Description of the problem, or @c NULL if there is none
+ */
+static const char *s_fit_error(size_t n, int same_x,
+        const regression_td *reg)
+{
+    if (n < 2) {
+        return "fewer than two points (are the columns right?)";
+    }
+    if (reg != NULL && (same_x || !isfinite(reg->a) ||
+                !isfinite(reg->b))) {
+        return "degenerate fit (every x is the same)";
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Write a string, quoted as the format asks
+ *
+ * @param s      String to write
+ * @param format Format of the results (@e cli_format_e)
+ */
+static void s_put_str(const char *s, int format)
+{
+    if (format == CLI_CSV && strpbrk(s, ",\"\r\n") == NULL) {
+        fputs(s, stdout);
+        return;
+    }
+
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *) s; *p; ++p) {
+        if (*p == '"') {
+            fputs((format == CLI_CSV) ? "\"\"" : "\\\"", stdout);
+        } else if (format == CLI_CSV) {
+            putchar(*p);
+        } else if (*p == '\\') {
+            fputs("\\\\", stdout);
+        } else if (*p < 0x20) {
+            printf("\\u%04x", *p);
+        } else {
+            putchar(*p);
+        }
+    }
+    putchar('"');
+}
+
+
+/**
+ * @brief Write a field of the results
+ *
+ * Values are written with the fewest digits that read back exactly
+ * (see @a fileio_format()); values that are not finite, which JSON has
+ * no numbers for, are written as @e null in JSON, and left empty in
+ * CSV.
+ *
+ * @param name   Name of the field
+ * @param v      Value of the field
+ * @param format Format of the results (@e cli_format_e)
+ */
+static void s_put_num(const char *name, double v, int format)
+{
+    char buf[FILEIO_NUM_MAX];
+
+    if (format == CLI_JSON) {
+        printf(",\"%s\":", name);
+    } else {
+        putchar(',');
+    }
+    if (isfinite(v)) {
+        fileio_format(v, buf);
+        fputs(buf, stdout);
+    } else if (format == CLI_JSON) {
+        fputs("null", stdout);
+    }
+}
+
+
+/**
+ * @brief Write the header of the results, if the format has one
+ *
+ * @param cmd    Command run (@e s_cmd_e)
+ * @param format Format of the results (@e cli_format_e)
+ */
+static void s_put_header(int cmd, int format)
+{
+    if (format != CLI_CSV) {
+        return;
+    }
+    if (cmd == S_CMD_FIT) {
+        puts("file,n,a,b,sa,sb,ea,eb,r");
+    } else {
+        puts("file,n,x_mean,y_mean,sum_x,sum_y,sum_x2,sum_y2,sum_xy,"
+                "ssx,ssy,snx,sny,snxn1,snyn1");
+    }
+}
+
+
+/**
+ * @brief Write the results of a file
+ *
+ * @param format   Format of the results (@e cli_format_e)
+ * @param filename Name of the file
+ * @param n        Number of points of the file
+ * @param reg      Pointer to the regression of the points, or @c NULL
+ *                 to write @p stats
+ * @param stats    Pointer to the statistics of the points
+ */
+static void s_put_results(int format, const char *filename, size_t n,
+        const regression_td *reg, const stats_td *stats)
+{
+    if (format == CLI_JSON) {
+        fputs("{\"file\":", stdout);
+    }
+    s_put_str(filename, format);
+    printf((format == CLI_JSON) ? ",\"n\":%zu" : ",%zu", n);
+
+    if (reg != NULL) {
+        s_put_num("a", reg->a, format);
+        s_put_num("b", reg->b, format);
+        s_put_num("sa", reg->sa, format);
+        s_put_num("sb", reg->sb, format);
+        s_put_num("ea", reg->ea, format);
+        s_put_num("eb", reg->eb, format);
+        s_put_num("r", reg->r, format);
+    } else {
+        s_put_num("x_mean", stats->x_mean, format);
+        s_put_num("y_mean", stats->y_mean, format);
+        s_put_num("sum_x", stats->sum_x, format);
+        s_put_num("sum_y", stats->sum_y, format);
+        s_put_num("sum_x2", stats->sum_x2, format);
+        s_put_num("sum_y2", stats->sum_y2, format);
+        s_put_num("sum_xy", stats->sum_xy, format);
+        s_put_num("ssx", stats->ssx, format);
+        s_put_num("ssy", stats->ssy, format);
+        s_put_num("snx", stats->snx, format);
+        s_put_num("sny", stats->sny, format);
+        s_put_num("snxn1", stats->snxn1, format);
+        s_put_num("snyn1", stats->snyn1, format);
+    }
+
+    puts((format == CLI_JSON) ? "}" : "");
+}
+
+
+/**
+ * @brief Read a file and write its results
+ *
+ * Files indexed (if @e opts->summary is set) are fitted from the
+ * summaries of their blocks (see @a fileio_summary()), which do not
+ * give the propagated errors @e ea and @e eb: they are written as not
+ * finite.
+ *
+ * @param cmd      Command run (@e s_cmd_e)
+ * @param format   Format of the results (@e cli_format_e)
+ * @param filename Name of the file, or @c CLI_STDIN
+ * @param opts     Pointer to the load options
+ *
+ * @return 0 on success, or 1 if the file cannot be read, has fewer than
+ *         two points, or (for a fit) all of them share the same @e x:
+ *         nothing is written then, but the reason, to the standard
+ *         error
+ */
+static int s_run_file(int cmd, int format, const char *filename,
+        const fileio_opts_td *opts)
+{
+    dataset_td ds;
+    summary_td sm;
+    int err;
+
+    const char *why = NULL;
+
+    if (cmd == S_CMD_FIT && opts->summary &&
+            strcmp(filename, CLI_STDIN) != 0) {
+        if ((err = fileio_summary(filename, opts, &sm)) != 0) {
+            why = s_load_error(err);
+        } else {
+            regression_td reg = summary_fit(&sm, 0, sm.n_blocks);
+            int same_x = 1;
+
+            for (size_t k = 0; k < sm.n_blocks; ++k) {
+                same_x &= (sm.blocks[k].x_min == sm.blocks[0].x_min &&
+                        sm.blocks[k].x_max == sm.blocks[0].x_min);
+            }
+            if ((why = s_fit_error(sm.n, same_x, &reg)) == NULL) {
+                reg.ea = reg.eb = NAN;
+                s_put_results(format, filename, sm.n, &reg, NULL);
+            }
+            summary_destroy(&sm);
+        }
+        if (why != NULL) {
+            fprintf(stderr, "%s: %s: %s\n", REGRES_EXEC_NAME, filename,
+                    why);
+        }
+
+        return (why != NULL);
+    }
+
+    dataset_init(&ds);
+    if (strcmp(filename, CLI_STDIN) == 0) {
+        err = fileio_load_stream(stdin, &ds, opts);
+    } else {
+        err = fileio_load_opts(filename, &ds, opts);
+    }
+
+    if (err != 0) {
+        why = s_load_error(err);
+    } else if (cmd == S_CMD_FIT) {
+        regression_td reg = regres_linear(&ds);
+
+        if ((why = s_fit_error(ds.size, s_same_x(&ds), &reg)) == NULL) {
+            s_put_results(format, filename, ds.size, &reg, NULL);
+        }
+    } else if ((why = s_fit_error(ds.size, 0, NULL)) == NULL) {
+        stats_td stats = stats_compute(&ds);
+
+        s_put_results(format, filename, ds.size, NULL, &stats);
+    }
+    dataset_destroy(&ds);
+    if (why != NULL) {
+        fprintf(stderr, "%s: %s: %s\n", REGRES_EXEC_NAME, filename, why);
+    }
+
+    return (why != NULL);
+}
+
+
+/* Run a command given on the command line, without the TUI */
+int cli_run(int argc, char *argv[])
+{
+    fileio_opts_td opts;
+    int format = CLI_JSON;
+    int cmd;
+    int c;
+
+    if (argc < 2) {
+        s_usage(stderr);
+        return 2;
+    }
+    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        s_usage(stdout);
+        return 0;
+    }
+    if (strcmp(argv[1], "-v") == 0 || strcmp(argv[1], "--version") == 0) {
+        printf("%s %s\n", REGRES_PROG_NAME, REGRES_PROG_VERSION);
+        return 0;
+    }
+    if (strcmp(argv[1], "fit") == 0) {
+        cmd = S_CMD_FIT;
+    } else if (strcmp(argv[1], "stats") == 0) {
+        cmd = S_CMD_STATS;
+    } else {
+        fprintf(stderr, "%s: unknown command '%s'\n", REGRES_EXEC_NAME,
+                argv[1]);
+        s_usage(stderr);
+        return 2;
+    }
+
+    /* Options follow the command, which takes the place of the name of
+     * the program for getopt */
+    fileio_opts_init(&opts);
+    while ((c = getopt(argc - 1, argv + 1, "f:d:x:y:e:ihv")) != -1) {
+        switch (c) {
+            case 'f':
+                if (strcmp(optarg, "json") == 0) {
+                    format = CLI_JSON;
+                } else if (strcmp(optarg, "csv") == 0) {
+                    format = CLI_CSV;
+                } else {
+                    fprintf(stderr, "%s: unknown format '%s'\n",
+                            REGRES_EXEC_NAME, optarg);
+                    return 2;
+                }
+                break;
+
+            case 'd':
+                if (strcmp(optarg, "tab") == 0) {
+                    opts.delim = '\t';
+                } else if (strlen(optarg) == 1) {
+                    opts.delim = optarg[0];
+                } else {
+                    fprintf(stderr, "%s: the delimiter must be a single"
+                            " character\n", REGRES_EXEC_NAME);
+                    return 2;
+                }
+                break;
+
+            case 'x':
+            case 'y':
+            case 'e':
+                if (s_set_column(&opts, (c == 'x') ? FILEIO_COL_X
+                            : (c == 'y') ? FILEIO_COL_Y : FILEIO_COL_EY,
+                            optarg) != 0) {
+                    fprintf(stderr, "%s: invalid column '%s'\n",
+                            REGRES_EXEC_NAME, optarg);
+                    return 2;
+                }
+                break;
+
+            case 'i':
+                opts.summary = 1;
+                break;
+
+            case 'h':
+                s_usage(stdout);
+                return 0;
+
+            case 'v':
+                printf("%s %s\n", REGRES_PROG_NAME, REGRES_PROG_VERSION);
+                return 0;
+
+            default:
+                s_usage(stderr);
+                return 2;
+        }
+    }
+
+    int first = optind + 1;
+    int failed = 0;
+
+    s_put_header(cmd, format);
+    if (first >= argc) {
+        failed |= s_run_file(cmd, format, CLI_STDIN, &opts);
+    }
+    for (int i = first; i < argc; ++i) {
+        failed |= s_run_file(cmd, format, argv[i], &opts);
+    }
+
+    return failed;
+}
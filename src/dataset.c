@@ -4,95 +4,559 @@
  * @brief Implementation of dataset management functions
  */
 
+#define _POSIX_C_SOURCE 200809L /* close */
+
+
 /* System includes */
-#include <math.h>       /* log, exp */
-#include <stdlib.h>     /* free, malloc */
+#include <float.h>      /* FLT_MAX */
+#include <math.h>       /* NAN, exp, fabs, log */
+#include <stdio.h>      /* snprintf */
+#include <stdlib.h>     /* free, malloc, realloc */
+#include <string.h>     /* memcpy, memmove, strcmp, strlen */
+#include <unistd.h>     /* close */
+
+/* Project includes */
+#include <arena.h>
 
 /* Local includes */
 #include <dataset.h>
 
 
+/**
+ * @brief Tell whether a value is exact in single precision
+ *
+ * @param v Value to check
+ *
+ * @return Non-zero if @p v survives a round trip through @e float
+ */
+static int s_fits_single(double v)
+{
+    /* Values out of range are not converted, as that is undefined */
+    return v != v || (fabs(v) <= FLT_MAX && (double) (float) v == v);
+}
+
+
+/**
+ * @brief Get the narrowest mode, within a mode, that holds a point
+ *
+ * @param mode Storage mode (@e dataset_mode_e flags)
+ * @param p    Point to hold exactly
+ *
+ * @return @p mode, without the flags that cannot hold @p p
+ */
+static int s_mode_for(int mode, const data_point_td *p)
+{
+    if ((mode & DATASET_NO_EY) && p->ey != 0.0) {
+        mode &= ~DATASET_NO_EY;
+    }
+    if ((mode & DATASET_SINGLE) && !(s_fits_single(p->x) &&
+                s_fits_single(p->y) && s_fits_single(p->ey))) {
+        mode &= ~DATASET_SINGLE;
+    }
+
+    return mode;
+}
+
+
+/**
+ * @brief Read a point stored in a given mode
+ *
+ * @param points Storage of the points
+ * @param mode   Storage mode (@e dataset_mode_e flags)
+ * @param i      Index of the point
+ *
+ * @return Values of the point, in double
+ */
+static data_point_td s_read(const void *points, int mode, size_t i)
+{
+    size_t k = (mode & DATASET_NO_EY) ? 2 : 3;
+    data_point_td p;
+
+    if (mode == DATASET_FULL) {
+        return ((const data_point_td *) points)[i];
+    }
+    if (mode & DATASET_SINGLE) {
+        const float *f = (const float *) points + k * i;
+        p.x = f[0];
+        p.y = f[1];
+        p.ey = (k == 3) ? f[2] : 0.0;
+    } else {
+        const double *d = (const double *) points + k * i;
+        p.x = d[0];
+        p.y = d[1];
+        p.ey = 0.0;
+    }
+
+    return p;
+}
+
+
+/**
+ * @brief Write a point stored in a given mode
+ *
+ * @param points Storage of the points
+ * @param mode   Storage mode (@e dataset_mode_e flags)
+ * @param i      Index of the point
+ * @param p      Values of the point, rounded or dropped if @p mode
+ *               cannot hold them
+ */
+static void s_write(void *points, int mode, size_t i,
+        const data_point_td *p)
+{
+    size_t k = (mode & DATASET_NO_EY) ? 2 : 3;
+
+    if (mode == DATASET_FULL) {
+        ((data_point_td *) points)[i] = *p;
+        return;
+    }
+    if (mode & DATASET_SINGLE) {
+        float *f = (float *) points + k * i;
+        f[0] = (float) p->x;
+        f[1] = (float) p->y;
+        if (k == 3) {
+            f[2] = (float) p->ey;
+        }
+    } else {
+        double *d = (double *) points + k * i;
+        d[0] = p->x;
+        d[1] = p->y;
+    }
+}
+
+
+/**
+ * @brief Convert the points of a dataset to another storage mode
+ *
+ * Points are converted in place: from the last one when they get
+ * wider, and from the first one otherwise, so that no point is
+ * overwritten before it is read.
+ *
+ * @param ds   Pointer to the dataset structure
+ * @param mode New storage mode (@e dataset_mode_e flags)
+ *
+ * @return 0 on success, or 2 on memory allocation failure
+ */
+static int s_convert(dataset_td *ds, int mode)
+{
+    size_t from = dataset_point_size(ds->mode);
+    size_t to = dataset_point_size(mode);
+
+    if (ds->points != NULL && to > from) {
+        void *points = arena_realloc(ds->points, ds->capacity * to);
+        if (points == NULL) {
+            return 2;
+        }
+        ds->points = points;
+        for (size_t i = ds->size; i-- > 0; ) {
+            data_point_td p = s_read(ds->points, ds->mode, i);
+            s_write(ds->points, mode, i, &p);
+        }
+    } else {
+        for (size_t i = 0; i < ds->size; ++i) {
+            data_point_td p = s_read(ds->points, ds->mode, i);
+            s_write(ds->points, mode, i, &p);
+        }
+    }
+    ds->mode = mode;
+
+    return 0;
+}
+
+
+/**
+ * @brief Grow the buffers of a dataset to a new capacity
+ *
+ * Buffers already grown are kept if a later one fails: they are only
+ * larger than needed, and the capacity is left as it was.
+ *
+ * @param ds       Pointer to the dataset structure
+ * @param capacity New capacity, in points
+ *
+ * @return 0 on success, or 2 on memory allocation failure
+ */
+static int s_grow(dataset_td *ds, size_t capacity)
+{
+    size_t bytes = capacity * dataset_point_size(ds->mode);
+    void *points = (ds->points == NULL && ds->fd >= 0)
+        ? arena_alloc_file(bytes, ds->fd)
+        : arena_realloc(ds->points, bytes);
+    if (points == NULL) {
+        return 2;
+    }
+    ds->points = points;
+
+    if (ds->keys != NULL) {
+        long *keys = arena_realloc(ds->keys, capacity * sizeof(*keys));
+        if (keys == NULL) {
+            return 2;
+        }
+        ds->keys = keys;
+    }
+
+    for (size_t c = 0; c < ds->n_cols; ++c) {
+        double *col = arena_realloc(ds->cols[c], capacity * sizeof(*col));
+        if (col == NULL) {
+            return 2;
+        }
+        ds->cols[c] = col;
+    }
+
+    ds->capacity = capacity;
+    return 0;
+}
+
+
 /* Initialize a dataset structure */
 void dataset_init(dataset_td *ds)
 {
     ds->size = 0;
-    ds->capacity = 20;
-    ds->points = malloc(ds->capacity * sizeof(data_point_td));
+    ds->capacity = 0;
+    ds->fd = -1;
+    ds->points = NULL;
+    ds->mode = DATASET_FULL;
+    ds->keys = NULL;
+    ds->key_names = NULL;
+    ds->n_key_names = 0;
+    ds->cols = NULL;
+    ds->col_names = NULL;
+    ds->n_cols = 0;
     ds->is_modified = 0;
+    ds->n_saved = 0;
+    ds->saved_id = 0;
+}
+
+
+/* Initialize a dataset structure whose points live in a file */
+int dataset_init_mapped(dataset_td *ds, const char *dir)
+{
+    dataset_init(ds);
+    ds->fd = arena_scratch(dir);
+
+    return (ds->fd < 0);
 }
 
 
 /* Destroy a dataset structure */
 void dataset_destroy(dataset_td *ds)
 {
-    free(ds->points);
+    arena_free(ds->points);
+    if (ds->fd >= 0) {
+        close(ds->fd);
+    }
+    arena_free(ds->keys);
+    for (size_t i = 0; i < ds->n_key_names; ++i) {
+        free(ds->key_names[i]);
+    }
+    free(ds->key_names);
+    for (size_t i = 0; i < ds->n_cols; ++i) {
+        arena_free(ds->cols[i]);
+        free(ds->col_names[i]);
+    }
+    free(ds->cols);
+    free(ds->col_names);
+}
+
+
+/* Make room for a number of points in the dataset */
+int dataset_reserve(dataset_td *ds, size_t n)
+{
+    if (n <= ds->capacity) {
+        return 0;
+    }
+
+    return s_grow(ds, n);
+}
+
+
+/* Change the storage mode of the points of a dataset */
+int dataset_set_mode(dataset_td *ds, int mode)
+{
+    if (mode == ds->mode) {
+        return 0;
+    }
+
+    /* Narrower storage may change the values already saved */
+    if ((mode & ~ds->mode) != 0 && ds->size > 0) {
+        ds->saved_id = 0;
+    }
+
+    return s_convert(ds, mode);
+}
+
+
+/* Read a block of points of the dataset */
+const data_point_td *dataset_block(const dataset_td *ds, size_t begin,
+        size_t len, data_point_td *buf)
+{
+    /* One loop per mode, so that each of them vectorizes */
+    if (ds->mode == DATASET_FULL) {
+        return (const data_point_td *) ds->points + begin;
+    } else if (ds->mode == DATASET_NO_EY) {
+        const double *d = (const double *) ds->points + 2 * begin;
+        for (size_t j = 0; j < len; ++j) {
+            buf[j].x = d[2 * j];
+            buf[j].y = d[2 * j + 1];
+            buf[j].ey = 0.0;
+        }
+    } else if (ds->mode == DATASET_SINGLE) {
+        const float *f = (const float *) ds->points + 3 * begin;
+        for (size_t j = 0; j < len; ++j) {
+            buf[j].x = f[3 * j];
+            buf[j].y = f[3 * j + 1];
+            buf[j].ey = f[3 * j + 2];
+        }
+    } else {
+        const float *f = (const float *) ds->points + 2 * begin;
+        for (size_t j = 0; j < len; ++j) {
+            buf[j].x = f[2 * j];
+            buf[j].y = f[2 * j + 1];
+            buf[j].ey = 0.0;
+        }
+    }
+
+    return buf;
+}
+
+
+/* Write a block of points of the dataset */
+int dataset_store(dataset_td *ds, size_t begin, size_t len,
+        const data_point_td *p)
+{
+    int mode = ds->mode;
+
+    for (size_t j = 0; j < len && mode != DATASET_FULL; ++j) {
+        mode = s_mode_for(mode, &p[j]);
+    }
+    if (mode != ds->mode && s_convert(ds, mode) != 0) {
+        return 2;
+    }
+
+    if (ds->mode == DATASET_FULL) {
+        /* The block may have been read in place */
+        data_point_td *q = (data_point_td *) ds->points + begin;
+        if (q != p) {
+            memmove(q, p, len * sizeof(*q));
+        }
+    } else {
+        for (size_t j = 0; j < len; ++j) {
+            s_write(ds->points, ds->mode, begin + j, &p[j]);
+        }
+    }
+    ds->is_modified = 1;
+    if (begin < ds->n_saved) {
+        ds->saved_id = 0;
+    }
+
+    return 0;
+}
+
+
+/* Get a point of the dataset */
+data_point_td dataset_get(const dataset_td *ds, size_t i)
+{
+    return s_read(ds->points, ds->mode, i);
 }
 
 
 /* Add a new data point to the dataset */
-void dataset_add(dataset_td *ds, double x, double y, double ey)
+int dataset_add(dataset_td *ds, double x, double y, double ey)
 {
+    data_point_td p;
+
+    p.x = x;
+    p.y = y;
+    p.ey = ey;
+
     if (ds->size == ds->capacity) {
-        ds->capacity *= 2;
-        ds->points =
-            realloc(ds->points, ds->capacity * sizeof(data_point_td));
+        size_t capacity = (ds->capacity) ? 2 * ds->capacity
+            : DATASET_MIN_CAPACITY;
+        if (s_grow(ds, capacity) != 0) {
+            return 2;
+        }
+    }
+    int mode = s_mode_for(ds->mode, &p);
+    if (mode != ds->mode && s_convert(ds, mode) != 0) {
+        return 2;
     }
 
-    ds->points[ds->size].x = x;
-    ds->points[ds->size].y = y;
-    ds->points[ds->size].ey = ey;
+    s_write(ds->points, ds->mode, ds->size, &p);
+    if (ds->keys != NULL) {
+        ds->keys[ds->size] = 0;
+    }
+    for (size_t c = 0; c < ds->n_cols; ++c) {
+        ds->cols[c][ds->size] = NAN;
+    }
     ds->size++;
     ds->is_modified = 1;
+
+    return 0;
+}
+
+
+/* Add a new data point with a group key to the dataset */
+int dataset_add_keyed(dataset_td *ds, double x, double y, double ey,
+        long key)
+{
+    if (ds->keys == NULL) {
+        size_t capacity = (ds->capacity) ? ds->capacity
+            : DATASET_MIN_CAPACITY;
+        long *keys = arena_alloc(capacity * sizeof(*keys));
+
+        if (keys == NULL || dataset_reserve(ds, capacity) != 0) {
+            arena_free(keys);
+            return 2;
+        }
+        for (size_t i = 0; i < ds->capacity; ++i) {
+            keys[i] = 0;
+        }
+        ds->keys = keys;
+
+        /* The points saved so far have no key column */
+        if (ds->size > 0) {
+            ds->saved_id = 0;
+        }
+    }
+
+    if (dataset_add(ds, x, y, ey) != 0) {
+        return 2;
+    }
+    ds->keys[ds->size - 1] = key;
+
+    return 0;
+}
+
+
+/* Get a printable label for a group key */
+const char *dataset_key_label(const dataset_td *ds, long key,
+        char *buf, size_t len)
+{
+    if (ds->key_names != NULL && key >= 0 &&
+            (size_t) key < ds->n_key_names) {
+        return ds->key_names[key];
+    }
+
+    snprintf(buf, len, "%ld", key);
+    return buf;
+}
+
+
+/* Add a named derived column to the dataset */
+int dataset_add_col(dataset_td *ds, const char *name)
+{
+    size_t len = strlen(name) + 1;
+    double *col = arena_alloc(ds->capacity * sizeof(*col));
+    char *col_name = malloc(len);
+    double **cols = realloc(ds->cols, (ds->n_cols + 1) * sizeof(*cols));
+
+    if (cols != NULL) {
+        ds->cols = cols;
+    }
+    char **names = realloc(ds->col_names,
+            (ds->n_cols + 1) * sizeof(*names));
+    if (names != NULL) {
+        ds->col_names = names;
+    }
+    if (col == NULL || col_name == NULL || cols == NULL || names == NULL) {
+        arena_free(col);
+        free(col_name);
+        return -1;
+    }
+
+    for (size_t i = 0; i < ds->size; ++i) {
+        col[i] = NAN;
+    }
+    memcpy(col_name, name, len);
+    ds->cols[ds->n_cols] = col;
+    ds->col_names[ds->n_cols] = col_name;
+
+    return (int) ds->n_cols++;
+}
+
+
+/* Find a derived column by name */
+int dataset_find_col(const dataset_td *ds, const char *name)
+{
+    for (size_t i = 0; i < ds->n_cols; ++i) {
+        if (strcmp(ds->col_names[i], name) == 0) {
+            return (int) i;
+        }
+    }
+
+    return -1;
 }
 
 
 /* Apply the logarithm transformation to a specified column */
-void dataset_log_col(dataset_td *ds, int col)
+int dataset_log_col(dataset_td *ds, int col)
 {
     for (size_t i = 0; i < ds->size; ++i) {
+        data_point_td p = dataset_get(ds, i);
         if (col == 0) {
-            ds->points[i].x = log(ds->points[i].x);
+            p.x = log(p.x);
         } else if (col == 1) {
-            ds->points[i].y = log(ds->points[i].y);
+            p.y = log(p.y);
+        }
+        if (dataset_store(ds, i, 1, &p) != 0) {
+            return 2;
         }
     }
+
+    return 0;
 }
 
 
 /* Apply the antilogarithm transformation to a specified column */
-void dataset_antilog_col(dataset_td *ds, int col)
+int dataset_antilog_col(dataset_td *ds, int col)
 {
     for (size_t i = 0; i < ds->size; ++i) {
+        data_point_td p = dataset_get(ds, i);
         if (col == 0) {
-            ds->points[i].x = exp(ds->points[i].x);
+            p.x = exp(p.x);
         } else if (col == 1) {
-            ds->points[i].y = exp(ds->points[i].y);
+            p.y = exp(p.y);
+        }
+        if (dataset_store(ds, i, 1, &p) != 0) {
+            return 2;
         }
     }
+
+    return 0;
 }
 
 
 /* Invert the values in a specified column */
-void dataset_inv_col(dataset_td *ds, int col)
+int dataset_inv_col(dataset_td *ds, int col)
 {
     for (size_t i = 0; i < ds->size; ++i) {
-        if (col == 0 && ds->points[i].x != 0) {
-            ds->points[i].x = 1.0 / ds->points[i].x;
-        } else if (col == 1 && ds->points[i].y != 0) {
-            ds->points[i].y = 1.0 / ds->points[i].y;
+        data_point_td p = dataset_get(ds, i);
+        if (col == 0 && p.x != 0) {
+            p.x = 1.0 / p.x;
+        } else if (col == 1 && p.y != 0) {
+            p.y = 1.0 / p.y;
+        }
+        if (dataset_store(ds, i, 1, &p) != 0) {
+            return 2;
         }
     }
+
+    return 0;
 }
 
 
 /* Multiply the values in a specified column by a factor */
-void dataset_mult_col(dataset_td *ds, int col, double factor)
+int dataset_mult_col(dataset_td *ds, int col, double factor)
 {
     for (size_t i = 0; i < ds->size; ++i) {
+        data_point_td p = dataset_get(ds, i);
         if (col == 0) {
-            ds->points[i].x *= factor;
+            p.x *= factor;
         } else if (col == 1) {
-            ds->points[i].y *= factor;
+            p.y *= factor;
+        }
+        if (dataset_store(ds, i, 1, &p) != 0) {
+            return 2;
         }
     }
+
+    return 0;
 }
@@ -0,0 +1,792 @@
+/**
+ * @file expr.c
+ *
+ * @brief Implementation of the column expression engine
+ */
+
+/* System includes */
+#include <ctype.h>      /* isalnum, isalpha, isdigit, isspace */
+#include <math.h>       /* atan, cos, exp, fabs, log, log10, pow, sin,
+                           sqrt, tan */
+#include <stdio.h>      /* snprintf */
+#include <stdlib.h>     /* free, malloc, strtod */
+#include <string.h>     /* memcpy, strcmp, strcpy */
+
+/* Project includes */
+#include <dataset.h>
+#include <transform.h>
+
+/* Local includes */
+#include <expr.h>
+
+
+/* Kinds of operand while compiling */
+#define S_CONST     (0)     /**< Known value, no register yet */
+#define S_COL       (1)     /**< Column register */
+#define S_CREG      (2)     /**< Constant register */
+#define S_TEMP      (3)     /**< Temporary register */
+
+/* Sources of the columns, when running */
+#define S_SRC_X     (-1)    /**< Column @e x of the points */
+#define S_SRC_Y     (-2)    /**< Column @e y of the points */
+#define S_SRC_EY    (-3)    /**< Column @e ey of the points */
+
+
+/**
+ * @brief Operand of an instruction while compiling
+ */
+typedef struct {
+    int kind;       /**< Kind of operand (@c S_CONST, ...) */
+    int idx;        /**< Index of the register among those of its kind */
+    double value;   /**< Value, if @c S_CONST */
+} s_operand_td;
+
+
+/**
+ * @brief State of the parser
+ */
+typedef struct {
+    const char *src;        /**< Source text */
+    const char *p;          /**< Current position */
+    expr_td *e;             /**< Expression being compiled */
+    const dataset_td *ds;   /**< Dataset (to check names) */
+    int n_temps;            /**< Temporaries in use */
+    int max_temps;          /**< Most temporaries ever in use */
+    char *err;              /**< Error message buffer */
+    size_t err_len;         /**< Size of @e err */
+    int failed;             /**< Non-zero once an error is found */
+} s_parser_td;
+
+
+/**
+ * @brief Function callable from an expression
+ */
+typedef struct {
+    const char *name;   /**< Name of the function */
+    int n_args;         /**< Number of arguments */
+    expr_op_e op;       /**< Instruction computing it */
+} s_function_td;
+
+
+static const s_function_td s_functions[] = {
+    { "abs",   1, EXPR_OP_ABS },
+    { "sqrt",  1, EXPR_OP_SQRT },
+    { "log",   1, EXPR_OP_LOG },
+    { "log10", 1, EXPR_OP_LOG10 },
+    { "exp",   1, EXPR_OP_EXP },
+    { "sin",   1, EXPR_OP_SIN },
+    { "cos",   1, EXPR_OP_COS },
+    { "tan",   1, EXPR_OP_TAN },
+    { "atan",  1, EXPR_OP_ATAN },
+    { "pow",   2, EXPR_OP_POW },
+    { "min",   2, EXPR_OP_MIN },
+    { "max",   2, EXPR_OP_MAX },
+    { NULL,    0, EXPR_OP_MOV }
+};
+
+
+static s_operand_td s_expr(s_parser_td *ps);
+
+
+/**
+ * @brief Evaluate an instruction on single values (constant folding)
+ *
+ * @param op Operation
+ * @param a  First operand
+ * @param b  Second operand
+ *
+ * @return Result of the operation
+ */
+static double s_eval(expr_op_e op, double a, double b)
+{
+    switch (op) {
+        case EXPR_OP_MOV:   return a;
+        case EXPR_OP_NEG:   return -a;
+        case EXPR_OP_ADD:   return a + b;
+        case EXPR_OP_SUB:   return a - b;
+        case EXPR_OP_MUL:   return a * b;
+        case EXPR_OP_DIV:   return a / b;
+        case EXPR_OP_POW:   return pow(a, b);
+        case EXPR_OP_MIN:   return (a < b) ? a : b;
+        case EXPR_OP_MAX:   return (a > b) ? a : b;
+        case EXPR_OP_ABS:   return fabs(a);
+        case EXPR_OP_SQRT:  return sqrt(a);
+        case EXPR_OP_LOG:   return log(a);
+        case EXPR_OP_LOG10: return log10(a);
+        case EXPR_OP_EXP:   return exp(a);
+        case EXPR_OP_SIN:   return sin(a);
+        case EXPR_OP_COS:   return cos(a);
+        case EXPR_OP_TAN:   return tan(a);
+        case EXPR_OP_ATAN:  return atan(a);
+        default:            return a;
+    }
+}
+
+
+/**
+ * @brief Record the first error found, with its position
+ *
+ * @param ps  Parser
+ * @param msg Error message
+ */
+static void s_error(s_parser_td *ps, const char *msg)
+{
+    if (!ps->failed) {
+        snprintf(ps->err, ps->err_len, "%s (at column %d)", msg,
+                (int) (ps->p - ps->src) + 1);
+        ps->failed = 1;
+    }
+}
+
+
+/**
+ * @brief Skip white space
+ *
+ * @param ps Parser
+ */
+static void s_skip(s_parser_td *ps)
+{
+    while (isspace((unsigned char) *ps->p)) {
+        ps->p++;
+    }
+}
+
+
+/**
+ * @brief Consume a character if it comes next
+ *
+ * @param ps Parser
+ * @param c  Character expected
+ *
+ * @return Non-zero if it was consumed
+ */
+static int s_accept(s_parser_td *ps, char c)
+{
+    s_skip(ps);
+    if (*ps->p == c) {
+        ps->p++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Read a name if it comes next
+ *
+ * @param ps   Parser
+ * @param name Where to store the name
+ *
+ * @return Non-zero if a name was read
+ */
+static int s_name(s_parser_td *ps, char name[EXPR_MAX_NAME])
+{
+    size_t len = 0;
+
+    s_skip(ps);
+    if (!isalpha((unsigned char) *ps->p) && *ps->p != '_') {
+        return 0;
+    }
+    while (isalnum((unsigned char) ps->p[len]) || ps->p[len] == '_') {
+        len++;
+    }
+    if (len >= EXPR_MAX_NAME) {
+        s_error(ps, "Name too long");
+        return 0;
+    }
+    memcpy(name, ps->p, len);
+    name[len] = '\0';
+    ps->p += len;
+
+    return 1;
+}
+
+
+/**
+ * @brief Get the register of a column, adding it if needed
+ *
+ * @param ps    Parser
+ * @param name  Name of the column
+ * @param write If non-zero, the column is being assigned
+ *
+ * @return Index of the column register, or -1 on error
+ */
+static int s_column(s_parser_td *ps, const char *name, int write)
+{
+    expr_td *e = ps->e;
+    int is_point = (strcmp(name, "x") == 0 || strcmp(name, "y") == 0
+            || strcmp(name, "ey") == 0);
+    size_t i;
+
+    for (i = 0; i < e->n_cols; ++i) {
+        if (strcmp(e->cols[i], name) == 0) {
+            break;
+        }
+    }
+
+    /* Reading a new name: it must exist already */
+    if (!write && !is_point && dataset_find_col(ps->ds, name) < 0
+            && (i == e->n_cols || !e->col_written[i])) {
+        s_error(ps, "Unknown column");
+        return -1;
+    }
+
+    if (i == e->n_cols) {
+        if (e->n_cols == EXPR_MAX_COLS) {
+            s_error(ps, "Too many columns");
+            return -1;
+        }
+        strcpy(e->cols[i], name);
+        e->col_written[i] = 0;
+        e->n_cols++;
+    }
+    e->col_written[i] |= write;
+
+    return (int) i;
+}
+
+
+/**
+ * @brief Encode a register for an instruction (before layout)
+ *
+ * @param kind Kind of register
+ * @param idx  Index among those of its kind
+ *
+ * @return Encoded register
+ */
+static int s_encode(int kind, int idx)
+{
+    return kind * EXPR_MAX_REGS + idx;
+}
+
+
+/**
+ * @brief Get the (encoded) register of an operand
+ *
+ * Constants are given a constant register, shared by equal values.
+ *
+ * @param ps Parser
+ * @param o  Operand
+ *
+ * @return Encoded register
+ */
+static int s_reg(s_parser_td *ps, s_operand_td o)
+{
+    expr_td *e = ps->e;
+
+    if (o.kind != S_CONST) {
+        return s_encode(o.kind, o.idx);
+    }
+
+    for (size_t i = 0; i < e->n_consts; ++i) {
+        if (e->consts[i] == o.value) {
+            return s_encode(S_CREG, (int) i);
+        }
+    }
+    if (e->n_consts == EXPR_MAX_REGS) {
+        s_error(ps, "Too many constants");
+        return 0;
+    }
+    e->consts[e->n_consts] = o.value;
+
+    return s_encode(S_CREG, (int) e->n_consts++);
+}
+
+
+/**
+ * @brief Append an instruction
+ *
+ * @param ps  Parser
+ * @param op  Operation
+ * @param dst Encoded destination register
+ * @param a   Encoded first operand register
+ * @param b   Encoded second operand register
+ */
+static void s_emit(s_parser_td *ps, expr_op_e op, int dst, int a, int b)
+{
+    expr_td *e = ps->e;
+
+    if (e->n_code == EXPR_MAX_CODE) {
+        s_error(ps, "Expression too long");
+        return;
+    }
+    e->code[e->n_code].op = op;
+    e->code[e->n_code].dst = dst;
+    e->code[e->n_code].a = a;
+    e->code[e->n_code].b = b;
+    e->n_code++;
+}
+
+
+/**
+ * @brief Compile an operation on one or two operands
+ *
+ * Operations on constants are folded.  Temporaries are used as a
+ * stack: the operands are released and the result takes the lowest
+ * of their registers.
+ *
+ * @param ps Parser
+ * @param op Operation
+ * @param a  First operand
+ * @param b  Second operand (ignored by one-operand operations)
+ * @param n  Number of operands (1 or 2)
+ *
+ * @return Result of the operation
+ */
+static s_operand_td s_apply(s_parser_td *ps, expr_op_e op,
+        s_operand_td a, s_operand_td b, int n)
+{
+    s_operand_td r = { S_CONST, 0, 0.0 };
+
+    if (a.kind == S_CONST && (n == 1 || b.kind == S_CONST)) {
+        r.value = s_eval(op, a.value, b.value);
+        return r;
+    }
+
+    /* Cheaper forms of common powers */
+    if (op == EXPR_OP_POW && n == 2 && b.kind == S_CONST) {
+        if (b.value == 2.0) {
+            op = EXPR_OP_MUL;
+            b = a;
+        } else if (b.value == 0.5) {
+            op = EXPR_OP_SQRT;
+            n = 1;
+        } else if (b.value == 1.0) {
+            return a;
+        }
+    }
+
+    int ra = s_reg(ps, a);
+    int rb = (n == 2) ? s_reg(ps, b) : ra;
+
+    /* Release the operands (the second one is on top) */
+    if (n == 2 && b.kind == S_TEMP && !(a.kind == S_TEMP
+                && a.idx == b.idx)) {
+        ps->n_temps--;
+    }
+    if (a.kind == S_TEMP) {
+        ps->n_temps--;
+    }
+
+    r.kind = S_TEMP;
+    r.idx = ps->n_temps++;
+    if (ps->n_temps > ps->max_temps) {
+        ps->max_temps = ps->n_temps;
+    }
+    s_emit(ps, op, s_encode(S_TEMP, r.idx), ra, rb);
+
+    return r;
+}
+
+
+/**
+ * @brief Parse a primary: number, name, call or parenthesized
+ *
+ * @param ps Parser
+ *
+ * @return Operand holding the value
+ */
+static s_operand_td s_primary(s_parser_td *ps)
+{
+    s_operand_td r = { S_CONST, 0, 0.0 };
+    char name[EXPR_MAX_NAME];
+
+    s_skip(ps);
+    if (isdigit((unsigned char) *ps->p) || (*ps->p == '.'
+                && isdigit((unsigned char) ps->p[1]))) {
+        char *end;
+        r.value = strtod(ps->p, &end);
+        ps->p = end;
+        return r;
+    }
+
+    if (s_accept(ps, '(')) {
+        r = s_expr(ps);
+        if (!s_accept(ps, ')')) {
+            s_error(ps, "Expected ')'");
+        }
+        return r;
+    }
+
+    if (!s_name(ps, name)) {
+        s_error(ps, "Expected a number, a name or '('");
+        return r;
+    }
+
+    /* Function call */
+    if (s_accept(ps, '(')) {
+        const s_function_td *f = s_functions;
+        while (f->name != NULL && strcmp(f->name, name) != 0) {
+            f++;
+        }
+        if (f->name == NULL) {
+            s_error(ps, "Unknown function");
+            return r;
+        }
+
+        s_operand_td a = s_expr(ps);
+        s_operand_td b = a;
+        if (f->n_args == 2) {
+            if (!s_accept(ps, ',')) {
+                s_error(ps, "Expected ','");
+                return r;
+            }
+            b = s_expr(ps);
+        }
+        if (!s_accept(ps, ')')) {
+            s_error(ps, "Expected ')'");
+            return r;
+        }
+        return s_apply(ps, f->op, a, b, f->n_args);
+    }
+
+    /* Column */
+    int col = s_column(ps, name, 0);
+    if (col >= 0) {
+        r.kind = S_COL;
+        r.idx = col;
+    }
+
+    return r;
+}
+
+
+/**
+ * @brief Parse a unary minus, or a power (right associative)
+ *
+ * @param ps Parser
+ *
+ * @return Operand holding the value
+ */
+static s_operand_td s_unary(s_parser_td *ps)
+{
+    if (s_accept(ps, '-')) {
+        s_operand_td a = s_unary(ps);
+        return s_apply(ps, EXPR_OP_NEG, a, a, 1);
+    }
+    if (s_accept(ps, '+')) {
+        return s_unary(ps);
+    }
+
+    s_operand_td a = s_primary(ps);
+    if (s_accept(ps, '^')) {
+        s_operand_td b = s_unary(ps);
+        return s_apply(ps, EXPR_OP_POW, a, b, 2);
+    }
+
+    return a;
+}
+
+
+/**
+ * @brief Parse a product or quotient
+ *
+ * @param ps Parser
+ *
+ * @return Operand holding the value
+ */
+static s_operand_td s_term(s_parser_td *ps)
+{
+    s_operand_td a = s_unary(ps);
+
+    while (!ps->failed) {
+        if (s_accept(ps, '*')) {
+            a = s_apply(ps, EXPR_OP_MUL, a, s_unary(ps), 2);
+        } else if (s_accept(ps, '/')) {
+            a = s_apply(ps, EXPR_OP_DIV, a, s_unary(ps), 2);
+        } else {
+            break;
+        }
+    }
+
+    return a;
+}
+
+
+/**
+ * @brief Parse a sum or difference
+ *
+ * @param ps Parser
+ *
+ * @return Operand holding the value
+ */
+static s_operand_td s_expr(s_parser_td *ps)
+{
+    s_operand_td a = s_term(ps);
+
+    while (!ps->failed) {
+        if (s_accept(ps, '+')) {
+            a = s_apply(ps, EXPR_OP_ADD, a, s_term(ps), 2);
+        } else if (s_accept(ps, '-')) {
+            a = s_apply(ps, EXPR_OP_SUB, a, s_term(ps), 2);
+        } else {
+            break;
+        }
+    }
+
+    return a;
+}
+
+
+/**
+ * @brief Parse an assignment: name = expression
+ *
+ * @param ps Parser
+ */
+static void s_statement(s_parser_td *ps)
+{
+    char name[EXPR_MAX_NAME];
+    expr_td *e = ps->e;
+
+    if (!s_name(ps, name)) {
+        s_error(ps, "Expected a column name");
+        return;
+    }
+    if (!s_accept(ps, '=')) {
+        s_error(ps, "Expected '='");
+        return;
+    }
+
+    s_operand_td v = s_expr(ps);
+    int col = s_column(ps, name, 1);
+    if (ps->failed) {
+        return;
+    }
+
+    /* Store the last result straight into the column */
+    int dst = s_encode(S_COL, col);
+    if (v.kind == S_TEMP && e->n_code > 0
+            && e->code[e->n_code - 1].dst == s_encode(S_TEMP, v.idx)) {
+        e->code[e->n_code - 1].dst = dst;
+    } else {
+        s_emit(ps, EXPR_OP_MOV, dst, s_reg(ps, v), 0);
+    }
+    ps->n_temps = 0;
+}
+
+
+/* Compile an expression to bytecode */
+int expr_compile(expr_td *e, const char *src, const dataset_td *ds,
+        char *err, size_t err_len)
+{
+    s_parser_td ps = { src, src, e, ds, 0, 0, err, err_len, 0 };
+
+    e->n_code = e->n_cols = e->n_consts = e->n_regs = 0;
+
+    do {
+        s_skip(&ps);
+        if (*ps.p == '\0') {
+            break;
+        }
+        s_statement(&ps);
+    } while (!ps.failed && s_accept(&ps, ';'));
+
+    s_skip(&ps);
+    if (!ps.failed && *ps.p != '\0') {
+        s_error(&ps, "Expected ';'");
+    }
+    if (!ps.failed && e->n_code == 0) {
+        s_error(&ps, "Nothing to compute");
+    }
+
+    e->n_regs = e->n_cols + e->n_consts + (size_t) ps.max_temps;
+    if (!ps.failed && e->n_regs > EXPR_MAX_REGS) {
+        s_error(&ps, "Expression too complex");
+    }
+    if (ps.failed) {
+        return 1;
+    }
+
+    /* Lay out the registers: columns, constants, temporaries */
+    int base[4];
+    base[S_COL] = 0;
+    base[S_CREG] = (int) e->n_cols;
+    base[S_TEMP] = (int) (e->n_cols + e->n_consts);
+    for (size_t i = 0; i < e->n_code; ++i) {
+        expr_insn_td *in = &e->code[i];
+        in->dst = base[in->dst / EXPR_MAX_REGS] + in->dst % EXPR_MAX_REGS;
+        in->a = base[in->a / EXPR_MAX_REGS] + in->a % EXPR_MAX_REGS;
+        in->b = base[in->b / EXPR_MAX_REGS] + in->b % EXPR_MAX_REGS;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Run an instruction over a block
+ *
+ * @param in   Instruction
+ * @param regs Registers
+ * @param n    Number of values in the block
+ */
+static void s_exec(const expr_insn_td *in, double *regs, size_t n)
+{
+    double *d = regs + (size_t) in->dst * EXPR_BLOCK;
+    const double *a = regs + (size_t) in->a * EXPR_BLOCK;
+    const double *b = regs + (size_t) in->b * EXPR_BLOCK;
+    size_t j;
+
+    switch (in->op) {
+        case EXPR_OP_MOV:
+            for (j = 0; j < n; ++j) d[j] = a[j];
+            break;
+        case EXPR_OP_NEG:
+            for (j = 0; j < n; ++j) d[j] = -a[j];
+            break;
+        case EXPR_OP_ADD:
+            for (j = 0; j < n; ++j) d[j] = a[j] + b[j];
+            break;
+        case EXPR_OP_SUB:
+            for (j = 0; j < n; ++j) d[j] = a[j] - b[j];
+            break;
+        case EXPR_OP_MUL:
+            for (j = 0; j < n; ++j) d[j] = a[j] * b[j];
+            break;
+        case EXPR_OP_DIV:
+            for (j = 0; j < n; ++j) d[j] = a[j] / b[j];
+            break;
+        case EXPR_OP_MIN:
+            for (j = 0; j < n; ++j) d[j] = (a[j] < b[j]) ? a[j] : b[j];
+            break;
+        case EXPR_OP_MAX:
+            for (j = 0; j < n; ++j) d[j] = (a[j] > b[j]) ? a[j] : b[j];
+            break;
+        case EXPR_OP_ABS:
+            for (j = 0; j < n; ++j) d[j] = fabs(a[j]);
+            break;
+        case EXPR_OP_SQRT:
+            for (j = 0; j < n; ++j) d[j] = sqrt(a[j]);
+            break;
+        case EXPR_OP_LOG:
+            for (j = 0; j < n; ++j) d[j] = a[j];
+            transform_log_block(d, n);
+            break;
+        case EXPR_OP_EXP:
+            for (j = 0; j < n; ++j) d[j] = a[j];
+            transform_exp_block(d, n);
+            break;
+        default:
+            /* Library functions, one value at a time */
+            for (j = 0; j < n; ++j) d[j] = s_eval(in->op, a[j], b[j]);
+            break;
+    }
+}
+
+
+/* Run a compiled expression over every point of a dataset */
+int expr_run(const expr_td *e, dataset_td *ds)
+{
+    int src[EXPR_MAX_COLS];
+    data_point_td buf[EXPR_BLOCK];
+
+    /* Where every column comes from */
+    for (size_t c = 0; c < e->n_cols; ++c) {
+        if (strcmp(e->cols[c], "x") == 0) {
+            src[c] = S_SRC_X;
+        } else if (strcmp(e->cols[c], "y") == 0) {
+            src[c] = S_SRC_Y;
+        } else if (strcmp(e->cols[c], "ey") == 0) {
+            src[c] = S_SRC_EY;
+        } else {
+            src[c] = dataset_find_col(ds, e->cols[c]);
+            if (src[c] < 0) {
+                src[c] = dataset_add_col(ds, e->cols[c]);
+            }
+            if (src[c] < 0) {
+                return 2;
+            }
+        }
+    }
+
+    /* Storage wide enough for any value assigned to x, y or ey, so
+     * that no block is left half way if memory runs out */
+    int mode = ds->mode;
+    for (size_t c = 0; c < e->n_cols; ++c) {
+        if (e->col_written[c] && src[c] < 0) {
+            mode &= ~DATASET_SINGLE;
+        }
+        if (e->col_written[c] && src[c] == S_SRC_EY) {
+            mode &= ~DATASET_NO_EY;
+        }
+    }
+    if (dataset_set_mode(ds, mode) != 0) {
+        return 2;
+    }
+
+    double *regs = malloc(e->n_regs * EXPR_BLOCK * sizeof(*regs));
+    if (regs == NULL) {
+        return 2;
+    }
+
+    /* Constants are loaded once */
+    for (size_t k = 0; k < e->n_consts; ++k) {
+        double *r = regs + (e->n_cols + k) * EXPR_BLOCK;
+        for (size_t j = 0; j < EXPR_BLOCK; ++j) {
+            r[j] = e->consts[k];
+        }
+    }
+
+    for (size_t i = 0; i < ds->size; i += EXPR_BLOCK) {
+        size_t n = (ds->size - i < EXPR_BLOCK) ? ds->size - i
+            : EXPR_BLOCK;
+        data_point_td *p = (data_point_td *) dataset_block(ds, i, n, buf);
+        int stored = 0;
+
+        /* Load */
+        for (size_t c = 0; c < e->n_cols; ++c) {
+            double *r = regs + c * EXPR_BLOCK;
+            switch (src[c]) {
+                case S_SRC_X:
+                    for (size_t j = 0; j < n; ++j) r[j] = p[j].x;
+                    break;
+                case S_SRC_Y:
+                    for (size_t j = 0; j < n; ++j) r[j] = p[j].y;
+                    break;
+                case S_SRC_EY:
+                    for (size_t j = 0; j < n; ++j) r[j] = p[j].ey;
+                    break;
+                default:
+                    memcpy(r, ds->cols[src[c]] + i, n * sizeof(*r));
+                    break;
+            }
+        }
+
+        for (size_t k = 0; k < e->n_code; ++k) {
+            s_exec(&e->code[k], regs, n);
+        }
+
+        /* Store */
+        for (size_t c = 0; c < e->n_cols; ++c) {
+            double *r = regs + c * EXPR_BLOCK;
+            if (!e->col_written[c]) {
+                continue;
+            }
+            switch (src[c]) {
+                case S_SRC_X:
+                    for (size_t j = 0; j < n; ++j) p[j].x = r[j];
+                    break;
+                case S_SRC_Y:
+                    for (size_t j = 0; j < n; ++j) p[j].y = r[j];
+                    break;
+                case S_SRC_EY:
+                    for (size_t j = 0; j < n; ++j) p[j].ey = r[j];
+                    break;
+                default:
+                    memcpy(ds->cols[src[c]] + i, r, n * sizeof(*r));
+                    break;
+            }
+            stored |= (src[c] < 0);
+        }
+        if (stored && dataset_store(ds, i, n, p) != 0) {
+            free(regs);
+            return 2;
+        }
+    }
+
+    free(regs);
+    ds->is_modified = 1;
+
+    return 0;
+}
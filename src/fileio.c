@@ -4,64 +4,2039 @@
  * @brief Implementation of file manipulation (load/save) functions
  */
 
+#define _POSIX_C_SOURCE 200809L /* fsync, glob, mkstemp, strdup,
+                                   sysconf */
+
+
 /* System includes */
-#include <stdio.h>      /* fopen, fgets, sscanf, size_t */
+#include <ctype.h>      /* isspace */
+#include <fcntl.h>      /* open, O_RDWR */
+#include <float.h>      /* DBL_MAX, FLT_MAX */
+#include <glob.h>       /* glob, globfree */
+#include <math.h>       /* ceil, fabs, signbit */
+#include <pthread.h>    /* pthread_create, pthread_join */
+#include <stdint.h>     /* uint64_t */
+#include <stdio.h>      /* fdopen, fopen, fwrite, rename, sscanf, ... */
+#include <stdlib.h>     /* free, malloc, mkstemp, realloc, strtod, ... */
+#include <string.h>     /* memcpy, strcmp, strcspn, strlen, strspn, ... */
+#include <sys/stat.h>   /* fchmod, stat, umask */
+#include <unistd.h>     /* close, fsync, sysconf, unlink */
 
 /* Project includes */
+#include <archive.h>
+#include <arrow.h>
 #include <dataset.h>
+#include <journal.h>
+#include <stream.h>
+#include <summary.h>
 
 /* Local includes */
 #include <fileio.h>
 
 
+#define FILEIO_MAX_COLS (32)    /**< Columns looked at in a keyed line */
+#define FILEIO_SAMPLE (64)      /**< Points read before estimating the
+                                     number of points of a file */
+#define FILEIO_SAVE_CHUNK (SUMMARY_BLOCK)   /**< Points formatted by a
+                                                 thread before writing
+                                                 them out (a block of the
+                                                 index) */
+#define FILEIO_MAX_THREADS (8)      /**< Maximum formatting threads */
+#define FILEIO_MAX_DECIMALS (17)    /**< Most decimals printed in
+                                         fixed notation */
+#define FILEIO_MAX_EXACT ((uint64_t) 1 << 53)   /**< Largest integer
+                                                     printed in fixed
+                                                     notation */
+#define FILEIO_MAX_DIGITS (17)  /**< Digits that always read back */
+#define FILEIO_POW10_COUNT (87)     /**< Cached powers of ten */
+#define FILEIO_POW10_STEP (8)       /**< Decimal exponent between them */
+#define FILEIO_POW10_MIN (-348)     /**< Decimal exponent of the first */
+#define FILEIO_ALPHA (-60)  /**< Least binary exponent of a scaled value */
+#define FILEIO_GAMMA (-32)  /**< Most binary exponent of a scaled value */
+#define FILEIO_TMP_SUFFIX ".XXXXXX" /**< Appended to the name of a file
+                                         to make its temporary copy */
+
+
+/**
+ * @brief Work of a thread: format a chunk of points
+ */
+typedef struct {
+    const dataset_td *ds;   /**< Dataset to save */
+    size_t begin;           /**< First point of the chunk */
+    size_t end;             /**< One past the last point of the chunk */
+    char *buf;              /**< Text of the chunk */
+    size_t len;             /**< Bytes of text in @e buf */
+    size_t cap;             /**< Capacity of @e buf */
+    int failed;             /**< Non-zero on memory allocation failure */
+} s_save_job_td;
+
+
+/**
+ * @brief Number f * 2^e, of a 64-bit significand
+ */
+typedef struct {
+    uint64_t f;     /**< Significand */
+    int e;          /**< Binary exponent */
+} s_fp_td;
+
+
+/**
+ * @brief Power of ten 10^k, as the nearest f * 2^e
+ */
+typedef struct {
+    uint64_t f;     /**< Significand, normalized (its top bit set) */
+    int16_t e;      /**< Binary exponent */
+    int16_t k;      /**< Decimal exponent */
+} s_pow10_td;
+
+
+/** Powers of ten from 10^-348 to 10^340, every @c FILEIO_POW10_STEP */
+static const s_pow10_td s_pow10[FILEIO_POW10_COUNT] = {
+    { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+    { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+    { 0x8b16fb203055ac76ULL, -1166, -332 },
+    { 0xcf42894a5dce35eaULL, -1140, -324 },
+    { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+    { 0xe61acf033d1a45dfULL, -1087, -308 },
+    { 0xab70fe17c79ac6caULL, -1060, -300 },
+    { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+    { 0xbe5691ef416bd60cULL, -1007, -284 },
+    { 0x8dd01fad907ffc3cULL, -980, -276 },
+    { 0xd3515c2831559a83ULL, -954, -268 },
+    { 0x9d71ac8fada6c9b5ULL, -927, -260 },
+    { 0xea9c227723ee8bcbULL, -901, -252 },
+    { 0xaecc49914078536dULL, -874, -244 },
+    { 0x823c12795db6ce57ULL, -847, -236 },
+    { 0xc21094364dfb5637ULL, -821, -228 },
+    { 0x9096ea6f3848984fULL, -794, -220 },
+    { 0xd77485cb25823ac7ULL, -768, -212 },
+    { 0xa086cfcd97bf97f4ULL, -741, -204 },
+    { 0xef340a98172aace5ULL, -715, -196 },
+    { 0xb23867fb2a35b28eULL, -688, -188 },
+    { 0x84c8d4dfd2c63f3bULL, -661, -180 },
+    { 0xc5dd44271ad3cdbaULL, -635, -172 },
+    { 0x936b9fcebb25c996ULL, -608, -164 },
+    { 0xdbac6c247d62a584ULL, -582, -156 },
+    { 0xa3ab66580d5fdaf6ULL, -555, -148 },
+    { 0xf3e2f893dec3f126ULL, -529, -140 },
+    { 0xb5b5ada8aaff80b8ULL, -502, -132 },
+    { 0x87625f056c7c4a8bULL, -475, -124 },
+    { 0xc9bcff6034c13053ULL, -449, -116 },
+    { 0x964e858c91ba2655ULL, -422, -108 },
+    { 0xdff9772470297ebdULL, -396, -100 },
+    { 0xa6dfbd9fb8e5b88fULL, -369, -92 },
+    { 0xf8a95fcf88747d94ULL, -343, -84 },
+    { 0xb94470938fa89bcfULL, -316, -76 },
+    { 0x8a08f0f8bf0f156bULL, -289, -68 },
+    { 0xcdb02555653131b6ULL, -263, -60 },
+    { 0x993fe2c6d07b7facULL, -236, -52 },
+    { 0xe45c10c42a2b3b06ULL, -210, -44 },
+    { 0xaa242499697392d3ULL, -183, -36 },
+    { 0xfd87b5f28300ca0eULL, -157, -28 },
+    { 0xbce5086492111aebULL, -130, -20 },
+    { 0x8cbccc096f5088ccULL, -103, -12 },
+    { 0xd1b71758e219652cULL, -77, -4 },
+    { 0x9c40000000000000ULL, -50, 4 },
+    { 0xe8d4a51000000000ULL, -24, 12 },
+    { 0xad78ebc5ac620000ULL, 3, 20 },
+    { 0x813f3978f8940984ULL, 30, 28 },
+    { 0xc097ce7bc90715b3ULL, 56, 36 },
+    { 0x8f7e32ce7bea5c70ULL, 83, 44 },
+    { 0xd5d238a4abe98068ULL, 109, 52 },
+    { 0x9f4f2726179a2245ULL, 136, 60 },
+    { 0xed63a231d4c4fb27ULL, 162, 68 },
+    { 0xb0de65388cc8ada8ULL, 189, 76 },
+    { 0x83c7088e1aab65dbULL, 216, 84 },
+    { 0xc45d1df942711d9aULL, 242, 92 },
+    { 0x924d692ca61be758ULL, 269, 100 },
+    { 0xda01ee641a708deaULL, 295, 108 },
+    { 0xa26da3999aef774aULL, 322, 116 },
+    { 0xf209787bb47d6b85ULL, 348, 124 },
+    { 0xb454e4a179dd1877ULL, 375, 132 },
+    { 0x865b86925b9bc5c2ULL, 402, 140 },
+    { 0xc83553c5c8965d3dULL, 428, 148 },
+    { 0x952ab45cfa97a0b3ULL, 455, 156 },
+    { 0xde469fbd99a05fe3ULL, 481, 164 },
+    { 0xa59bc234db398c25ULL, 508, 172 },
+    { 0xf6c69a72a3989f5cULL, 534, 180 },
+    { 0xb7dcbf5354e9beceULL, 561, 188 },
+    { 0x88fcf317f22241e2ULL, 588, 196 },
+    { 0xcc20ce9bd35c78a5ULL, 614, 204 },
+    { 0x98165af37b2153dfULL, 641, 212 },
+    { 0xe2a0b5dc971f303aULL, 667, 220 },
+    { 0xa8d9d1535ce3b396ULL, 694, 228 },
+    { 0xfb9b7cd9a4a7443cULL, 720, 236 },
+    { 0xbb764c4ca7a44410ULL, 747, 244 },
+    { 0x8bab8eefb6409c1aULL, 774, 252 },
+    { 0xd01fef10a657842cULL, 800, 260 },
+    { 0x9b10a4e5e9913129ULL, 827, 268 },
+    { 0xe7109bfba19c0c9dULL, 853, 276 },
+    { 0xac2820d9623bf429ULL, 880, 284 },
+    { 0x80444b5e7aa7cf85ULL, 907, 292 },
+    { 0xbf21e44003acdd2dULL, 933, 300 },
+    { 0x8e679c2f5e44ff8fULL, 960, 308 },
+    { 0xd433179d9c8cb841ULL, 986, 316 },
+    { 0x9e19db92b4e31ba9ULL, 1013, 324 },
+    { 0xeb96bf6ebadf77d9ULL, 1039, 332 },
+    { 0xaf87023b9bf0ee6bULL, 1066, 340 }
+};
+
+
+/**
+ * @brief Columns read from every line of a delimited file
+ */
+typedef struct {
+    char delim;                 /**< Delimiter, or '\0' for blanks */
+    int cols[FILEIO_COL_MAX];   /**< Column of every value, or -1 if
+                                     not read */
+    int key_col;                /**< Column of the key, or -1 */
+    int last;                   /**< Last column read */
+} s_layout_td;
+
+
+/**
+ * @brief Files loaded in parallel by a pool of threads
+ */
+typedef struct {
+    const char *const *filenames;   /**< Files to load */
+    size_t n;                       /**< Number of files */
+    const fileio_opts_td *opts;     /**< Load options of every file */
+    dataset_td *parts;      /**< Dataset of every file */
+    int *errs;              /**< Error of every file */
+    size_t next;            /**< Next file to load (those before it
+                                 are loaded, or failed) */
+    int failed;             /**< Non-zero once a file failed */
+    pthread_mutex_t lock;   /**< Guards @e next and @e failed */
+} s_load_pool_td;
+
+
+/**
+ * @brief Table of distinct strings, each one given a dense id
+ *
+ * Open addressing with linear probing: @e slots holds @e id+1 of the
+ * string stored there, or 0 if the slot is free.
+ */
+typedef struct {
+    char **names;       /**< Distinct strings, indexed by id */
+    size_t n;           /**< Number of distinct strings */
+    size_t cap;         /**< Capacity of @e names */
+    size_t *slots;      /**< Hash slots */
+    size_t n_slots;     /**< Number of slots (power of two) */
+} s_intern_td;
+
+
+/**
+ * @brief Hash a string of known length (FNV-1a)
+ *
+ * @param s   String to hash
+ * @param len Length of the string
+ *
+ * @return Hash of the string
+ */
+static uint64_t s_hash_str(const char *s, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Free the memory used by a string table
+ *
+ * @param t Pointer to the table
+ */
+static void s_intern_free(s_intern_td *t)
+{
+    for (size_t i = 0; i < t->n; ++i) {
+        free(t->names[i]);
+    }
+    free(t->names);
+    free(t->slots);
+}
+
+
+/**
+ * @brief Get the id of a string, adding it to the table if needed
+ *
+ * @param t   Pointer to the table
+ * @param s   String (not necessarily null-terminated)
+ * @param len Length of the string
+ *
+ * @return Id of the string, or -1 on memory allocation failure
+ */
+static long s_intern(s_intern_td *t, const char *s, size_t len)
+{
+    /* Keep the load factor under 1/2 */
+    if (2 * (t->n + 1) > t->n_slots) {
+        size_t n_slots = (t->n_slots) ? 2 * t->n_slots : 64;
+        size_t *slots = calloc(n_slots, sizeof(*slots));
+        if (slots == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < t->n; ++i) {
+            size_t j = s_hash_str(t->names[i], strlen(t->names[i])) &
+                (n_slots - 1);
+            while (slots[j] != 0) {
+                j = (j + 1) & (n_slots - 1);
+            }
+            slots[j] = i + 1;
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->n_slots = n_slots;
+    }
+
+    size_t j = s_hash_str(s, len) & (t->n_slots - 1);
+    while (t->slots[j] != 0) {
+        const char *name = t->names[t->slots[j] - 1];
+        if (strlen(name) == len && memcmp(name, s, len) == 0) {
+            return (long) (t->slots[j] - 1);
+        }
+        j = (j + 1) & (t->n_slots - 1);
+    }
+
+    if (t->n == t->cap) {
+        size_t cap = (t->cap) ? 2 * t->cap : 16;
+        char **names = realloc(t->names, cap * sizeof(*names));
+        if (names == NULL) {
+            return -1;
+        }
+        t->names = names;
+        t->cap = cap;
+    }
+    char *name = malloc(len + 1);
+    if (name == NULL) {
+        return -1;
+    }
+    memcpy(name, s, len);
+    name[len] = '\0';
+
+    t->names[t->n] = name;
+    t->slots[j] = ++t->n;
+
+    return (long) (t->n - 1);
+}
+
+
+/**
+ * @brief Get the size of an open file
+ *
+ * @param fp Stream of the file, at its beginning
+ *
+ * @return Size of the file in bytes, or 0 if it cannot be told (e.g.,
+ *         a pipe)
+ */
+static size_t s_file_size(FILE *fp)
+{
+    long size = 0;
+
+    if (fseek(fp, 0L, SEEK_END) == 0) {
+        size = ftell(fp);
+    }
+    if (fseek(fp, 0L, SEEK_SET) != 0 || size < 0) {
+        return 0;
+    }
+
+    return (size_t) size;
+}
+
+
+/**
+ * @brief Tell if a file is too large to be loaded in memory
+ *
+ * @param size Size of the file in bytes, about the memory its points
+ *             take once loaded
+ *
+ * @return 1 if the file is larger than half the physical memory, or 0
+ *         otherwise (or if the memory size cannot be told)
+ */
+static int s_is_out_of_core(size_t size)
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (pages <= 0 || page_size <= 0) {
+        return 0;
+    }
+
+    return (size / (size_t) page_size > (size_t) pages / 2);
+}
+
+
+/**
+ * @brief Give the key names collected during a load to the dataset
+ *
+ * If every name is an integer literal, the keys are turned into those
+ * integers and the names are dropped; otherwise the keys stay as ids
+ * into the names, which are handed over to the dataset.
+ *
+ * @param ds Pointer to the loaded dataset
+ * @param t  Pointer to the table of key names (emptied on return)
+ */
+static void s_intern_to_dataset(dataset_td *ds, s_intern_td *t)
+{
+    long *values = malloc((t->n + 1) * sizeof(*values));
+    int all_int = (values != NULL);
+
+    for (size_t i = 0; all_int && i < t->n; ++i) {
+        char *end;
+        values[i] = strtol(t->names[i], &end, 10);
+        all_int = (*end == '\0' && end != t->names[i]);
+    }
+
+    if (all_int && ds->keys != NULL) {
+        for (size_t i = 0; i < ds->size; ++i) {
+            ds->keys[i] = values[ds->keys[i]];
+        }
+        s_intern_free(t);
+    } else {
+        ds->key_names = t->names;
+        ds->n_key_names = t->n;
+        free(t->slots);
+    }
+    free(values);
+}
+
+
+/**
+ * @brief Round a value to single precision
+ *
+ * @param v Value to round
+ *
+ * @return @p v rounded, or @p v itself if out of range
+ */
+static double s_round_single(double v)
+{
+    return (fabs(v) <= FLT_MAX) ? (double) (float) v : v;
+}
+
+
+/**
+ * @brief Parse a line whose columns include a group key
+ *
+ * The key is the whole token at column @p key_col; the remaining
+ * columns, in order, are @e (x, y, [ey]).
+ *
+ * @param line    Null-terminated line to parse
+ * @param key_col Column (from 0) of the key
+ * @param single  Non-zero to round the values to single precision
+ * @param keys    Table where the key is interned
+ * @param ds      Dataset where the point is added
+ *
+ * @return 0 if the line was added or skipped (fewer than two numeric
+ *         values), 1 on memory allocation failure
+ */
+static int s_parse_keyed(const char *line, int key_col, int single,
+        s_intern_td *keys, dataset_td *ds)
+{
+    const char *tok[FILEIO_MAX_COLS];
+    size_t len[FILEIO_MAX_COLS];
+    int n_tok = 0;
+    const char *p = line;
+
+    while (n_tok < FILEIO_MAX_COLS) {
+        while (isspace((unsigned char) *p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        tok[n_tok] = p;
+        while (*p != '\0' && !isspace((unsigned char) *p)) {
+            p++;
+        }
+        len[n_tok] = (size_t) (p - tok[n_tok]);
+        n_tok++;
+    }
+
+    if (key_col >= n_tok) {
+        return 0;
+    }
+
+    double v[3] = { 0.0, 0.0, 0.0 };
+    int n = 0;
+    for (int c = 0; c < n_tok && n < 3; ++c) {
+        char *end;
+        if (c == key_col) {
+            continue;
+        }
+        v[n] = strtod(tok[c], &end);
+        if (end == tok[c]) {
+            break;
+        }
+        if (single) {
+            v[n] = s_round_single(v[n]);
+        }
+        n++;
+    }
+    if (n < 2) {
+        return 0;
+    }
+
+    long key = s_intern(keys, tok[key_col], len[key_col]);
+    if (key < 0) {
+        return 1;
+    }
+
+    return (dataset_add_keyed(ds, v[0], v[1], v[2], key) != 0);
+}
+
+
+/* Set the default options to load a data file */
+void fileio_opts_init(fileio_opts_td *opts)
+{
+    opts->key_col = -1;
+    opts->mapped = 0;
+    opts->single = 0;
+    opts->delim = '\0';
+    for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+        opts->cols[k] = -1;
+        opts->names[k] = NULL;
+    }
+    opts->tag_files = 0;
+    opts->summary = 0;
+    opts->stale_journal = 0;
+}
+
+
+/**
+ * @brief Get the identity of the options a file is read with
+ *
+ * Only the options that change the points read count: an index
+ * written for a file read one way is not used for another way.
+ *
+ * @param opts Pointer to the load options
+ *
+ * @return Identity of the options
+ */
+static uint64_t s_opts_id(const fileio_opts_td *opts)
+{
+    char text[96];
+    int len = snprintf(text, sizeof(text), "%d %d %d %d %d %d",
+            opts->key_col, opts->single, opts->delim,
+            opts->cols[FILEIO_COL_X], opts->cols[FILEIO_COL_Y],
+            opts->cols[FILEIO_COL_EY]);
+    uint64_t h = s_hash_str(text, (size_t) len);
+
+    for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+        const char *name = opts->names[k];
+        h ^= (name != NULL) ? s_hash_str(name, strlen(name)) : 0;
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
 /* Load data points from a text file into a dataset */
 int fileio_load(const char *filename, dataset_td *ds)
 {
-    FILE *fp = fopen(filename, "r");
+    return fileio_load_opts(filename, ds, NULL);
+}
 
-    if (fp == NULL) {
-        return 1;
+
+/**
+ * @brief Split the next field of a line
+ *
+ * A field starting with a double quote ends at the closing one (two
+ * double quotes stand for one inside it); the field is then the text
+ * between them, as is, and anything up to the delimiter is dropped.
+ *
+ * @param p     Start of the field
+ * @param delim Delimiter, or '\0' for runs of blanks
+ * @param tok   Where to store the start of the field
+ * @param len   Where to store the length of the field
+ *
+ * @return Start of the next field, or @c NULL if this is the last one
+ */
+static const char *s_field(const char *p, char delim, const char **tok,
+        size_t *len)
+{
+    const char stops[4] = { delim, '\r', '\n', '\0' };
+
+    if (delim == '\0') {
+        p += strspn(p, " \t");
     }
 
-    dataset_destroy(ds);
-    dataset_init(ds);
+    if (*p == '"') {
+        const char *q = ++p;
+        while (*q != '\0' && (q[0] != '"' || q[1] == '"')) {
+            q += (q[0] == '"') ? 2 : 1;
+        }
+        *tok = p;
+        *len = (size_t) (q - p);
+        p = (*q == '"') ? q + 1 : q;
+        p += strcspn(p, (delim != '\0') ? stops : " \t\r\n");
+    } else {
+        *tok = p;
+        p += strcspn(p, (delim != '\0') ? stops : " \t\r\n");
+        *len = (size_t) (p - *tok);
+    }
 
-    char line[256];
-    while (fgets(line, sizeof(line), fp)) {
-        double x, y, ey=0;
-        int n = sscanf(line, "%lf %lf %lf", &x, &y, &ey);
+    if (delim != '\0') {
+        return (*p == delim) ? p + 1 : NULL;
+    }
+    p += strspn(p, " \t");
+    return (*p == '\0' || *p == '\r' || *p == '\n') ? NULL : p;
+}
 
-        if (n < 2) {
+
+/**
+ * @brief Find the columns to read from a delimited file
+ *
+ * Values given neither a column nor a name take the first columns
+ * that are not the key, in order, unless @e x or @e y is given one: the
+ * other values are then only read if given one too.
+ *
+ * @param opts   Pointer to the load options
+ * @param header First line of the file, or @c NULL if no name is used
+ * @param lay    Where to store the columns to read
+ *
+ * @return 0 on success, or 4 if a name is not in the header
+ */
+static int s_layout(const fileio_opts_td *opts, const char *header,
+        s_layout_td *lay)
+{
+    int by_position = 1;
+
+    lay->delim = opts->delim;
+    lay->key_col = opts->key_col;
+    for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+        lay->cols[k] = (opts->names[k] == NULL) ? opts->cols[k] : -1;
+        if (opts->names[k] == NULL && opts->cols[k] < 0) {
             continue;
         }
-        if (n == 2) {
-            ey = 0;
+        if (k == FILEIO_COL_X || k == FILEIO_COL_Y) {
+            by_position = 0;
         }
-        dataset_add(ds, x, y, ey);
     }
 
-    fclose(fp);
-    ds->is_modified = 0;
+    /* Names are matched without surrounding blanks */
+    const char *p = header;
+    for (int c = 0; p != NULL; ++c) {
+        const char *tok;
+        size_t len;
+
+        p = s_field(p, lay->delim, &tok, &len);
+        while (len > 0 && isspace((unsigned char) *tok)) {
+            tok++;
+            len--;
+        }
+        while (len > 0 && isspace((unsigned char) tok[len - 1])) {
+            len--;
+        }
+        for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+            if (opts->names[k] != NULL && lay->cols[k] < 0 &&
+                    strlen(opts->names[k]) == len &&
+                    strncmp(opts->names[k], tok, len) == 0) {
+                lay->cols[k] = c;
+            }
+        }
+    }
+
+    int next = 0;
+    lay->last = lay->key_col;
+    for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+        if (opts->names[k] != NULL && lay->cols[k] < 0) {
+            return 4;
+        }
+        if (lay->cols[k] < 0 && by_position) {
+            next += (next == lay->key_col);
+            lay->cols[k] = next++;
+        }
+        if (lay->cols[k] > lay->last) {
+            lay->last = lay->cols[k];
+        }
+    }
 
     return 0;
 }
 
 
-/* Save dataset points to a text file */
-int fileio_save(const char *filename, dataset_td *ds)
+/**
+ * @brief Parse a line of a delimited file
+ *
+ * Only the columns of the layout are converted, and the line is not
+ * split past the last of them.
+ *
+ * @param line   Null-terminated line to parse
+ * @param lay    Pointer to the columns to read
+ * @param single Non-zero to round the values to single precision
+ * @param keys   Table where the key is interned
+ * @param ds     Dataset where the point is added
+ *
+ * @return 0 if the line was added or skipped (no numeric @e x or
+ *         @e y), 1 on memory allocation failure
+ */
+static int s_parse_delim(const char *line, const s_layout_td *lay,
+        int single, s_intern_td *keys, dataset_td *ds)
 {
-    FILE *fp = fopen(filename, "w");
+    double v[FILEIO_COL_MAX] = { 0.0, 0.0, 0.0 };
+    int got[FILEIO_COL_MAX] = { 0, 0, 0 };
+    const char *key = NULL;
+    size_t key_len = 0;
+    const char *p = line;
 
-    if (fp == NULL) {
+    for (int c = 0; p != NULL && c <= lay->last; ++c) {
+        const char *tok;
+        size_t len;
+
+        p = s_field(p, lay->delim, &tok, &len);
+        if (c == lay->key_col) {
+            key = tok;
+            key_len = len;
+            continue;
+        }
+        for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+            if (c == lay->cols[k]) {
+                char *end;
+                v[k] = strtod(tok, &end);
+                got[k] = (end != tok && end <= tok + len);
+            }
+        }
+    }
+
+    if (!got[FILEIO_COL_X] || !got[FILEIO_COL_Y] ||
+            (lay->key_col >= 0 && key == NULL)) {
+        return 0;
+    }
+    if (!got[FILEIO_COL_EY]) {
+        v[FILEIO_COL_EY] = 0.0;
+    }
+    if (single) {
+        for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+            v[k] = s_round_single(v[k]);
+        }
+    }
+
+    if (lay->key_col < 0) {
+        return (dataset_add(ds, v[0], v[1], v[2]) != 0);
+    }
+
+    long id = s_intern(keys, key, key_len);
+    if (id < 0) {
+        return 1;
+    }
+
+    return (dataset_add_keyed(ds, v[0], v[1], v[2], id) != 0);
+}
+
+
+/**
+ * @brief Note where a block of the index ends in a text file
+ *
+ * @param ends   Offsets noted so far (to be freed), or @c NULL
+ * @param n_ends Number of offsets noted
+ * @param cap    Capacity of @p ends
+ * @param pos    Offset where the block ends, or -1 if it is not known
+ *
+ * @return 0 on success, or 1 if the offset is not known or memory runs
+ *         out: the offsets are then freed, as the index cannot be
+ *         written
+ */
+static int s_push_end(uint64_t **ends, size_t *n_ends, size_t *cap,
+        long pos)
+{
+    if (pos >= 0 && *n_ends == *cap) {
+        size_t new_cap = (*cap > 0) ? 2 * *cap : 16;
+        uint64_t *p = realloc(*ends, new_cap * sizeof(*p));
+        if (p != NULL) {
+            *ends = p;
+            *cap = new_cap;
+        } else {
+            pos = -1;
+        }
+    }
+    if (pos < 0) {
+        free(*ends);
+        *ends = NULL;
         return 1;
     }
+    (*ends)[(*n_ends)++] = (uint64_t) pos;
+
+    return 0;
+}
+
+
+/**
+ * @brief Read the points of a text file into a new dataset
+ *
+ * @param fp     Text file, open for reading (closed on return); it may
+ *               be compressed (see @a stream_open())
+ * @param opts   Pointer to the load options
+ * @param loaded Pointer to the dataset, initialized here
+ * @param ends   Where to store the offset one past the last byte every
+ *               block of @c SUMMARY_BLOCK points was read from (to be
+ *               freed), or @c NULL if they are not known (the file is
+ *               compressed, or memory ran out)
+ *
+ * @return 0 on success, or the error of @a fileio_load_opts() (the
+ *         dataset is then destroyed)
+ */
+static int s_load_text(FILE *fp, const fileio_opts_td *opts,
+        dataset_td *loaded, uint64_t **ends)
+{
+    int key_col = opts->key_col;
+    int single = opts->single;
+    s_intern_td keys = { NULL, 0, 0, NULL, 0 };
+    s_layout_td lay = { '\0', { -1, -1, -1 }, -1, -1 };
+    stream_td st;
+    int delimited = (opts->delim != '\0');
+    int named = 0;
+    int err = 0;
+    size_t n_ends = 0, cap_ends = 0;
+    int track = 1;
+
+    *ends = NULL;
+    for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+        delimited |= (opts->cols[k] >= 0 || opts->names[k] != NULL);
+        named |= (opts->names[k] != NULL);
+    }
+
+    size_t file_size = s_file_size(fp);
+    if ((err = stream_open(&st, fp)) != 0) {
+        return err;
+    }
+    if (opts->mapped || s_is_out_of_core(file_size)) {
+        dataset_init_mapped(loaded, NULL);
+    } else {
+        dataset_init(loaded);
+    }
+
+    /* Narrowest storage first: values that do not fit it widen it as
+     * they are read, so the mode is known once the file is */
+    dataset_set_mode(loaded, DATASET_NO_EY | DATASET_SINGLE);
+
+    /* The header, if columns are named, is only read for the names */
+    char line[FILEIO_MAX_LINE];
+    if (delimited) {
+        const char *header = NULL;
+        if (named && stream_gets(line, sizeof(line), &st) != NULL) {
+            header = line;
+        }
+        err = s_layout(opts, (named) ? header : NULL, &lay);
+        if (err != 0) {
+            stream_close(&st);
+            dataset_destroy(loaded);
+            return err;
+        }
+    }
+
+    while (err == 0 && stream_gets(line, sizeof(line), &st)) {
+        size_t len = strlen(line);
+
+        /* A block of the index ends where the line after its last
+         * point starts */
+        if (track && loaded->size == (n_ends + 1) * SUMMARY_BLOCK) {
+            long pos = stream_tell(&st);
+            track = (s_push_end(ends, &n_ends, &cap_ends,
+                        (pos >= 0) ? pos - (long) len : -1) == 0);
+        }
+
+        /* Lines too long to be read at once are skipped whole */
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            while (stream_gets(line, sizeof(line), &st) != NULL &&
+                    line[strlen(line) - 1] != '\n') {
+                continue;
+            }
+            continue;
+        }
+
+        /* Room for the whole file, guessed from the bytes per point of
+         * its first lines, so that the buffers are not grown (and
+         * copied) over and over (compressed files are not known to
+         * hold how many bytes of text) */
+        if (loaded->size == FILEIO_SAMPLE && file_size > 0) {
+            long pos = stream_tell(&st);
+            if (pos > 0) {
+                size_t guess = (size_t) ((double) file_size
+                        * FILEIO_SAMPLE / (double) pos * 1.0625);
+                dataset_reserve(loaded, guess);
+            }
+        }
+
+        if (delimited) {
+            err = s_parse_delim(line, &lay, single, &keys, loaded);
+            continue;
+        }
+        if (key_col >= 0) {
+            err = s_parse_keyed(line, key_col, single, &keys, loaded);
+            continue;
+        }
+
+        double x, y, ey=0;
+        int n = sscanf(line, "%lf %lf %lf", &x, &y, &ey);
+
+        if (n < 2) {
+            continue;
+        }
+        if (n == 2) {
+            ey = 0;
+        }
+        if (single) {
+            x = s_round_single(x);
+            y = s_round_single(y);
+            ey = s_round_single(ey);
+        }
+        err = dataset_add(loaded, x, y, ey);
+    }
+
+    /* The last block ends with the file */
+    if (track && loaded->size > n_ends * SUMMARY_BLOCK) {
+        s_push_end(ends, &n_ends, &cap_ends, stream_tell(&st));
+    } else if (track && n_ends > 0) {
+        (*ends)[n_ends - 1] = (uint64_t) stream_tell(&st);
+    }
+
+    /* A compressed file may end early, or be corrupted halfway */
+    int read_err = stream_close(&st);
+    if (err != 0 || read_err != 0) {
+        free(*ends);
+        *ends = NULL;
+        s_intern_free(&keys);
+        dataset_destroy(loaded);
+        return (err != 0) ? 2 : read_err;
+    }
+    if (key_col >= 0) {
+        s_intern_to_dataset(loaded, &keys);
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Read a data file (text or archive) into a new dataset
+ *
+ * @param filename Path to the file
+ * @param opts     Pointer to the load options
+ * @param loaded   Pointer to the dataset, initialized here on success
+ * @param in_sync  Where to store whether the points are those of the
+ *                 file and its journal (see @a journal_replay())
+ *
+ * @return 0 on success, or the error of @a fileio_load_opts()
+ */
+static int s_load_file(const char *filename, const fileio_opts_td *opts,
+        dataset_td *loaded, int *in_sync)
+{
+    FILE *fp = fopen(filename, "r");
+    uint64_t *ends = NULL;
+    int err;
+
+    if (fp == NULL) {
+        return 1;
+    }
+
+    if (archive_check(filename)) {
+        fclose(fp);
+        dataset_init(loaded);
+        if ((err = archive_load(filename, loaded)) != 0) {
+            dataset_destroy(loaded);
+            return err;
+        }
+    } else if (arrow_check(filename)) {
+        fclose(fp);
+        dataset_init(loaded);
+        if ((err = arrow_load(filename, loaded, opts->names)) != 0) {
+            dataset_destroy(loaded);
+            return err;
+        }
+    } else if ((err = s_load_text(fp, opts, loaded, &ends)) != 0) {
+        return err;
+    }
+
+    /* The index of a text file, if asked, is written or checked while
+     * its bytes are still cached; it is only a shortcut, so it is left
+     * behind if it cannot be written */
+    if (ends != NULL && opts->summary) {
+        summary_td sm;
+        uint64_t id = s_opts_id(opts);
+
+        if (summary_read(&sm, filename, id) == 0) {
+            summary_destroy(&sm);
+        } else if (summary_build(&sm, loaded, loaded->size, filename,
+                    ends, id) == 0) {
+            summary_write(&sm, filename);
+            summary_destroy(&sm);
+        }
+    }
+    free(ends);
+
+    /* Points saved since the file was last rewritten, unless the
+     * journal was written for other contents, which the caller must
+     * agree to load without them */
+    err = journal_replay(filename, loaded);
+    if (err == 2 || (err == 3 && !opts->stale_journal)) {
+        dataset_destroy(loaded);
+        return (err == 2) ? 2 : 6;
+    }
+
+    /* Rounded values are not those of the file: it is rewritten when
+     * next saved */
+    *in_sync = (err == 0 && !opts->single);
+
+    return 0;
+}
+
+
+/* Load data points from a text file into a dataset, with options */
+int fileio_load_opts(const char *filename, dataset_td *ds,
+        const fileio_opts_td *opts)
+{
+    fileio_opts_td defaults;
+    dataset_td loaded;
+    int in_sync;
+    int err;
+
+    if (opts == NULL) {
+        fileio_opts_init(&defaults);
+        opts = &defaults;
+    }
+
+    /* Read into a new dataset, so that the current one is kept if
+     * memory runs out */
+    if ((err = s_load_file(filename, opts, &loaded, &in_sync)) != 0) {
+        return err;
+    }
+
+    dataset_destroy(ds);
+    *ds = loaded;
+    ds->is_modified = 0;
+    ds->n_saved = ds->size;
+    ds->saved_id = (in_sync) ? journal_state(filename) : 0;
+
+    return 0;
+}
+
+
+/* Load data points from an open stream into a dataset */
+int fileio_load_stream(FILE *fp, dataset_td *ds,
+        const fileio_opts_td *opts)
+{
+    fileio_opts_td defaults;
+    dataset_td loaded;
+    uint64_t *ends;
+    int err;
+
+    if (opts == NULL) {
+        fileio_opts_init(&defaults);
+        opts = &defaults;
+    }
+
+    /* A pipe is parsed as it comes: the first bytes, read to tell the
+     * compression, are kept by the stream (see stream_open()) */
+    if ((err = s_load_text(fp, opts, &loaded, &ends)) != 0) {
+        return err;
+    }
+    free(ends);
+
+    /* Points of no file, as if entered */
+    dataset_destroy(ds);
+    *ds = loaded;
+    ds->is_modified = (ds->size > 0);
+    ds->n_saved = 0;
+    ds->saved_id = 0;
+
+    return 0;
+}
+
+
+/**
+ * @brief Load files in parallel, each into a dataset of its own
+ *
+ * Threads take the next file not taken yet, so that a few large files
+ * do not keep the others waiting behind them.
+ *
+ * @param arg Pointer to a @e s_load_pool_td
+ *
+ * @return Always @c NULL
+ */
+static void *s_load_worker(void *arg)
+{
+    s_load_pool_td *pool = arg;
+
+    for (;;) {
+        /* A file is taken only to be loaded: every one below
+         * pool->next was, either into its dataset or with an error */
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next;
+        int done = (i >= pool->n || pool->failed);
+        if (!done) {
+            pool->next++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if (done) {
+            break;
+        }
+
+        int in_sync;
+        pool->errs[i] = s_load_file(pool->filenames[i], pool->opts,
+                &pool->parts[i], &in_sync);
+        if (pool->errs[i] != 0) {
+            pthread_mutex_lock(&pool->lock);
+            pool->failed = 1;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Append the points of a loaded file to the merged dataset
+ *
+ * @param ds    Pointer to the merged dataset
+ * @param part  Pointer to the dataset of the file (destroyed here)
+ * @param keyed Non-zero if the merged points have keys
+ * @param tag   Key of every point of the file, or -1 to keep their own
+ *              keys (interned into @p names by their label)
+ * @param names Table of the labels of the merged keys
+ *
+ * @return 0 on success, or 2 on memory allocation failure
+ */
+static int s_append_part(dataset_td *ds, dataset_td *part, int keyed,
+        long tag, s_intern_td *names)
+{
+    data_point_td buf[FILEIO_SAMPLE];
+    char label[FILEIO_NUM_MAX];
+    long *ids = NULL;
+    int err = 0;
+
+    /* Names of the keys of the file, interned once */
+    if (keyed && tag < 0 && part->key_names != NULL) {
+        ids = malloc(part->n_key_names * sizeof(*ids) + 1);
+        err = (ids == NULL);
+        for (size_t k = 0; err == 0 && k < part->n_key_names; ++k) {
+            const char *name = part->key_names[k];
+            ids[k] = s_intern(names, name, strlen(name));
+            err = (ids[k] < 0);
+        }
+    }
+
+    for (size_t i = 0; err == 0 && i < part->size; i += FILEIO_SAMPLE) {
+        size_t len = (part->size - i < FILEIO_SAMPLE)
+            ? part->size - i : FILEIO_SAMPLE;
+        const data_point_td *p = dataset_block(part, i, len, buf);
+
+        for (size_t j = 0; err == 0 && j < len; ++j) {
+            long key = tag;
+
+            if (!keyed) {
+                err = dataset_add(ds, p[j].x, p[j].y, p[j].ey);
+                continue;
+            }
+
+            /* Integer keys (or none, taken as 0) by their text, so
+             * that they merge with the same names in other files */
+            if (tag < 0 && ids != NULL) {
+                key = ids[part->keys[i + j]];
+            } else if (tag < 0) {
+                long value = (part->keys != NULL) ? part->keys[i + j] : 0;
+                int n = snprintf(label, sizeof(label), "%ld", value);
+                key = s_intern(names, label, (size_t) n);
+            }
+            err = (key < 0 || dataset_add_keyed(ds, p[j].x, p[j].y,
+                        p[j].ey, key) != 0);
+        }
+    }
+
+    free(ids);
+    dataset_destroy(part);
+
+    return (err != 0) ? 2 : 0;
+}
+
+
+/**
+ * @brief Name the keys of a merged dataset after its files
+ *
+ * @param ds        Pointer to the merged dataset
+ * @param filenames Files, in order
+ * @param n         Number of files
+ *
+ * @return 0 on success, or 2 on memory allocation failure
+ */
+static int s_name_keys(dataset_td *ds, const char *const *filenames,
+        size_t n)
+{
+    ds->key_names = malloc(n * sizeof(*ds->key_names));
+    if (ds->key_names == NULL) {
+        return 2;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if ((ds->key_names[i] = strdup(filenames[i])) == NULL) {
+            return 2;
+        }
+        ds->n_key_names++;
+    }
+
+    return 0;
+}
+
+
+/* Load data points from several files into a single dataset */
+int fileio_load_many(const char *const *filenames, size_t n,
+        dataset_td *ds, const fileio_opts_td *opts, size_t *failed)
+{
+    fileio_opts_td defaults;
+    s_load_pool_td pool;
+    s_intern_td names = { NULL, 0, 0, NULL, 0 };
+    dataset_td merged;
+    int err = 0;
+
+    if (n == 0) {
+        return 1;
+    }
+    if (opts == NULL) {
+        fileio_opts_init(&defaults);
+        opts = &defaults;
+    }
+
+    pool.filenames = filenames;
+    pool.n = n;
+    pool.opts = opts;
+    pool.parts = malloc(n * sizeof(*pool.parts));
+    pool.errs = calloc(n, sizeof(*pool.errs));
+    pool.next = 0;
+    pool.failed = 0;
+    if (pool.parts == NULL || pool.errs == NULL) {
+        free(pool.parts);
+        free(pool.errs);
+        return 2;
+    }
+
+    /* This thread is a worker too, so every file is loaded even if no
+     * other thread can be started */
+    long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_jobs = (n_cpu > 0) ? (size_t) n_cpu : 1;
+    if (n_jobs > FILEIO_MAX_THREADS) {
+        n_jobs = FILEIO_MAX_THREADS;
+    }
+    if (n_jobs > n) {
+        n_jobs = n;
+    }
+
+    pthread_t threads[FILEIO_MAX_THREADS];
+    int started[FILEIO_MAX_THREADS];
+    pthread_mutex_init(&pool.lock, NULL);
+    for (size_t j = 1; j < n_jobs; ++j) {
+        started[j] = (pthread_create(&threads[j], NULL, s_load_worker,
+                    &pool) == 0);
+    }
+    s_load_worker(&pool);
+    for (size_t j = 1; j < n_jobs; ++j) {
+        if (started[j]) {
+            pthread_join(threads[j], NULL);
+        }
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    /* Room for every point at once, in the widest mode of the files;
+     * once a file failed, those after it may not have been taken */
+    size_t n_taken = pool.next;
+    size_t total = 0;
+    int mode = DATASET_NO_EY | DATASET_SINGLE;
+    int keyed = (opts->tag_files != 0);
+    for (size_t i = 0; i < n_taken; ++i) {
+        if (pool.errs[i] != 0) {
+            if (err == 0 && failed != NULL) {
+                *failed = i;
+            }
+            err = (err != 0) ? err : pool.errs[i];
+            continue;
+        }
+        total += pool.parts[i].size;
+        mode &= pool.parts[i].mode;
+        keyed |= (pool.parts[i].keys != NULL);
+    }
+
+    if (err == 0) {
+        if (opts->mapped ||
+                s_is_out_of_core(total * sizeof(data_point_td))) {
+            dataset_init_mapped(&merged, NULL);
+        } else {
+            dataset_init(&merged);
+        }
+        if (dataset_set_mode(&merged, mode) != 0 ||
+                dataset_reserve(&merged, total) != 0) {
+            err = 2;
+        }
+    }
+
+    /* In file order, freeing every file once it is copied, so that
+     * little more than the merged points is held at once */
+    for (size_t i = 0; i < n_taken; ++i) {
+        if (pool.errs[i] != 0) {
+            continue;
+        }
+        if (err != 0) {
+            dataset_destroy(&pool.parts[i]);
+            continue;
+        }
+        err = s_append_part(&merged, &pool.parts[i], keyed,
+                (opts->tag_files) ? (long) i : -1, &names);
+    }
+    free(pool.parts);
+    free(pool.errs);
+    if (err != 0) {
+        s_intern_free(&names);
+        if (!pool.failed) {
+            dataset_destroy(&merged);
+        }
+        return err;
+    }
+
+    if (opts->tag_files) {
+        err = s_name_keys(&merged, filenames, n);
+    } else if (keyed) {
+        s_intern_to_dataset(&merged, &names);
+    }
+    if (err != 0) {
+        dataset_destroy(&merged);
+        return err;
+    }
+
+    /* The points are not those of any single file */
+    dataset_destroy(ds);
+    *ds = merged;
+    ds->is_modified = 1;
+
+    return 0;
+}
+
+
+/* Load data points from every file matching a pattern */
+int fileio_load_glob(const char *pattern, dataset_td *ds,
+        const fileio_opts_td *opts, size_t *n_files)
+{
+    glob_t g;
+    int err = glob(pattern, 0, NULL, &g);
+
+    if (n_files != NULL) {
+        *n_files = (err == 0) ? g.gl_pathc : 0;
+    }
+    if (err != 0) {
+        return (err == GLOB_NOSPACE) ? 2 : 1;
+    }
+
+    err = fileio_load_many((const char *const *) g.gl_pathv, g.gl_pathc,
+            ds, opts, NULL);
+    globfree(&g);
+
+    return err;
+}
+
+
+/* Get the summaries of the blocks of points of a data file */
+int fileio_summary(const char *filename, const fileio_opts_td *opts,
+        summary_td *sm)
+{
+    fileio_opts_td indexed;
+    dataset_td loaded;
+    int in_sync;
+    int err;
+
+    if (opts == NULL) {
+        fileio_opts_init(&indexed);
+    } else {
+        indexed = *opts;
+    }
+
+    /* Journaled points are not in the index */
+    if (!journal_pending(filename)) {
+        err = summary_read(sm, filename, s_opts_id(&indexed));
+        if (err == 0 || err == 2) {
+            return err;
+        }
+    }
+
+    if ((err = s_load_file(filename, &indexed, &loaded, &in_sync)) != 0) {
+        return err;
+    }
+    err = summary_build(sm, &loaded, loaded.size, NULL, NULL,
+            s_opts_id(&indexed));
+    dataset_destroy(&loaded);
+
+    return err;
+}
+
+
+/**
+ * @brief Tell if a decimal string reads back as a given double
+ *
+ * @param buf Null-terminated decimal string
+ * @param v   Value
+ *
+ * @return Non-zero if @p buf is parsed into exactly @p v
+ */
+static int s_reads_back(const char *buf, double v)
+{
+    double r = strtod(buf, NULL);
+
+    return memcmp(&r, &v, sizeof(v)) == 0;
+}
+
+
+/**
+ * @brief Format a chunk of points as text
+ *
+ * @param arg Pointer to a @e s_save_job_td
+ *
+ * @return Always @c NULL
+ */
+static void *s_save_worker(void *arg)
+{
+    s_save_job_td *job = arg;
+    const dataset_td *ds = job->ds;
+
+    job->len = 0;
+    for (size_t i = job->begin; i < job->end; ++i) {
+        data_point_td p = dataset_get(ds, i);
+        const char *label = NULL;
+        size_t label_len = 0;
+        char kbuf[32];
+
+        if (dataset_has_keys(ds)) {
+            label = dataset_key_label(ds, ds->keys[i], kbuf, sizeof(kbuf));
+            label_len = strlen(label) + 1;
+        }
+
+        /* Room for the longest line */
+        size_t need = 3 * FILEIO_NUM_MAX + label_len + 1;
+        if (job->len + need > job->cap) {
+            size_t cap = 2 * job->cap + need;
+            char *buf = realloc(job->buf, cap);
+            if (buf == NULL) {
+                job->failed = 1;
+                return NULL;
+            }
+            job->buf = buf;
+            job->cap = cap;
+        }
+
+        char *q = job->buf + job->len;
+        q += fileio_format(p.x, q);
+        *q++ = ' ';
+        q += fileio_format(p.y, q);
+        *q++ = ' ';
+        q += fileio_format(p.ey, q);
+        if (label != NULL) {
+            *q++ = ' ';
+            memcpy(q, label, label_len - 1);
+            q += label_len - 1;
+        }
+        *q++ = '\n';
+        job->len = (size_t) (q - job->buf);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Multiply two numbers, rounding the product to 64 bits
+ *
+ * @param x First factor
+ * @param y Second factor
+ *
+ * @return Product, within half a unit of its last place
+ */
+static s_fp_td s_fp_mul(s_fp_td x, s_fp_td y)
+{
+    const uint64_t m32 = 0xffffffffu;
+    uint64_t a = x.f >> 32, b = x.f & m32;
+    uint64_t c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & m32) + (bc & m32) + (1u << 31);
+    s_fp_td r;
+
+    r.f = ac + (ad >> 32) + (bc >> 32) + (mid >> 32);
+    r.e = x.e + y.e + 64;
+
+    return r;
+}
+
+
+/**
+ * @brief Shift a non-zero number until the top bit of its significand
+ *        is set
+ *
+ * @param x Number
+ *
+ * @return Same number, normalized
+ */
+static s_fp_td s_fp_norm(s_fp_td x)
+{
+    while (!(x.f & ((uint64_t) 1 << 63))) {
+        x.f <<= 1;
+        --x.e;
+    }
+
+    return x;
+}
+
+
+/**
+ * @brief Move the last digit of Grisu towards the scaled value, and
+ *        tell if the digits are certainly the right ones
+ *
+ * Distances are in the units of the scaled values, to their upper
+ * bound, which is known to read back as the value.
+ *
+ * @param digits Digits generated
+ * @param n      Number of digits
+ * @param dist   Distance from the scaled value to the upper bound
+ * @param delta  Width of the interval that reads back as the value
+ * @param rest   Distance from the digits to the upper bound
+ * @param ten_k  Value of a unit of the last digit
+ * @param unit   Uncertainty of the scaled values
+ *
+ * @return Non-zero if the digits are the closest to the value that
+ *         read back as it, 0 if that cannot be told
+ */
+static int s_grisu_round(char *digits, int n, uint64_t dist,
+        uint64_t delta, uint64_t rest, uint64_t ten_k, uint64_t unit)
+{
+    uint64_t small = dist - unit;
+    uint64_t big = dist + unit;
+
+    while (rest < small && delta - rest >= ten_k
+            && (rest + ten_k < small
+                || small - rest >= rest + ten_k - small)) {
+        --digits[n - 1];
+        rest += ten_k;
+    }
+    if (rest < big && delta - rest >= ten_k
+            && (rest + ten_k < big || big - rest > rest + ten_k - big)) {
+        return 0;
+    }
+
+    return 2 * unit <= rest && rest <= delta - 4 * unit;
+}
+
+
+/**
+ * @brief Generate the fewest digits within the bounds of a value
+ *
+ * @param lo     Lower bound, scaled
+ * @param w      Value, scaled to a binary exponent within
+ *               [@c FILEIO_ALPHA, @c FILEIO_GAMMA]
+ * @param hi     Upper bound, scaled
+ * @param digits Where to store the digits, at least
+ *               @c FILEIO_MAX_DIGITS + 1 of them
+ * @param n      Where to store the number of digits
+ * @param kappa  Where to store the decimal exponent of the last digit
+ *
+ * @return Non-zero if the digits are certainly the right ones
+ */
+static int s_grisu_digits(s_fp_td lo, s_fp_td w, s_fp_td hi,
+        char *digits, int *n, int *kappa)
+{
+    int shift = -w.e;
+    uint64_t one = (uint64_t) 1 << shift;
+    uint64_t unit = 1;
+    uint64_t top = hi.f + unit;
+    uint64_t delta = top - (lo.f - unit);
+    uint32_t p1 = (uint32_t) (top >> shift);
+    uint64_t p2 = top & (one - 1);
+    uint32_t div = 1;
+
+    *kappa = 1;
+    while (p1 / div >= 10) {
+        div *= 10;
+        ++*kappa;
+    }
+    *n = 0;
+
+    /* Digits of the integer part */
+    while (*kappa > 0) {
+        uint64_t rest;
+
+        digits[(*n)++] = (char) ('0' + p1 / div);
+        p1 %= div;
+        --*kappa;
+        rest = ((uint64_t) p1 << shift) + p2;
+        if (rest < delta) {
+            return s_grisu_round(digits, *n, top - w.f, delta, rest,
+                    (uint64_t) div << shift, unit);
+        }
+        div /= 10;
+    }
+
+    /* Digits of the fractional part */
+    for (;;) {
+        if (*n > FILEIO_MAX_DIGITS) {
+            return 0;
+        }
+        p2 *= 10;
+        unit *= 10;
+        delta *= 10;
+        digits[(*n)++] = (char) ('0' + (p2 >> shift));
+        p2 &= one - 1;
+        --*kappa;
+        if (p2 < delta) {
+            return s_grisu_round(digits, *n, (top - w.f) * unit, delta,
+                    p2, one, unit);
+        }
+    }
+}
+
+
+/**
+ * @brief Get the fewest digits that read back as a value, by Grisu3
+ *
+ * The value and the bounds halfway to its neighbours are scaled by a
+ * cached power of ten, and the digits generated from the upper bound
+ * until they fall within the lower one (Loitsch, "Printing
+ * floating-point numbers quickly and accurately with integers", 2010).
+ *
+ * @param v      Value, finite and positive
+ * @param digits Where to store the digits, at least
+ *               @c FILEIO_MAX_DIGITS + 1 of them
+ * @param n      Where to store the number of digits
+ * @param dexp   Where to store the decimal exponent, such that
+ *               v = digits * 10^dexp
+ *
+ * @return Non-zero on success, or 0 for the few values whose digits
+ *         cannot be told apart with 64 bits
+ */
+static int s_grisu(double v, char *digits, int *n, int *dexp)
+{
+    uint64_t bits;
+    s_fp_td w, lo, hi, c;
+    int be, i, k, kappa, ok;
+
+    memcpy(&bits, &v, sizeof(bits));
+    be = (int) ((bits >> 52) & 0x7ff);
+    w.f = bits & (((uint64_t) 1 << 52) - 1);
+    w.e = (be == 0) ? -1074 : be - 1075;
+    if (be != 0) {
+        w.f |= (uint64_t) 1 << 52;
+    }
+
+    /* Bounds halfway to the neighbours; the lower one is closer on a
+     * power of two, but for the least normal */
+    hi.f = (w.f << 1) + 1;
+    hi.e = w.e - 1;
+    hi = s_fp_norm(hi);
+    if ((bits & (((uint64_t) 1 << 52) - 1)) == 0 && be > 1) {
+        lo.f = (w.f << 2) - 1;
+        lo.e = w.e - 2;
+    } else {
+        lo.f = (w.f << 1) - 1;
+        lo.e = w.e - 1;
+    }
+    lo.f <<= lo.e - hi.e;
+    lo.e = hi.e;
+    w = s_fp_norm(w);
+
+    /* Cached 10^k bringing the exponent within [ALPHA, GAMMA] */
+    k = (int) ceil((FILEIO_ALPHA - w.e - 1) * 0.30102999566398114);
+    i = (k - FILEIO_POW10_MIN - 1) / FILEIO_POW10_STEP + 1;
+    c.f = s_pow10[i].f;
+    c.e = s_pow10[i].e;
+
+    ok = s_grisu_digits(s_fp_mul(lo, c), s_fp_mul(w, c), s_fp_mul(hi, c),
+            digits, n, &kappa);
+    *dexp = kappa - s_pow10[i].k;
+
+    return ok;
+}
+
+
+/**
+ * @brief Get the fewest digits that read back as a value, by trying
+ *        precisions with @a strtod()
+ *
+ * If @e p digits read back, so do @e p+1, so it is searched by halves;
+ * @c FILEIO_MAX_DIGITS always do.
+ *
+ * @param v      Value, finite and positive
+ * @param digits Where to store the digits, at least
+ *               @c FILEIO_MAX_DIGITS of them
+ * @param n      Where to store the number of digits
+ * @param dexp   Where to store the decimal exponent, such that
+ *               v = digits * 10^dexp
+ */
+static void s_shortest(double v, char *digits, int *n, int *dexp)
+{
+    char text[FILEIO_NUM_MAX];
+    const char *p;
+    int lo = 1, hi = FILEIO_MAX_DIGITS;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        snprintf(text, FILEIO_NUM_MAX, "%.*e", mid - 1, v);
+        if (s_reads_back(text, v)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    snprintf(text, FILEIO_NUM_MAX, "%.*e", lo - 1, v);
+
+    *n = 0;
+    for (p = text; *p != 'e'; ++p) {
+        if (*p != '.') {
+            digits[(*n)++] = *p;
+        }
+    }
+    *dexp = atoi(p + 1) - (*n - 1);
+}
+
+
+/* Format a value with the fewest digits that read back exactly */
+size_t fileio_format(double v, char *buf)
+{
+    char digits[FILEIO_MAX_DIGITS + 1];
+    char *q = buf;
+    int n, dexp, point, fixed;
+
+    if (v != v || fabs(v) > DBL_MAX) {
+        return (size_t) snprintf(buf, FILEIO_NUM_MAX, "%g", v);
+    }
+
+    if (signbit(v)) {
+        *q++ = '-';
+        v = -v;
+    }
+    if (v == 0) {
+        digits[0] = '0';
+        n = 1;
+        dexp = 0;
+    } else if (!s_grisu(v, digits, &n, &dexp)) {
+        s_shortest(v, digits, &n, &dexp);
+    }
+    while (n > 1 && digits[n - 1] == '0') {
+        --n;
+        ++dexp;
+    }
+
+    /* Fixed notation where "%g" would use it, and for every integer
+     * below 2^53 divided by up to 17 powers of ten, as most values read
+     * from text are; scientific notation otherwise */
+    point = n + dexp;
+    fixed = (point > -4 && point <= n);
+    if (!fixed && -dexp <= FILEIO_MAX_DECIMALS
+            && point <= FILEIO_MAX_DIGITS - 1) {
+        uint64_t k = 0;
+
+        for (int i = 0; i < point || i < n; ++i) {
+            k = 10 * k + (uint64_t) ((i < n) ? digits[i] - '0' : 0);
+        }
+        fixed = (k < FILEIO_MAX_EXACT);
+    }
+
+    if (!fixed) {
+        *q++ = digits[0];
+        if (n > 1) {
+            *q++ = '.';
+            memcpy(q, digits + 1, (size_t) (n - 1));
+            q += n - 1;
+        }
+        q += snprintf(q, 8, "e%c%02d", (point > 0) ? '+' : '-',
+                abs(point - 1));
+    } else if (point <= 0) {
+        *q++ = '0';
+        *q++ = '.';
+        for (int i = point; i < 0; ++i) {
+            *q++ = '0';
+        }
+        memcpy(q, digits, (size_t) n);
+        q += n;
+    } else {
+        for (int i = 0; i < n || i < point; ++i) {
+            if (i == point) {
+                *q++ = '.';
+            }
+            *q++ = (i < n) ? digits[i] : '0';
+        }
+    }
+    *q = '\0';
+
+    return (size_t) (q - buf);
+}
+
+
+/**
+ * @brief Write every point of a dataset as text
+ *
+ * @param fp   Text file, open for writing
+ * @param ds   Pointer to the dataset
+ * @param ends Where to store the offset one past the last byte of
+ *             every block of @c SUMMARY_BLOCK points, or @c NULL
+ *
+ * @return 0 on success, 1 on write failure, or 2 on memory allocation
+ *         failure
+ */
+static int s_write_text(FILE *fp, const dataset_td *ds, uint64_t *ends)
+{
+    /* One chunk per thread at a time, written out in order */
+    long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_jobs = (n_cpu > 0) ? (size_t) n_cpu : 1;
+    if (n_jobs > FILEIO_MAX_THREADS) {
+        n_jobs = FILEIO_MAX_THREADS;
+    }
+
+    s_save_job_td jobs[FILEIO_MAX_THREADS];
+    pthread_t threads[FILEIO_MAX_THREADS];
+    int started[FILEIO_MAX_THREADS];
+    uint64_t written = 0;
+    int err = 0;
+
+    for (size_t j = 0; j < n_jobs; ++j) {
+        jobs[j].ds = ds;
+        jobs[j].buf = NULL;
+        jobs[j].len = jobs[j].cap = 0;
+        jobs[j].failed = 0;
+    }
+
+    for (size_t i = 0; err == 0 && i < ds->size;
+            i += n_jobs * FILEIO_SAVE_CHUNK) {
+        size_t m = 0;
+
+        for (size_t j = 0; j < n_jobs; ++j) {
+            size_t begin = i + j * FILEIO_SAVE_CHUNK;
+            if (begin >= ds->size) {
+                break;
+            }
+            jobs[j].begin = begin;
+            jobs[j].end = (ds->size - begin < FILEIO_SAVE_CHUNK)
+                ? ds->size : begin + FILEIO_SAVE_CHUNK;
+            m++;
+        }
+
+        /* Chunk 0 is done by this thread, and so is any chunk whose
+         * thread could not be started */
+        for (size_t j = 1; j < m; ++j) {
+            started[j] = (pthread_create(&threads[j], NULL,
+                        s_save_worker, &jobs[j]) == 0);
+        }
+        s_save_worker(&jobs[0]);
+        for (size_t j = 1; j < m; ++j) {
+            if (started[j]) {
+                pthread_join(threads[j], NULL);
+            } else {
+                s_save_worker(&jobs[j]);
+            }
+        }
+
+        for (size_t j = 0; err == 0 && j < m; ++j) {
+            if (jobs[j].failed) {
+                err = 2;
+            } else if (fwrite(jobs[j].buf, 1, jobs[j].len, fp)
+                    != jobs[j].len) {
+                err = 1;
+            } else if (ends != NULL) {
+                written += jobs[j].len;
+                ends[jobs[j].begin / FILEIO_SAVE_CHUNK] = written;
+            }
+        }
+    }
+
+    for (size_t j = 0; j < n_jobs; ++j) {
+        free(jobs[j].buf);
+    }
+
+    return err;
+}
+
+
+/**
+ * @brief Make the contents of a file durable
+ *
+ * @param filename Path to the file
+ *
+ * @return 0 on success, or 1 on failure
+ */
+static int s_sync(const char *filename)
+{
+    int fd = open(filename, O_RDWR);
+    int err;
+
+    if (fd < 0) {
+        return 1;
+    }
+    err = (fsync(fd) != 0);
+    close(fd);
+
+    return err;
+}
+
+
+/**
+ * @brief Tell if the name of a file ends in an extension
+ *
+ * @param filename Name of the file
+ * @param ext      Extension, with its dot
+ *
+ * @return Non-zero if @p filename ends in @p ext (and is not only it)
+ */
+static int s_has_ext(const char *filename, const char *ext)
+{
+    size_t len = strlen(filename);
+    size_t ext_len = strlen(ext);
+
+    return len > ext_len && strcmp(filename + len - ext_len, ext) == 0;
+}
+
+
+/**
+ * @brief Write the index of a file just rewritten
+ *
+ * The file is indexed as it is read with the default options, which
+ * give back the points it was saved with.
+ *
+ * @param filename Path to the file
+ * @param ds       Pointer to the dataset saved
+ * @param ends     Offset one past the last byte of every block of the
+ *                 file (see @a s_write_text()), or @c NULL to remove
+ *                 its index instead
+ */
+static void s_index_saved(const char *filename, const dataset_td *ds,
+        const uint64_t *ends)
+{
+    fileio_opts_td defaults;
+    summary_td sm;
+
+    fileio_opts_init(&defaults);
+    if (ends == NULL || summary_build(&sm, ds, ds->size, filename, ends,
+                s_opts_id(&defaults)) != 0) {
+        summary_remove(filename);
+        return;
+    }
+    if (summary_write(&sm, filename) != 0) {
+        summary_remove(filename);
+    }
+    summary_destroy(&sm);
+}
+
+
+/**
+ * @brief Rewrite a file with every point of a dataset, atomically
+ *
+ * The points are written to a temporary file next to it, which is
+ * synced to disk and then renamed over it, so that a crash leaves
+ * either the old file or the new one, but never a part of it.
+ *
+ * Text files that had an index get a new one (see @a summary_write()),
+ * and any other file loses the one it had.
+ *
+ * @param filename Path to the file
+ * @param ds       Pointer to the dataset
+ *
+ * @return 0 on success, 1 on failure (the file is left as it was), or
+ *         2 on memory allocation failure
+ */
+static int s_rewrite(const char *filename, const dataset_td *ds)
+{
+    size_t len = strlen(filename);
+    char *tmp = malloc(len + sizeof(FILEIO_TMP_SUFFIX));
+    struct stat st;
+    uint64_t *ends = NULL;
+    mode_t mode;
+    int fd, err;
+
+    if (tmp == NULL) {
+        return 2;
+    }
+    snprintf(tmp, len + sizeof(FILEIO_TMP_SUFFIX), "%s%s", filename,
+            FILEIO_TMP_SUFFIX);
+    if ((fd = mkstemp(tmp)) < 0) {
+        free(tmp);
+        return 1;
+    }
+
+    /* Same permissions as the file it replaces, or as a new file */
+    if (stat(filename, &st) == 0) {
+        mode = st.st_mode & 07777;
+    } else {
+        mode = umask(0);
+        umask(mode);
+        mode = 0666 & ~mode;
+    }
+    err = (fchmod(fd, mode) != 0);
+
+    if (s_has_ext(filename, ARCHIVE_EXT)) {
+        close(fd);
+        if (err == 0 && (err = archive_save(tmp, ds)) == 0) {
+            err = s_sync(tmp);
+        }
+    } else if (s_has_ext(filename, ARROW_EXT)) {
+        close(fd);
+        if (err == 0 && (err = arrow_save(tmp, ds)) == 0) {
+            err = s_sync(tmp);
+        }
+    } else {
+        FILE *fp = fdopen(fd, "w");
+        if (fp == NULL) {
+            close(fd);
+            err = 1;
+        } else {
+            if (summary_exists(filename)) {
+                ends = malloc((ds->size / SUMMARY_BLOCK + 1)
+                        * sizeof(*ends));
+            }
+            if (err == 0) {
+                err = s_write_text(fp, ds, ends);
+            }
+            if (err == 0 && (fflush(fp) != 0 || fsync(fd) != 0)) {
+                err = 1;
+            }
+            if (fclose(fp) != 0 && err == 0) {
+                err = 1;
+            }
+        }
+    }
+
+    if (err == 0 && rename(tmp, filename) != 0) {
+        err = 1;
+    }
+    if (err != 0) {
+        unlink(tmp);
+    } else {
+        s_index_saved(filename, ds, ends);
+    }
+    free(ends);
+    free(tmp);
+
+    return err;
+}
+
+
+/* Save dataset points to a text file */
+int fileio_save(const char *filename, dataset_td *ds)
+{
+    /* Only the points added since the file was last loaded or saved,
+     * if it is still as it was then */
+    int in_sync = (ds->saved_id != 0 &&
+            ds->saved_id == journal_state(filename));
+    if (!in_sync || ds->n_saved > ds->size ||
+            journal_append(filename, ds, ds->n_saved) != 0) {
+        /* Journaled points the dataset does not hold are only dropped
+         * once the caller removes them */
+        if (!in_sync && journal_pending(filename)) {
+            return 6;
+        }
+
+        int err = s_rewrite(filename, ds);
+        if (err != 0) {
+            return err;
+        }
 
-    for (size_t i=0; i < ds->size; ++i) {
-        fprintf(fp, "%f %f %f\n",
-                ds->points[i].x, ds->points[i].y, ds->points[i].ey);
+        /* Also makes the rename durable (the directory is synced) */
+        journal_reset(filename, ds->size);
     }
 
-    fclose(fp);
+    ds->n_saved = ds->size;
+    ds->saved_id = journal_state(filename);
     ds->is_modified = 0;
 
     return 0;
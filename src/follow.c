@@ -0,0 +1,231 @@
+/**
+ * @file follow.c
+ *
+ * @brief Implementation of the following of a growing data file
+ */
+
+#define _POSIX_C_SOURCE 200809L /* pread */
+
+
+/* System includes */
+#include <fcntl.h>      /* open, O_RDONLY */
+#include <poll.h>       /* poll, POLLIN */
+#include <stdio.h>      /* sscanf */
+#include <string.h>     /* memchr, memcpy */
+#include <sys/stat.h>   /* fstat */
+#include <unistd.h>     /* close, pread, read */
+#ifdef __linux__
+#include <sys/inotify.h>    /* inotify_add_watch, inotify_init1 */
+#endif  /* __linux__ */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+
+/* Local includes */
+#include <follow.h>
+
+
+/**
+ * @brief Discard the notifications of a watched file
+ *
+ * @param f Pointer to the state of the followed file
+ */
+static void s_drain(const follow_td *f)
+{
+    char buf[4096];
+
+    if (f->watch < 0) {
+        return;
+    }
+    while (read(f->watch, buf, sizeof(buf)) > 0) {
+        continue;
+    }
+}
+
+
+/**
+ * @brief Add the point of a complete line, if it has one
+ *
+ * @param f  Pointer to the state of the followed file, whose @e line
+ *           is null-terminated
+ * @param ds Pointer to the dataset where the point is added
+ *
+ * @return 0 on success (or if the line has no point), or 2 on memory
+ *         allocation failure
+ */
+static int s_add_line(follow_td *f, dataset_td *ds)
+{
+    double x, y, ey = 0.0;
+    int n = sscanf(f->line, "%lf %lf %lf", &x, &y, &ey);
+
+    if (n < 2) {
+        return 0;
+    }
+    if (n == 2) {
+        ey = 0.0;
+    }
+    if (dataset_add(ds, x, y, ey) != 0) {
+        return 2;
+    }
+
+    /* Sums about the first point, so that a large offset of the data
+     * does not cancel digits */
+    if (f->plain.n == 0) {
+        moments_init(&f->plain, x, y, 0);
+        moments_init(&f->weighted, x, y, 1);
+    }
+    moments_add(&f->plain, x, y, ey);
+    moments_add(&f->weighted, x, y, ey);
+    if (ey > 0.0) {
+        f->use_weights = 1;
+    }
+
+    return 0;
+}
+
+
+/* Start following a data file */
+int follow_open(follow_td *f, const char *filename)
+{
+    f->offset = 0;
+    f->pending = 0;
+    f->line_len = 0;
+    f->line_long = 0;
+    f->use_weights = 0;
+    moments_init(&f->plain, 0.0, 0.0, 0);
+    moments_init(&f->weighted, 0.0, 0.0, 1);
+
+    if ((f->fd = open(filename, O_RDONLY)) < 0) {
+        return 1;
+    }
+
+    f->watch = -1;
+#ifdef __linux__
+    f->watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (f->watch >= 0 && inotify_add_watch(f->watch, filename,
+                IN_MODIFY | IN_ATTRIB) < 0) {
+        close(f->watch);
+        f->watch = -1;
+    }
+#endif  /* __linux__ */
+
+    return 0;
+}
+
+
+/* Read what was appended to a followed file */
+int follow_read(follow_td *f, dataset_td *ds)
+{
+    char buf[FOLLOW_READ_SIZE];
+    struct stat st;
+    size_t total = 0;
+
+    s_drain(f);
+    if (fstat(f->fd, &st) != 0) {
+        return 1;
+    }
+
+    /* A file that shrank holds other points: they are read again from
+     * its start, into new sums, once the caller empties the dataset */
+    if (st.st_size < f->offset) {
+        f->offset = 0;
+        f->pending = 0;
+        f->line_len = 0;
+        f->line_long = 0;
+        f->use_weights = 0;
+        moments_init(&f->plain, 0.0, 0.0, 0);
+        moments_init(&f->weighted, 0.0, 0.0, 1);
+        return 3;
+    }
+
+    f->pending = 0;
+    while (total < FOLLOW_BATCH) {
+        ssize_t n = pread(f->fd, buf, sizeof(buf), f->offset);
+        if (n < 0) {
+            return 1;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        f->offset += n;
+        total += (size_t) n;
+
+        /* Line by line, carrying the unfinished one over */
+        const char *p = buf;
+        const char *end = buf + n;
+        while (p < end) {
+            const char *nl = memchr(p, '\n', (size_t) (end - p));
+            size_t len = (size_t) (((nl != NULL) ? nl : end) - p);
+
+            if (f->line_len + len < sizeof(f->line)) {
+                memcpy(f->line + f->line_len, p, len);
+                f->line_len += len;
+            } else {
+                f->line_long = 1;
+            }
+            if (nl == NULL) {
+                break;
+            }
+
+            f->line[f->line_len] = '\0';
+            if (!f->line_long && s_add_line(f, ds) != 0) {
+                return 2;
+            }
+            f->line_len = 0;
+            f->line_long = 0;
+            p = nl + 1;
+        }
+    }
+    f->pending = 1;
+
+    return 0;
+}
+
+
+/* Wait until a followed file is written, or for another input */
+int follow_wait(const follow_td *f, int fd, int timeout_ms)
+{
+    struct pollfd fds[2];
+    nfds_t n = 0;
+
+    if (fd >= 0) {
+        fds[n].fd = fd;
+        fds[n].events = POLLIN;
+        n++;
+    }
+    if (f->watch >= 0) {
+        fds[n].fd = f->watch;
+        fds[n].events = POLLIN;
+        n++;
+    } else if (timeout_ms < 0 || timeout_ms > FOLLOW_POLL_MS) {
+        timeout_ms = FOLLOW_POLL_MS;
+    }
+
+    if (poll(fds, n, timeout_ms) <= 0) {
+        return 0;
+    }
+
+    return (fd >= 0 && (fds[0].revents & POLLIN) != 0);
+}
+
+
+/* Get the running moment sums of a followed file */
+const moments_td *follow_moments(const follow_td *f)
+{
+    return (f->use_weights) ? &f->weighted : &f->plain;
+}
+
+
+/* Stop following a data file */
+void follow_close(follow_td *f)
+{
+    if (f->watch >= 0) {
+        close(f->watch);
+        f->watch = -1;
+    }
+    if (f->fd >= 0) {
+        close(f->fd);
+        f->fd = -1;
+    }
+}
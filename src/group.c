@@ -0,0 +1,282 @@
+/**
+ * @file group.c
+ *
+ * @brief Implementation of grouped (per key) regression
+ */
+
+#define _POSIX_C_SOURCE 200809L /* sysconf */
+
+
+/* System includes */
+#include <pthread.h>    /* pthread_create, pthread_join */
+#include <stdint.h>     /* uint64_t */
+#include <stdlib.h>     /* calloc, free, malloc, qsort */
+#include <unistd.h>     /* sysconf */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+/* Local includes */
+#include <group.h>
+
+
+/**
+ * @brief Slot of the table of groups
+ */
+typedef struct {
+    long key;               /**< Group key */
+    int used;               /**< Non-zero if the slot holds a group */
+    int has_err;            /**< Non-zero if any point has 'ey' > 0 */
+    moments_td plain;       /**< Unweighted sums of the group */
+    moments_td weighted;    /**< Sums weighted by 1/ey^2 */
+} s_group_slot_td;
+
+
+/**
+ * @brief Open-addressing (linear probing) hash table of groups
+ */
+typedef struct {
+    s_group_slot_td *slots; /**< Slots (power of two) */
+    size_t n_slots;         /**< Number of slots */
+    size_t n_used;          /**< Number of groups stored */
+    double x0;              /**< Origin of the sums of every group */
+    double y0;              /**< Origin of the sums of every group */
+} s_group_table_td;
+
+
+/**
+ * @brief Work of a thread: accumulate a chunk of points into a table
+ */
+typedef struct {
+    const dataset_td *ds;   /**< Dataset to read */
+    size_t begin;           /**< First point of the chunk */
+    size_t end;             /**< One past the last point of the chunk */
+    s_group_table_td table; /**< Table of the chunk */
+    int failed;             /**< Non-zero on memory allocation failure */
+} s_group_job_td;
+
+
+/**
+ * @brief Mix the bits of a key (SplitMix64 finalizer)
+ *
+ * @param key Key to hash
+ *
+ * @return Hash of the key
+ */
+static uint64_t s_hash_key(long key)
+{
+    uint64_t h = (uint64_t) key;
+
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+
+    return h;
+}
+
+
+/**
+ * @brief Find the slot of a key, inserting an empty group if needed
+ *
+ * @param t   Pointer to the table
+ * @param key Group key
+ *
+ * @return Pointer to the slot of the group, or @c NULL on memory
+ *         allocation failure
+ */
+static s_group_slot_td *s_table_get(s_group_table_td *t, long key)
+{
+    /* Keep the load factor under 1/2 */
+    if (2 * (t->n_used + 1) > t->n_slots) {
+        size_t n_slots = (t->n_slots) ? 2 * t->n_slots : 64;
+        s_group_slot_td *slots = calloc(n_slots, sizeof(*slots));
+        if (slots == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < t->n_slots; ++i) {
+            if (t->slots[i].used) {
+                size_t j = s_hash_key(t->slots[i].key) & (n_slots - 1);
+                while (slots[j].used) {
+                    j = (j + 1) & (n_slots - 1);
+                }
+                slots[j] = t->slots[i];
+            }
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->n_slots = n_slots;
+    }
+
+    size_t j = s_hash_key(key) & (t->n_slots - 1);
+    while (t->slots[j].used) {
+        if (t->slots[j].key == key) {
+            return &t->slots[j];
+        }
+        j = (j + 1) & (t->n_slots - 1);
+    }
+
+    s_group_slot_td *slot = &t->slots[j];
+    slot->key = key;
+    slot->used = 1;
+    slot->has_err = 0;
+    moments_init(&slot->plain, t->x0, t->y0, 0);
+    moments_init(&slot->weighted, t->x0, t->y0, 1);
+    t->n_used++;
+
+    return slot;
+}
+
+
+/**
+ * @brief Accumulate a chunk of points into the table of the job
+ *
+ * @param arg Pointer to a @e s_group_job_td
+ *
+ * @return Always @c NULL
+ */
+static void *s_group_worker(void *arg)
+{
+    s_group_job_td *job = arg;
+    const dataset_td *ds = job->ds;
+
+    for (size_t i = job->begin; i < job->end; ++i) {
+        s_group_slot_td *slot = s_table_get(&job->table, ds->keys[i]);
+        data_point_td p = dataset_get(ds, i);
+
+        if (slot == NULL) {
+            job->failed = 1;
+            break;
+        }
+        moments_add(&slot->plain, p.x, p.y, p.ey);
+        moments_add(&slot->weighted, p.x, p.y, p.ey);
+        slot->has_err |= (p.ey > 0.0);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Compare two group fits by key, for @a qsort()
+ *
+ * @param a Pointer to the first @e group_fit_td
+ * @param b Pointer to the second @e group_fit_td
+ *
+ * @return Negative, zero or positive, as required by @a qsort()
+ */
+static int s_group_fit_cmp(const void *a, const void *b)
+{
+    long ka = ((const group_fit_td *) a)->key;
+    long kb = ((const group_fit_td *) b)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+
+/* Fit a straight line to the points of every group */
+int group_fit(const dataset_td *ds, group_fit_td **fits, size_t *n_fits)
+{
+    size_t n = ds->size;
+
+    if (!dataset_has_keys(ds)) {
+        return 1;
+    }
+
+    /* One chunk per thread, but never chunks too small to pay off */
+    long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_jobs = (n_cpu > 0) ? (size_t) n_cpu : 1;
+    if (n_jobs > GROUP_MAX_THREADS) {
+        n_jobs = GROUP_MAX_THREADS;
+    }
+    if (n_jobs > n / GROUP_MIN_CHUNK) {
+        n_jobs = (n / GROUP_MIN_CHUNK > 0) ? n / GROUP_MIN_CHUNK : 1;
+    }
+
+    s_group_job_td jobs[GROUP_MAX_THREADS];
+    pthread_t threads[GROUP_MAX_THREADS];
+    int started[GROUP_MAX_THREADS];
+    double x0 = (n > 0) ? dataset_get(ds, 0).x : 0.0;
+    double y0 = (n > 0) ? dataset_get(ds, 0).y : 0.0;
+
+    for (size_t j = 0; j < n_jobs; ++j) {
+        jobs[j].ds = ds;
+        jobs[j].begin = j * n / n_jobs;
+        jobs[j].end = (j + 1) * n / n_jobs;
+        jobs[j].table.slots = NULL;
+        jobs[j].table.n_slots = jobs[j].table.n_used = 0;
+        jobs[j].table.x0 = x0;
+        jobs[j].table.y0 = y0;
+        jobs[j].failed = 0;
+    }
+
+    /* Chunk 0 is done by this thread, and so is any chunk whose thread
+     * could not be started */
+    for (size_t j = 1; j < n_jobs; ++j) {
+        started[j] = (pthread_create(&threads[j], NULL, s_group_worker,
+                    &jobs[j]) == 0);
+    }
+    s_group_worker(&jobs[0]);
+    for (size_t j = 1; j < n_jobs; ++j) {
+        if (started[j]) {
+            pthread_join(threads[j], NULL);
+        } else {
+            s_group_worker(&jobs[j]);
+        }
+    }
+
+    /* Merge every table into the first one */
+    s_group_table_td *table = &jobs[0].table;
+    int failed = jobs[0].failed;
+    for (size_t j = 1; j < n_jobs; ++j) {
+        s_group_table_td *t = &jobs[j].table;
+
+        failed |= jobs[j].failed;
+        for (size_t i = 0; !failed && i < t->n_slots; ++i) {
+            if (t->slots[i].used) {
+                s_group_slot_td *slot = s_table_get(table, t->slots[i].key);
+                if (slot == NULL) {
+                    failed = 1;
+                    break;
+                }
+                moments_merge(&slot->plain, &t->slots[i].plain);
+                moments_merge(&slot->weighted, &t->slots[i].weighted);
+                slot->has_err |= t->slots[i].has_err;
+            }
+        }
+        free(t->slots);
+    }
+
+    group_fit_td *out = NULL;
+    if (!failed) {
+        out = malloc((table->n_used + 1) * sizeof(*out));
+        failed = (out == NULL);
+    }
+    if (failed) {
+        free(table->slots);
+        return 2;
+    }
+
+    size_t k = 0;
+    for (size_t i = 0; i < table->n_slots; ++i) {
+        const s_group_slot_td *slot = &table->slots[i];
+        if (slot->used) {
+            const moments_td *m = (slot->has_err) ? &slot->weighted
+                : &slot->plain;
+            out[k].key = slot->key;
+            out[k].n = m->n;
+            out[k].reg = regres_from_moments(m);
+            k++;
+        }
+    }
+    free(table->slots);
+    qsort(out, k, sizeof(*out), s_group_fit_cmp);
+
+    *fits = out;
+    *n_fits = k;
+
+    return 0;
+}
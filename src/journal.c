@@ -0,0 +1,607 @@
+/**
+ * @file journal.c
+ *
+ * @brief Implementation of the append-only journal of a saved dataset
+ */
+
+#define _POSIX_C_SOURCE 200809L /* fsync, ftruncate, pread, truncate */
+
+
+/* System includes */
+#include <errno.h>      /* errno, ENOENT */
+#include <fcntl.h>      /* open, O_CREAT, O_RDWR, O_RDONLY */
+#include <stdio.h>      /* fclose, fopen, fread, snprintf */
+#include <stdlib.h>     /* free, malloc, realloc, strtol */
+#include <string.h>     /* memcmp, memcpy, strcmp, strcpy, ... */
+#include <sys/stat.h>   /* fstat, stat */
+#include <unistd.h>     /* close, fsync, ftruncate, lseek, pread, ... */
+
+/* Project includes */
+#include <dataset.h>
+
+/* Local includes */
+#include <journal.h>
+
+
+#define S_HEADER_SIZE (40)      /**< Bytes of the header */
+#define S_RECORD_SIZE (36)      /**< Bytes of a record, without its key */
+#define S_MAX_LABEL (65535)     /**< Longest key a record can hold */
+#define S_BUF_SIZE (65536)      /**< Bytes of records written at once */
+#define S_TAIL_SIZE (65536)     /**< Bytes at the end of a file hashed to
+                                     tell its contents apart */
+
+#define S_OP_ADD (1)            /**< Record of a point added */
+#define S_HAS_KEY (1u)          /**< Flag: the record carries a key */
+
+
+/*
+ * Layout of a journal (integers are little endian):
+ *
+ *   - header, S_HEADER_SIZE bytes:
+ *       0 magic, 8 size of the file the journal was started for, 16
+ *       checksum of its last S_TAIL_SIZE bytes, 24 points in that
+ *       file, 32 checksum of the header (of its first 32 bytes)
+ *   - records, one per point added:
+ *       0 operation, 1 flags, 2 length of the key, 4 x, 12 y, 20 ey,
+ *       28 key, and the checksum of all of the above
+ */
+
+
+/**
+ * @brief Checksum of a range of bytes (FNV-1a)
+ *
+ * @param h   Checksum of the bytes before, or the FNV offset basis
+ * @param p   Bytes to hash
+ * @param len Number of bytes
+ *
+ * @return Checksum of the bytes
+ */
+static uint64_t s_checksum(uint64_t h, const unsigned char *p, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Store an integer of @p n bytes, little endian
+ *
+ * @param p Where to store it
+ * @param v Value to store
+ * @param n Number of bytes
+ */
+static void s_put_le(unsigned char *p, uint64_t v, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+
+/**
+ * @brief Read an integer of @p n bytes, little endian
+ *
+ * @param p Where to read it from
+ * @param n Number of bytes
+ *
+ * @return Value read
+ */
+static uint64_t s_get_le(const unsigned char *p, int n)
+{
+    uint64_t v = 0;
+
+    for (int i = n - 1; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+
+/**
+ * @brief Mix what tells a file apart into a checksum
+ *
+ * @param h  Checksum so far
+ * @param st Status of the file
+ *
+ * @return Checksum with the device, inode, size and modification time
+ *         of the file
+ */
+static uint64_t s_mix_stat(uint64_t h, const struct stat *st)
+{
+    uint64_t f[5];
+
+    f[0] = (uint64_t) st->st_dev;
+    f[1] = (uint64_t) st->st_ino;
+    f[2] = (uint64_t) st->st_size;
+    f[3] = (uint64_t) st->st_mtim.tv_sec;
+    f[4] = (uint64_t) st->st_mtim.tv_nsec;
+
+    return s_checksum(h, (const unsigned char *) f, sizeof(f));
+}
+
+
+/**
+ * @brief Get the signature of the contents of a file, which its journal
+ *        is started for
+ *
+ * The signature is made of the size of the file and the checksum of its
+ * last bytes, not of where the file is: a copy of the file, or the file
+ * touched, has the same one, and keeps its journal.
+ *
+ * @param filename Path to the file
+ * @param sig      Where to store the signature: size and checksum
+ *
+ * @return 0 on success, or 1 if the file cannot be read
+ */
+static int s_file_sig(const char *filename, uint64_t sig[2])
+{
+    unsigned char buf[S_TAIL_SIZE];
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    int err = 1;
+
+    if (fd < 0) {
+        return 1;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size >= 0) {
+        off_t at = (st.st_size > S_TAIL_SIZE) ? st.st_size - S_TAIL_SIZE
+            : 0;
+        size_t len = (size_t) (st.st_size - at);
+
+        if (pread(fd, buf, len, at) == (ssize_t) len) {
+            sig[0] = (uint64_t) st.st_size;
+            sig[1] = s_checksum(14695981039346656037ULL, buf, len);
+            err = 0;
+        }
+    }
+    close(fd);
+
+    return err;
+}
+
+
+/**
+ * @brief Get the path of the journal of a file
+ *
+ * @param filename Path to the file
+ *
+ * @return Path of the journal (to be freed), or @c NULL on memory
+ *         allocation failure
+ */
+static char *s_path(const char *filename)
+{
+    size_t len = strlen(filename) + strlen(JOURNAL_EXT) + 1;
+    char *path = malloc(len);
+
+    if (path != NULL) {
+        snprintf(path, len, "%s%s", filename, JOURNAL_EXT);
+    }
+
+    return path;
+}
+
+
+/**
+ * @brief Make the entries of the directory of a file durable
+ *
+ * @param filename Path to the file
+ */
+static void s_sync_dir(const char *filename)
+{
+    char *dir = malloc(strlen(filename) + 2);
+    char *slash;
+    int fd;
+
+    if (dir == NULL) {
+        return;
+    }
+    strcpy(dir, filename);
+    if ((slash = strrchr(dir, '/')) == NULL) {
+        strcpy(dir, ".");
+    } else {
+        slash[slash == dir] = '\0';
+    }
+
+    if ((fd = open(dir, O_RDONLY)) >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+
+/**
+ * @brief Write a whole buffer to a file
+ *
+ * @param fd  Descriptor of the file
+ * @param p   Bytes to write
+ * @param len Number of bytes
+ *
+ * @return 0 on success, or 1 on failure
+ */
+static int s_write_all(int fd, const unsigned char *p, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) {
+            return 1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Build the header of a journal
+ *
+ * @param h        Where to store the header, @c S_HEADER_SIZE bytes
+ * @param sig      Signature of the file the journal is started for
+ * @param n_points Points in that file
+ */
+static void s_header(unsigned char *h, const uint64_t sig[2],
+        size_t n_points)
+{
+    memcpy(h, JOURNAL_MAGIC, 8);
+    s_put_le(h + 8, sig[0], 8);
+    s_put_le(h + 16, sig[1], 8);
+    s_put_le(h + 24, n_points, 8);
+    s_put_le(h + 32, s_checksum(14695981039346656037ULL, h, 32), 8);
+}
+
+
+/**
+ * @brief Check the header of a journal against its file
+ *
+ * @param h        Header, @c S_HEADER_SIZE bytes
+ * @param sig      Signature of the file as it is now
+ * @param n_points Where to store the points in the file
+ *
+ * @return 1 if the journal is valid and was started for the contents
+ *         the file has now, or 0 otherwise
+ */
+static int s_check_header(const unsigned char *h, const uint64_t sig[2],
+        size_t *n_points)
+{
+    if (memcmp(h, JOURNAL_MAGIC, 8) != 0 ||
+            s_checksum(14695981039346656037ULL, h, 32)
+                != s_get_le(h + 32, 8) ||
+            s_get_le(h + 8, 8) != sig[0] ||
+            s_get_le(h + 16, 8) != sig[1]) {
+        return 0;
+    }
+    *n_points = (size_t) s_get_le(h + 24, 8);
+
+    return 1;
+}
+
+
+/**
+ * @brief Tell if a journal holds records, whatever file it was written
+ *        for
+ *
+ * @param path Path to the journal
+ *
+ * @return 1 if the journal is longer than its header, or 0 otherwise
+ *         (or if there is none)
+ */
+static int s_has_records(const char *path)
+{
+    struct stat st;
+
+    return stat(path, &st) == 0 && st.st_size > S_HEADER_SIZE;
+}
+
+
+/**
+ * @brief Find (or add) the id of a key name of a dataset
+ *
+ * @param ds    Pointer to the dataset, with key names
+ * @param label Name of the key
+ *
+ * @return Id of the name, or -1 on memory allocation failure
+ */
+static long s_key_id(dataset_td *ds, const char *label)
+{
+    for (size_t i = 0; i < ds->n_key_names; ++i) {
+        if (strcmp(ds->key_names[i], label) == 0) {
+            return (long) i;
+        }
+    }
+
+    char **names = realloc(ds->key_names,
+            (ds->n_key_names + 1) * sizeof(*names));
+    if (names == NULL) {
+        return -1;
+    }
+    ds->key_names = names;
+    if ((names[ds->n_key_names] = malloc(strlen(label) + 1)) == NULL) {
+        return -1;
+    }
+    strcpy(names[ds->n_key_names], label);
+
+    return (long) ds->n_key_names++;
+}
+
+
+/* Get the state of a file together with its journal */
+uint64_t journal_state(const char *filename)
+{
+    char *path = s_path(filename);
+    struct stat st;
+    uint64_t h;
+
+    if (path == NULL || stat(filename, &st) != 0) {
+        free(path);
+        return 0;
+    }
+    h = s_mix_stat(14695981039346656037ULL, &st);
+    if (stat(path, &st) == 0) {
+        h = s_mix_stat(h, &st);
+    }
+    free(path);
+
+    return (h != 0) ? h : 1;
+}
+
+
+/* Append points of a dataset to the journal of a file */
+int journal_append(const char *filename, const dataset_td *ds,
+        size_t begin)
+{
+    unsigned char buf[S_BUF_SIZE];
+    uint64_t sig[2];
+    char *path = s_path(filename);
+    struct stat st;
+    size_t n_base;
+    int fd;
+
+    if (path == NULL || s_file_sig(filename, sig) != 0) {
+        free(path);
+        return 1;
+    }
+    fd = open(path, O_RDWR | O_CREAT, 0666);
+    free(path);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    /* A new journal starts at 'begin': the file holds the points
+     * before it */
+    off_t end = st.st_size;
+    if (end == 0) {
+        n_base = begin;
+    } else if (end < S_HEADER_SIZE ||
+            pread(fd, buf, S_HEADER_SIZE, 0) != S_HEADER_SIZE ||
+            !s_check_header(buf, sig, &n_base)) {
+        close(fd);
+        return 1;
+    }
+
+    /* Too many points journaled: the file is better rewritten */
+    size_t n_journal = ds->size - n_base;
+    int err = (begin < n_base || (n_journal > JOURNAL_MIN_POINTS &&
+                n_journal > n_base / JOURNAL_RATIO));
+
+    size_t len = 0;
+    if (err == 0 && end == 0) {
+        s_header(buf, sig, n_base);
+        len = S_HEADER_SIZE;
+    } else if (err == 0) {
+        err = (lseek(fd, 0, SEEK_END) < 0);
+    }
+    for (size_t i = begin; err == 0 && i < ds->size; ++i) {
+        data_point_td p = dataset_get(ds, i);
+        const char *label = "";
+        char kbuf[32];
+        size_t label_len = 0;
+
+        if (dataset_has_keys(ds)) {
+            label = dataset_key_label(ds, ds->keys[i], kbuf, sizeof(kbuf));
+            label_len = strlen(label);
+        }
+        if (label_len > S_MAX_LABEL) {
+            err = 1;
+            break;
+        }
+        if (len + S_RECORD_SIZE + label_len > sizeof(buf)) {
+            err = s_write_all(fd, buf, len);
+            len = 0;
+        }
+        if (S_RECORD_SIZE + label_len > sizeof(buf)) {
+            err = 1;
+        }
+        if (err != 0) {
+            break;
+        }
+
+        unsigned char *r = buf + len;
+        uint64_t u[3];
+        memcpy(&u[0], &p.x, sizeof(p.x));
+        memcpy(&u[1], &p.y, sizeof(p.y));
+        memcpy(&u[2], &p.ey, sizeof(p.ey));
+
+        r[0] = S_OP_ADD;
+        r[1] = dataset_has_keys(ds) ? S_HAS_KEY : 0;
+        s_put_le(r + 2, label_len, 2);
+        s_put_le(r + 4, u[0], 8);
+        s_put_le(r + 12, u[1], 8);
+        s_put_le(r + 20, u[2], 8);
+        memcpy(r + 28, label, label_len);
+        s_put_le(r + 28 + label_len,
+                s_checksum(14695981039346656037ULL, r, 28 + label_len), 8);
+        len += S_RECORD_SIZE + label_len;
+    }
+    if (err == 0) {
+        err = s_write_all(fd, buf, len);
+    }
+    if (err == 0) {
+        err = (fsync(fd) != 0);
+    }
+
+    /* Leave the journal as it was, so that no torn record is left */
+    if (err != 0 && ftruncate(fd, end) != 0) {
+        err = 1;
+    }
+    close(fd);
+    if (err == 0 && end == 0) {
+        s_sync_dir(filename);
+    }
+
+    return err;
+}
+
+
+/* Add the points journaled for a file to a dataset */
+int journal_replay(const char *filename, dataset_td *ds)
+{
+    unsigned char r[S_RECORD_SIZE + S_MAX_LABEL];
+    uint64_t sig[2];
+    char *path = s_path(filename);
+    size_t n_base;
+    FILE *fp;
+
+    if (path == NULL) {
+        return 2;
+    }
+    if (s_file_sig(filename, sig) != 0 ||
+            (fp = fopen(path, "rb")) == NULL) {
+        free(path);
+        return 0;
+    }
+    if (fread(r, 1, S_HEADER_SIZE, fp) != S_HEADER_SIZE ||
+            !s_check_header(r, sig, &n_base)) {
+        /* Not for the contents of this file (it was changed, or the
+         * journal is of another format): its points are kept, and the
+         * caller is told if there are any */
+        int stale = s_has_records(path);
+        fclose(fp);
+        free(path);
+        return (stale) ? 3 : 0;
+    }
+    if (n_base != ds->size) {
+        fclose(fp);
+        free(path);
+        return 1;
+    }
+
+    long good = S_HEADER_SIZE;
+    int err = 0;
+    while (err == 0 && fread(r, 1, 4, fp) == 4) {
+        size_t label_len = (size_t) s_get_le(r + 2, 2);
+        size_t rest = S_RECORD_SIZE - 4 + label_len;
+
+        if (r[0] != S_OP_ADD || fread(r + 4, 1, rest, fp) != rest ||
+                s_checksum(14695981039346656037ULL, r, 28 + label_len)
+                    != s_get_le(r + 28 + label_len, 8)) {
+            break;
+        }
+
+        data_point_td p;
+        uint64_t u[3] = {
+            s_get_le(r + 4, 8), s_get_le(r + 12, 8), s_get_le(r + 20, 8)
+        };
+        memcpy(&p.x, &u[0], sizeof(p.x));
+        memcpy(&p.y, &u[1], sizeof(p.y));
+        memcpy(&p.ey, &u[2], sizeof(p.ey));
+
+        if ((r[1] & S_HAS_KEY) && ds->keys != NULL) {
+            char label[S_MAX_LABEL + 1];
+            long key;
+
+            memcpy(label, r + 28, label_len);
+            label[label_len] = '\0';
+            key = (ds->key_names != NULL) ? s_key_id(ds, label)
+                : strtol(label, NULL, 10);
+            err = (key < 0 && ds->key_names != NULL)
+                || dataset_add_keyed(ds, p.x, p.y, p.ey, key) != 0;
+        } else {
+            err = (dataset_add(ds, p.x, p.y, p.ey) != 0);
+        }
+        good += (long) (S_RECORD_SIZE + label_len);
+    }
+    fclose(fp);
+
+    /* Cut off a torn or corrupted tail, or appends would follow it */
+    if (err == 0) {
+        struct stat st;
+        if (stat(path, &st) == 0 && st.st_size > good &&
+                truncate(path, good) != 0) {
+            err = 1;
+        }
+    } else {
+        err = 2;
+    }
+    free(path);
+
+    return err;
+}
+
+
+/* Tell if a file has points journaled since it was last rewritten */
+int journal_pending(const char *filename)
+{
+    char *path = s_path(filename);
+    int pending = (path != NULL && s_has_records(path));
+
+    free(path);
+
+    return pending;
+}
+
+
+/* Start a new, empty journal for a file */
+int journal_reset(const char *filename, size_t n_points)
+{
+    unsigned char h[S_HEADER_SIZE];
+    uint64_t sig[2];
+    char *path = s_path(filename);
+    int fd, err;
+
+    if (path == NULL || s_file_sig(filename, sig) != 0) {
+        free(path);
+        return 1;
+    }
+    unlink(path);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    free(path);
+    if (fd < 0) {
+        return 1;
+    }
+
+    s_header(h, sig, n_points);
+    err = s_write_all(fd, h, S_HEADER_SIZE) != 0 || fsync(fd) != 0;
+    close(fd);
+    s_sync_dir(filename);
+
+    return err;
+}
+
+
+/* Remove the journal of a file, with the points it holds */
+int journal_remove(const char *filename)
+{
+    char *path = s_path(filename);
+    int err;
+
+    if (path == NULL) {
+        return 1;
+    }
+    err = (unlink(path) != 0 && errno != ENOENT);
+    free(path);
+    if (err == 0) {
+        s_sync_dir(filename);
+    }
+
+    return err;
+}
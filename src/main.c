@@ -5,7 +5,9 @@
  *
  * Given a dataset of points, perform statistical analysis and linear
  * regression.  Data can be load & saved, and plot by using @c gnuplot
- * on a menu-driven @c ncurses interface.
+ * on a menu-driven @c ncurses interface.  Given a command instead
+ * (e.g., @e "regres fit FILE"), the results are written to the standard
+ * output, without the interface (see @a cli_run()).
  *
  * @author J. A. Corbal <jacorbal@gmail.com>
  * @version 4.1.2
@@ -20,12 +22,17 @@
 #include <stdio.h>      /* fprintf */
 
 /* Project includes */
+#include <cli.h>
 #include <tui.h>
 
 
 /* Main entry */
-int main(void)
+int main(int argc, char *argv[])
 {
+    if (argc > 1) {
+        return cli_run(argc, argv);
+    }
+
     if (tui_start() != 0) {
         fprintf(stderr, "Cannot open TUI for Regres\n");
         return 1;
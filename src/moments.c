@@ -0,0 +1,228 @@
+/**
+ * @file moments.c
+ *
+ * @brief Implementation of moment sums used to build least squares fits
+ */
+
+/* Local includes */
+#include <moments.h>
+
+
+/* Initialize an empty set of moment sums */
+void moments_init(moments_td *m, double x0, double y0, int weighted)
+{
+    m->x0 = x0;
+    m->y0 = y0;
+    m->s = m->sx = m->sy = 0.0;
+    m->sxx = m->sxy = m->syy = 0.0;
+    m->n = 0;
+    m->weighted = weighted;
+}
+
+
+/* Add a single point to the moment sums */
+void moments_add(moments_td *m, double x, double y, double ey)
+{
+    double w = (!m->weighted) ? 1.0 : (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+    double u = x - m->x0;
+    double v = y - m->y0;
+
+    m->s   += w;
+    m->sx  += w * u;
+    m->sy  += w * v;
+    m->sxx += w * u * u;
+    m->sxy += w * u * v;
+    m->syy += w * v * v;
+    m->n++;
+}
+
+
+/* Accumulate a range of dataset points into the moment sums */
+void moments_accumulate(moments_td *m, const dataset_td *ds,
+        size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i) {
+        data_point_td p = dataset_get(ds, i);
+        moments_add(m, p.x, p.y, p.ey);
+    }
+}
+
+
+/**
+ * @brief Accumulate a block of up to 64 points of a slice
+ *
+ * The terms of every point are computed first, with selects rather
+ * than branches for the points left out (so that their values, maybe
+ * NaN, do not reach the sums), then added keeping @c SLICE_LANES
+ * partial sums; both loops vectorize, which a single running sum does
+ * not allow under strict floating point semantics.
+ *
+ * @param m   Pointer to the moments to update
+ * @param p   First point of the block
+ * @param len Number of points in the block
+ * @param on  Selection flag of every point (1.0 or 0.0)
+ */
+static void s_accumulate_block(moments_td *m, const data_point_td *p,
+        size_t len, const double *on)
+{
+    double t[6][SLICE_WORD_BITS];
+    double acc[6][SLICE_LANES] = {{0.0}};
+    double x0 = m->x0, y0 = m->y0;
+    int weighted = m->weighted;
+
+    for (size_t j = 0; j < len; ++j) {
+        double ey = p[j].ey;
+        double w = (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+        double u = p[j].x - x0;
+        double v = p[j].y - y0;
+        int sel = (on[j] != 0.0);
+
+        w = (weighted) ? w : 1.0;
+        w = sel ? w : 0.0;
+        u = sel ? u : 0.0;
+        v = sel ? v : 0.0;
+        t[0][j] = w;
+        t[1][j] = w * u;
+        t[2][j] = w * v;
+        t[3][j] = w * u * u;
+        t[4][j] = w * u * v;
+        t[5][j] = w * v * v;
+    }
+
+    /* Blocks are whole multiples of the lanes but the last one */
+    for (size_t j = len; j % SLICE_LANES != 0; ++j) {
+        for (size_t k = 0; k < 6; ++k) {
+            t[k][j] = 0.0;
+        }
+    }
+    for (size_t j = 0; j < len; j += SLICE_LANES) {
+        for (size_t k = 0; k < 6; ++k) {
+            for (size_t l = 0; l < SLICE_LANES; ++l) {
+                acc[k][l] += t[k][j + l];
+            }
+        }
+    }
+
+    for (size_t l = 0; l < SLICE_LANES; ++l) {
+        m->s   += acc[0][l];
+        m->sx  += acc[1][l];
+        m->sy  += acc[2][l];
+        m->sxx += acc[3][l];
+        m->sxy += acc[4][l];
+        m->syy += acc[5][l];
+    }
+}
+
+
+/* Accumulate the points of a slice into the moment sums */
+void moments_accumulate_slice(moments_td *m, const slice_td *s)
+{
+    double on[SLICE_WORD_BITS];
+    data_point_td buf[SLICE_WORD_BITS];
+
+    for (size_t w = s->begin / SLICE_WORD_BITS;
+            w < slice_mask_words(s->end); ++w) {
+        uint64_t bits = slice_bits(s, w);
+        size_t base = w * SLICE_WORD_BITS;
+        size_t len = s->end - base;
+
+        if (bits == 0) {
+            continue;
+        }
+        if (len > SLICE_WORD_BITS) {
+            len = SLICE_WORD_BITS;
+        }
+        slice_expand(bits, len, on);
+        s_accumulate_block(m, dataset_block(s->ds, base, len, buf), len,
+                on);
+        m->n += slice_popcount(bits);
+    }
+}
+
+
+/* Merge two sets of moment sums */
+void moments_merge(moments_td *m, const moments_td *o)
+{
+    m->s   += o->s;
+    m->sx  += o->sx;
+    m->sy  += o->sy;
+    m->sxx += o->sxx;
+    m->sxy += o->sxy;
+    m->syy += o->syy;
+    m->n   += o->n;
+}
+
+
+/* Subtract a subset of moment sums */
+void moments_sub(moments_td *m, const moments_td *o)
+{
+    m->s   -= o->s;
+    m->sx  -= o->sx;
+    m->sy  -= o->sy;
+    m->sxx -= o->sxx;
+    m->sxy -= o->sxy;
+    m->syy -= o->syy;
+    m->n   -= o->n;
+}
+
+
+/* Move the origin of a set of moment sums */
+void moments_shift(moments_td *m, double x0, double y0)
+{
+    /* u' = u + du, v' = v + dv */
+    double du = m->x0 - x0;
+    double dv = m->y0 - y0;
+
+    m->sxx += 2.0 * du * m->sx + du * du * m->s;
+    m->syy += 2.0 * dv * m->sy + dv * dv * m->s;
+    m->sxy += du * m->sy + dv * m->sx + du * dv * m->s;
+    m->sx  += du * m->s;
+    m->sy  += dv * m->s;
+    m->x0 = x0;
+    m->y0 = y0;
+}
+
+
+/* Tell if a dataset has to be fitted with weights */
+int moments_use_weights(const dataset_td *ds)
+{
+    slice_td s = slice_all(ds);
+
+    return moments_slice_use_weights(&s);
+}
+
+
+/* Tell if a slice has to be fitted with weights */
+int moments_slice_use_weights(const slice_td *s)
+{
+    data_point_td buf[SLICE_WORD_BITS];
+
+    /* No error is stored if they are all 0 */
+    if (s->ds->mode & DATASET_NO_EY) {
+        return 0;
+    }
+
+    for (size_t w = s->begin / SLICE_WORD_BITS;
+            w < slice_mask_words(s->end); ++w) {
+        uint64_t bits = slice_bits(s, w);
+        size_t base = w * SLICE_WORD_BITS;
+        size_t len = s->end - base;
+        const data_point_td *p;
+
+        if (bits == 0) {
+            continue;
+        }
+        if (len > SLICE_WORD_BITS) {
+            len = SLICE_WORD_BITS;
+        }
+        p = dataset_block(s->ds, base, len, buf);
+
+        for (size_t j = 0; bits != 0; ++j, bits >>= 1) {
+            if ((bits & 1u) && p[j].ey > 0.0) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file piecewise.c
+ *
+ * @brief Implementation of segmented (piecewise linear) regression
+ */
+
+/* System includes */
+#include <math.h>       /* HUGE_VAL */
+#include <stdlib.h>     /* free, malloc */
+
+/* Project includes */
+#include <moments.h>
+#include <regres.h>
+#include <xindex.h>
+
+/* Local includes */
+#include <piecewise.h>
+
+
+/**
+ * @brief Sum of squared residuals of the best line over a run of points
+ *
+ * @param idx   Pointer to the prefix-sum index
+ * @param begin Sorted position of the first point of the segment
+ * @param end   Sorted position one past the last point of the segment
+ *
+ * @return Weighted sum of squared residuals (O(1))
+ */
+static double s_segment_cost(const xindex_td *idx, size_t begin,
+        size_t end)
+{
+    moments_td m;
+
+    xindex_moments(idx, begin, end, &m);
+    if (m.s <= 0.0) {
+        return 0.0;
+    }
+
+    double dxx = m.sxx - m.sx * m.sx / m.s;
+    double dyy = m.syy - m.sy * m.sy / m.s;
+    double dxy = m.sxy - m.sx * m.sy / m.s;
+    double cost = (dxx > 0.0) ? dyy - dxy * dxy / dxx : dyy;
+
+    return (cost > 0.0) ? cost : 0.0;
+}
+
+
+/* Fit independent straight lines to consecutive ranges of 'x' */
+int piecewise_fit(const xindex_td *idx, size_t k, piecewise_td *pw)
+{
+    size_t n = idx->n;
+
+    if (k < 1 || k > PIECEWISE_MAX_BREAKS ||
+            n < (k + 1) * PIECEWISE_MIN_POINTS) {
+        return 1;
+    }
+
+    /* Candidate splits: between distinct 'x', leaving enough points on
+     * both sides; 'cand' also holds the start (0) and the end (n) */
+    size_t *cand = malloc(n * sizeof(*cand));
+    if (cand == NULL) {
+        return 2;
+    }
+    size_t n_pos = 0;
+    for (size_t p = PIECEWISE_MIN_POINTS;
+            p + PIECEWISE_MIN_POINTS <= n; ++p) {
+        if (idx->x[p - 1] < idx->x[p]) {
+            cand[1 + n_pos++] = p;
+        }
+    }
+    if (n_pos < k) {
+        free(cand);
+        return 1;
+    }
+    if (k > 1 && n_pos > PIECEWISE_MAX_CANDIDATES) {
+        for (size_t i = 0; i < PIECEWISE_MAX_CANDIDATES; ++i) {
+            cand[1 + i] = cand[1 + (i * n_pos) / PIECEWISE_MAX_CANDIDATES];
+        }
+        n_pos = PIECEWISE_MAX_CANDIDATES;
+    }
+    size_t c = n_pos + 2;
+    cand[0] = 0;
+    cand[c - 1] = n;
+
+    /* best[j*c + t]: least cost of splitting [0, cand[t]) in j+1
+     * segments; from[j*c + t]: candidate where the last one starts */
+    double *best = malloc(k * c * sizeof(*best));
+    size_t *from = malloc(k * c * sizeof(*from));
+    if (best == NULL || from == NULL) {
+        free(best);
+        free(from);
+        free(cand);
+        return 2;
+    }
+
+    for (size_t t = 1; t + 1 < c; ++t) {
+        best[t] = s_segment_cost(idx, 0, cand[t]);
+        from[t] = 0;
+    }
+    for (size_t j = 1; j < k; ++j) {
+        double *prev_row = best + (j - 1) * c;
+        double *row = best + j * c;
+
+        for (size_t t = 1; t + 1 < c; ++t) {
+            row[t] = HUGE_VAL;
+            from[j * c + t] = 0;
+            for (size_t s = 1; s < t; ++s) {
+                if (prev_row[s] == HUGE_VAL ||
+                        cand[t] - cand[s] < PIECEWISE_MIN_POINTS) {
+                    continue;
+                }
+                double cost = prev_row[s] +
+                    s_segment_cost(idx, cand[s], cand[t]);
+                if (cost < row[t]) {
+                    row[t] = cost;
+                    from[j * c + t] = s;
+                }
+            }
+        }
+    }
+
+    /* Last segment runs up to the end */
+    double total = HUGE_VAL;
+    size_t last = 0;
+    for (size_t s = 1; s + 1 < c; ++s) {
+        double b = best[(k - 1) * c + s];
+        if (b == HUGE_VAL || n - cand[s] < PIECEWISE_MIN_POINTS) {
+            continue;
+        }
+        double cost = b + s_segment_cost(idx, cand[s], n);
+        if (cost < total) {
+            total = cost;
+            last = s;
+        }
+    }
+
+    if (total == HUGE_VAL) {
+        free(best);
+        free(from);
+        free(cand);
+        return 1;
+    }
+
+    /* Walk the choices back to get every split position */
+    size_t split[PIECEWISE_MAX_BREAKS + 1];
+    size_t t = last;
+    for (size_t j = k; j-- > 0; ) {
+        split[j] = cand[t];
+        t = from[j * c + t];
+    }
+    split[k] = n;
+
+    pw->n_breaks = k;
+    pw->chisq = total;
+    for (size_t j = 0, begin = 0; j <= k; ++j) {
+        moments_td m;
+
+        xindex_moments(idx, begin, split[j], &m);
+        pw->seg[j] = regres_from_moments(&m);
+        pw->seg_n[j] = split[j] - begin;
+        if (j < k) {
+            pw->breaks[j] =
+                0.5 * (idx->x[split[j] - 1] + idx->x[split[j]]);
+        }
+        begin = split[j];
+    }
+
+    free(best);
+    free(from);
+    free(cand);
+
+    return 0;
+}
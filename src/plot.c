@@ -8,13 +8,17 @@
 
 
 /* System includes */
+#include <math.h>       /* sqrt */
 #include <stdio.h>      /* fdopen, fopen, popen, pclose */
 #include <stdlib.h>     /* atexit, getenv, mkstemp */
 #include <string.h>     /* strdup */
 #include <unistd.h>     /* close, unlink, size_t */
 
 /* Project includes */
+#include <bins.h>
 #include <dataset.h>
+#include <moments.h>
+#include <slice.h>
 
 /* Local includes */
 #include <plot.h>
@@ -152,36 +156,54 @@ static const char *s_tmpdir_first_nonempty(const char *names[],
 }
 
 
-/* Plot data points and the regression line (a + b*x) using 'gnuplot' */
-void plot_data(const dataset_td *ds, double a, double b)
+/**
+ * @brief Create and open a registered temporary data file
+ *
+ * @param tmpl Buffer where the name of the file is stored
+ * @param len  Size of @p tmpl
+ *
+ * @return Stream open for writing, or @c NULL on failure
+ */
+static FILE *s_tmp_open(char *tmpl, size_t len)
 {
     FILE *fp;
-    FILE *gp;
     int fd;
-    char tmpl[256];
     const char *tmp_names[] = { "TMPDIR", "TEMPDIR", "TMP", "TEMP", NULL };
     const char *tmpdir = s_tmpdir_first_nonempty(tmp_names, "/tmp");
 
-    snprintf(tmpl, sizeof(tmpl), "%s/regres_dat_XXXXXX", tmpdir);
+    snprintf(tmpl, len, "%s/regres_dat_XXXXXX", tmpdir);
     atexit(s_tmp_files_delete);
 
     if ((fd = mkstemp(tmpl)) == -1) {
-        return;
+        return NULL;
     }
 
     if ((fp = fdopen(fd, "w")) == NULL ){
         close(fd);
         unlink(tmpl);
-        return;
-    }
-
-    for (size_t i = 0; i < ds->size; ++i) {
-        fprintf(fp, "%f %f\n", ds->points[i].x, ds->points[i].y);
+        return NULL;
     }
-    fflush(fp);
-    fclose(fp);
     s_tmp_files_register(tmpl);
 
+    return fp;
+}
+
+
+/**
+ * @brief Plot a data file and the regression line using @c gnuplot
+ *
+ * @param tmpl  Name of the data file
+ * @param title Title of the plot
+ * @param style Plot style of the data file (e.g., @c "with points")
+ * @param label Title of the data in the key
+ * @param a     Intercept of the regression line
+ * @param b     Slope of the regression line
+ */
+static void s_plot_run(const char *tmpl, const char *title,
+        const char *style, const char *label, double a, double b)
+{
+    FILE *gp;
+
     /* Execute 'gnuplot' */
     if ((gp = popen("gnuplot -p 2>/dev/null", "w")) == NULL) {
         unlink(tmpl);
@@ -189,15 +211,95 @@ void plot_data(const dataset_td *ds, double a, double b)
     }
 
     fprintf(gp, "set grid\n");
-    fprintf(gp, "set title 'Data plot with regression'\n");
-    fprintf(gp, "plot '%s' title 'Data points' with"
-                " points pointtype 2 pointsize 1, %f + %f*x"
+    fprintf(gp, "set title '%s'\n", title);
+    fprintf(gp, "plot '%s' title '%s' %s, %f + %f*x"
                 " with lines linewidth 1 lc rgb 'red'"
                 " title 'Regression'\n",
-            tmpl, a, b);
+            tmpl, label, style, a, b);
 
     fflush(gp);
     pclose(gp);
+}
+
+
+/* Plot data points and the regression line (a + b*x) using 'gnuplot' */
+void plot_data(const dataset_td *ds, double a, double b)
+{
+    slice_td s = slice_all(ds);
+
+    plot_data_slice(&s, a, b);
+}
+
+
+/* Plot the points of a slice and the regression line (a + b*x) */
+void plot_data_slice(const slice_td *s, double a, double b)
+{
+    data_point_td buf[SLICE_WORD_BITS];
+    FILE *fp;
+    char tmpl[256];
+
+    if ((fp = s_tmp_open(tmpl, sizeof(tmpl))) == NULL) {
+        return;
+    }
+
+    for (size_t w = s->begin / SLICE_WORD_BITS;
+            w < slice_mask_words(s->end); ++w) {
+        uint64_t bits = slice_bits(s, w);
+        size_t base = w * SLICE_WORD_BITS;
+        size_t len = s->end - base;
+        const data_point_td *p;
+
+        if (bits == 0) {
+            continue;
+        }
+        if (len > SLICE_WORD_BITS) {
+            len = SLICE_WORD_BITS;
+        }
+        p = dataset_block(s->ds, base, len, buf);
+        for (size_t j = 0; bits != 0; ++j, bits >>= 1) {
+            if (bits & 1u) {
+                fprintf(fp, "%f %f\n", p[j].x, p[j].y);
+            }
+        }
+    }
+    fflush(fp);
+    fclose(fp);
+
+    s_plot_run(tmpl, "Data plot with regression",
+            "with points pointtype 2 pointsize 1", "Data points", a, b);
+
+    return;
+}
+
+
+/* Plot the bin means and the regression line (a + b*x) using 'gnuplot' */
+void plot_bins(const bins_td *bins, double a, double b)
+{
+    FILE *fp;
+    char tmpl[256];
+
+    if ((fp = s_tmp_open(tmpl, sizeof(tmpl))) == NULL) {
+        return;
+    }
+
+    for (size_t k = 0; k < bins->n_bins; ++k) {
+        const moments_td *m = &bins->bins[k].plain;
+        double n = (double) m->n;
+
+        if (m->n == 0) {
+            continue;
+        }
+
+        /* Mean and standard deviation of 'y' in the bin */
+        double var = (m->syy - m->sy * m->sy / n) / n;
+        fprintf(fp, "%f %f %f\n", m->x0 + m->sx / n, m->y0 + m->sy / n,
+                (var > 0.0) ? sqrt(var) : 0.0);
+    }
+    fflush(fp);
+    fclose(fp);
+
+    s_plot_run(tmpl, "Binned data plot with regression",
+            "with yerrorbars pointtype 7 pointsize 0.5", "Bin means", a, b);
 
     return;
 }
@@ -5,97 +5,177 @@
  */
 
 /* System includes */
-#include <math.h>       /* sqrt */
+#include <math.h>       /* NAN, sqrt */
+#include <stdlib.h>     /* free, malloc */
+
+/* Project includes */
+#include <moments.h>
+#include <slice.h>
 
 /* Local includes */
 #include <regres.h>
 
 
-/* Compute simple linear regression for a data set (y = a + b*x) */
-regression_td regres_linear(const dataset_td *ds)
+/**
+ * @brief Solve the normal equations given by a set of moment sums
+ *
+ * @param m Pointer to the moment sums of the points to fit
+ * @param a Where to store the intercept, in the original coordinates
+ * @param b Where to store the slope
+ *
+ * @return 0 on success, or 1 if there are fewer than two points or
+ *         the @e x values have no spread (up to rounding)
+ */
+static int s_moments_line(const moments_td *m, double *a, double *b)
 {
-    regression_td reg = {0};
-    size_t n = ds->size;
+    double delta = m->s * m->sxx - m->sx * m->sx;
 
-    if (n < 2) {
-        return reg;
+    if (m->n < 2 || m->s <= 0.0 || delta <= 1e-12 * m->s * m->sxx) {
+        return 1;
     }
 
-    /* Accumulators for weighted or unweighted normal equations */
-    double S = 0.0, Sx = 0.0, Sy = 0.0, Sxx = 0.0, Sxy = 0.0;
-    int use_weights = 0;
+    *b = (m->s * m->sxy - m->sx * m->sy) / delta;
+    *a = (m->sxx * m->sy - m->sx * m->sxy) / delta;
 
-    /* Check if 'ey' weights are valid */
-    for (size_t i = 0; i < n; ++i) {
-        if (ds->points[i].ey > 0.0) {
-             use_weights = 1;
-             break;
-        }
+    /* Back from the origin (x0, y0) of the sums */
+    *a += m->y0 - *b * m->x0;
+
+    return 0;
+}
+
+
+/**
+ * @brief Accumulate the residual and error propagation sums of a block
+ *
+ * Vectorized like the moment sums of a slice (see
+ * @a moments_accumulate_slice()).
+ *
+ * @param m           Pointer to the sums of the fit, about the origin
+ * @param a           Intercept of the fit
+ * @param b           Slope of the fit
+ * @param use_weights If non-zero, residuals are weighted by @e 1/ey^2
+ * @param p           First point of the block
+ * @param len         Number of points in the block (at most 64)
+ * @param on          Selection flag of every point (1.0 or 0.0)
+ * @param sums        Where to add the weighted sum of squared
+ *                    residuals, and the sums of
+ *                    @e |S*x - Sx|*ey and @e |Sxx - x*Sx|*ey (with
+ *                    @e ey = 1 if not weighted)
+ */
+static void s_residual_block(const moments_td *m, double a, double b,
+        int use_weights, const data_point_td *p, size_t len,
+        const double *on, double *sums)
+{
+    double t[3][SLICE_WORD_BITS];
+    double acc[3][SLICE_LANES] = {{0.0}};
+    double S = m->s, Sx = m->sx, Sxx = m->sxx;
+
+    for (size_t j = 0; j < len; ++j) {
+        double x = p[j].x;
+        double ey = p[j].ey;
+        double r = p[j].y - (a + b * x);
+        double w = (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+        double e = (ey > 0.0) ? ey : 0.0;
+        int sel = (on[j] != 0.0);
+
+        w = (use_weights) ? w : 1.0;
+        e = (use_weights) ? e : 1.0;
+        w = sel ? w : 0.0;
+        e = sel ? e : 0.0;
+        x = sel ? x : 0.0;
+        r = sel ? r : 0.0;
+        t[0][j] = w * r * r;
+        t[1][j] = fabs(S * x - Sx) * e;
+        t[2][j] = fabs(Sxx - x * Sx) * e;
     }
 
-    if (use_weights) {
-        /* Weighted least squares: weight = 1/ey^2 */
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double y = ds->points[i].y;
-            double ey = ds->points[i].ey;
-            double w = (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
-            S   += w;
-            Sx  += w * x;
-            Sy  += w * y;
-            Sxx += w * x * x;
-            Sxy += w * x * y;
+    for (size_t j = len; j % SLICE_LANES != 0; ++j) {
+        for (size_t k = 0; k < 3; ++k) {
+            t[k][j] = 0.0;
         }
-    } else {
-        /* Ordinary least squares (equal weights) */
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double y = ds->points[i].y;
-            double w = 1.0;
-            S   += w;
-            Sx  += w * x;
-            Sy  += w * y;
-            Sxx += w * x * x;
-            Sxy += w * x * y;
+    }
+    for (size_t j = 0; j < len; j += SLICE_LANES) {
+        for (size_t k = 0; k < 3; ++k) {
+            for (size_t l = 0; l < SLICE_LANES; ++l) {
+                acc[k][l] += t[k][j + l];
+            }
         }
     }
 
+    for (size_t l = 0; l < SLICE_LANES; ++l) {
+        sums[0] += acc[0][l];
+        sums[1] += acc[1][l];
+        sums[2] += acc[2][l];
+    }
+}
+
+
+/* Compute simple linear regression for a data set (y = a + b*x) */
+regression_td regres_linear(const dataset_td *ds)
+{
+    slice_td s = slice_all(ds);
+
+    return regres_linear_slice(&s);
+}
+
+
+/* Compute simple linear regression for a slice of a data set */
+regression_td regres_linear_slice(const slice_td *s)
+{
+    regression_td reg = {0};
+    size_t n = slice_count(s);
+
+    if (n < 2) {
+        return reg;
+    }
+
+    /* Normal equations, weighted (w = 1/ey^2) if any 'ey' is valid */
+    int use_weights = moments_slice_use_weights(s);
+    moments_td m;
+
+    moments_init(&m, 0.0, 0.0, use_weights);
+    moments_accumulate_slice(&m, s);
+
+    double S = m.s, Sx = m.sx, Sy = m.sy, Sxx = m.sxx, Sxy = m.sxy;
     double delta = S * Sxx - Sx * Sx;
-    double a = 0.0, b = 0.0, sa = 0.0, sb = 0.0;
-    double ea = 0.0, eb = 0.0;
-    double r = 0.0;
 
     /* Degenerate case */
     if (delta == 0.0) {
-        reg.a = 0.0;
-        reg.b = 0.0;
-        reg.sa = reg.sb = 0.0;
-        reg.ea = reg.eb = 0.0;
-        reg.r = 0.0;
-
         return reg;
     }
 
     /* Best-fit parameters */
-    b = (S * Sxy - Sx * Sy) / delta;
-    a = (Sxx * Sy - Sx * Sxy) / delta;
+    double b = (S * Sxy - Sx * Sy) / delta;
+    double a = (Sxx * Sy - Sx * Sxy) / delta;
+    double sa = 0.0, sb = 0.0, ea = 0.0, eb = 0.0;
 
-    /* Residual sums to estimate variance */
-    double chisq = 0.0; /* Used for weighted case */
-    double ssr = 0.0;   /* Unweighted sum of squared residuals */
-    if (use_weights) {
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double y = ds->points[i].y;
-            double ey = ds->points[i].ey;
-            double fit = a + b * x;
-            double resid = y - fit;
-            double w = (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+    /* Residual sums to estimate variance (chisq is the plain sum of
+     * squared residuals if unweighted), and error propagation sums:
+     *   - ea = sum_i | (S*x_i - Sx) / delta | * ey_i
+     *   - eb = sum_i | (Sxx - x_i*Sx) / delta | * ey_i */
+    double sums[3] = {0.0, 0.0, 0.0};
+    double on[SLICE_WORD_BITS];
+    data_point_td buf[SLICE_WORD_BITS];
+
+    for (size_t w = s->begin / SLICE_WORD_BITS;
+            w < slice_mask_words(s->end); ++w) {
+        uint64_t bits = slice_bits(s, w);
+        size_t base = w * SLICE_WORD_BITS;
+        size_t len = s->end - base;
 
-            chisq += w * resid * resid;
-            ssr += resid * resid;   /* Keep unweighted SSR if needed */
+        if (bits == 0) {
+            continue;
         }
+        if (len > SLICE_WORD_BITS) {
+            len = SLICE_WORD_BITS;
+        }
+        slice_expand(bits, len, on);
+        s_residual_block(&m, a, b, use_weights,
+                dataset_block(s->ds, base, len, buf), len, on, sums);
+    }
+    double chisq = sums[0];
 
+    if (use_weights) {
         /* For weighted fits, parameter covariance matrix is
          * inverse(normal matrix):
          *   - cov(a,a) = Sxx / delta
@@ -112,114 +192,34 @@ regression_td regres_linear(const dataset_td *ds)
          * (i.e. s2 ~= 1).  Scale by s2 (common practice) */
         sb = sqrt(s2 * (S / delta));
         sa = sqrt(s2 * (Sxx / delta));
-
-        /* Propagation errors ea, eb using your linear propagation formulas:
-         *   - ea = sum_i | (n*x_i - S) / den | * ey_i
-         *   - eb = sum_i | (Sx2 - x_i*S) / den | * ey_i
-         * where den = n*sx2 - sx*sx  (here using weighted equivalents)
-         * For weighted case we use S, Sx, Sxx and den = delta */
-
-        double den = delta;
-        double sum_a = 0.0, sum_b = 0.0;
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double ey = ds->points[i].ey;
-            double coef_a = fabs((S * x - Sx) / den);   /* ~(n*x-sx)/den */
-            double coef_b = fabs((Sxx - x * Sx) / den); /* ~(sx2-x*sx)/den */
-            if (ey < 0.0) ey = 0.0;
-            sum_a += coef_a * ey;
-            sum_b += coef_b * ey;
-        }
-        ea = sum_a;
-        eb = sum_b;
+        ea = sums[1] / fabs(delta);
+        eb = sums[2] / fabs(delta);
     } else {
-        /* Unweighted case */
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double y = ds->points[i].y;
-            double fit = a + b * x;
-            double resid = y - fit;
-
-            ssr += resid * resid;
-        }
-        double s2 = (n > 2) ? (ssr / (double)(n - 2)) : 0.0;
+        double s2 = (n > 2) ? (chisq / (double)(n - 2)) : 0.0;
 
         /* Useful combination: Sxx - Sx^2 / S = sum (x - x_mean)^2
          * (for equal weights) */
         double denom = Sxx - (Sx * Sx) / S;
-        if (denom <= 0.0) {
-            sb = 0.0;
-            sa = 0.0;
-        } else {
+        if (denom > 0.0) {
             sb = sqrt(s2 / denom);
             sa = sqrt(s2 * Sxx / (S * denom));
 
             /* For propagation errors with unweighted data we need
-             * per-point 'ey'.  If caller provided ey==0 for all, treat
-             * measurement errors as sqrt(s2) (same uncertainty for all
-             * points).  Then apply your linear propagation discrete
-             * sums with den = n*sx2 - sx*sx. */
-            double den = S * Sxx - Sx * Sx; /* Equals delta */
-            double sum_a = 0.0, sum_b = 0.0;
-            double ey_effective = sqrt(s2); /* Same 'ey' for all points */
-            for (size_t i = 0; i < n; ++i) {
-                double x = ds->points[i].x;
-                double coef_a = fabs((S * x - Sx) / den);
-                double coef_b = fabs((Sxx - x * Sx) / den);
-                sum_a += coef_a * ey_effective;
-                sum_b += coef_b * ey_effective;
-            }
-            ea = sum_a;
-            eb = sum_b;
+             * per-point 'ey'.  Treat measurement errors as sqrt(s2)
+             * (same uncertainty for all points) */
+            ea = sums[1] / fabs(delta) * sqrt(s2);
+            eb = sums[2] / fabs(delta) * sqrt(s2);
         }
     }
 
-    /* Pearson correlation coefficient r:
-     *   - For unweighted data use standard definition.
-     *   - For weighted data use weighted covariance/variances.
-     */
-    if (use_weights) {
-        /* Compute weighted means */
-        double xw_mean = Sx / S;
-        double yw_mean = Sy / S;
-        double cov_xy = 0.0, var_x = 0.0, var_y = 0.0;
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double y = ds->points[i].y;
-            double ey = ds->points[i].ey;
-            double w = (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
-            double dx = x - xw_mean;
-            double dy = y - yw_mean;
-
-            cov_xy += w * dx * dy;
-            var_x += w * dx * dx;
-            var_y += w * dy * dy;
-        }
-        if (var_x > 0.0 && var_y > 0.0) {
-            r = cov_xy / sqrt(var_x * var_y);
-        } else {
-            r = 0.0;
-        }
-    } else {
-        /* Unweighted Pearson r */
-        double xmean = Sx / S;
-        double ymean = Sy / S;
-        double num = 0.0, denx = 0.0, deny = 0.0;
-        for (size_t i = 0; i < n; ++i) {
-            double x = ds->points[i].x;
-            double y = ds->points[i].y;
-            double dx = x - xmean;
-            double dy = y - ymean;
+    /* Pearson correlation coefficient r, from the (weighted) sums about
+     * the (weighted) means */
+    moments_td c;
 
-            num += dx * dy;
-            denx += dx * dx;
-            deny += dy * dy;
-        }
-        if (denx > 0.0 && deny > 0.0) {
-            r = num / sqrt(denx * deny);
-        } else {
-            r = 0.0;
-        }
+    moments_init(&c, Sx / S, Sy / S, use_weights);
+    moments_accumulate_slice(&c, s);
+    if (c.sxx > 0.0 && c.syy > 0.0) {
+        reg.r = c.sxy / sqrt(c.sxx * c.syy);
     }
 
     /* Populate the structure */
@@ -229,7 +229,291 @@ regression_td regres_linear(const dataset_td *ds)
     reg.sb = sb;
     reg.ea = ea;
     reg.eb = eb;
-    reg.r = r;
 
     return reg;
 }
+
+
+/* Compute leave-one-out diagnostics for every point of a data set */
+int regres_influence(const dataset_td *ds, influence_td *out)
+{
+    size_t n = ds->size;
+
+    if (n < 3) {
+        return 1;
+    }
+
+    /* Same weighting rule as 'regres_linear' */
+    int use_weights = moments_use_weights(ds);
+
+    double S = 0.0, Sx = 0.0, Sy = 0.0, Sxx = 0.0, Sxy = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        data_point_td p = dataset_get(ds, i);
+        double x = p.x;
+        double y = p.y;
+        double ey = p.ey;
+        double w = (!use_weights) ? 1.0 : (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+        S   += w;
+        Sx  += w * x;
+        Sy  += w * y;
+        Sxx += w * x * x;
+        Sxy += w * x * y;
+    }
+
+    double delta = S * Sxx - Sx * Sx;
+    if (delta <= 0.0) {
+        return 1;
+    }
+
+    double b = (S * Sxy - Sx * Sy) / delta;
+    double a = (Sxx * Sy - Sx * Sxy) / delta;
+    double xmean = Sx / S;
+    double dxx = delta / S;     /* Sum w*(x - xmean)^2 */
+
+    /* Weighted sum of squared residuals of the full fit */
+    double chisq = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        data_point_td p = dataset_get(ds, i);
+        double ey = p.ey;
+        double w = (!use_weights) ? 1.0 : (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+        double resid = p.y - (a + b * p.x);
+        chisq += w * resid * resid;
+    }
+    double s2 = chisq / (double) (n - 2);
+
+    /* Dropping point 'i' is a rank-one downdate of the normal matrix,
+     * so every diagnostic has a closed form in terms of the residual
+     * 'e' and the leverage 'h' (Sherman-Morrison):
+     *   - a_(i) - a = -w*e*(Sxx - Sx*x) / (delta*(1-h))
+     *   - b_(i) - b = -w*e*(S*x - Sx) / (delta*(1-h))
+     *   - s_(i)^2   = (chisq - w*e^2/(1-h)) / (n-3) */
+    for (size_t i = 0; i < n; ++i) {
+        data_point_td p = dataset_get(ds, i);
+        double x = p.x;
+        double ey = p.ey;
+        double w = (!use_weights) ? 1.0 : (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+        double e = p.y - (a + b * x);
+        double h = w * (1.0 / S + (x - xmean) * (x - xmean) / dxx);
+        double rem = 1.0 - h;
+
+        out[i].h = h;
+        if (rem <= 1e-12) {
+            out[i].rstud = out[i].cook = NAN;
+            out[i].da = out[i].db = NAN;
+            continue;
+        }
+
+        double k = w * e / (delta * rem);
+        out[i].da = -k * (Sxx - Sx * x);
+        out[i].db = -k * (S * x - Sx);
+
+        if (n > 3) {
+            double s2_i = (chisq - w * e * e / rem) / (double) (n - 3);
+            out[i].rstud = (s2_i > 0.0) ? e * sqrt(w / (s2_i * rem)) : 0.0;
+        } else {
+            out[i].rstud = NAN;     /* No degrees of freedom left */
+        }
+        out[i].cook = (s2 > 0.0)
+            ? w * e * e * h / (2.0 * s2 * rem * rem)
+            : 0.0;
+    }
+
+    return 0;
+}
+
+
+/* Compute a linear regression from its moment sums */
+regression_td regres_from_moments(const moments_td *m)
+{
+    regression_td reg = {0};
+    double a, b;
+
+    if (s_moments_line(m, &a, &b) != 0) {
+        return reg;
+    }
+
+    /* Centered sums: Sum w*(x-xm)^2, Sum w*(y-ym)^2, Sum w*(x-xm)*(y-ym) */
+    double dxx = m->sxx - m->sx * m->sx / m->s;
+    double dyy = m->syy - m->sy * m->sy / m->s;
+    double dxy = m->sxy - m->sx * m->sy / m->s;
+    double xmean = m->x0 + m->sx / m->s;
+
+    /* Weighted (or plain) sum of squared residuals */
+    double chisq = dyy - b * dxy;
+    if (chisq < 0.0) {
+        chisq = 0.0;
+    }
+
+    double s2;
+    if (m->n > 2) {
+        s2 = chisq / (double) (m->n - 2);
+    } else {
+        s2 = (m->weighted) ? 1.0 : 0.0;
+    }
+
+    reg.a = a;
+    reg.b = b;
+    reg.sb = sqrt(s2 / dxx);
+    reg.sa = sqrt(s2 * (1.0 / m->s + xmean * xmean / dxx));
+    reg.ea = reg.eb = 0.0;
+    reg.r = (dxx > 0.0 && dyy > 0.0) ? dxy / sqrt(dxx * dyy) : 0.0;
+
+    return reg;
+}
+
+
+/**
+ * @brief Weight of a held-out residual in the cross-validated RMSE
+ *
+ * @param use_weights Non-zero if the fit is weighted
+ * @param ey          Error of the point
+ *
+ * @return 1/ey^2 (0 if @p ey is not positive) for weighted fits, or 1
+ */
+static double s_crossval_weight(int use_weights, double ey)
+{
+    if (!use_weights) {
+        return 1.0;
+    }
+
+    return (ey > 0.0) ? 1.0 / (ey * ey) : 0.0;
+}
+
+
+/* Estimate the out-of-sample error of the linear fit */
+int regres_crossval(const dataset_td *ds, size_t k, crossval_td *cv)
+{
+    size_t n = ds->size;
+
+    if (n < 3 || k < 2) {
+        return 1;
+    }
+    if (k > n) {
+        k = n;
+    }
+
+    int use_weights = moments_use_weights(ds);
+    int loo = (k == n);
+    data_point_td p0 = dataset_get(ds, 0);
+    double x0 = p0.x;
+    double y0 = p0.y;
+    moments_td total;
+    moments_td *folds = NULL;
+    double *fit_a = NULL, *fit_b = NULL;
+    unsigned char *fit_ok = NULL;
+
+    /* First pass: sums of every fold (a fold is a single point in the
+     * leave-one-out case, so those are rebuilt on the fly instead) */
+    moments_init(&total, x0, y0, use_weights);
+    if (loo) {
+        moments_accumulate(&total, ds, 0, n);
+    } else {
+        folds = malloc(k * sizeof(*folds));
+        fit_a = malloc(k * sizeof(*fit_a));
+        fit_b = malloc(k * sizeof(*fit_b));
+        fit_ok = malloc(k * sizeof(*fit_ok));
+        if (!folds || !fit_a || !fit_b || !fit_ok) {
+            free(folds);
+            free(fit_a);
+            free(fit_b);
+            free(fit_ok);
+            return 2;
+        }
+
+        for (size_t f = 0; f < k; ++f) {
+            moments_init(&folds[f], x0, y0, use_weights);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            data_point_td p = dataset_get(ds, i);
+            moments_add(&folds[i % k], p.x, p.y, p.ey);
+        }
+        for (size_t f = 0; f < k; ++f) {
+            moments_merge(&total, &folds[f]);
+        }
+    }
+
+    size_t n_fits = 0, n_pred = 0;
+    double sse = 0.0, sw = 0.0;
+    double b_mean = 0.0, b_m2 = 0.0, b_min = 0.0, b_max = 0.0;
+
+    /* Training fits are the total minus the held-out fold; the second
+     * pass predicts every held-out point with its own training fit */
+    for (size_t f = 0; f < k; ++f) {
+        moments_td train = total;
+        double a, b;
+
+        if (loo) {
+            moments_td one;
+            data_point_td p = dataset_get(ds, f);
+            moments_init(&one, x0, y0, use_weights);
+            moments_add(&one, p.x, p.y, p.ey);
+            moments_sub(&train, &one);
+        } else {
+            moments_sub(&train, &folds[f]);
+        }
+
+        if (s_moments_line(&train, &a, &b) != 0) {
+            if (!loo) {
+                fit_ok[f] = 0;
+            }
+            continue;
+        }
+
+        /* Running mean and variance of the slopes (Welford) */
+        n_fits++;
+        double d = b - b_mean;
+        b_mean += d / (double) n_fits;
+        b_m2 += d * (b - b_mean);
+        if (n_fits == 1 || b < b_min) {
+            b_min = b;
+        }
+        if (n_fits == 1 || b > b_max) {
+            b_max = b;
+        }
+
+        if (loo) {
+            data_point_td p = dataset_get(ds, f);
+            double e = p.y - (a + b * p.x);
+            double w = s_crossval_weight(use_weights, p.ey);
+            sse += w * e * e;
+            sw += w;
+            n_pred++;
+        } else {
+            fit_a[f] = a;
+            fit_b[f] = b;
+            fit_ok[f] = 1;
+        }
+    }
+
+    if (!loo) {
+        for (size_t i = 0; i < n; ++i) {
+            size_t f = i % k;
+            if (fit_ok[f]) {
+                data_point_td p = dataset_get(ds, i);
+                double e = p.y - (fit_a[f] + fit_b[f] * p.x);
+                double w = s_crossval_weight(use_weights, p.ey);
+                sse += w * e * e;
+                sw += w;
+                n_pred++;
+            }
+        }
+        free(folds);
+        free(fit_a);
+        free(fit_b);
+        free(fit_ok);
+    }
+
+    if (n_fits == 0 || sw == 0.0) {
+        return 1;
+    }
+
+    cv->k = k;
+    cv->n_pred = n_pred;
+    cv->rmse = sqrt(sse / sw);
+    cv->b_mean = b_mean;
+    cv->b_sd = (n_fits > 1) ? sqrt(b_m2 / (double) (n_fits - 1)) : 0.0;
+    cv->b_min = b_min;
+    cv->b_max = b_max;
+
+    return 0;
+}
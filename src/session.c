@@ -0,0 +1,837 @@
+/**
+ * @file session.c
+ *
+ * @brief Implementation of the snapshot of a session, to restart from it
+ */
+
+#define _POSIX_C_SOURCE 200809L /* fdopen, mkstemp, pread */
+
+
+/* System includes */
+#include <fcntl.h>      /* open, O_RDONLY */
+#include <stdint.h>     /* uint64_t */
+#include <stdio.h>      /* fclose, fdopen, fseek, fwrite, rename, ... */
+#include <stdlib.h>     /* free, getenv, malloc, mkstemp, realloc */
+#include <string.h>     /* memcmp, memcpy, memset, strlen */
+#include <sys/stat.h>   /* fstat */
+#include <unistd.h>     /* close, pread, unlink */
+
+/* Project includes */
+#include <arena.h>
+#include <bins.h>
+#include <dataset.h>
+#include <regres.h>
+#include <stats.h>
+#include <summary.h>
+#include <transform.h>
+#include <view.h>
+
+/* Local includes */
+#include <session.h>
+
+
+#define S_HEADER_SIZE (32)      /**< Bytes of the header */
+#define S_ORDER (0x0102030405060708ULL) /**< Stored in the byte order of
+                                             the machine */
+#define S_TMP_SUFFIX ".XXXXXX"  /**< Appended to the name of a snapshot
+                                     to make its temporary copy */
+
+
+/*
+ * Layout of a snapshot:
+ *
+ *   - header, S_HEADER_SIZE bytes:
+ *       0 magic, 8 S_ORDER (in the byte order of the machine), 16
+ *       bytes of the description, 24 checksum of the description
+ *   - description (integers are little endian, values are the bits of
+ *     IEEE 754 doubles, strings are their length and their bytes):
+ *       points, storage mode, bytes of a key, modified flag, points
+ *       saved, state of their file, offset of the points, offset of
+ *       the keys (0 if none), key names (a flag, their number and
+ *       every name), derived columns (their number, and the name and
+ *       offset of every one), file name (a flag and the name),
+ *       transform stacks of x and y (their length, and the operation,
+ *       argument and flag of every layer), and the results computed
+ *       (a flag and the fields of each one)
+ *   - columns (points, keys and derived columns), in the byte order
+ *     and layout of the machine, each one @c ARENA_MAP_OFFSET bytes
+ *     after an offset aligned to SESSION_ALIGN; offsets are taken from
+ *     the first aligned one after the description
+ */
+
+
+/**
+ * @brief Description of a session being written
+ */
+typedef struct {
+    unsigned char *p;   /**< Bytes written */
+    size_t len;         /**< Number of bytes written */
+    size_t cap;         /**< Capacity of @e p */
+    int failed;         /**< Non-zero on memory allocation failure */
+} s_writer_td;
+
+/**
+ * @brief Description of a session being read
+ */
+typedef struct {
+    const unsigned char *p; /**< Bytes of the description */
+    size_t len;             /**< Number of bytes */
+    size_t pos;             /**< Bytes read so far */
+    int bad;                /**< Non-zero if read past the end */
+} s_reader_td;
+
+
+/**
+ * @brief Checksum of a range of bytes (FNV-1a)
+ *
+ * @param p   Bytes to hash
+ * @param len Number of bytes
+ *
+ * @return Checksum of the bytes
+ */
+static uint64_t s_checksum(const unsigned char *p, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Store an integer of 8 bytes, little endian
+ *
+ * @param p Where to store it
+ * @param v Value to store
+ */
+static void s_put_le(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+
+/**
+ * @brief Read an integer of 8 bytes, little endian
+ *
+ * @param p Where to read it from
+ *
+ * @return Value read
+ */
+static uint64_t s_get_le(const unsigned char *p)
+{
+    uint64_t v = 0;
+
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+
+/**
+ * @brief Append bytes to a description
+ *
+ * @param w   Pointer to the description
+ * @param p   Bytes to append
+ * @param len Number of bytes
+ */
+static void s_write(s_writer_td *w, const void *p, size_t len)
+{
+    if (w->failed) {
+        return;
+    }
+    if (w->len + len > w->cap) {
+        size_t cap = 2 * w->cap + len + 256;
+        unsigned char *q = realloc(w->p, cap);
+        if (q == NULL) {
+            w->failed = 1;
+            return;
+        }
+        w->p = q;
+        w->cap = cap;
+    }
+    memcpy(w->p + w->len, p, len);
+    w->len += len;
+}
+
+
+/**
+ * @brief Append an integer to a description
+ *
+ * @param w Pointer to the description
+ * @param v Value to append
+ */
+static void s_write_u64(s_writer_td *w, uint64_t v)
+{
+    unsigned char b[8];
+
+    s_put_le(b, v);
+    s_write(w, b, sizeof(b));
+}
+
+
+/**
+ * @brief Append a double to a description
+ *
+ * @param w Pointer to the description
+ * @param v Value to append
+ */
+static void s_write_f64(s_writer_td *w, double v)
+{
+    uint64_t u;
+
+    memcpy(&u, &v, sizeof(u));
+    s_write_u64(w, u);
+}
+
+
+/**
+ * @brief Append a string to a description
+ *
+ * @param w Pointer to the description
+ * @param s String to append
+ */
+static void s_write_str(s_writer_td *w, const char *s)
+{
+    size_t len = strlen(s);
+
+    s_write_u64(w, len);
+    s_write(w, s, len);
+}
+
+
+/**
+ * @brief Read an integer from a description
+ *
+ * @param r Pointer to the description
+ *
+ * @return Value read, or 0 past the end
+ */
+static uint64_t s_read_u64(s_reader_td *r)
+{
+    if (r->bad || r->len - r->pos < 8) {
+        r->bad = 1;
+        return 0;
+    }
+    r->pos += 8;
+
+    return s_get_le(r->p + r->pos - 8);
+}
+
+
+/**
+ * @brief Read a double from a description
+ *
+ * @param r Pointer to the description
+ *
+ * @return Value read, or 0 past the end
+ */
+static double s_read_f64(s_reader_td *r)
+{
+    uint64_t u = s_read_u64(r);
+    double v;
+
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+
+/**
+ * @brief Read a string from a description
+ *
+ * @param r Pointer to the description
+ *
+ * @return Newly allocated string, or @c NULL past the end or on memory
+ *         allocation failure (@e r->bad tells them apart)
+ */
+static char *s_read_str(s_reader_td *r)
+{
+    size_t len = (size_t) s_read_u64(r);
+    char *s;
+
+    if (r->bad || r->len - r->pos < len) {
+        r->bad = 1;
+        return NULL;
+    }
+    if ((s = malloc(len + 1)) != NULL) {
+        memcpy(s, r->p + r->pos, len);
+        s[len] = '\0';
+    }
+    r->pos += len;
+
+    return s;
+}
+
+
+/**
+ * @brief Append a cross-validation to a description
+ *
+ * @param w  Pointer to the description
+ * @param cv Pointer to the cross-validation
+ */
+static void s_write_crossval(s_writer_td *w, const crossval_td *cv)
+{
+    s_write_u64(w, cv->k);
+    s_write_u64(w, cv->n_pred);
+    s_write_f64(w, cv->rmse);
+    s_write_f64(w, cv->b_mean);
+    s_write_f64(w, cv->b_sd);
+    s_write_f64(w, cv->b_min);
+    s_write_f64(w, cv->b_max);
+}
+
+
+/**
+ * @brief Read a cross-validation from a description
+ *
+ * @param r  Pointer to the description
+ * @param cv Pointer to where the cross-validation is stored
+ */
+static void s_read_crossval(s_reader_td *r, crossval_td *cv)
+{
+    cv->k = (size_t) s_read_u64(r);
+    cv->n_pred = (size_t) s_read_u64(r);
+    cv->rmse = s_read_f64(r);
+    cv->b_mean = s_read_f64(r);
+    cv->b_sd = s_read_f64(r);
+    cv->b_min = s_read_f64(r);
+    cv->b_max = s_read_f64(r);
+}
+
+
+/**
+ * @brief Append the results computed to a description
+ *
+ * @param w Pointer to the description
+ * @param c Pointer to the results
+ */
+static void s_write_cache(s_writer_td *w, const session_cache_td *c)
+{
+    const stats_td *s = &c->stats;
+    const regression_td *g = &c->reg;
+
+    s_write_u64(w, (c->has_stats) ? 1 : 0);
+    s_write_u64(w, s->n);
+    s_write_f64(w, s->x_mean);
+    s_write_f64(w, s->y_mean);
+    s_write_f64(w, s->sum_x);
+    s_write_f64(w, s->sum_y);
+    s_write_f64(w, s->sum_x2);
+    s_write_f64(w, s->sum_y2);
+    s_write_f64(w, s->sum_xy);
+    s_write_f64(w, s->ssx);
+    s_write_f64(w, s->ssy);
+    s_write_f64(w, s->snx);
+    s_write_f64(w, s->sny);
+    s_write_f64(w, s->snxn1);
+    s_write_f64(w, s->snyn1);
+
+    s_write_u64(w, (c->has_fit) ? 1 : 0);
+    s_write_f64(w, g->a);
+    s_write_f64(w, g->b);
+    s_write_f64(w, g->sa);
+    s_write_f64(w, g->sb);
+    s_write_f64(w, g->ea);
+    s_write_f64(w, g->eb);
+    s_write_f64(w, g->r);
+    s_write_u64(w, (c->has_kfold) ? 1 : 0);
+    s_write_crossval(w, &c->kfold);
+    s_write_u64(w, (c->has_loo) ? 1 : 0);
+    s_write_crossval(w, &c->loo);
+}
+
+
+/**
+ * @brief Read the results computed from a description
+ *
+ * @param r Pointer to the description
+ * @param c Pointer to where the results are stored
+ */
+static void s_read_cache(s_reader_td *r, session_cache_td *c)
+{
+    stats_td *s = &c->stats;
+    regression_td *g = &c->reg;
+
+    c->has_stats = (s_read_u64(r) != 0);
+    s->n = (size_t) s_read_u64(r);
+    s->x_mean = s_read_f64(r);
+    s->y_mean = s_read_f64(r);
+    s->sum_x = s_read_f64(r);
+    s->sum_y = s_read_f64(r);
+    s->sum_x2 = s_read_f64(r);
+    s->sum_y2 = s_read_f64(r);
+    s->sum_xy = s_read_f64(r);
+    s->ssx = s_read_f64(r);
+    s->ssy = s_read_f64(r);
+    s->snx = s_read_f64(r);
+    s->sny = s_read_f64(r);
+    s->snxn1 = s_read_f64(r);
+    s->snyn1 = s_read_f64(r);
+
+    c->has_fit = (s_read_u64(r) != 0);
+    g->a = s_read_f64(r);
+    g->b = s_read_f64(r);
+    g->sa = s_read_f64(r);
+    g->sb = s_read_f64(r);
+    g->ea = s_read_f64(r);
+    g->eb = s_read_f64(r);
+    g->r = s_read_f64(r);
+    c->has_kfold = (s_read_u64(r) != 0);
+    s_read_crossval(r, &c->kfold);
+    c->has_loo = (s_read_u64(r) != 0);
+    s_read_crossval(r, &c->loo);
+}
+
+
+/**
+ * @brief Get the bytes a column takes in a snapshot
+ *
+ * @param bytes Bytes of the column
+ *
+ * @return Bytes of the column and of the room before it, rounded up to
+ *         @c SESSION_ALIGN
+ */
+static size_t s_span(size_t bytes)
+{
+    return (ARENA_MAP_OFFSET + bytes + SESSION_ALIGN - 1)
+        / SESSION_ALIGN * SESSION_ALIGN;
+}
+
+
+/* Initialize the results computed for the data of a session */
+void session_cache_init(session_cache_td *cache)
+{
+    cache->summary = NULL;
+    cache->bins = NULL;
+    session_cache_clear(cache);
+}
+
+
+/* Forget the results computed for the data of a session */
+void session_cache_clear(session_cache_td *cache)
+{
+    cache->has_stats = 0;
+    cache->has_fit = 0;
+    cache->has_kfold = 0;
+    cache->has_loo = 0;
+    if (cache->summary != NULL) {
+        summary_destroy(cache->summary);
+        free(cache->summary);
+        cache->summary = NULL;
+    }
+    if (cache->bins != NULL) {
+        bins_destroy(cache->bins);
+        free(cache->bins);
+        cache->bins = NULL;
+    }
+}
+
+
+/* Get the path of the snapshot of the last session */
+char *session_path(void)
+{
+    const char *home = getenv("HOME");
+    size_t len;
+    char *path;
+
+    if (home == NULL || *home == '\0') {
+        home = ".";
+    }
+    len = strlen(home) + strlen(SESSION_FILE) + 2;
+    if ((path = malloc(len)) != NULL) {
+        snprintf(path, len, "%s/%s", home, SESSION_FILE);
+    }
+
+    return path;
+}
+
+
+/* Save a snapshot of a session */
+int session_save(const char *path, const dataset_td *ds,
+        const view_td *view, const char *filename,
+        const session_cache_td *cache)
+{
+    size_t n = ds->size;
+    size_t point_bytes = n * dataset_point_size(ds->mode);
+    size_t col_bytes = n * sizeof(double);
+    size_t key_bytes = n * sizeof(long);
+    s_writer_td w = { NULL, 0, 0, 0 };
+    session_cache_td none;
+    size_t at = 0;
+
+    /* Where every column goes, from the first aligned offset */
+    s_write_u64(&w, n);
+    s_write_u64(&w, (uint64_t) ds->mode);
+    s_write_u64(&w, sizeof(long));
+    s_write_u64(&w, (ds->is_modified) ? 1 : 0);
+    s_write_u64(&w, ds->n_saved);
+    s_write_u64(&w, ds->saved_id);
+    s_write_u64(&w, at);
+    at += s_span(point_bytes);
+    s_write_u64(&w, (ds->keys != NULL) ? at : 0);
+    at += (ds->keys != NULL) ? s_span(key_bytes) : 0;
+
+    s_write_u64(&w, (ds->key_names != NULL) ? 1 : 0);
+    s_write_u64(&w, ds->n_key_names);
+    for (size_t i = 0; i < ds->n_key_names; ++i) {
+        s_write_str(&w, ds->key_names[i]);
+    }
+    s_write_u64(&w, ds->n_cols);
+    for (size_t i = 0; i < ds->n_cols; ++i) {
+        s_write_str(&w, ds->col_names[i]);
+        s_write_u64(&w, at);
+        at += s_span(col_bytes);
+    }
+    s_write_u64(&w, (filename != NULL) ? 1 : 0);
+    s_write_str(&w, (filename != NULL) ? filename : "");
+
+    for (int col = 0; col < 2; ++col) {
+        s_write_u64(&w, view->n_layers[col]);
+        for (size_t i = 0; i < view->n_layers[col]; ++i) {
+            const view_layer_td *l = &view->layers[col][i];
+            s_write_u64(&w, (uint64_t) l->step.op);
+            s_write_f64(&w, l->step.arg);
+            s_write_u64(&w, (l->enabled) ? 1 : 0);
+        }
+    }
+    if (cache == NULL) {
+        memset(&none, 0, sizeof(none));
+        cache = &none;
+    }
+    s_write_cache(&w, cache);
+    if (w.failed) {
+        free(w.p);
+        return 1;
+    }
+
+    unsigned char h[S_HEADER_SIZE];
+    uint64_t order = S_ORDER;
+    memcpy(h, SESSION_MAGIC, 8);
+    memcpy(h + 8, &order, 8);
+    s_put_le(h + 16, w.len);
+    s_put_le(h + 24, s_checksum(w.p, w.len));
+    size_t base = s_span(S_HEADER_SIZE + w.len - ARENA_MAP_OFFSET);
+
+    /* A new file, so that a session mapping the previous one keeps
+     * its pages */
+    size_t len = strlen(path) + sizeof(S_TMP_SUFFIX);
+    char *tmp = malloc(len);
+    FILE *fp = NULL;
+    int fd = -1;
+    int err = 1;
+
+    if (tmp != NULL) {
+        snprintf(tmp, len, "%s%s", path, S_TMP_SUFFIX);
+        fd = mkstemp(tmp);
+    }
+    if (fd >= 0 && (fp = fdopen(fd, "wb")) == NULL) {
+        close(fd);
+    }
+    if (fp != NULL) {
+        /* Only readable by its owner, as made by mkstemp */
+        err = fwrite(h, 1, S_HEADER_SIZE, fp) != S_HEADER_SIZE
+            || fwrite(w.p, 1, w.len, fp) != w.len;
+
+        /* Columns in the order of their offsets */
+        at = base;
+        if (err == 0 && n > 0) {
+            err = fseek(fp, (long) (at + ARENA_MAP_OFFSET), SEEK_SET) != 0
+                || fwrite(ds->points, 1, point_bytes, fp) != point_bytes;
+            at += s_span(point_bytes);
+        }
+        if (err == 0 && n > 0 && ds->keys != NULL) {
+            err = fseek(fp, (long) (at + ARENA_MAP_OFFSET), SEEK_SET) != 0
+                || fwrite(ds->keys, 1, key_bytes, fp) != key_bytes;
+            at += s_span(key_bytes);
+        }
+        for (size_t i = 0; err == 0 && n > 0 && i < ds->n_cols; ++i) {
+            err = fseek(fp, (long) (at + ARENA_MAP_OFFSET), SEEK_SET) != 0
+                || fwrite(ds->cols[i], 1, col_bytes, fp) != col_bytes;
+            at += s_span(col_bytes);
+        }
+        if (fclose(fp) != 0) {
+            err = 1;
+        }
+    }
+
+    if (err == 0 && rename(tmp, path) != 0) {
+        err = 1;
+    }
+    if (err != 0 && fd >= 0) {
+        unlink(tmp);
+    }
+    free(tmp);
+    free(w.p);
+
+    return err;
+}
+
+
+/**
+ * @brief Read the description of a snapshot
+ *
+ * @param fd   Descriptor of the snapshot, open for reading
+ * @param desc Where to store the description (to be freed)
+ * @param len  Where to store its number of bytes
+ * @param size Where to store the bytes of the snapshot
+ *
+ * @return 0 on success, 1 if the file is not a snapshot, 2 on memory
+ *         allocation failure, or 3 if it is corrupted
+ */
+static int s_read_desc(int fd, unsigned char **desc, size_t *len,
+        size_t *size)
+{
+    unsigned char h[S_HEADER_SIZE];
+    uint64_t order = S_ORDER;
+    struct stat st;
+
+    *desc = NULL;
+    if (fstat(fd, &st) != 0 ||
+            pread(fd, h, S_HEADER_SIZE, 0) != S_HEADER_SIZE ||
+            memcmp(h, SESSION_MAGIC, 8) != 0) {
+        return 1;
+    }
+    *size = (size_t) st.st_size;
+    *len = (size_t) s_get_le(h + 16);
+    if (memcmp(h + 8, &order, 8) != 0 ||
+            *len > *size - S_HEADER_SIZE) {
+        return 3;
+    }
+    if ((*desc = malloc(*len + 1)) == NULL) {
+        return 2;
+    }
+    if (pread(fd, *desc, *len, S_HEADER_SIZE) != (ssize_t) *len ||
+            s_checksum(*desc, *len) != s_get_le(h + 24)) {
+        free(*desc);
+        *desc = NULL;
+        return 3;
+    }
+
+    return 0;
+}
+
+
+/* Tell the number of points in a snapshot */
+size_t session_points(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    unsigned char *desc;
+    size_t len, size;
+    size_t n = 0;
+
+    if (fd < 0) {
+        return 0;
+    }
+    if (s_read_desc(fd, &desc, &len, &size) == 0) {
+        s_reader_td r = { desc, len, 0, 0 };
+        n = (size_t) s_read_u64(&r);
+        free(desc);
+    }
+    close(fd);
+
+    return n;
+}
+
+
+/**
+ * @brief Map a column of a snapshot
+ *
+ * @param fd    Descriptor of the snapshot
+ * @param base  Offset of the first column
+ * @param at    Offset of the column, from @p base
+ * @param bytes Bytes of the column
+ * @param size  Bytes of the snapshot
+ * @param p     Where to store the column, @c NULL if it is empty
+ *
+ * @return 0 on success, 1 if it cannot be mapped, or 3 if it is not in
+ *         the snapshot
+ */
+static int s_map(int fd, size_t base, uint64_t at, size_t bytes,
+        size_t size, void **p)
+{
+    *p = NULL;
+    if (bytes == 0) {
+        return 0;
+    }
+    if (at % SESSION_ALIGN != 0 || at > size || base > size - at ||
+            ARENA_MAP_OFFSET + bytes > size - base - at) {
+        return 3;
+    }
+
+    return ((*p = arena_map(fd, base + at, bytes)) == NULL);
+}
+
+
+/* Restore a session from a snapshot */
+int session_load(const char *path, dataset_td *ds, view_td *view,
+        char **filename, session_cache_td *cache)
+{
+    int fd = open(path, O_RDONLY);
+    unsigned char *desc;
+    size_t len, size;
+    int err;
+
+    if (fd < 0) {
+        return 1;
+    }
+    if ((err = s_read_desc(fd, &desc, &len, &size)) != 0) {
+        close(fd);
+        return err;
+    }
+
+    s_reader_td r = { desc, len, 0, 0 };
+    size_t base = s_span(S_HEADER_SIZE + len - ARENA_MAP_OFFSET);
+    dataset_td loaded;
+    session_cache_td c;
+    char *name = NULL;
+    void *p;
+
+    dataset_init(&loaded);
+    size_t n = (size_t) s_read_u64(&r);
+    uint64_t mode = s_read_u64(&r);
+    uint64_t key_size = s_read_u64(&r);
+    loaded.is_modified = (s_read_u64(&r) != 0);
+    loaded.n_saved = (size_t) s_read_u64(&r);
+    loaded.saved_id = s_read_u64(&r);
+    uint64_t at_points = s_read_u64(&r);
+    uint64_t at_keys = s_read_u64(&r);
+
+    /* Sizes that cannot be those of columns of the snapshot are told
+     * before anything is mapped */
+    err = (r.bad || mode > (DATASET_NO_EY | DATASET_SINGLE) ||
+            key_size != sizeof(long) || n > size / sizeof(float)) ? 3 : 0;
+    if (err == 0) {
+        loaded.mode = (int) mode;
+        err = s_map(fd, base, at_points,
+                n * dataset_point_size(loaded.mode), size, &p);
+        loaded.points = p;
+    }
+    if (err == 0 && at_keys != 0) {
+        err = s_map(fd, base, at_keys, n * sizeof(long), size, &p);
+        loaded.keys = p;
+
+        /* Grouped, even if empty */
+        if (err == 0 && p == NULL &&
+                (loaded.keys = arena_alloc(sizeof(long))) == NULL) {
+            err = 2;
+        }
+    }
+
+    int has_names = (s_read_u64(&r) != 0);
+    size_t n_names = (size_t) s_read_u64(&r);
+    if (err == 0 && (r.bad || n_names > len / 8)) {
+        err = 3;
+    }
+    if (err == 0 && has_names &&
+            (loaded.key_names = malloc((n_names + 1)
+                    * sizeof(*loaded.key_names))) == NULL) {
+        err = 2;
+    }
+    for (size_t i = 0; err == 0 && i < n_names; ++i) {
+        char *s = s_read_str(&r);
+        err = (r.bad || !has_names) ? 3 : (s == NULL) ? 2 : 0;
+        if (err == 0) {
+            loaded.key_names[loaded.n_key_names++] = s;
+        } else {
+            free(s);
+        }
+    }
+
+    size_t n_cols = (size_t) s_read_u64(&r);
+    if (err == 0 && (r.bad || n_cols > len / 16)) {
+        err = 3;
+    }
+    if (err == 0 && n_cols > 0 &&
+            ((loaded.cols = malloc(n_cols * sizeof(*loaded.cols)))
+                == NULL ||
+             (loaded.col_names = malloc(n_cols
+                * sizeof(*loaded.col_names))) == NULL)) {
+        err = 2;
+    }
+    for (size_t i = 0; err == 0 && i < n_cols; ++i) {
+        char *s = s_read_str(&r);
+        uint64_t at = s_read_u64(&r);
+
+        err = (r.bad) ? 3 : (s == NULL) ? 2 : 0;
+        if (err == 0) {
+            err = s_map(fd, base, at, n * sizeof(double), size, &p);
+        }
+        if (err == 0) {
+            loaded.cols[i] = p;
+            loaded.col_names[i] = s;
+            loaded.n_cols++;
+        } else {
+            free(s);
+        }
+    }
+    loaded.capacity = loaded.size = (err == 0) ? n : 0;
+
+    int has_name = (s_read_u64(&r) != 0);
+    name = s_read_str(&r);
+    if (err == 0) {
+        err = (r.bad) ? 3 : (name == NULL) ? 2 : 0;
+    }
+    if (!has_name) {
+        free(name);
+        name = NULL;
+    }
+
+    /* The stacks are checked whole before the view is changed */
+    view_layer_td layers[2][TRANSFORM_MAX_STEPS];
+    size_t n_layers[2] = { 0, 0 };
+    for (int col = 0; err == 0 && col < 2; ++col) {
+        n_layers[col] = (size_t) s_read_u64(&r);
+        if (n_layers[col] > TRANSFORM_MAX_STEPS) {
+            err = 3;
+            break;
+        }
+        for (size_t i = 0; i < n_layers[col]; ++i) {
+            uint64_t op = s_read_u64(&r);
+            layers[col][i].step.op = (op < TRANSFORM_MAX)
+                ? (transform_op_e) op : TRANSFORM_MAX;
+            layers[col][i].step.arg = s_read_f64(&r);
+            layers[col][i].enabled = (s_read_u64(&r) != 0);
+            err |= (op >= TRANSFORM_MAX) ? 3 : 0;
+        }
+    }
+    s_read_cache(&r, &c);
+    if (err == 0 && (r.bad || r.pos != r.len)) {
+        err = 3;
+    }
+
+    /* Mapped columns stay valid once the file is closed */
+    free(desc);
+    close(fd);
+    if (err != 0) {
+        free(name);
+        dataset_destroy(&loaded);
+        return err;
+    }
+
+    dataset_destroy(ds);
+    *ds = loaded;
+    view_clear(view);
+    for (int col = 0; col < 2; ++col) {
+        for (size_t i = 0; i < n_layers[col]; ++i) {
+            view_push(view, col, layers[col][i].step.op,
+                    layers[col][i].step.arg);
+            if (!layers[col][i].enabled) {
+                view_toggle(view, col, i);
+            }
+        }
+    }
+    view_invalidate(view);
+    *filename = name;
+    session_cache_clear(cache);
+    c.summary = NULL;
+    *cache = c;
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file slice.c
+ *
+ * @brief Implementation of non-owning slices of a dataset
+ */
+
+/* Local includes */
+#include <slice.h>
+
+
+/* Make a slice with every point of a dataset */
+slice_td slice_all(const dataset_td *ds)
+{
+    return slice_masked(ds, 0, ds->size, NULL);
+}
+
+
+/* Make a slice with a range of points of a dataset */
+slice_td slice_range(const dataset_td *ds, size_t begin, size_t end)
+{
+    return slice_masked(ds, begin, end, NULL);
+}
+
+
+/* Make a slice with the selected points of a range of a dataset */
+slice_td slice_masked(const dataset_td *ds, size_t begin, size_t end,
+        const uint64_t *mask)
+{
+    slice_td s;
+
+    if (end > ds->size) {
+        end = ds->size;
+    }
+    if (begin > end) {
+        begin = end;
+    }
+
+    s.ds = ds;
+    s.begin = begin;
+    s.end = end;
+    s.mask = mask;
+
+    return s;
+}
+
+
+/* Get the selected points of a word of a slice */
+uint64_t slice_bits(const slice_td *s, size_t w)
+{
+    size_t base = w * SLICE_WORD_BITS;
+    uint64_t bits;
+
+    if (s->begin >= base + SLICE_WORD_BITS || s->end <= base) {
+        return 0;
+    }
+
+    bits = (s->mask != NULL) ? s->mask[w] : ~(uint64_t) 0;
+    if (s->begin > base) {
+        bits &= ~(uint64_t) 0 << (s->begin - base);
+    }
+    if (s->end < base + SLICE_WORD_BITS) {
+        bits &= ~(uint64_t) 0 >> (base + SLICE_WORD_BITS - s->end);
+    }
+
+    return bits;
+}
+
+
+/* Count the points of a slice */
+size_t slice_count(const slice_td *s)
+{
+    size_t n = 0;
+
+    if (s->mask == NULL) {
+        return s->end - s->begin;
+    }
+
+    for (size_t w = s->begin / SLICE_WORD_BITS;
+            w < slice_mask_words(s->end); ++w) {
+        n += slice_popcount(slice_bits(s, w));
+    }
+
+    return n;
+}
+
+
+/* Count the bits set in a word */
+unsigned slice_popcount(uint64_t bits)
+{
+    /* Sum of bits in pairs, nibbles, then bytes (SWAR) */
+    bits -= (bits >> 1) & 0x5555555555555555ULL;
+    bits = (bits & 0x3333333333333333ULL)
+        + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+
+    return (unsigned) ((bits * 0x0101010101010101ULL) >> 56);
+}
+
+
+/* Expand a word of a selection bitmap into selection flags */
+void slice_expand(uint64_t bits, size_t len, double *on)
+{
+    for (size_t j = 0; j < len; ++j) {
+        on[j] = (double) (int) ((bits >> j) & 1u);
+    }
+}
@@ -7,55 +7,88 @@
 /* System includes */
 #include <stddef.h>     /* size_t */
 
+/* Project includes */
+#include <moments.h>
+#include <slice.h>
+
 /* Local includes */
 #include <stats.h>
 
 
 /* Compute statistics and populate the structure */
 stats_td stats_compute(const dataset_td *ds)
+{
+    slice_td s = slice_all(ds);
+
+    return stats_compute_slice(&s);
+}
+
+
+/* Compute statistics of a slice of a dataset */
+stats_td stats_compute_slice(const slice_td *s)
 {
     stats_td stats;
-    size_t n = ds->size;
-    double sum_x = 0, sum_y = 0, sum_x2 = 0, sum_y2 = 0, sum_xy = 0;
-
-    for (size_t i = 0; i < n; ++i) {
-        double x = ds->points[i].x;
-        double y = ds->points[i].y;
-        sum_x += x;
-        sum_y += y;
-        sum_x2 += x * x;
-        sum_y2 += y * y;
-        sum_xy += x * y;
-    }
-
-    double xmn = sum_x / n;
-    double ymn = sum_y / n;
-    double ssx = 0., ssy = 0.;
-    double  snx = 0., sny = 0., snxn1 = 0., snyn1 = 0.;
-    for (size_t i = 0; i < n; ++i) {
-        ssx += (ds->points[i].x - xmn) * (ds->points[i].x - xmn);
-        ssy += (ds->points[i].y - ymn) * (ds->points[i].y - ymn);
-    }
-    snx = ssx / n;
-    sny = ssy / n;
-    snxn1 = ssx / (n - 1);
-    snyn1 = ssy / (n - 1);
+    moments_td m, c;
+
+    /* Plain sums, then sums about the means */
+    moments_init(&m, 0.0, 0.0, 0);
+    moments_accumulate_slice(&m, s);
+
+    size_t n = m.n;
+    double xmn = m.sx / n;
+    double ymn = m.sy / n;
+
+    moments_init(&c, xmn, ymn, 0);
+    moments_accumulate_slice(&c, s);
+
+    double ssx = c.sxx;
+    double ssy = c.syy;
 
     /* Populate the structure */
     stats.n = n;
     stats.x_mean = xmn;
     stats.y_mean = ymn;
-    stats.sum_x = sum_x;
-    stats.sum_y = sum_y;
-    stats.sum_x2 = sum_x2;
-    stats.sum_y2 = sum_y2;
-    stats.sum_xy = sum_xy;
+    stats.sum_x = m.sx;
+    stats.sum_y = m.sy;
+    stats.sum_x2 = m.sxx;
+    stats.sum_y2 = m.syy;
+    stats.sum_xy = m.sxy;
+    stats.ssx = ssx;
+    stats.ssy = ssy;
+    stats.snx = ssx / n;
+    stats.sny = ssy / n;
+    stats.snxn1 = ssx / (n - 1);
+    stats.snyn1 = ssy / (n - 1);
+
+    return stats;
+}
+
+
+/* Compute statistics from unweighted moment sums */
+stats_td stats_from_moments(const moments_td *m)
+{
+    stats_td stats;
+    double n = (double) m->n;
+    double x0 = m->x0, y0 = m->y0;
+
+    /* Centered sums do not depend on the origin */
+    double ssx = m->sxx - m->sx * m->sx / n;
+    double ssy = m->syy - m->sy * m->sy / n;
+
+    stats.n = m->n;
+    stats.x_mean = x0 + m->sx / n;
+    stats.y_mean = y0 + m->sy / n;
+    stats.sum_x = m->sx + n * x0;
+    stats.sum_y = m->sy + n * y0;
+    stats.sum_x2 = m->sxx + 2.0 * x0 * m->sx + n * x0 * x0;
+    stats.sum_y2 = m->syy + 2.0 * y0 * m->sy + n * y0 * y0;
+    stats.sum_xy = m->sxy + x0 * m->sy + y0 * m->sx + n * x0 * y0;
     stats.ssx = ssx;
     stats.ssy = ssy;
-    stats.snx = snx;
-    stats.sny = sny;
-    stats.snxn1 = snxn1;
-    stats.snyn1 = snyn1;
+    stats.snx = ssx / n;
+    stats.sny = ssy / n;
+    stats.snxn1 = ssx / (n - 1);
+    stats.snyn1 = ssy / (n - 1);
 
     return stats;
 }
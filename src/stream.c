@@ -0,0 +1,514 @@
+/**
+ * @file stream.c
+ *
+ * @brief Implementation of the reading of text files that may be
+ *        compressed
+ */
+
+/* System includes */
+#include <pthread.h>    /* pthread_cond_wait, pthread_create, ... */
+#include <stdio.h>      /* clearerr, fclose, fgets, fread, fseek, ftell */
+#include <stdlib.h>     /* free, malloc */
+#include <string.h>     /* memchr, memcmp, memcpy, memset */
+#ifdef HAVE_ZLIB
+#include <zlib.h>       /* inflate, inflateInit2, inflateReset */
+#endif  /* HAVE_ZLIB */
+#ifdef HAVE_ZSTD
+#include <zstd.h>       /* ZSTD_createDStream, ZSTD_decompressStream */
+#endif  /* HAVE_ZSTD */
+
+/* Local includes */
+#include <stream.h>
+
+
+/** First bytes of a gzip member */
+static const unsigned char s_gzip_magic[] = { 0x1f, 0x8b };
+
+/** First bytes of a Zstandard frame */
+static const unsigned char s_zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+
+/**
+ * @brief Free the ring of a stream, and close its file
+ *
+ * @param s Pointer to the stream
+ */
+static void s_free(stream_td *s)
+{
+    for (size_t k = 0; k < STREAM_SLOTS; ++k) {
+        free(s->slots[k]);
+    }
+    fclose(s->fp);
+}
+
+
+/**
+ * @brief Tell the compression of a file from its first bytes
+ *
+ * The file seeks back to the bytes read, or if it cannot (a pipe), they
+ * are kept in the stream to be read again.
+ *
+ * @param s Pointer to the stream, with its file at the start of the
+ *          text
+ *
+ * @return Kind of the file (@e stream_kind_e)
+ */
+static int s_kind(stream_td *s)
+{
+    unsigned char *magic = s->back;
+    size_t n = fread(magic, 1, STREAM_MAGIC_LEN, s->fp);
+    int kind = STREAM_PLAIN;
+
+    if (n >= sizeof(s_gzip_magic) &&
+            memcmp(magic, s_gzip_magic, sizeof(s_gzip_magic)) == 0) {
+        kind = STREAM_GZIP;
+    } else if (n >= sizeof(s_zstd_magic) &&
+            memcmp(magic, s_zstd_magic, sizeof(s_zstd_magic)) == 0) {
+        kind = STREAM_ZSTD;
+    }
+
+    s->back_pos = 0;
+    s->n_back = (n == 0 || fseek(s->fp, -(long) n, SEEK_CUR) == 0) ? 0
+        : n;
+    clearerr(s->fp);
+
+    return kind;
+}
+
+
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+/**
+ * @brief Read bytes from the file of a stream, the ones kept by
+ *        @a s_kind() first
+ *
+ * @param s   Pointer to the stream
+ * @param buf Where to store the bytes
+ * @param len Bytes to read
+ *
+ * @return Bytes read, fewer than @p len only at the end of the file or
+ *         on failure (as @a fread())
+ */
+static size_t s_read(stream_td *s, unsigned char *buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len && s->back_pos < s->n_back) {
+        buf[n++] = s->back[s->back_pos++];
+    }
+    if (n < len) {
+        n += fread(buf + n, 1, len - n, s->fp);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Wait for a slot of the ring to be free, to fill it
+ *
+ * @param s Pointer to the stream
+ *
+ * @return Slot to fill, or -1 if the reader has stopped
+ */
+static int s_acquire(stream_td *s)
+{
+    int slot = -1;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->count == STREAM_SLOTS && !s->stop) {
+        pthread_cond_wait(&s->emptied, &s->lock);
+    }
+    if (!s->stop) {
+        slot = (int) ((s->head + s->count) % STREAM_SLOTS);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return slot;
+}
+
+
+/**
+ * @brief Hand a filled slot over to the reader
+ *
+ * @param s    Pointer to the stream
+ * @param slot Slot filled
+ * @param len  Bytes of text in the slot
+ */
+static void s_publish(stream_td *s, int slot, size_t len)
+{
+    pthread_mutex_lock(&s->lock);
+    s->lens[slot] = len;
+    s->count++;
+    pthread_cond_signal(&s->filled);
+    pthread_mutex_unlock(&s->lock);
+}
+#endif  /* HAVE_ZLIB || HAVE_ZSTD */
+
+
+#ifdef HAVE_ZLIB
+/**
+ * @brief Decompress a gzip file into the ring
+ *
+ * Members are decompressed one after another, as @c gzip does.
+ *
+ * @param s  Pointer to the stream
+ * @param in Buffer of @c STREAM_IN_SIZE bytes for the compressed data
+ *
+ * @return 0 on success, 1 on read failure, 2 on memory allocation
+ *         failure, or 3 if the data is corrupted or truncated
+ */
+static int s_gunzip(stream_td *s, unsigned char *in)
+{
+    z_stream z;
+    int member = 0;
+    int full = 0;
+    int err = 0;
+
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, 15 + 32) != Z_OK) {
+        return 2;
+    }
+
+    int slot = s_acquire(s);
+    if (slot >= 0) {
+        z.next_out = (Bytef *) s->slots[slot];
+        z.avail_out = STREAM_SLOT_SIZE;
+    }
+    while (slot >= 0) {
+        /* A full buffer may leave text to flush with no more input */
+        if (z.avail_in == 0 && !full) {
+            size_t n = s_read(s, in, STREAM_IN_SIZE);
+            if (n == 0) {
+                err = ferror(s->fp) ? 1 : (member ? 3 : 0);
+                break;
+            }
+            z.next_in = in;
+            z.avail_in = (uInt) n;
+        }
+
+        member |= (z.avail_in > 0);
+        int ret = inflate(&z, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            member = 0;
+            inflateReset(&z);
+        } else if (ret == Z_MEM_ERROR) {
+            err = 2;
+            break;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            err = 3;
+            break;
+        }
+
+        full = (z.avail_out == 0);
+        if (full) {
+            s_publish(s, slot, STREAM_SLOT_SIZE);
+            if ((slot = s_acquire(s)) >= 0) {
+                z.next_out = (Bytef *) s->slots[slot];
+                z.avail_out = STREAM_SLOT_SIZE;
+            }
+        }
+    }
+    if (slot >= 0 && z.avail_out < STREAM_SLOT_SIZE) {
+        s_publish(s, slot, STREAM_SLOT_SIZE - z.avail_out);
+    }
+    inflateEnd(&z);
+
+    return err;
+}
+#endif  /* HAVE_ZLIB */
+
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Decompress a Zstandard file into the ring
+ *
+ * Frames are decompressed one after another, as @c zstd does.
+ *
+ * @param s  Pointer to the stream
+ * @param in Buffer of @c STREAM_IN_SIZE bytes for the compressed data
+ *
+ * @return 0 on success, 1 on read failure, 2 on memory allocation
+ *         failure, or 3 if the data is corrupted or truncated
+ */
+static int s_unzstd(stream_td *s, unsigned char *in)
+{
+    ZSTD_DStream *d = ZSTD_createDStream();
+    ZSTD_inBuffer ib = { in, 0, 0 };
+    ZSTD_outBuffer ob = { NULL, 0, 0 };
+    size_t left = 0;
+    int full = 0;
+    int err = 0;
+
+    if (d == NULL) {
+        return 2;
+    }
+    if (ZSTD_isError(ZSTD_initDStream(d))) {
+        ZSTD_freeDStream(d);
+        return 2;
+    }
+
+    int slot = s_acquire(s);
+    if (slot >= 0) {
+        ob.dst = s->slots[slot];
+        ob.size = STREAM_SLOT_SIZE;
+    }
+    while (slot >= 0) {
+        /* A full buffer may leave text to flush with no more input */
+        if (ib.pos == ib.size && !full) {
+            size_t n = s_read(s, in, STREAM_IN_SIZE);
+            if (n == 0) {
+                err = ferror(s->fp) ? 1 : (left != 0 ? 3 : 0);
+                break;
+            }
+            ib.size = n;
+            ib.pos = 0;
+        }
+
+        /* Zero once a frame is whole and flushed */
+        left = ZSTD_decompressStream(d, &ob, &ib);
+        if (ZSTD_isError(left)) {
+            err = 3;
+            break;
+        }
+
+        full = (ob.pos == ob.size);
+        if (full) {
+            s_publish(s, slot, ob.pos);
+            if ((slot = s_acquire(s)) >= 0) {
+                ob.dst = s->slots[slot];
+                ob.pos = 0;
+            }
+        }
+    }
+    if (slot >= 0 && ob.pos > 0) {
+        s_publish(s, slot, ob.pos);
+    }
+    ZSTD_freeDStream(d);
+
+    return err;
+}
+#endif  /* HAVE_ZSTD */
+
+
+/**
+ * @brief Decompress a file into the ring of its stream
+ *
+ * @param arg Pointer to the @e stream_td
+ *
+ * @return Always @c NULL
+ */
+static void *s_worker(void *arg)
+{
+    stream_td *s = arg;
+    unsigned char *in = malloc(STREAM_IN_SIZE);
+    int err = 2;
+
+    if (in != NULL) {
+#ifdef HAVE_ZLIB
+        if (s->kind == STREAM_GZIP) {
+            err = s_gunzip(s, in);
+        }
+#endif  /* HAVE_ZLIB */
+#ifdef HAVE_ZSTD
+        if (s->kind == STREAM_ZSTD) {
+            err = s_unzstd(s, in);
+        }
+#endif  /* HAVE_ZSTD */
+        free(in);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->err = err;
+    s->done = 1;
+    pthread_cond_signal(&s->filled);
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+
+
+/* Start reading a text file, decompressing it if needed */
+int stream_open(stream_td *s, FILE *fp)
+{
+    s->fp = fp;
+    s->kind = s_kind(s);
+    s->threaded = 0;
+    if (s->kind == STREAM_PLAIN) {
+        return 0;
+    }
+
+#ifndef HAVE_ZLIB
+    if (s->kind == STREAM_GZIP) {
+        fclose(fp);
+        return 5;
+    }
+#endif  /* ! HAVE_ZLIB */
+#ifndef HAVE_ZSTD
+    if (s->kind == STREAM_ZSTD) {
+        fclose(fp);
+        return 5;
+    }
+#endif  /* ! HAVE_ZSTD */
+
+    int err = 0;
+    for (size_t k = 0; k < STREAM_SLOTS; ++k) {
+        s->slots[k] = malloc(STREAM_SLOT_SIZE);
+        err |= (s->slots[k] == NULL);
+    }
+    s->head = 0;
+    s->count = 0;
+    s->pos = 0;
+    s->done = 0;
+    s->stop = 0;
+    s->err = 0;
+    if (err) {
+        s_free(s);
+        return 2;
+    }
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->filled, NULL);
+    pthread_cond_init(&s->emptied, NULL);
+    if (pthread_create(&s->thread, NULL, s_worker, s) != 0) {
+        pthread_cond_destroy(&s->emptied);
+        pthread_cond_destroy(&s->filled);
+        pthread_mutex_destroy(&s->lock);
+        s_free(s);
+        return 1;
+    }
+    s->threaded = 1;
+
+    return 0;
+}
+
+
+/**
+ * @brief Wait for the slot at the head of the ring to hold text
+ *
+ * @param s Pointer to the stream
+ *
+ * @return Non-zero if there is text to read, or 0 at its end
+ */
+static int s_wait(stream_td *s)
+{
+    int ready;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->count == 0 && !s->done) {
+        pthread_cond_wait(&s->filled, &s->lock);
+    }
+    ready = (s->count > 0);
+    pthread_mutex_unlock(&s->lock);
+
+    return ready;
+}
+
+
+/**
+ * @brief Give the slot at the head of the ring back to the thread
+ *
+ * @param s Pointer to the stream
+ */
+static void s_release(stream_td *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->head = (s->head + 1) % STREAM_SLOTS;
+    s->count--;
+    s->pos = 0;
+    pthread_cond_signal(&s->emptied);
+    pthread_mutex_unlock(&s->lock);
+}
+
+
+/* Read a line of text from a stream */
+char *stream_gets(char *buf, size_t size, stream_td *s)
+{
+    size_t n = 0;
+
+    /* The bytes kept by s_kind() start the first line */
+    if (!s->threaded) {
+        while (n + 1 < size && s->back_pos < s->n_back) {
+            buf[n] = (char) s->back[s->back_pos++];
+            if (buf[n++] == '\n') {
+                break;
+            }
+        }
+        if (n == 0) {
+            return fgets(buf, (int) size, s->fp);
+        }
+        if (buf[n - 1] != '\n' && n + 1 < size &&
+                fgets(buf + n, (int) (size - n), s->fp) != NULL) {
+            return buf;
+        }
+        buf[n] = '\0';
+        return buf;
+    }
+
+    /* The slot at the head, once filled, is only written again after
+     * it is released, so it is read without holding the lock */
+    while (n + 1 < size && s_wait(s)) {
+        const char *p = s->slots[s->head] + s->pos;
+        size_t avail = s->lens[s->head] - s->pos;
+        if (avail > size - 1 - n) {
+            avail = size - 1 - n;
+        }
+
+        const char *nl = memchr(p, '\n', avail);
+        size_t len = (nl != NULL) ? (size_t) (nl - p) + 1 : avail;
+        memcpy(buf + n, p, len);
+        n += len;
+        s->pos += len;
+        if (s->pos == s->lens[s->head]) {
+            s_release(s);
+        }
+        if (nl != NULL) {
+            break;
+        }
+    }
+    if (n == 0) {
+        return NULL;
+    }
+    buf[n] = '\0';
+
+    return buf;
+}
+
+
+/* Tell how far a stream has been read */
+long stream_tell(stream_td *s)
+{
+    long pos;
+
+    if (s->threaded || (pos = ftell(s->fp)) < 0) {
+        return -1;
+    }
+
+    return pos - (long) (s->n_back - s->back_pos);
+}
+
+
+/* Stop reading a stream, and close its file */
+int stream_close(stream_td *s)
+{
+    int err;
+
+    if (!s->threaded) {
+        fclose(s->fp);
+        return 0;
+    }
+
+    /* The thread may be waiting for a slot the reader will not free */
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_signal(&s->emptied);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+
+    err = s->err;
+    pthread_cond_destroy(&s->emptied);
+    pthread_cond_destroy(&s->filled);
+    pthread_mutex_destroy(&s->lock);
+    s_free(s);
+
+    return err;
+}
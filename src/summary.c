@@ -0,0 +1,669 @@
+/**
+ * @file summary.c
+ *
+ * @brief Implementation of the block-summary index of a data file
+ */
+
+#define _POSIX_C_SOURCE 200809L /* fchmod, mkstemp, pread, st_mtim */
+
+
+/* System includes */
+#include <fcntl.h>      /* open, O_RDONLY */
+#include <stdio.h>      /* fclose, fopen, fread, rename, snprintf */
+#include <stdlib.h>     /* free, malloc, mkstemp */
+#include <string.h>     /* memcmp, memcpy, strlen */
+#include <sys/stat.h>   /* fchmod, fstat, stat, umask */
+#include <unistd.h>     /* access, close, pread, unlink, write */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+/* Local includes */
+#include <summary.h>
+
+
+#define S_HEADER_SIZE (48)      /**< Bytes of the header */
+#define S_BLOCK_SIZE (176)      /**< Bytes of the summary of a block */
+#define S_BUF_SIZE (1 << 20)    /**< Bytes of a file hashed at once (a
+                                     multiple of 8) */
+#define S_TMP_SUFFIX ".XXXXXX"  /**< Appended to the name of an index to
+                                     make its temporary copy */
+#define S_FNV_BASIS (14695981039346656037ULL)   /**< FNV offset basis */
+#define S_FNV_PRIME (1099511628211ULL)          /**< FNV prime */
+
+
+/*
+ * Layout of an index (integers are little endian, values are the bits
+ * of IEEE 754 doubles):
+ *
+ *   - header, S_HEADER_SIZE bytes:
+ *       0 magic, 8 state of the file, 16 identity of the options it was
+ *       read with, 24 points, 32 blocks, 40 checksum of the first 40
+ *       bytes of the header and of every block
+ *   - blocks, S_BLOCK_SIZE bytes each:
+ *       0 points, 8 x0, 16 y0, 24 unweighted sums (s, sx, sy, sxx,
+ *       sxy, syy), 72 weighted sums (idem), 120 smallest x, 128
+ *       largest x, 136 smallest y, 144 largest y, 152 flags, 160 end
+ *       of the block in the file, 168 checksum of its bytes
+ */
+
+
+/**
+ * @brief Store an integer of 8 bytes, little endian
+ *
+ * @param p Where to store it
+ * @param v Value to store
+ */
+static void s_put_le(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+
+/**
+ * @brief Read an integer of 8 bytes, little endian
+ *
+ * @param p Where to read it from
+ *
+ * @return Value read
+ */
+static uint64_t s_get_le(const unsigned char *p)
+{
+    uint64_t v = 0;
+
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+
+/**
+ * @brief Store a double as its bits, little endian
+ *
+ * @param p Where to store it
+ * @param v Value to store
+ */
+static void s_put_double(unsigned char *p, double v)
+{
+    uint64_t u;
+
+    memcpy(&u, &v, sizeof(u));
+    s_put_le(p, u);
+}
+
+
+/**
+ * @brief Read a double stored as its bits, little endian
+ *
+ * @param p Where to read it from
+ *
+ * @return Value read
+ */
+static double s_get_double(const unsigned char *p)
+{
+    uint64_t u = s_get_le(p);
+    double v;
+
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+
+/**
+ * @brief Checksum of a range of bytes (FNV-1a, on 64-bit words)
+ *
+ * Whole words are hashed at once, which is several times faster than
+ * byte by byte on the large ranges of a data file; the bytes left
+ * over, if any, are then hashed one by one.
+ *
+ * @param h   Checksum of the bytes before (if they were a multiple of
+ *            8), or @c S_FNV_BASIS
+ * @param p   Bytes to hash
+ * @param len Number of bytes
+ *
+ * @return Checksum of the bytes
+ */
+static uint64_t s_checksum(uint64_t h, const unsigned char *p, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        h ^= s_get_le(p + i);
+        h *= S_FNV_PRIME;
+    }
+    for (; i < len; ++i) {
+        h ^= p[i];
+        h *= S_FNV_PRIME;
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Checksum of a range of bytes of a file
+ *
+ * @param fd    Descriptor of the file, open for reading
+ * @param begin Offset of the first byte
+ * @param end   Offset one past the last byte
+ * @param buf   Buffer of @c S_BUF_SIZE bytes
+ * @param h     Where to store the checksum
+ *
+ * @return 0 on success, or 1 if the bytes cannot be read
+ */
+static int s_checksum_file(int fd, uint64_t begin, uint64_t end,
+        unsigned char *buf, uint64_t *h)
+{
+    *h = S_FNV_BASIS;
+    while (begin < end) {
+        size_t len = (end - begin < S_BUF_SIZE)
+            ? (size_t) (end - begin) : S_BUF_SIZE;
+        ssize_t got = pread(fd, buf, len, (off_t) begin);
+
+        if (got != (ssize_t) len) {
+            return 1;
+        }
+        *h = s_checksum(*h, buf, len);
+        begin += len;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Get the state of a file
+ *
+ * @param filename Path to the file
+ *
+ * @return Checksum of the device, inode, size and modification time of
+ *         the file (never 0), or 0 if it does not exist
+ */
+static uint64_t s_state(const char *filename)
+{
+    unsigned char f[40];
+    struct stat st;
+
+    if (stat(filename, &st) != 0) {
+        return 0;
+    }
+    s_put_le(f, (uint64_t) st.st_dev);
+    s_put_le(f + 8, (uint64_t) st.st_ino);
+    s_put_le(f + 16, (uint64_t) st.st_size);
+    s_put_le(f + 24, (uint64_t) st.st_mtim.tv_sec);
+    s_put_le(f + 32, (uint64_t) st.st_mtim.tv_nsec);
+
+    uint64_t h = s_checksum(S_FNV_BASIS, f, sizeof(f));
+    return (h != 0) ? h : 1;
+}
+
+
+/**
+ * @brief Get the path of the index of a file
+ *
+ * @param filename Path to the file
+ * @param suffix   Appended to the path, or an empty string
+ *
+ * @return Path of the index (to be freed), or @c NULL on memory
+ *         allocation failure
+ */
+static char *s_path(const char *filename, const char *suffix)
+{
+    size_t len = strlen(filename) + strlen(SUMMARY_EXT)
+        + strlen(suffix) + 1;
+    char *path = malloc(len);
+
+    if (path != NULL) {
+        snprintf(path, len, "%s%s%s", filename, SUMMARY_EXT, suffix);
+    }
+
+    return path;
+}
+
+
+/**
+ * @brief Store the summary of a block
+ *
+ * @param p Where to store it, @c S_BLOCK_SIZE bytes
+ * @param b Pointer to the summary of the block
+ */
+static void s_put_block(unsigned char *p, const summary_block_td *b)
+{
+    const moments_td *m[2] = { &b->plain, &b->weighted };
+
+    s_put_le(p, b->plain.n);
+    s_put_double(p + 8, b->plain.x0);
+    s_put_double(p + 16, b->plain.y0);
+    for (int k = 0; k < 2; ++k) {
+        unsigned char *q = p + 24 + 48 * k;
+        s_put_double(q, m[k]->s);
+        s_put_double(q + 8, m[k]->sx);
+        s_put_double(q + 16, m[k]->sy);
+        s_put_double(q + 24, m[k]->sxx);
+        s_put_double(q + 32, m[k]->sxy);
+        s_put_double(q + 40, m[k]->syy);
+    }
+    s_put_double(p + 120, b->x_min);
+    s_put_double(p + 128, b->x_max);
+    s_put_double(p + 136, b->y_min);
+    s_put_double(p + 144, b->y_max);
+    s_put_le(p + 152, (b->has_ey) ? 1 : 0);
+    s_put_le(p + 160, b->end);
+    s_put_le(p + 168, b->hash);
+}
+
+
+/**
+ * @brief Read the summary of a block
+ *
+ * @param p Where to read it from, @c S_BLOCK_SIZE bytes
+ * @param b Pointer to where the summary is stored
+ */
+static void s_get_block(const unsigned char *p, summary_block_td *b)
+{
+    moments_td *m[2] = { &b->plain, &b->weighted };
+
+    for (int k = 0; k < 2; ++k) {
+        const unsigned char *q = p + 24 + 48 * k;
+        moments_init(m[k], s_get_double(p + 8), s_get_double(p + 16), k);
+        m[k]->n = (size_t) s_get_le(p);
+        m[k]->s = s_get_double(q);
+        m[k]->sx = s_get_double(q + 8);
+        m[k]->sy = s_get_double(q + 16);
+        m[k]->sxx = s_get_double(q + 24);
+        m[k]->sxy = s_get_double(q + 32);
+        m[k]->syy = s_get_double(q + 40);
+    }
+    b->x_min = s_get_double(p + 120);
+    b->x_max = s_get_double(p + 128);
+    b->y_min = s_get_double(p + 136);
+    b->y_max = s_get_double(p + 144);
+    b->has_ey = (s_get_le(p + 152) & 1) != 0;
+    b->end = s_get_le(p + 160);
+    b->hash = s_get_le(p + 168);
+}
+
+
+/* Summarize the points of a dataset in blocks */
+int summary_build(summary_td *sm, const dataset_td *ds, size_t n,
+        const char *filename, const uint64_t *ends, uint64_t options)
+{
+    sm->n = n;
+    sm->n_blocks = (n + SUMMARY_BLOCK - 1) / SUMMARY_BLOCK;
+    sm->options = options;
+    sm->has_bytes = (filename != NULL && ends != NULL);
+    sm->blocks = NULL;
+    if (sm->n_blocks > 0 &&
+            (sm->blocks = malloc(sm->n_blocks * sizeof(*sm->blocks)))
+                == NULL) {
+        return 2;
+    }
+
+    for (size_t k = 0; k < sm->n_blocks; ++k) {
+        summary_block_td *b = &sm->blocks[k];
+        size_t begin = k * SUMMARY_BLOCK;
+        size_t end = (n - begin < SUMMARY_BLOCK)
+            ? n : begin + SUMMARY_BLOCK;
+        data_point_td p0 = dataset_get(ds, begin);
+
+        moments_init(&b->plain, p0.x, p0.y, 0);
+        moments_init(&b->weighted, p0.x, p0.y, 1);
+        b->x_min = b->x_max = p0.x;
+        b->y_min = b->y_max = p0.y;
+        b->has_ey = 0;
+        for (size_t i = begin; i < end; ++i) {
+            data_point_td p = dataset_get(ds, i);
+            moments_add(&b->plain, p.x, p.y, p.ey);
+            moments_add(&b->weighted, p.x, p.y, p.ey);
+            b->x_min = (p.x < b->x_min) ? p.x : b->x_min;
+            b->x_max = (p.x > b->x_max) ? p.x : b->x_max;
+            b->y_min = (p.y < b->y_min) ? p.y : b->y_min;
+            b->y_max = (p.y > b->y_max) ? p.y : b->y_max;
+            b->has_ey |= (p.ey > 0.0);
+        }
+        b->end = (sm->has_bytes) ? ends[k] : 0;
+        b->hash = 0;
+    }
+    if (!sm->has_bytes || sm->n_blocks == 0) {
+        return 0;
+    }
+
+    /* The bytes are hashed once the points are summarized, from the
+     * file itself (they are most likely still cached) */
+    unsigned char *buf = malloc(S_BUF_SIZE);
+    int fd = open(filename, O_RDONLY);
+    int err = (buf == NULL) ? 2 : (fd < 0);
+
+    for (size_t k = 0; err == 0 && k < sm->n_blocks; ++k) {
+        uint64_t begin = (k > 0) ? sm->blocks[k - 1].end : 0;
+        err = s_checksum_file(fd, begin, sm->blocks[k].end, buf,
+                &sm->blocks[k].hash);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+    if (err != 0) {
+        summary_destroy(sm);
+    }
+
+    return err;
+}
+
+
+/* Free the memory used by a summary */
+void summary_destroy(summary_td *sm)
+{
+    free(sm->blocks);
+    sm->blocks = NULL;
+    sm->n = sm->n_blocks = 0;
+}
+
+
+/**
+ * @brief Write an index with the state of its file as it is now
+ *
+ * @param sm       Pointer to the summary
+ * @param filename Path to the file
+ * @param state    State of the file (see @a s_state())
+ *
+ * @return 0 on success, or 1 on failure
+ */
+static int s_write(const summary_td *sm, const char *filename,
+        uint64_t state)
+{
+    size_t len = S_HEADER_SIZE + sm->n_blocks * S_BLOCK_SIZE;
+    unsigned char *h = malloc(len);
+    char *path = s_path(filename, "");
+    char *tmp = s_path(filename, S_TMP_SUFFIX);
+    int fd = -1;
+    int err = 1;
+
+    if (h == NULL || path == NULL || tmp == NULL ||
+            (fd = mkstemp(tmp)) < 0) {
+        goto done;
+    }
+
+    memcpy(h, SUMMARY_MAGIC, 8);
+    s_put_le(h + 8, state);
+    s_put_le(h + 16, sm->options);
+    s_put_le(h + 24, sm->n);
+    s_put_le(h + 32, sm->n_blocks);
+    for (size_t k = 0; k < sm->n_blocks; ++k) {
+        s_put_block(h + S_HEADER_SIZE + k * S_BLOCK_SIZE, &sm->blocks[k]);
+    }
+    s_put_le(h + 40, s_checksum(s_checksum(S_FNV_BASIS, h, 40),
+                h + S_HEADER_SIZE, len - S_HEADER_SIZE));
+
+    /* Readable by whoever may read a new file */
+    mode_t mask = umask(0);
+    umask(mask);
+    err = (fchmod(fd, 0666 & ~mask) != 0);
+
+    for (size_t done = 0; err == 0 && done < len; ) {
+        ssize_t n = write(fd, h + done, len - done);
+        err = (n <= 0);
+        done += (n > 0) ? (size_t) n : 0;
+    }
+    if (close(fd) != 0 || err != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        err = 1;
+    }
+
+done:
+    free(h);
+    free(path);
+    free(tmp);
+
+    return err;
+}
+
+
+/* Write a summary as the index of a file */
+int summary_write(const summary_td *sm, const char *filename)
+{
+    uint64_t state = s_state(filename);
+
+    if (!sm->has_bytes || sm->n_blocks == 0 || state == 0) {
+        return 1;
+    }
+
+    return s_write(sm, filename, state);
+}
+
+
+/**
+ * @brief Check the blocks of a summary against the bytes of its file
+ *
+ * @param sm       Pointer to the summary
+ * @param filename Path to the file
+ *
+ * @return 0 if every block matches the file, 2 on memory allocation
+ *         failure, or 3 otherwise
+ */
+static int s_verify(const summary_td *sm, const char *filename)
+{
+    unsigned char *buf = malloc(S_BUF_SIZE);
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    int err = (buf == NULL) ? 2 : 0;
+
+    /* A file that grew or shrank is not checked any further */
+    if (err == 0 && (fd < 0 || fstat(fd, &st) != 0 ||
+                (uint64_t) st.st_size
+                    != sm->blocks[sm->n_blocks - 1].end)) {
+        err = 3;
+    }
+    for (size_t k = 0; err == 0 && k < sm->n_blocks; ++k) {
+        uint64_t begin = (k > 0) ? sm->blocks[k - 1].end : 0;
+        uint64_t h;
+
+        if (s_checksum_file(fd, begin, sm->blocks[k].end, buf, &h) != 0
+                || h != sm->blocks[k].hash) {
+            err = 3;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+
+    return err;
+}
+
+
+/* Read the index of a file, if it is up to date */
+int summary_read(summary_td *sm, const char *filename, uint64_t options)
+{
+    unsigned char h[S_HEADER_SIZE];
+    unsigned char *data = NULL;
+    char *path = s_path(filename, "");
+    uint64_t state = s_state(filename);
+    struct stat st;
+    FILE *fp = NULL;
+    int err = 1;
+
+    sm->n = sm->n_blocks = 0;
+    sm->blocks = NULL;
+    if (path == NULL) {
+        return 2;
+    }
+    if (state == 0 || (fp = fopen(path, "rb")) == NULL ||
+            fstat(fileno(fp), &st) != 0 ||
+            fread(h, 1, S_HEADER_SIZE, fp) != S_HEADER_SIZE) {
+        goto done;
+    }
+
+    /* Every block is whole, and holds the points it has to */
+    err = 3;
+    size_t n = (size_t) s_get_le(h + 24);
+    size_t n_blocks = (size_t) s_get_le(h + 32);
+    if (memcmp(h, SUMMARY_MAGIC, 8) != 0 || s_get_le(h + 16) != options
+            || n_blocks != (n + SUMMARY_BLOCK - 1) / SUMMARY_BLOCK
+            || n_blocks == 0
+            || n_blocks > ((size_t) st.st_size - S_HEADER_SIZE)
+                / S_BLOCK_SIZE
+            || (size_t) st.st_size
+                != S_HEADER_SIZE + n_blocks * S_BLOCK_SIZE) {
+        goto done;
+    }
+    size_t len = n_blocks * S_BLOCK_SIZE;
+    if ((data = malloc(len)) == NULL ||
+            (sm->blocks = malloc(n_blocks * sizeof(*sm->blocks)))
+                == NULL) {
+        err = 2;
+        goto done;
+    }
+    if (fread(data, 1, len, fp) != len ||
+            s_checksum(s_checksum(S_FNV_BASIS, h, 40), data, len)
+                != s_get_le(h + 40)) {
+        goto done;
+    }
+
+    uint64_t prev = 0;
+    for (size_t k = 0; k < n_blocks; ++k) {
+        summary_block_td *b = &sm->blocks[k];
+        size_t want = (n - k * SUMMARY_BLOCK < SUMMARY_BLOCK)
+            ? n - k * SUMMARY_BLOCK : SUMMARY_BLOCK;
+
+        s_get_block(data + k * S_BLOCK_SIZE, b);
+        if (b->plain.n != want || b->end < prev) {
+            goto done;
+        }
+        prev = b->end;
+    }
+    sm->n = n;
+    sm->n_blocks = n_blocks;
+    sm->options = options;
+    sm->has_bytes = 1;
+
+    /* Copied or touched files are told apart from rewritten ones by the
+     * bytes of their blocks */
+    err = 0;
+    if (s_get_le(h + 8) != state && (err = s_verify(sm, filename)) == 0) {
+        s_write(sm, filename, state);
+    }
+
+done:
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    if (err != 0) {
+        summary_destroy(sm);
+    }
+    free(data);
+    free(path);
+
+    return err;
+}
+
+
+/* Tell if a file has an index, up to date or not */
+int summary_exists(const char *filename)
+{
+    char *path = s_path(filename, "");
+    int exists = (path != NULL && access(path, F_OK) == 0);
+
+    free(path);
+
+    return exists;
+}
+
+
+/* Remove the index of a file, if it has one */
+void summary_remove(const char *filename)
+{
+    char *path = s_path(filename, "");
+
+    if (path != NULL) {
+        unlink(path);
+    }
+    free(path);
+}
+
+
+/* Get the moment sums of a run of blocks */
+void summary_moments(const summary_td *sm, size_t begin, size_t end,
+        int weighted, moments_td *m)
+{
+    if (begin >= end) {
+        moments_init(m, 0.0, 0.0, weighted);
+        return;
+    }
+
+    moments_init(m, sm->blocks[begin].plain.x0,
+            sm->blocks[begin].plain.y0, weighted);
+    for (size_t k = begin; k < end; ++k) {
+        moments_td b = (weighted) ? sm->blocks[k].weighted
+            : sm->blocks[k].plain;
+        moments_shift(&b, m->x0, m->y0);
+        moments_merge(m, &b);
+    }
+}
+
+
+/* Fit the points of a run of blocks */
+regression_td summary_fit(const summary_td *sm, size_t begin, size_t end)
+{
+    moments_td m;
+    int weighted = 0;
+
+    for (size_t k = begin; k < end; ++k) {
+        weighted |= sm->blocks[k].has_ey;
+    }
+    summary_moments(sm, begin, end, weighted, &m);
+
+    return regres_from_moments(&m);
+}
+
+
+/* Fit the points whose 'x' lies in a closed range */
+regression_td summary_fit_range(const summary_td *sm, const dataset_td *ds,
+        double xa, double xb, size_t *n_out)
+{
+    moments_td m;
+    int weighted = 0;
+
+    for (size_t k = 0; k < sm->n_blocks; ++k) {
+        weighted |= sm->blocks[k].has_ey;
+    }
+    if (sm->n_blocks > 0) {
+        moments_init(&m, sm->blocks[0].plain.x0, sm->blocks[0].plain.y0,
+                weighted);
+    } else {
+        moments_init(&m, 0.0, 0.0, weighted);
+    }
+
+    for (size_t k = 0; k < sm->n_blocks; ++k) {
+        const summary_block_td *b = &sm->blocks[k];
+
+        if (b->x_max < xa || b->x_min > xb) {
+            continue;
+        }
+        if (b->x_min >= xa && b->x_max <= xb) {
+            moments_td o = (weighted) ? b->weighted : b->plain;
+            moments_shift(&o, m.x0, m.y0);
+            moments_merge(&m, &o);
+            continue;
+        }
+
+        size_t end = (k + 1) * SUMMARY_BLOCK;
+        for (size_t i = k * SUMMARY_BLOCK; i < end && i < sm->n; ++i) {
+            data_point_td p = dataset_get(ds, i);
+            if (p.x >= xa && p.x <= xb) {
+                moments_add(&m, p.x, p.y, p.ey);
+            }
+        }
+    }
+    if (n_out != NULL) {
+        *n_out = m.n;
+    }
+
+    return regres_from_moments(&m);
+}
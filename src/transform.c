@@ -0,0 +1,357 @@
+/**
+ * @file transform.c
+ *
+ * @brief Implementation of the column-transform pipeline
+ */
+
+/* System includes */
+#include <float.h>      /* DBL_MIN */
+#include <math.h>       /* INFINITY, NAN, fabs, floor, fmod, sqrt */
+#include <stdint.h>     /* uint64_t */
+#include <string.h>     /* memcpy */
+
+/* Project includes */
+#include <dataset.h>
+
+/* Local includes */
+#include <transform.h>
+
+
+#define S_LN2_HI  (6.93147180369123816490e-01) /**< High bits of ln(2) */
+#define S_LN2_LO  (1.90821492927058770002e-10) /**< ln(2) - S_LN2_HI */
+#define S_LOG2E   (1.44269504088896338700e+00) /**< 1/ln(2) */
+#define S_SQRT2   (1.41421356237309514547e+00) /**< sqrt(2) */
+#define S_ROUND   (6755399441055744.0)         /**< 1.5*2^52, rounds to
+                                                    integer when added */
+#define S_EXP_HI  (709.782712893383973096)     /**< exp overflows above */
+#define S_EXP_LO  (-745.133219101941108420)    /**< exp is 0 below */
+
+/* Minimax coefficients of (log(1+f) - 2*s)/s^3, s = f/(2+f), in s^2
+ * (the same ones as the classic fdlibm 'e_log.c') */
+#define S_LG1     (6.666666666666735130e-01)
+#define S_LG2     (3.999999999940941908e-01)
+#define S_LG3     (2.857142874366239149e-01)
+#define S_LG4     (2.222219843214978396e-01)
+#define S_LG5     (1.818357216161805012e-01)
+#define S_LG6     (1.531383769920937332e-01)
+#define S_LG7     (1.479819860511658591e-01)
+
+
+/**
+ * @brief Build the double @e 2^(k-1024), for @e k in the normal range
+ *
+ * @param k Exponent plus 1024, in [2, 2047]
+ *
+ * @return @e 2^(k-1024)
+ */
+static double s_pow2(uint64_t k)
+{
+    uint64_t bits = (k - 1) << 52;
+    double d;
+
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+
+/* Natural logarithm of every value of a block */
+void transform_log_block(double *v, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double x = v[i];
+
+        /* Subnormals are scaled up to get a full mantissa (both bit
+         * patterns are computed and one is selected: no branches) */
+        double xs = x * 18014398509481984.0;    /* 2^54 */
+        uint64_t bx, bs;
+        memcpy(&bx, &x, sizeof(bx));
+        memcpy(&bs, &xs, sizeof(bs));
+        uint64_t bits = (x < DBL_MIN) ? bs : bx;
+        uint64_t bias = (x < DBL_MIN)
+            ? 0x4330000000000435ULL : 0x43300000000003ffULL;
+
+        /* Exponent as a double without an integer conversion: the
+         * mantissa of 2^52 + field holds the biased exponent field */
+        uint64_t eb = 0x4330000000000000ULL | ((bits >> 52) & 0x7ff);
+        double de, db;
+        memcpy(&de, &eb, sizeof(de));
+        memcpy(&db, &bias, sizeof(db));
+        de -= db;                   /* 2^52 + 1023 (+ 54) */
+
+        /* Mantissa in [1, 2), halved if above sqrt(2) */
+        bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+        double m;
+        memcpy(&m, &bits, sizeof(m));
+        int big = (m > S_SQRT2);
+        m *= big ? 0.5 : 1.0;
+        de += big ? 1.0 : 0.0;
+
+        double f = m - 1.0;
+        double s = f / (2.0 + f);
+        double z = s * s;
+        double r = S_LG7;
+        r = r * z + S_LG6;
+        r = r * z + S_LG5;
+        r = r * z + S_LG4;
+        r = r * z + S_LG3;
+        r = r * z + S_LG2;
+        r = r * z + S_LG1;
+        double lm = f - s * (f - z * r);    /* 2*s + s^3*r */
+        double y = de * S_LN2_HI + (lm + de * S_LN2_LO);
+
+        /* Same special values as the C library */
+        y = (x == INFINITY) ? INFINITY : y;
+        y = (x == 0.0) ? -INFINITY : y;
+        y = ((x < 0.0) | (x != x)) ? NAN : y;
+        v[i] = y;
+    }
+}
+
+
+/* Exponential of every value of a block */
+void transform_exp_block(double *v, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double x = v[i];
+
+        /* The low bits of 't' hold k = round(x/ln(2)); values out of
+         * the finite range give garbage here, replaced at the end */
+        double t = x * S_LOG2E + S_ROUND;
+        double kd = t - S_ROUND;
+        double r = (x - kd * S_LN2_HI) - kd * S_LN2_LO;
+        double p = 1.0 / 6227020800.0;
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+
+        /* 2^k in two halves, each one a normal number */
+        uint64_t kb;
+        memcpy(&kb, &t, sizeof(kb));
+        uint64_t k = kb - 0x4338000000000000ULL + 2048;     /* k + 2048 */
+        uint64_t k1 = k >> 1;
+        double y = p * s_pow2(k1) * s_pow2(k - k1);
+
+        y = (x > S_EXP_HI) ? INFINITY : y;
+        y = (x < S_EXP_LO) ? 0.0 : y;
+        y = (x != x) ? x : y;
+        v[i] = y;
+    }
+}
+
+
+/**
+ * @brief Apply a step to a block, updating the derivative of the chain
+ *
+ * @param st Step to apply
+ * @param v  Values, overwritten by the results
+ * @param d  Derivatives of the chain so far, or @c NULL if not needed
+ * @param t  Scratch buffer of the same size
+ * @param n  Number of values
+ */
+static void s_step_block(const transform_step_td *st, double *v,
+        double *d, double *t, size_t n)
+{
+    double c = st->arg;
+
+    switch (st->op) {
+        case TRANSFORM_LOG:
+            if (d != NULL) {
+                for (size_t i = 0; i < n; ++i) {
+                    d[i] /= v[i];
+                }
+            }
+            transform_log_block(v, n);
+            break;
+
+        case TRANSFORM_EXP:
+            transform_exp_block(v, n);
+            if (d != NULL) {
+                for (size_t i = 0; i < n; ++i) {
+                    d[i] *= v[i];
+                }
+            }
+            break;
+
+        case TRANSFORM_INV:
+            for (size_t i = 0; i < n; ++i) {
+                double r = (v[i] != 0.0) ? 1.0 / v[i] : v[i];
+                if (d != NULL) {
+                    d[i] *= (v[i] != 0.0) ? r * r : 1.0;
+                }
+                v[i] = r;
+            }
+            break;
+
+        case TRANSFORM_SCALE:
+            for (size_t i = 0; i < n; ++i) {
+                v[i] *= c;
+            }
+            if (d != NULL) {
+                for (size_t i = 0; i < n; ++i) {
+                    d[i] *= c;
+                }
+            }
+            break;
+
+        case TRANSFORM_OFFSET:
+            for (size_t i = 0; i < n; ++i) {
+                v[i] += c;
+            }
+            break;
+
+        case TRANSFORM_POW:
+            if (c == 2.0) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (d != NULL) {
+                        d[i] *= 2.0 * v[i];
+                    }
+                    v[i] *= v[i];
+                }
+                break;
+            }
+            if (c == 0.5) {
+                for (size_t i = 0; i < n; ++i) {
+                    v[i] = sqrt(v[i]);
+                    if (d != NULL) {
+                        d[i] *= 0.5 / v[i];
+                    }
+                }
+                break;
+            }
+
+            /* |v|^c = exp(c*log|v|), then the sign for negative bases:
+             * odd integer powers keep it, other integers drop it, and
+             * fractional powers are not real */
+            {
+                int odd = (c == floor(c)) && (fabs(fmod(c, 2.0)) == 1.0);
+                int whole = (c == floor(c));
+
+                for (size_t i = 0; i < n; ++i) {
+                    t[i] = fabs(v[i]);
+                }
+                transform_log_block(t, n);
+                for (size_t i = 0; i < n; ++i) {
+                    t[i] *= c;
+                }
+                transform_exp_block(t, n);
+                for (size_t i = 0; i < n; ++i) {
+                    double r = t[i];
+                    r = (v[i] < 0.0 && odd) ? -r : r;
+                    r = (v[i] < 0.0 && !whole) ? NAN : r;
+                    r = (c == 0.0) ? 1.0 : r;
+                    if (d != NULL) {
+                        d[i] *= (v[i] != 0.0) ? c * r / v[i] : 0.0;
+                    }
+                    v[i] = r;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/* Initialize an empty pipeline */
+void transform_init(transform_td *t)
+{
+    t->n_steps[0] = t->n_steps[1] = 0;
+}
+
+
+/* Queue an operation on a column */
+int transform_push(transform_td *t, int col, transform_op_e op,
+        double arg)
+{
+    if (col < 0 || col > 1 || op < 0 || op >= TRANSFORM_MAX
+            || t->n_steps[col] >= TRANSFORM_MAX_STEPS) {
+        return 1;
+    }
+
+    t->steps[col][t->n_steps[col]].op = op;
+    t->steps[col][t->n_steps[col]].arg = arg;
+    t->n_steps[col]++;
+
+    return 0;
+}
+
+
+/* Apply every queued operation in a single pass over the data */
+int transform_apply(const transform_td *t, dataset_td *ds)
+{
+    data_point_td buf[TRANSFORM_BLOCK];
+    double x[TRANSFORM_BLOCK];
+    double y[TRANSFORM_BLOCK];
+    double d[TRANSFORM_BLOCK];
+    double tmp[TRANSFORM_BLOCK];
+    int do_x = (t->n_steps[0] > 0);
+    int do_y = (t->n_steps[1] > 0);
+
+    if (!do_x && !do_y) {
+        return 0;
+    }
+
+    /* Widened once and for all here, so that no block is left half
+     * way if memory runs out (errors stay as they are: ey' = 0 if
+     * ey = 0) */
+    if (dataset_set_mode(ds, ds->mode & ~DATASET_SINGLE) != 0) {
+        return 2;
+    }
+
+    for (size_t i = 0; i < ds->size; i += TRANSFORM_BLOCK) {
+        size_t n = (ds->size - i < TRANSFORM_BLOCK) ? ds->size - i
+            : TRANSFORM_BLOCK;
+        /* Points stored in full are transformed in place */
+        data_point_td *p = (data_point_td *) dataset_block(ds, i, n, buf);
+
+        /* Gather */
+        for (size_t j = 0; j < n; ++j) {
+            x[j] = p[j].x;
+            y[j] = p[j].y;
+            d[j] = 1.0;
+        }
+
+        for (size_t s = 0; s < t->n_steps[0]; ++s) {
+            s_step_block(&t->steps[0][s], x, NULL, tmp, n);
+        }
+        for (size_t s = 0; s < t->n_steps[1]; ++s) {
+            s_step_block(&t->steps[1][s], y, d, tmp, n);
+        }
+
+        /* Scatter */
+        for (size_t j = 0; j < n; ++j) {
+            p[j].x = x[j];
+            p[j].y = y[j];
+            p[j].ey = (p[j].ey > 0.0) ? fabs(d[j]) * p[j].ey : p[j].ey;
+        }
+        if (dataset_store(ds, i, n, p) != 0) {
+            return 2;
+        }
+    }
+
+    ds->is_modified = 1;
+
+    return 0;
+}
+
+
+/* Get the name of an operation */
+const char *transform_op_name(transform_op_e op)
+{
+    static const char *names[] = {
+        "log", "exp", "inverse", "scale", "offset", "power"
+    };
+
+    return (op >= 0 && op < TRANSFORM_MAX) ? names[op] : "?";
+}
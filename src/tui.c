@@ -7,7 +7,9 @@
 #define _POSIX_C_SOURCE  200809L
 
 /* System includes */
+#include <stdio.h>      /* snprintf */
 #include <stdlib.h>     /* free */
+#include <unistd.h>     /* unlink */
 
 /* Library includes */
 #include <menu.h>
@@ -17,9 +19,12 @@
 #include <dataset.h>
 #include <fileio.h>
 #include <global.h>
+#include <session.h>
+#include <view.h>
 
 /* Local includes */
 #include <tui.h>
+#include <tui/dialogs.h>
 #include <tui/menu.h>
 #include <tui/views.h>
 
@@ -59,9 +64,30 @@ int tui_start(void)
 int tui_loop(void)
 {
     dataset_td dataset;
+    view_td view;
     char *cur_filename = NULL;
+    session_cache_td cache;
+    char *session = session_path();
+    size_t n_session;
 
     dataset_init(&dataset);
+    view_init(&view, &dataset);
+    session_cache_init(&cache);
+
+    /* The last session is mapped back as it was left, whatever its
+     * size */
+    if (session != NULL && (n_session = session_points(session)) > 0) {
+        char msg[80];
+
+        snprintf(msg, sizeof(msg),
+                "Restore the last session (%zu points)? (y/N)", n_session);
+        if (tui_dialog_confirm_if_modified(1, msg) &&
+                session_load(session, &dataset, &view, &cur_filename,
+                    &cache) != 0) {
+            tui_dialog_alert_on_condition(0,
+                    "Cannot restore the last session");
+        }
+    }
 
     is_running = 1;
     while (is_running) {
@@ -105,8 +131,8 @@ int tui_loop(void)
         int index = tui_menu_navigate_and_get_index(menu, menu_win);
 
         /* Execute chosen action (may set 'is_running' to 0) */
-        tui_menu_execute_choice(index, &dataset, &cur_filename,
-                &is_running);
+        tui_menu_execute_choice(index, &dataset, &view, &cur_filename,
+                &cache, &is_running);
 
         /* Centralized cleanup */
         tui_menu_destroy(menu, menu_win, menu_sub, items, items_count);
@@ -117,11 +143,23 @@ int tui_loop(void)
         items = NULL;
     }
 
+    /* Only a session with data is worth restoring */
+    if (session != NULL) {
+        if (!dataset_is_empty(&dataset)) {
+            session_save(session, &dataset, &view, cur_filename, &cache);
+        } else {
+            unlink(session);
+        }
+        free(session);
+    }
+    session_cache_clear(&cache);
+
     if (cur_filename) {
         free(cur_filename);
         cur_filename = NULL;
     }
 
+    view_destroy(&view);
     dataset_destroy(&dataset);
     return 0;
 }
@@ -8,20 +8,36 @@
 
 
 /* System includes */
-#include <string.h>     /* strdup */
-#include <stdlib.h>     /* free */
-#include <unistd.h>     /* getcwd */
+#include <ctype.h>      /* tolower */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* strchr, strcmp, strcspn, strdup, strlen,
+                           strpbrk, strspn */
+#include <stdlib.h>     /* atoi, free, malloc, strtod */
+#include <unistd.h>     /* getcwd, STDIN_FILENO */
 
 /* Library includes */
 #include <ncurses.h>
 
 /* Project includes */
+#include <aggregate.h>
+#include <bins.h>
 #include <dataset.h>
+#include <expr.h>
 #include <fileio.h>
+#include <follow.h>
 #include <global.h>
+#include <group.h>
+#include <journal.h>
+#include <moments.h>
+#include <piecewise.h>
 #include <plot.h>
 #include <regres.h>
+#include <session.h>
 #include <stats.h>
+#include <summary.h>
+#include <transform.h>
+#include <view.h>
+#include <xindex.h>
 
 /* Local includes */
 #include <tui/actions.h>
@@ -55,6 +71,39 @@ static const char *s_get_cwd_msg(void)
 }
 
 
+/**
+ * @brief Read the columns of @e (x, y, [ey]) chosen by the user
+ *
+ * Every word, separated by blanks or commas, is a column number (from
+ * 1) or a name in the header of the file.
+ *
+ * @param text Text entered, split in place (names point into it)
+ * @param opts Options where the columns are stored
+ */
+static void s_parse_columns(char *text, fileio_opts_td *opts)
+{
+    char *p = text;
+
+    for (int k = 0; k < FILEIO_COL_MAX; ++k) {
+        p += strspn(p, " \t,");
+        if (*p == '\0') {
+            break;
+        }
+
+        char *word = p;
+        p += strcspn(p, " \t,");
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+        if (strspn(word, "0123456789") == strlen(word)) {
+            opts->cols[k] = atoi(word) - 1;
+        } else {
+            opts->names[k] = word;
+        }
+    }
+}
+
+
 /* Handle input action for the dataset */
 void tui_action_input(dataset_td *dataset)
 {
@@ -66,8 +115,69 @@ void tui_action_input(dataset_td *dataset)
 }
 
 
+/**
+ * @brief Save a dataset, asking before its journal is dropped
+ *
+ * @param filename Path to the file to save
+ * @param dataset  Pointer to the dataset to save
+ *
+ * @return The error of @a fileio_save(), which is 6 only if the user
+ *         chose to keep the journal
+ */
+static int s_save(const char *filename, dataset_td *dataset)
+{
+    int err = fileio_save(filename, dataset);
+
+    if (err == 6 && tui_dialog_confirm_if_modified(1,
+                "Journaled points! Drop them and save? (y/N)")) {
+        err = (journal_remove(filename) != 0) ? 1
+            : fileio_save(filename, dataset);
+    }
+
+    return err;
+}
+
+
+/**
+ * @brief Keep the summaries of the blocks of a file just loaded, read
+ *        back from the index written along with it
+ *
+ * Nothing is kept unless the file was indexed (text files that are not
+ * compressed), or if it has journaled points, which are not in the
+ * index: its summaries would then be built by parsing it again.
+ *
+ * @param filename Path to the file
+ * @param opts     Pointer to the options it was loaded with
+ * @param dataset  Pointer to the dataset loaded from it
+ * @param cache    Pointer to where the summaries are kept
+ */
+static void s_keep_summary(const char *filename,
+        const fileio_opts_td *opts, const dataset_td *dataset,
+        session_cache_td *cache)
+{
+    summary_td *sm;
+
+    if (!opts->summary || !summary_exists(filename) ||
+            journal_pending(filename) ||
+            (sm = malloc(sizeof(*sm))) == NULL) {
+        return;
+    }
+    if (fileio_summary(filename, opts, sm) != 0) {
+        free(sm);
+        return;
+    }
+    if (sm->n != dataset->size) {
+        summary_destroy(sm);
+        free(sm);
+        return;
+    }
+    cache->summary = sm;
+}
+
+
 /* Handle load action for the dataset */
-void tui_action_load(dataset_td *dataset, char **cur_filename)
+void tui_action_load(dataset_td *dataset, char **cur_filename,
+        session_cache_td *cache)
 {
     WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
 
@@ -78,23 +188,97 @@ void tui_action_load(dataset_td *dataset, char **cur_filename)
     mvwprintw(win, 3, 2, "Current file: '%s'",
           (*cur_filename) ? *cur_filename : "(none)");
     */
-    mvwprintw(win, 2, 2, "Enter filename to load: ");
+    mvwprintw(win, 2, 2, "Enter filename to load (or a pattern, such as"
+            " run*.txt): ");
     wrefresh(win);
 
     char filename[256];
+    char key_text[16];
+    char delim_text[8];
+    char cols_text[128];
+    fileio_opts_td opts;
+    fileio_opts_init(&opts);
     curs_set(1);
     wgetnstr(win, filename, sizeof(filename) - 1);
+    mvwprintw(win, 3, 2, "Group key column (Enter for none): ");
+    wgetnstr(win, key_text, sizeof(key_text) - 1);
+    mvwprintw(win, 4, 2, "Delimiter (Enter for blanks, t for tab): ");
+    wgetnstr(win, delim_text, sizeof(delim_text) - 1);
+    mvwprintw(win, 5, 2, "Columns of x y [ey], by number or name"
+            " (Enter for 1 2 3): ");
+    wgetnstr(win, cols_text, sizeof(cols_text) - 1);
+
+    /* Several files at once if the name is a pattern */
+    int many = (strpbrk(filename, "*?[") != NULL);
+    if (many) {
+        char tag_text[8];
+        mvwprintw(win, 6, 2, "Take the file of every point as its group"
+                " key? (y/N): ");
+        wgetnstr(win, tag_text, sizeof(tag_text) - 1);
+        opts.tag_files = (tolower(tag_text[0]) == 'y');
+    } else {
+        char index_text[8];
+        mvwprintw(win, 6, 2, "Index the file for fast range fits?"
+                " (y/N): ");
+        wgetnstr(win, index_text, sizeof(index_text) - 1);
+        opts.summary = (tolower(index_text[0]) == 'y');
+    }
     curs_set(0);
     noecho();
 
-    if (fileio_load(filename, dataset) != 0) {
-        mvwprintw(win, 4, 2, "Failed to load");
+    /* Columns are numbered from 1 for the user */
+    if (atoi(key_text) > 0) {
+        opts.key_col = atoi(key_text) - 1;
+    }
+    if (delim_text[0] == 't' && delim_text[1] == '\0') {
+        opts.delim = '\t';
+    } else {
+        opts.delim = delim_text[0];
+    }
+    s_parse_columns(cols_text, &opts);
+
+    size_t n_files = 0;
+    int err = (many)
+        ? fileio_load_glob(filename, dataset, &opts, &n_files)
+        : fileio_load_opts(filename, dataset, &opts);
+
+    /* The points of a journal that no longer matches its file are only
+     * left out if the user agrees */
+    if (err == 6 && !many && tui_dialog_confirm_if_modified(1,
+                "Stale journal! Load without its points? (y/N)")) {
+        opts.stale_journal = 1;
+        err = fileio_load_opts(filename, dataset, &opts);
+    }
+    if (err == 2) {
+        mvwprintw(win, 7, 2, "Failed to load (insufficient memory)");
+    } else if (err == 3) {
+        mvwprintw(win, 7, 2, "Failed to load (corrupted or truncated"
+                " file)");
+    } else if (err == 4) {
+        mvwprintw(win, 7, 2, "Failed to load (column name not in the"
+                " header)");
+    } else if (err == 5) {
+        mvwprintw(win, 7, 2, "Failed to load (compression not supported"
+                " by this build)");
+    } else if (err == 6) {
+        mvwprintw(win, 7, 2, "Not loaded (journal written for other"
+                " contents of the file)");
+    } else if (err != 0 && many && n_files == 0) {
+        mvwprintw(win, 7, 2, "Failed to load (no file matches)");
+    } else if (err != 0) {
+        mvwprintw(win, 7, 2, "Failed to load");
+    } else if (many) {
+        /* Saved as a whole only under a new name */
+        mvwprintw(win, 7, 2, "Data loaded from %zu files", n_files);
+        free(*cur_filename);
+        *cur_filename = NULL;
     } else {
-        mvwprintw(win, 4, 2, "Data loaded from '%s'", filename);
+        mvwprintw(win, 7, 2, "Data loaded from '%s'", filename);
+        s_keep_summary(filename, &opts, dataset, cache);
         free(*cur_filename);
         *cur_filename = strdup(filename);
         if (!*cur_filename) {
-            mvwprintw(win, 5, 2,
+            mvwprintw(win, 8, 2,
                     "Failed to store filename (insufficient memory)");
 /*
         } else {
@@ -109,10 +293,111 @@ void tui_action_load(dataset_td *dataset, char **cur_filename)
 }
 
 
+/* Follow a data file as it grows */
+void tui_action_follow(dataset_td *dataset, char **cur_filename)
+{
+    WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
+
+    keypad(win, TRUE);
+    echo();
+    mvwprintw(win, 1, 2, "Current directory: '%s'", s_get_cwd_msg());
+    mvwprintw(win, 2, 2, "Enter filename to follow (Enter for current): ");
+    wrefresh(win);
+
+    char filename[256];
+    curs_set(1);
+    wgetnstr(win, filename, sizeof(filename) - 1);
+    curs_set(0);
+    noecho();
+    if (filename[0] == '\0' && *cur_filename != NULL) {
+        snprintf(filename, sizeof(filename), "%s", *cur_filename);
+    }
+
+    follow_td f;
+    dataset_td live;
+    if (filename[0] == '\0' || follow_open(&f, filename) != 0) {
+        mvwprintw(win, 4, 2, "Failed to open '%s'", filename);
+        wrefresh(win);
+        wgetch(win);
+        delwin(win);
+        return;
+    }
+    /* Errors are stored from the start, as the fit shown weighs them;
+     * values stay in single precision while they fit it exactly */
+    dataset_init(&live);
+    dataset_set_mode(&live, DATASET_SINGLE);
+
+    /* Keys are read without waiting: the loop waits on the terminal
+     * and on the file at once */
+    int err = 0;
+    int done = 0;
+    size_t shown = (size_t) -1;
+    wtimeout(win, 0);
+    while (!done) {
+        if ((err = follow_read(&f, &live)) == 3) {
+            /* Truncated: the points read are no longer in the file */
+            dataset_destroy(&live);
+            dataset_init(&live);
+            dataset_set_mode(&live, DATASET_SINGLE);
+            shown = (size_t) -1;
+            continue;
+        }
+        if (err != 0) {
+            break;
+        }
+        if (live.size != shown) {
+            stats_td stats = { 0 };
+            if (f.plain.n > 0) {
+                stats = stats_from_moments(&f.plain);
+            }
+            tui_view_follow(filename, live.size, stats,
+                    regres_from_moments(follow_moments(&f)),
+                    f.watch >= 0, win);
+            shown = live.size;
+        }
+
+        int ch;
+        while ((ch = wgetch(win)) != ERR) {
+            if (ch == 27/*ESC*/ || ch == 'q' || ch == 'Q') {
+                done = 1;
+            }
+        }
+        if (!done && !f.pending) {
+            follow_wait(&f, STDIN_FILENO, TUI_ACTION_FOLLOW_MS);
+        }
+    }
+    wtimeout(win, -1);
+    follow_close(&f);
+
+    /* The points read so far are kept, even if reading failed; they
+     * were never saved, so the next save rewrites the whole file */
+    dataset_destroy(dataset);
+    *dataset = live;
+    dataset->is_modified = (dataset->size > 0);
+    dataset->n_saved = 0;
+    dataset->saved_id = 0;
+    if (*cur_filename == NULL || strcmp(*cur_filename, filename) != 0) {
+        free(*cur_filename);
+        *cur_filename = strdup(filename);
+    }
+
+    if (err != 0) {
+        mvwprintw(win, getmaxy(win) - 2, 2, "%-40s",
+                (err == 2) ? "Stopped (insufficient memory)"
+                : "Stopped (cannot read the file)");
+        wrefresh(win);
+        wgetch(win);
+    }
+    delwin(win);
+}
+
+
 /* Handle save action for the dataset */
 void tui_action_save(dataset_td *dataset, char **cur_filename)
 {
-    if (cur_filename && cur_filename) {
+    if (cur_filename && *cur_filename == NULL) {
+        tui_action_saveas(dataset, cur_filename);
+    } else if (cur_filename) {
         /* Prompt if data is modified */
         if (!tui_dialog_confirm_if_modified(dataset->is_modified,
                     "Save changes to current file? (y/N)")) {
@@ -120,7 +405,7 @@ void tui_action_save(dataset_td *dataset, char **cur_filename)
         }
 
         /* Try to save in current name */
-        if (fileio_save(*cur_filename, dataset) != 0) {
+        if (s_save(*cur_filename, dataset) != 0) {
             /* Failed to save */
             WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
             keypad(win, TRUE);
@@ -163,7 +448,7 @@ void tui_action_saveas(dataset_td *dataset, char **cur_filename)
     curs_set(0);
     noecho();
 
-    if (fileio_save(filename, dataset) != 0) {
+    if (s_save(filename, dataset) != 0) {
         mvwprintw(win, 4, 2, "Failed to save");
     } else {
         mvwprintw(win, 4, 2, "Data saved");
@@ -192,43 +477,383 @@ void tui_action_saveas(dataset_td *dataset, char **cur_filename)
 void tui_action_show_data(const dataset_td *dataset)
 {
     WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
+    influence_td *diag = NULL;
+
+    /* Diagnostics are optional: show the plain table without them, as
+     * for datasets out of core, which are only paged through */
+    if (!dataset_is_mapped(dataset)) {
+        diag = malloc(dataset->size * sizeof(*diag));
+    }
+    if (diag != NULL && regres_influence(dataset, diag) != 0) {
+        free(diag);
+        diag = NULL;
+    }
 
     keypad(win, TRUE);
-    tui_view_show_data(dataset, win);
+    tui_view_show_data(dataset, diag, win);
     delwin(win);
+    free(diag);
 }
 
+/**
+ * @brief Get the bins of a large dataset, built once until it changes
+ *
+ * @param dataset Pointer to the dataset
+ * @param cache   Pointer to the results computed for the dataset, where
+ *                the bins are kept
+ *
+ * @return Pointer to the bins, or @c NULL if the dataset is not larger
+ *         than @c TUI_ACTION_BIN_MIN points, or on memory allocation
+ *         failure (the points are then read one by one)
+ */
+static const bins_td *s_bins(const dataset_td *dataset,
+        session_cache_td *cache)
+{
+    bins_td *b;
+
+    if (cache->bins != NULL || dataset->size <= TUI_ACTION_BIN_MIN) {
+        return cache->bins;
+    }
+    if ((b = malloc(sizeof(*b))) == NULL) {
+        return NULL;
+    }
+    if (bins_build(b, dataset, BINS_DEFAULT) != 0) {
+        free(b);
+        return NULL;
+    }
+    cache->bins = b;
+
+    return b;
+}
+
+
 /* Plot the data from the dataset */
-void tui_action_plot(const dataset_td *dataset)
+void tui_action_plot(const dataset_td *dataset, session_cache_td *cache)
 {
+    const bins_td *bins = s_bins(dataset, cache);
     regression_td reg;
+
+    if (bins != NULL) {
+        reg = bins_fit(bins, NULL);
+        plot_bins(bins, reg.a, reg.b);
+        return;
+    }
+
     reg = regres_linear(dataset);
     plot_data(dataset, reg.a, reg.b);
 }
 
 
 /* Compute and show statistics for the dataset */
-void tui_action_stats(const dataset_td *dataset)
+void tui_action_stats(const dataset_td *dataset, session_cache_td *cache)
 {
     WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
+    const bins_td *bins;
     stats_td stats;
 
     keypad(win, TRUE);
-    stats = stats_compute(dataset);
+    if (cache->has_stats) {
+        stats = cache->stats;
+    } else if ((bins = s_bins(dataset, cache)) != NULL) {
+        moments_td m;
+        bins_moments(bins, 0, &m);
+        stats = stats_from_moments(&m);
+    } else {
+        stats = stats_compute(dataset);
+    }
+    cache->stats = stats;
+    cache->has_stats = 1;
     tui_view_stats(stats, win);
     delwin(win);
 }
 
 
 /*a Show regression analysis for the dataset */
-void tui_action_regres(const dataset_td *dataset)
+void tui_action_regres(const dataset_td *dataset, const summary_td *summary,
+        session_cache_td *cache)
 {
     WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
 
     keypad(win, TRUE);
     regression_td reg;
-    reg = regres_linear(dataset);
-    tui_view_regression(reg, win);
+    crossval_td kfold, loo;
+    int has_kfold, has_loo;
+
+    if (!cache->has_fit) {
+        cache->reg = regres_linear(dataset);
+        cache->has_kfold = (regres_crossval(dataset, TUI_ACTION_CV_FOLDS,
+                    &cache->kfold) == 0);
+        cache->has_loo = (regres_crossval(dataset, dataset->size,
+                    &cache->loo) == 0);
+        cache->has_fit = 1;
+    }
+    reg = cache->reg;
+    kfold = cache->kfold;
+    loo = cache->loo;
+    has_kfold = cache->has_kfold;
+    has_loo = cache->has_loo;
+
+    /* The prefix-sum index is built on the first range or segmented
+     * fit asked, then every range or segment is fitted in O(1); ranges
+     * of a file loaded with its index are fitted from its blocks
+     * instead, without sorting the points */
+    xindex_td index;
+    int has_index = 0;
+    int key = tui_view_regression(reg, has_kfold ? &kfold : NULL,
+            has_loo ? &loo : NULL, win);
+    while (key == 'r' || key == 's') {
+        if (!has_index && (key == 's' || summary == NULL)) {
+            if (xindex_build(&index, dataset) != 0) {
+                tui_dialog_alert_on_condition(0,
+                        "Cannot build the range index"
+                        " (insufficient memory)");
+                break;
+            }
+            has_index = 1;
+        }
+
+        if (key == 'r') {
+            double xa, xb;
+            size_t n_in;
+
+            if (tui_view_prompt_range(win, &xa, &xb) != 0) {
+                break;
+            }
+            reg = (summary != NULL)
+                ? summary_fit_range(summary, dataset, xa, xb, &n_in)
+                : xindex_fit(&index, xa, xb, &n_in);
+            key = tui_view_range_regression(reg, xa, xb, n_in, win);
+        } else {
+            piecewise_td pw;
+            size_t k;
+
+            if (tui_view_prompt_breaks(win, PIECEWISE_MAX_BREAKS,
+                        &k) != 0) {
+                break;
+            }
+            if (piecewise_fit(&index, k, &pw) != 0) {
+                tui_dialog_alert_on_condition(0,
+                        "Not enough distinct x values for so many"
+                        " breakpoints");
+                break;
+            }
+            key = tui_view_piecewise(&pw, win);
+        }
+    }
+
+    if (has_index) {
+        xindex_destroy(&index);
+    }
+
+    delwin(win);
+}
+
+
+/* Fit and show the regression of every group of the dataset */
+void tui_action_groups(const dataset_td *dataset)
+{
+    group_fit_td *fits = NULL;
+    size_t n_fits = 0;
+
+    if (group_fit(dataset, &fits, &n_fits) != 0) {
+        tui_dialog_alert_on_condition(0,
+                "Cannot fit the groups (insufficient memory)");
+        return;
+    }
+
+    WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
+    keypad(win, TRUE);
+    tui_view_groups(dataset, fits, n_fits, win);
+    delwin(win);
+    free(fits);
+}
+
+
+/* Merge the points measured at the same 'x' */
+void tui_action_aggregate(dataset_td *dataset)
+{
+    WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
+    char text[32];
+    dataset_td reduced;
+
+    keypad(win, TRUE);
+    echo();
+    mvwprintw(win, 1, 2, "Merge the points measured at the same x into"
+            " their mean");
+    mvwprintw(win, 2, 2, "x tolerance (Enter for exact matches): ");
+    wrefresh(win);
+
+    curs_set(1);
+    wgetnstr(win, text, sizeof(text) - 1);
+    curs_set(0);
+    noecho();
+
+    double tol = strtod(text, NULL);
+    if (!(tol > 0.0)) {
+        tol = 0.0;
+    }
+
+    size_t before = dataset->size;
+    if (aggregate_x(dataset, tol, &reduced) != 0) {
+        mvwprintw(win, 4, 2, "Failed to aggregate (insufficient memory)");
+    } else {
+        dataset_destroy(dataset);
+        *dataset = reduced;
+        mvwprintw(win, 4, 2, "%zu points reduced to %zu (mean y, standard"
+                " error as ey)", before, dataset->size);
+    }
+
+    wrefresh(win);
+    wgetch(win);
+    delwin(win);
+}
+
+
+/**
+ * @brief Prompt for an expression and run it over the dataset
+ *
+ * @param dataset Pointer to the dataset to transform
+ * @param win     Window where to print
+ */
+static void s_transform_expr(dataset_td *dataset, WINDOW *win)
+{
+    char text[256];
+    char err[128];
+    expr_td e;
+
+    mvwprintw(win, 9, 2, "Expression (e.g., y = y/(1 + 0.003*x);"
+            " w = x^2):");
+    wmove(win, 10, 4);
+    wrefresh(win);
+    echo();
+    curs_set(1);
+    wgetnstr(win, text, sizeof(text) - 1);
+    curs_set(0);
+    noecho();
+
+    if (expr_compile(&e, text, dataset, err, sizeof(err)) != 0) {
+        mvwprintw(win, 12, 2, "%s", err);
+    } else if (expr_run(&e, dataset) != 0) {
+        mvwprintw(win, 12, 2, "Failed to run the expression (insufficient"
+                " memory)");
+    } else {
+        mvwprintw(win, 12, 2, "Expression computed on %zu points",
+                dataset->size);
+    }
+    wrefresh(win);
+    wgetch(win);
+}
+
+
+/* Transform the columns of the dataset */
+void tui_action_transform(dataset_td *dataset, view_td *view)
+{
+    WINDOW *win = newwin(LINES - 4, COLS - 4, 2, 2);
+    char text[32];
+    int c;
+
+    keypad(win, TRUE);
+
+    for (;;) {
+        tui_view_transform(view, win);
+        mvwprintw(win, 6, 2, "x, y: add an operation   t: turn on/off"
+                "   c: clear");
+        mvwprintw(win, 7, 2, "a: apply to the data   e: expression"
+                "   q: back ");
+        wrefresh(win);
+        /* Keys beyond a byte (arrows, function keys) are not
+         * characters, for tolower() */
+        c = wgetch(win);
+        if (c == 27/*ESC*/ || c == KEY_ENTER || c == '\n') {
+            break;
+        }
+        c = (c > 0 && c < 256) ? tolower(c) : 0;
+        if (c == 'q') {
+            break;
+        }
+
+        if (c == 'e') {
+            s_transform_expr(dataset, win);
+            view_invalidate(view);
+        } else if (c == 'c') {
+            view_clear(view);
+        } else if (c == 't') {
+            int number = 0;
+
+            mvwprintw(win, 9, 2, "Operation number: ");
+            wrefresh(win);
+            echo();
+            curs_set(1);
+            int n = wscanw(win, "%d", &number);
+            curs_set(0);
+            noecho();
+
+            /* Operations are numbered from 1, those of x first */
+            size_t i = (n == 1 && number > 0) ? (size_t) number - 1
+                : (size_t) -1;
+            if (i < view->n_layers[0]) {
+                view_toggle(view, 0, i);
+            } else if (i != (size_t) -1) {
+                view_toggle(view, 1, i - view->n_layers[0]);
+            }
+        } else if (c == 'a') {
+            transform_td t;
+
+            if (!view_is_active(view)) {
+                continue;
+            }
+            view_pipeline(view, &t);
+            if (transform_apply(&t, dataset) != 0) {
+                mvwprintw(win, 9, 2, "Failed to transform the data"
+                        " (insufficient memory)");
+                wrefresh(win);
+                wgetch(win);
+                continue;
+            }
+            view_clear(view);
+            tui_view_transform(view, win);
+            mvwprintw(win, 9, 2, "%zu points transformed (ey propagated"
+                    " through the operations on y)", dataset->size);
+            wrefresh(win);
+            wgetch(win);
+        } else if (c == 'x' || c == 'y') {
+            int col = (c == 'y');
+
+            mvwprintw(win, 9, 2, "Operation on %c: (l)og, (e)xp, (i)nverse,"
+                    " (s)cale, (o)ffset, (p)ower: ", c);
+            wrefresh(win);
+            const char *ops = "leisop";
+            int key = wgetch(win);
+            const char *op = (key > 0 && key < 256)
+                ? strchr(ops, tolower(key)) : NULL;
+            if (op == NULL || *op == '\0') {
+                continue;
+            }
+
+            double arg = 0.0;
+            if (*op == 's' || *op == 'o' || *op == 'p') {
+                mvwprintw(win, 10, 2, "Value: ");
+                wrefresh(win);
+                echo();
+                curs_set(1);
+                wgetnstr(win, text, sizeof(text) - 1);
+                curs_set(0);
+                noecho();
+
+                char *end;
+                arg = strtod(text, &end);
+                if (end == text) {
+                    continue;
+                }
+            }
+
+            if (view_push(view, col, (transform_op_e) (op - ops),
+                        arg) != 0) {
+                tui_dialog_alert_on_condition(0, "Too many operations on"
+                        " this column");
+            }
+        }
+    }
 
     delwin(win);
 }
@@ -47,6 +47,26 @@ static size_t s_max_strlen(const char *strs[])
 }
 
 
+/**
+ * @brief Read the data seen through the view, alerting on failure
+ *
+ * @param view Pointer to the view of the dataset
+ *
+ * @return Pointer to the data, or @c NULL on memory allocation failure
+ */
+static const dataset_td *s_view_data(view_td *view)
+{
+    const dataset_td *ds = view_data(view);
+
+    if (ds == NULL) {
+        tui_dialog_alert_on_condition(0, "Cannot transform the data"
+                " (insufficient memory)");
+    }
+
+    return ds;
+}
+
+
 /* Create a menu for the terminal user interface */
 MENU *tui_menu_create(WINDOW **out_menu_win, WINDOW **out_menu_sub,
         ITEM ***out_items, int *out_items_count,
@@ -55,12 +75,16 @@ MENU *tui_menu_create(WINDOW **out_menu_win, WINDOW **out_menu_sub,
     const char *choices[] = {
         "Input new data",
         "Load data from file",
+        "Follow growing file",
         "Save current data",
         "Save as",
         "Show data table",
         "Plot graph",
         "Statistics",
         "Linear regression",
+        "Grouped regression",
+        "Aggregate repeated x",
+        "Transform",
         "About",
         "Quit",
         NULL
@@ -97,7 +121,9 @@ MENU *tui_menu_create(WINDOW **out_menu_win, WINDOW **out_menu_sub,
             /* Disable menu options that do not work without data */
             if (i == TUI_MENU_SAVE_DATA  || i == TUI_MENU_SAVEAS_DATA ||
                 i == TUI_MENU_SHOW_TABLE || i == TUI_MENU_PLOT ||
-                i == TUI_MENU_STATISTICS || i == TUI_MENU_REGRESSION) {
+                i == TUI_MENU_STATISTICS || i == TUI_MENU_REGRESSION ||
+                i == TUI_MENU_GROUPS || i == TUI_MENU_AGGREGATE ||
+                i == TUI_MENU_TRANSFORM) {
                 int opts = item_opts(items[i]);
                 opts &= ~O_SELECTABLE;
                 set_item_opts(items[i], opts);
@@ -110,6 +136,12 @@ MENU *tui_menu_create(WINDOW **out_menu_win, WINDOW **out_menu_sub,
                 set_item_opts(items[i], opts);
             }
         }
+        if (!dataset_has_keys(dataset) && i == TUI_MENU_GROUPS) {
+            /* Disable menu options that need grouped data */
+            int opts = item_opts(items[i]);
+            opts &= ~O_SELECTABLE;
+            set_item_opts(items[i], opts);
+        }
         ++items_created;
     }
 
@@ -222,11 +254,16 @@ int tui_menu_navigate_and_get_index(MENU *menu, WINDOW *menu_win)
 
 /* Execute chosen action corresponding to the selected menu item */
 void tui_menu_execute_choice(int index, dataset_td *dataset,
-        char **cur_filename, int *is_running)
+        view_td *view, char **cur_filename, session_cache_td *cache,
+        int *is_running)
 {
+    const dataset_td *seen;
+
     switch (index) {
         case TUI_MENU_INPUT_DATA:
             tui_action_input(dataset);
+            view_invalidate(view);
+            session_cache_clear(cache);
             break;
 
         case TUI_MENU_LOAD_DATA:
@@ -236,7 +273,21 @@ void tui_menu_execute_choice(int index, dataset_td *dataset,
                         " (y/N)")) {
                 break;
             }
-            tui_action_load(dataset, cur_filename);
+            session_cache_clear(cache);
+            tui_action_load(dataset, cur_filename, cache);
+            view_invalidate(view);
+            break;
+
+        case TUI_MENU_FOLLOW:
+            if (!tui_dialog_confirm_if_modified(
+                        dataset_is_modified(dataset),
+                        "Unsaved data! Follow another file anyway?"
+                        " (y/N)")) {
+                break;
+            }
+            tui_action_follow(dataset, cur_filename);
+            view_invalidate(view);
+            session_cache_clear(cache);
             break;
 
         case TUI_MENU_SAVE_DATA:
@@ -269,7 +320,9 @@ void tui_menu_execute_choice(int index, dataset_td *dataset,
                         " an existing file") != 0) {
                 break;
             }
-            tui_action_show_data(dataset);
+            if ((seen = s_view_data(view)) != NULL) {
+                tui_action_show_data(seen);
+            }
             break;
 
         case TUI_MENU_PLOT:
@@ -278,7 +331,9 @@ void tui_menu_execute_choice(int index, dataset_td *dataset,
                         " an existing file") != 0) {
                 break;
             }
-            tui_action_plot(dataset);
+            if ((seen = s_view_data(view)) != NULL) {
+                tui_action_plot(seen, cache);
+            }
             break;
 
         case TUI_MENU_STATISTICS:
@@ -287,7 +342,9 @@ void tui_menu_execute_choice(int index, dataset_td *dataset,
                         " an existing file") != 0) {
                 break;
             }
-            tui_action_stats(dataset);
+            if ((seen = s_view_data(view)) != NULL) {
+                tui_action_stats(seen, cache);
+            }
             break;
 
         case TUI_MENU_REGRESSION:
@@ -296,7 +353,42 @@ void tui_menu_execute_choice(int index, dataset_td *dataset,
                         " an existing file") != 0) {
                 break;
             }
-            tui_action_regres(dataset);
+            if ((seen = s_view_data(view)) != NULL) {
+                tui_action_regres(seen,
+                        (seen == dataset) ? cache->summary : NULL, cache);
+            }
+            break;
+
+        case TUI_MENU_GROUPS:
+            if (tui_dialog_alert_on_condition(dataset_has_keys(dataset),
+                        "No group keys: load a file choosing its key"
+                        " column") != 0) {
+                break;
+            }
+            if ((seen = s_view_data(view)) != NULL) {
+                tui_action_groups(seen);
+            }
+            break;
+
+        case TUI_MENU_AGGREGATE:
+            if (tui_dialog_alert_on_condition(dataset_size(dataset),
+                        "No data to aggregate: enter new data or load"
+                        " an existing file") != 0) {
+                break;
+            }
+            tui_action_aggregate(dataset);
+            view_invalidate(view);
+            session_cache_clear(cache);
+            break;
+
+        case TUI_MENU_TRANSFORM:
+            if (tui_dialog_alert_on_condition(dataset_size(dataset),
+                        "No data to transform: enter new data or load"
+                        " an existing file") != 0) {
+                break;
+            }
+            tui_action_transform(dataset, view);
+            session_cache_clear(cache);
             break;
 
         case TUI_MENU_ABOUT:
@@ -5,8 +5,11 @@
  */
 
 /* System includes */
-#include <math.h>       /* sqrt */
-#include <string.h>     /* strlen, strncat, size_t */
+#include <ctype.h>      /* tolower */
+#include <math.h>       /* isnan, sqrt */
+#include <stdio.h>      /* snprintf */
+#include <stdlib.h>     /* free, malloc, qsort */
+#include <string.h>     /* strchr, strlen, strncat, size_t */
 
 /* Library includes */
 #include <ncurses.h>
@@ -14,13 +17,20 @@
 /* Project includes */
 #include <dataset.h>
 #include <global.h>
+#include <group.h>
+#include <piecewise.h>
 #include <regres.h>
 #include <stats.h>
+#include <transform.h>
 
 /* Local includes */
 #include <tui/views.h>
 
 
+#define TUI_VIEW_DATA_WIDTH (53)    /**< Width of index, X, Y, ErrorY */
+#define TUI_VIEW_DIAG_WIDTH (50)    /**< Width of diagnostic columns */
+
+
 /**
  * @brief Generic viewer for table of labels and values with pagination
  *
@@ -29,9 +39,14 @@
  * @param labels  Array of labels
  * @param values  Array of values of type double
  * @param title   Page title
+ * @param keys    Extra keys (lowercase) that close the view, or @c NULL
+ * @param hint    Footer help for the extra keys, or @c NULL
+ *
+ * @return The key that closed the view: 'q', or one of @p keys
  */
-static void s_gui_view_table(WINDOW *win, size_t n_lines,
-        const char *labels[], double values[], const char *title)
+static int s_gui_view_table(WINDOW *win, size_t n_lines,
+        const char *labels[], double values[], const char *title,
+        const char *keys, const char *hint)
 {
     /* Pagination setup */
     int inner_h = getmaxy(win) - 4; /* Leave room for title and footer */
@@ -65,12 +80,17 @@ static void s_gui_view_table(WINDOW *win, size_t n_lines,
                     "%*.8f", value_width, values[i]);
         }
 
-        mvwprintw(win, getmaxy(win) - 2, 2, "n: next, p: prev, q: back");
+        mvwprintw(win, getmaxy(win) - 2, 2, "n: next, p: prev, %s%sq: back",
+                (hint) ? hint : "", (hint) ? ", " : "");
         wrefresh(win);
 
         int ch = wgetch(win);
         if (ch == 27/*ESC*/ || ch == 'q' || ch == 'Q') {
-            break;
+            return 'q';
+        }
+        if (keys != NULL && ch > 0 && ch < 256 &&
+                strchr(keys, tolower(ch)) != NULL) {
+            return tolower(ch);
         }
         if (ch == 'n' || ch == 'N') {
             if (page + 1 < pages) {
@@ -85,6 +105,73 @@ static void s_gui_view_table(WINDOW *win, size_t n_lines,
 }
 
 
+/**
+ * @brief Pair of sort key and row index, used to order table rows
+ */
+typedef struct {
+    double key;     /**< Sort key */
+    size_t idx;     /**< Row index in the dataset */
+} s_row_key_td;
+
+
+/**
+ * @brief Compare two rows by decreasing key, undefined keys last
+ *
+ * @param a Pointer to the first @e s_row_key_td
+ * @param b Pointer to the second @e s_row_key_td
+ *
+ * @return Negative, zero or positive, as required by @a qsort()
+ */
+static int s_row_key_cmp_desc(const void *a, const void *b)
+{
+    const s_row_key_td *ra = a;
+    const s_row_key_td *rb = b;
+
+    if (isnan(ra->key) || isnan(rb->key)) {
+        return (isnan(ra->key) != 0) - (isnan(rb->key) != 0);
+    }
+    if (ra->key != rb->key) {
+        return (ra->key < rb->key) ? 1 : -1;
+    }
+
+    return (ra->idx > rb->idx) - (ra->idx < rb->idx);
+}
+
+
+/**
+ * @brief Build the row order of a data table sorted by influence
+ *
+ * @param diag Diagnostics for every point
+ * @param n    Number of points
+ *
+ * @return Newly allocated array of row indices, most influential point
+ *         (largest Cook's distance) first, or @c NULL on failure
+ */
+static size_t *s_influence_order(const influence_td *diag, size_t n)
+{
+    s_row_key_td *keys = malloc(n * sizeof(*keys));
+    size_t *order = malloc(n * sizeof(*order));
+
+    if (keys == NULL || order == NULL) {
+        free(keys);
+        free(order);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        keys[i].key = diag[i].cook;
+        keys[i].idx = i;
+    }
+    qsort(keys, n, sizeof(*keys), s_row_key_cmp_desc);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = keys[i].idx;
+    }
+    free(keys);
+
+    return order;
+}
+
+
 /* Print title header and a mark regarding if data is saved */
 void tui_view_print_title(const char *filename,
         int is_modified, int is_empty)
@@ -153,7 +240,9 @@ void tui_view_input_data(dataset_td *ds, WINDOW *win)
         curs_set(0);
 
         mvwprintw(win,2,2,"Press 'q' to stop, or ENTER to continue");
-        dataset_add(ds, x, y, ey);
+        if (dataset_add(ds, x, y, ey) != 0) {
+            mvwprintw(win,8,2,"Point not added (insufficient memory)");
+        }
 
         ch = wgetch(win);
         if (ch == 27/*ESC*/ || ch == 'q' || ch == 'Q') {
@@ -166,35 +255,66 @@ void tui_view_input_data(dataset_td *ds, WINDOW *win)
 
 
 /* View for showing the data tables */
-void tui_view_show_data(const dataset_td *ds, WINDOW *win)
+void tui_view_show_data(const dataset_td *ds, const influence_td *diag,
+        WINDOW *win)
 {
     size_t max_rows = getmaxy(win) - 4;
     size_t total = ds->size;
     size_t pages = (total + max_rows - 1) / max_rows;
     size_t page=0;
+    size_t *order = NULL;   /* Row order when sorted by influence */
+    int by_influence = 0;
+    int show_diag = 0;
+    int wide = (getmaxx(win) - 4) >= TUI_VIEW_DATA_WIDTH +
+        TUI_VIEW_DIAG_WIDTH;
 
     while (1) {
         int ch;
         size_t start_idx;
         size_t end_idx;
+        int show_xy = wide || !show_diag;
 
         werase(win);
         box(win, 0, 0);
-        mvwprintw(win, 0, 2, "Data Table (Page %zu/%zu)", page+1, pages);
-        mvwprintw(win, 1, 2,
-                "%4s    %-14s %-14s %-14s", "i", "X", "Y", "ErrorY");
+        mvwprintw(win, 0, 2, "Data Table (Page %zu/%zu)%s", page+1, pages,
+                by_influence ? " [by influence]" : "");
+        mvwprintw(win, 1, 2, "%4s    ", "i");
+        if (show_xy) {
+            wprintw(win, "%-14s %-14s %-14s", "X", "Y", "ErrorY");
+        }
+        if (diag != NULL && (wide || show_diag)) {
+            wprintw(win, " %-9s %-9s %-9s %-9s %-9s",
+                    "h", "r*", "Cook D", "da", "db");
+        }
         start_idx = page * max_rows;
         end_idx = (start_idx + max_rows > total)
             ? total
             : start_idx + max_rows;
 
-        for (size_t i= start_idx; i < end_idx; ++i) {
-            mvwprintw(win, 2 + i - start_idx, 2,
-                "%4zu    %-14.8f %-14.8f %-14.8f",
-                i + 1, ds->points[i].x, ds->points[i].y, ds->points[i].ey);
+        for (size_t r = start_idx; r < end_idx; ++r) {
+            size_t i = (by_influence && order != NULL) ? order[r] : r;
+
+            mvwprintw(win, 2 + r - start_idx, 2, "%4zu    ", i + 1);
+            if (show_xy) {
+                data_point_td p = dataset_get(ds, i);
+                wprintw(win, "%-14.8f %-14.8f %-14.8f", p.x, p.y, p.ey);
+            }
+            if (diag != NULL && (wide || show_diag)) {
+                wprintw(win, " %-9.3g %-9.3g %-9.3g %-9.3g %-9.3g",
+                        diag[i].h, diag[i].rstud, diag[i].cook,
+                        diag[i].da, diag[i].db);
+            }
         }
 
-        mvwprintw(win, getmaxy(win)-2, 2, "n: next, p: prev, q: back");
+        if (diag == NULL) {
+            mvwprintw(win, getmaxy(win)-2, 2, "n: next, p: prev, q: back");
+        } else if (wide) {
+            mvwprintw(win, getmaxy(win)-2, 2,
+                    "n: next, p: prev, s: sort, q: back");
+        } else {
+            mvwprintw(win, getmaxy(win)-2, 2,
+                    "n: next, p: prev, d: diagnostics, s: sort, q: back");
+        }
         wrefresh(win);
 
         ch = wgetch(win);
@@ -210,8 +330,18 @@ void tui_view_show_data(const dataset_td *ds, WINDOW *win)
             if (page > 0) {
                 page--;
             }
+        } else if ((ch == 'd' || ch == 'D') && diag != NULL) {
+            show_diag = !show_diag;
+        } else if ((ch == 's' || ch == 'S') && diag != NULL) {
+            if (order == NULL) {
+                order = s_influence_order(diag, total);
+            }
+            by_influence = (order != NULL) && !by_influence;
+            page = 0;
         }
     }
+
+    free(order);
 }
 
 
@@ -240,24 +370,287 @@ void tui_view_stats(const stats_td stats, WINDOW *win)
     };
     size_t n_lines = sizeof(values) / sizeof(values[0]);
 
-    s_gui_view_table(win, n_lines, labels, values, "Statistics");
+    s_gui_view_table(win, n_lines, labels, values, "Statistics",
+            NULL, NULL);
+}
+
+
+/* Live view of a followed file */
+void tui_view_follow(const char *filename, size_t n, const stats_td stats,
+        const regression_td reg, int watched, WINDOW *win)
+{
+    const char *labels[] = {
+        "Mean X:", "Mean Y:", "s_n-1(x):", "s_n-1(y):",
+        "a [intercept]", "b [slope]", "s(a)", "s(b)", "r", "r^2"
+    };
+    double values[] = {
+        stats.x_mean, stats.y_mean, stats.snxn1, stats.snyn1,
+        reg.a, reg.b, reg.sa, reg.sb, reg.r, reg.r * reg.r
+    };
+    size_t n_lines = sizeof(values) / sizeof(values[0]);
+    int rows = getmaxy(win) - 6;
+
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 0, 2, "Following '%s' (%s)", filename,
+            (watched) ? "watched" : "polled");
+    mvwprintw(win, 2, 2, "%-20s", "Points:");
+    mvwprintw(win, 2, 25, "%18zu", n);
+    for (size_t i = 0; i < n_lines && (int) i < rows; ++i) {
+        mvwprintw(win, 4 + (int) i, 2, "%-20s", labels[i]);
+        mvwprintw(win, 4 + (int) i, 25, "%18.8f", values[i]);
+    }
+    mvwprintw(win, getmaxy(win) - 2, 2, "q: stop following");
+    wrefresh(win);
 }
 
 
 /* View regression analysis */
-void tui_view_regression(const regression_td reg, WINDOW *win)
+int tui_view_regression(const regression_td reg,
+        const crossval_td *kfold, const crossval_td *loo, WINDOW *win)
 {
+    char kfold_label[32] = "";
     const char *labels[] = {
         "a [intercept]", "b [slope]",
         "s(a)", "s(b)", "e(a)", "e(b)",
-        "r", "r^2"
+        "r", "r^2",
+        kfold_label, "CV s(b) [folds]", "CV RMSE [LOO]"
     };
     double values[] = {
         reg.a, reg.b, reg.sa, reg.sb, reg.ea, reg.eb,
-        reg.r, reg.r * reg.r
+        reg.r, reg.r * reg.r,
+        0.0, 0.0, 0.0
+    };
+    size_t n_lines = 8;
+
+    /* Optional cross-validation rows */
+    if (kfold != NULL) {
+        snprintf(kfold_label, sizeof(kfold_label), "CV RMSE [%zu-fold]",
+                kfold->k);
+        values[n_lines++] = kfold->rmse;
+        values[n_lines++] = kfold->b_sd;
+    }
+    if (loo != NULL) {
+        labels[n_lines] = labels[10];
+        values[n_lines++] = loo->rmse;
+    }
+
+    return s_gui_view_table(win, n_lines, labels, values,
+            "Linear regression (y=a+bx)", "rs", "r: range fit, s: segmented");
+}
+
+
+/* Prompt for a range of 'x' values */
+int tui_view_prompt_range(WINDOW *win, double *xa, double *xb)
+{
+    int n;
+
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 1, 2, "Fit only the points with x in [x min, x max]");
+    mvwprintw(win, 3, 4, "x min: ");
+    wrefresh(win);
+
+    echo();
+    curs_set(1);
+    n = wscanw(win, "%lf", xa);
+    if (n == 1) {
+        mvwprintw(win, 4, 4, "x max: ");
+        n += wscanw(win, "%lf", xb);
+    }
+    curs_set(0);
+    noecho();
+
+    if (n != 2) {
+        return 1;
+    }
+    if (*xa > *xb) {
+        double t = *xa;
+        *xa = *xb;
+        *xb = t;
+    }
+
+    return 0;
+}
+
+
+/* View regression analysis over a range of 'x' */
+int tui_view_range_regression(const regression_td reg,
+        double xa, double xb, size_t n, WINDOW *win)
+{
+    char title[128];
+    const char *labels[] = {
+        "a [intercept]", "b [slope]",
+        "s(a)", "s(b)", "r", "r^2"
+    };
+    double values[] = {
+        reg.a, reg.b, reg.sa, reg.sb, reg.r, reg.r * reg.r
     };
     size_t n_lines = sizeof(values) / sizeof(values[0]);
 
-    s_gui_view_table(win, n_lines, labels, values,
-            "Linear regression (y=a+bx)");
+    snprintf(title, sizeof(title), "Range fit x in [%g, %g], %zu points",
+            xa, xb, n);
+
+    return s_gui_view_table(win, n_lines, labels, values, title,
+            "r", "r: new range");
+}
+
+
+/* Prompt for a number of breakpoints */
+int tui_view_prompt_breaks(WINDOW *win, size_t max, size_t *k)
+{
+    int value = 0;
+    int n;
+
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 1, 2, "Segmented regression: independent lines"
+            " between breakpoints");
+    mvwprintw(win, 3, 4, "Number of breakpoints (1-%zu): ", max);
+    wrefresh(win);
+
+    echo();
+    curs_set(1);
+    n = wscanw(win, "%d", &value);
+    curs_set(0);
+    noecho();
+
+    if (n != 1 || value < 1 || (size_t) value > max) {
+        return 1;
+    }
+    *k = (size_t) value;
+
+    return 0;
+}
+
+
+/* Segmented regression view */
+int tui_view_piecewise(const piecewise_td *pw, WINDOW *win)
+{
+    enum { ROWS_PER_SEG = 5 };
+    char text[PIECEWISE_MAX_BREAKS + 1][ROWS_PER_SEG][32];
+    const char *labels[(PIECEWISE_MAX_BREAKS + 1) * ROWS_PER_SEG + 1];
+    double values[(PIECEWISE_MAX_BREAKS + 1) * ROWS_PER_SEG + 1];
+    size_t n_lines = 0;
+
+    for (size_t j = 0; j <= pw->n_breaks; ++j) {
+        snprintf(text[j][0], sizeof(text[j][0]), "[%zu] points", j + 1);
+        snprintf(text[j][1], sizeof(text[j][1]), "[%zu] a", j + 1);
+        snprintf(text[j][2], sizeof(text[j][2]), "[%zu] b", j + 1);
+        snprintf(text[j][3], sizeof(text[j][3]), "[%zu] s(b)", j + 1);
+        snprintf(text[j][4], sizeof(text[j][4]), "[%zu] up to x", j + 1);
+
+        labels[n_lines] = text[j][0];
+        values[n_lines++] = (double) pw->seg_n[j];
+        labels[n_lines] = text[j][1];
+        values[n_lines++] = pw->seg[j].a;
+        labels[n_lines] = text[j][2];
+        values[n_lines++] = pw->seg[j].b;
+        labels[n_lines] = text[j][3];
+        values[n_lines++] = pw->seg[j].sb;
+        if (j < pw->n_breaks) {
+            labels[n_lines] = text[j][4];
+            values[n_lines++] = pw->breaks[j];
+        }
+    }
+    labels[n_lines] = "Sum of sq. residuals";
+    values[n_lines++] = pw->chisq;
+
+    return s_gui_view_table(win, n_lines, labels, values,
+            "Segmented regression", "s", "s: new breakpoints");
+}
+
+
+/* Grouped regression view */
+void tui_view_groups(const dataset_td *ds, const group_fit_td *fits,
+        size_t n_fits, WINDOW *win)
+{
+    size_t max_rows = getmaxy(win) - 4;
+    size_t pages = (n_fits + max_rows - 1) / max_rows;
+    size_t page = 0;
+
+    while (1) {
+        int ch;
+        size_t start_idx = page * max_rows;
+        size_t end_idx = (start_idx + max_rows > n_fits)
+            ? n_fits
+            : start_idx + max_rows;
+
+        werase(win);
+        box(win, 0, 0);
+        mvwprintw(win, 0, 2, "Grouped regression, %zu groups"
+                " (Page %zu/%zu)", n_fits, page + 1, pages);
+        mvwprintw(win, 1, 2, "%-10s %7s %-9s %-9s %-9s %-7s",
+                "Group", "n", "a", "b", "s(b)", "r");
+
+        for (size_t i = start_idx; i < end_idx; ++i) {
+            char buf[32];
+            mvwprintw(win, 2 + i - start_idx, 2,
+                    "%-10.10s %7zu %-9.4g %-9.4g %-9.4g %-7.4f",
+                    dataset_key_label(ds, fits[i].key, buf, sizeof(buf)),
+                    fits[i].n, fits[i].reg.a, fits[i].reg.b,
+                    fits[i].reg.sb, fits[i].reg.r);
+        }
+
+        mvwprintw(win, getmaxy(win)-2, 2, "n: next, p: prev, q: back");
+        wrefresh(win);
+
+        ch = wgetch(win);
+        if (ch == 27/*ESC*/ || ch == 'q' || ch == 'Q') {
+            break;
+        }
+
+        if (ch == 'n' || ch == 'N') {
+            if (page + 1 < pages) {
+                page++;
+            }
+        } else if (ch == 'p' || ch == 'P') {
+            if (page > 0) {
+                page--;
+            }
+        }
+    }
+}
+
+
+/* Transform pipeline view */
+void tui_view_transform(const view_td *view, WINDOW *win)
+{
+    const char *cols = "xy";
+    size_t number = 1;
+
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 1, 2, "Transform: operations on the view of the data;"
+            " the raw data is kept");
+
+    for (int col = 0; col < 2; ++col) {
+        char line[256];
+        size_t len = 0;
+
+        line[0] = '\0';
+        for (size_t i = 0; i < view->n_layers[col]; ++i, ++number) {
+            const transform_step_td *st = &view->layers[col][i].step;
+            const char *off = view->layers[col][i].enabled ? "" : " (off)";
+            int has_arg = (st->op == TRANSFORM_SCALE
+                    || st->op == TRANSFORM_OFFSET
+                    || st->op == TRANSFORM_POW);
+
+            if (len >= sizeof(line)) {
+                break;
+            }
+            if (has_arg) {
+                len += snprintf(line + len, sizeof(line) - len,
+                        "%s%zu %s %g%s", (i > 0) ? ", " : "", number,
+                        transform_op_name(st->op), st->arg, off);
+            } else {
+                len += snprintf(line + len, sizeof(line) - len,
+                        "%s%zu %s%s", (i > 0) ? ", " : "", number,
+                        transform_op_name(st->op), off);
+            }
+        }
+        mvwprintw(win, 3 + col, 4, "%c: %.*s", cols[col],
+                getmaxx(win) - 10, (len > 0) ? line : "(none)");
+    }
+    wrefresh(win);
 }
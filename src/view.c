@@ -0,0 +1,214 @@
+/**
+ * @file view.c
+ *
+ * @brief Implementation of lazily transformed views of a dataset
+ */
+
+#define _POSIX_C_SOURCE 200809L /* close */
+
+
+/* System includes */
+#include <unistd.h>     /* close */
+
+/* Project includes */
+#include <arena.h>
+#include <dataset.h>
+#include <transform.h>
+
+/* Local includes */
+#include <view.h>
+
+
+/**
+ * @brief Get the enabled operations of a column as a pipeline
+ *
+ * @param v   Pointer to the view
+ * @param col Column (0 for @e x, 1 for @e y)
+ * @param t   Pointer to the pipeline where they are queued
+ */
+static void s_push_enabled(const view_td *v, int col, transform_td *t)
+{
+    for (size_t i = 0; i < v->n_layers[col]; ++i) {
+        if (v->layers[col][i].enabled) {
+            transform_push(t, col, v->layers[col][i].step.op,
+                    v->layers[col][i].step.arg);
+        }
+    }
+}
+
+
+/* Initialize a view with no transforms */
+void view_init(view_td *v, const dataset_td *src)
+{
+    v->src = src;
+    v->n_layers[0] = v->n_layers[1] = 0;
+    v->dirty[0] = v->dirty[1] = 1;
+
+    /* Transformed values are kept in full, whatever the mode of the
+     * source */
+    dataset_init(&v->cache);
+    dataset_set_mode(&v->cache, DATASET_FULL);
+}
+
+
+/* Free the memory used by the cache of a view */
+void view_destroy(view_td *v)
+{
+    /* Keys and derived columns are those of the source (see
+     * view_data()): only the points are the cache's own */
+    arena_free(v->cache.points);
+    if (v->cache.fd >= 0) {
+        close(v->cache.fd);
+    }
+    dataset_init(&v->cache);
+}
+
+
+/* Stack an operation on a column, enabled */
+int view_push(view_td *v, int col, transform_op_e op, double arg)
+{
+    if (col < 0 || col > 1 || op < 0 || op >= TRANSFORM_MAX
+            || v->n_layers[col] >= TRANSFORM_MAX_STEPS) {
+        return 1;
+    }
+
+    view_layer_td *l = &v->layers[col][v->n_layers[col]++];
+    l->step.op = op;
+    l->step.arg = arg;
+    l->enabled = 1;
+    v->dirty[col] = 1;
+
+    return 0;
+}
+
+
+/* Turn an operation of a stack on or off */
+int view_toggle(view_td *v, int col, size_t i)
+{
+    if (col < 0 || col > 1 || i >= v->n_layers[col]) {
+        return 1;
+    }
+
+    v->layers[col][i].enabled = !v->layers[col][i].enabled;
+    v->dirty[col] = 1;
+
+    return 0;
+}
+
+
+/* Remove every operation of both stacks */
+void view_clear(view_td *v)
+{
+    v->n_layers[0] = v->n_layers[1] = 0;
+    v->dirty[0] = v->dirty[1] = 1;
+}
+
+
+/* Tell the view that the raw data has changed */
+void view_invalidate(view_td *v)
+{
+    v->dirty[0] = v->dirty[1] = 1;
+}
+
+
+/* Tell if any operation of the view is enabled */
+int view_is_active(const view_td *v)
+{
+    for (int col = 0; col < 2; ++col) {
+        for (size_t i = 0; i < v->n_layers[col]; ++i) {
+            if (v->layers[col][i].enabled) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/* Get the enabled operations of the view as a pipeline */
+void view_pipeline(const view_td *v, transform_td *t)
+{
+    transform_init(t);
+    s_push_enabled(v, 0, t);
+    s_push_enabled(v, 1, t);
+}
+
+
+/* Read the data seen through the view */
+const dataset_td *view_data(view_td *v)
+{
+    const dataset_td *src = v->src;
+    dataset_td *c = &v->cache;
+
+    if (!view_is_active(v) || src->size == 0) {
+        return src;
+    }
+
+    /* The transformed copy of a dataset too large for the memory goes
+     * to a scratch file as well */
+    if (c->points == NULL && dataset_is_mapped(src) && c->fd < 0) {
+        c->fd = arena_scratch(NULL);
+    }
+    if (c->capacity < src->size) {
+        size_t bytes = src->size * sizeof(data_point_td);
+        void *points = (c->points == NULL && c->fd >= 0)
+            ? arena_alloc_file(bytes, c->fd)
+            : arena_realloc(c->points, bytes);
+        if (points == NULL) {
+            return NULL;
+        }
+        c->points = points;
+        c->capacity = src->size;
+    }
+    if (c->size != src->size) {
+        c->size = src->size;
+        v->dirty[0] = v->dirty[1] = 1;
+    }
+
+    /* Groups and derived columns are read from the raw data */
+    c->keys = src->keys;
+    c->key_names = src->key_names;
+    c->n_key_names = src->n_key_names;
+    c->cols = src->cols;
+    c->col_names = src->col_names;
+    c->n_cols = src->n_cols;
+
+    if (v->dirty[0] || v->dirty[1]) {
+        data_point_td buf[TRANSFORM_BLOCK];
+        transform_td t;
+
+        /* Raw values of the columns out of date, then their stacks */
+        /* The copy is stored in full, whatever the mode of the
+         * source: transformed values seldom fit a compact one */
+        transform_init(&t);
+        for (size_t i = 0; i < c->size; i += TRANSFORM_BLOCK) {
+            size_t n = (c->size - i < TRANSFORM_BLOCK) ? c->size - i
+                : TRANSFORM_BLOCK;
+            const data_point_td *p = dataset_block(src, i, n, buf);
+            data_point_td *q = (data_point_td *) c->points + i;
+
+            for (size_t j = 0; j < n; ++j) {
+                if (v->dirty[0]) {
+                    q[j].x = p[j].x;
+                }
+                if (v->dirty[1]) {
+                    q[j].y = p[j].y;
+                    q[j].ey = p[j].ey;
+                }
+            }
+        }
+        for (int col = 0; col < 2; ++col) {
+            if (v->dirty[col]) {
+                s_push_enabled(v, col, &t);
+            }
+        }
+        if (transform_apply(&t, c) != 0) {
+            return NULL;
+        }
+        v->dirty[0] = v->dirty[1] = 0;
+    }
+    c->is_modified = src->is_modified;
+
+    return c;
+}
@@ -0,0 +1,263 @@
+/**
+ * @file xindex.c
+ *
+ * @brief Implementation of the prefix-sum index over @e x-sorted data
+ */
+
+/* System includes */
+#include <stdint.h>     /* uint64_t */
+#include <stdlib.h>     /* calloc, free, malloc */
+#include <string.h>     /* memcpy, size_t */
+
+/* Project includes */
+#include <dataset.h>
+#include <moments.h>
+#include <regres.h>
+
+/* Local includes */
+#include <xindex.h>
+
+
+#define XINDEX_RADIX_BITS   (11)    /**< Bits of the key per pass */
+#define XINDEX_RADIX_SIZE   (1 << XINDEX_RADIX_BITS)
+#define XINDEX_RADIX_MASK   (XINDEX_RADIX_SIZE - 1)
+#define XINDEX_RADIX_PASSES ((64 + XINDEX_RADIX_BITS - 1) / \
+                             XINDEX_RADIX_BITS)
+
+
+/**
+ * @brief Map a double to an unsigned key with the same ordering
+ *
+ * Positive values get the sign bit set, negative values get all their
+ * bits flipped, so that comparing keys as unsigned integers gives the
+ * numeric order of the values (with @e -0 just before @e +0).
+ *
+ * @param x Value to map
+ *
+ * @return Sortable key of @p x
+ */
+static uint64_t s_sort_key(double x)
+{
+    uint64_t u;
+
+    memcpy(&u, &x, sizeof(u));
+    return (u >> 63) ? ~u : (u | ((uint64_t) 1 << 63));
+}
+
+
+/* Sort the points of a dataset by 'x' */
+size_t *xindex_argsort(const dataset_td *ds)
+{
+    size_t n = ds->size;
+
+    if (n == 0) {
+        return NULL;
+    }
+
+    uint64_t *keys = malloc(n * sizeof(*keys));
+    uint64_t *keys_tmp = malloc(n * sizeof(*keys_tmp));
+    size_t *perm = malloc(n * sizeof(*perm));
+    size_t *perm_tmp = malloc(n * sizeof(*perm_tmp));
+    size_t (*hist)[XINDEX_RADIX_SIZE] =
+        calloc(XINDEX_RADIX_PASSES, sizeof(*hist));
+
+    if (!keys || !keys_tmp || !perm || !perm_tmp || !hist) {
+        free(keys);
+        free(keys_tmp);
+        free(perm);
+        free(perm_tmp);
+        free(hist);
+        return NULL;
+    }
+
+    /* All digit histograms in a single pass */
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t k = s_sort_key(dataset_get(ds, i).x);
+        keys[i] = k;
+        perm[i] = i;
+        for (int p = 0; p < XINDEX_RADIX_PASSES; ++p) {
+            hist[p][(k >> (p * XINDEX_RADIX_BITS)) & XINDEX_RADIX_MASK]++;
+        }
+    }
+
+    for (int p = 0; p < XINDEX_RADIX_PASSES; ++p) {
+        int shift = p * XINDEX_RADIX_BITS;
+        size_t sum = 0;
+
+        /* Every key has the same digit: this pass would not move them */
+        if (hist[p][(keys[0] >> shift) & XINDEX_RADIX_MASK] == n) {
+            continue;
+        }
+
+        for (int d = 0; d < XINDEX_RADIX_SIZE; ++d) {
+            size_t c = hist[p][d];
+            hist[p][d] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            size_t pos = hist[p][(keys[i] >> shift) & XINDEX_RADIX_MASK]++;
+            keys_tmp[pos] = keys[i];
+            perm_tmp[pos] = perm[i];
+        }
+
+        uint64_t *kt = keys;
+        keys = keys_tmp;
+        keys_tmp = kt;
+        size_t *pt = perm;
+        perm = perm_tmp;
+        perm_tmp = pt;
+    }
+
+    free(keys);
+    free(keys_tmp);
+    free(perm_tmp);
+    free(hist);
+
+    return perm;
+}
+
+
+/* Build the prefix-sum index of a dataset */
+int xindex_build(xindex_td *idx, const dataset_td *ds)
+{
+    size_t n = ds->size;
+
+    if (n == 0) {
+        return 1;
+    }
+
+    size_t *perm = xindex_argsort(ds);
+    if (perm == NULL) {
+        return 2;
+    }
+
+    idx->n = n;
+    idx->weighted = moments_use_weights(ds);
+    idx->x = malloc(n * sizeof(double));
+    idx->s = malloc((n + 1) * sizeof(double));
+    idx->sx = malloc((n + 1) * sizeof(double));
+    idx->sy = malloc((n + 1) * sizeof(double));
+    idx->sxx = malloc((n + 1) * sizeof(double));
+    idx->sxy = malloc((n + 1) * sizeof(double));
+    idx->syy = malloc((n + 1) * sizeof(double));
+    if (!idx->x || !idx->s || !idx->sx || !idx->sy ||
+            !idx->sxx || !idx->sxy || !idx->syy) {
+        xindex_destroy(idx);
+        free(perm);
+        return 2;
+    }
+
+    /* Origin at the median point keeps the prefix sums small */
+    idx->x0 = dataset_get(ds, perm[n / 2]).x;
+    idx->y0 = dataset_get(ds, perm[n / 2]).y;
+
+    idx->s[0] = idx->sx[0] = idx->sy[0] = 0.0;
+    idx->sxx[0] = idx->sxy[0] = idx->syy[0] = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        data_point_td p = dataset_get(ds, perm[i]);
+        double w = (!idx->weighted) ? 1.0
+            : (p.ey > 0.0) ? 1.0 / (p.ey * p.ey) : 0.0;
+        double u = p.x - idx->x0;
+        double v = p.y - idx->y0;
+
+        idx->x[i] = p.x;
+        idx->s[i + 1]   = idx->s[i]   + w;
+        idx->sx[i + 1]  = idx->sx[i]  + w * u;
+        idx->sy[i + 1]  = idx->sy[i]  + w * v;
+        idx->sxx[i + 1] = idx->sxx[i] + w * u * u;
+        idx->sxy[i + 1] = idx->sxy[i] + w * u * v;
+        idx->syy[i + 1] = idx->syy[i] + w * v * v;
+    }
+    free(perm);
+
+    return 0;
+}
+
+
+/* Free the memory used by a prefix-sum index */
+void xindex_destroy(xindex_td *idx)
+{
+    free(idx->x);
+    free(idx->s);
+    free(idx->sx);
+    free(idx->sy);
+    free(idx->sxx);
+    free(idx->sxy);
+    free(idx->syy);
+    idx->x = idx->s = idx->sx = idx->sy = NULL;
+    idx->sxx = idx->sxy = idx->syy = NULL;
+    idx->n = 0;
+}
+
+
+/* Find the first sorted position whose 'x' is not below a value */
+size_t xindex_lower(const xindex_td *idx, double x)
+{
+    size_t lo = 0, hi = idx->n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->x[mid] < x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/* Find the first sorted position whose 'x' is above a value */
+size_t xindex_upper(const xindex_td *idx, double x)
+{
+    size_t lo = 0, hi = idx->n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->x[mid] <= x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/* Get the moment sums of a run of sorted points */
+void xindex_moments(const xindex_td *idx, size_t begin, size_t end,
+        moments_td *m)
+{
+    m->x0 = idx->x0;
+    m->y0 = idx->y0;
+    m->weighted = idx->weighted;
+    m->n = end - begin;
+    m->s   = idx->s[end]   - idx->s[begin];
+    m->sx  = idx->sx[end]  - idx->sx[begin];
+    m->sy  = idx->sy[end]  - idx->sy[begin];
+    m->sxx = idx->sxx[end] - idx->sxx[begin];
+    m->sxy = idx->sxy[end] - idx->sxy[begin];
+    m->syy = idx->syy[end] - idx->syy[begin];
+}
+
+
+/* Fit the points whose 'x' lies in a closed range */
+regression_td xindex_fit(const xindex_td *idx, double xa, double xb,
+        size_t *n_out)
+{
+    size_t begin = xindex_lower(idx, xa);
+    size_t end = xindex_upper(idx, xb);
+    moments_td m;
+
+    if (end < begin) {
+        end = begin;
+    }
+    xindex_moments(idx, begin, end, &m);
+    if (n_out != NULL) {
+        *n_out = end - begin;
+    }
+
+    return regres_from_moments(&m);
+}
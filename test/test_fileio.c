@@ -0,0 +1,152 @@
+/**
+ * @file test_fileio.c
+ *
+ * @brief Tests of loading several files into a single dataset
+ *
+ * Writes a set of small data files to a temporary directory and loads
+ * them with @a fileio_load_many(), once all readable, and once with a
+ * missing file first, in the middle, and last.  Built and run by
+ * `make test`.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* mkdtemp */
+
+
+/* System includes */
+#include <stdio.h>      /* fclose, fopen, fprintf, printf, remove, ... */
+#include <stdlib.h>     /* EXIT_FAILURE, EXIT_SUCCESS, mkdtemp */
+#include <unistd.h>     /* rmdir */
+
+/* Project includes */
+#include <dataset.h>
+#include <fileio.h>
+
+
+#define S_N_FILES (40)      /**< Files loaded at once, more than the
+                                 threads that load them */
+#define S_N_POINTS (10)     /**< Points of every file */
+#define S_PATH_MAX (256)    /**< Longest path of a test file */
+
+
+static int s_failures = 0;  /**< Checks failed so far */
+
+
+/**
+ * @brief Report a check that fails
+ *
+ * @param cond Condition that must hold
+ * @param what Description of the check
+ */
+static void s_check(int cond, const char *what)
+{
+    if (!cond) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        s_failures++;
+    }
+}
+
+
+/**
+ * @brief Write a data file of @c S_N_POINTS points
+ *
+ * @param path Path of the file
+ * @param k    Index of the file, which every @e x starts with
+ *
+ * @return 0 on success, or 1 if the file cannot be written
+ */
+static int s_write(const char *path, size_t k)
+{
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < S_N_POINTS; ++i) {
+        fprintf(fp, "%zu.%zu %zu 1\n", k, i, 2 * i + 1);
+    }
+
+    return (fclose(fp) != 0);
+}
+
+
+/**
+ * @brief Load every file, with one of them missing
+ *
+ * @param paths   Paths to the files
+ * @param missing Index of the missing file, or @c S_N_FILES if none
+ */
+static void s_load(char paths[][S_PATH_MAX], size_t missing)
+{
+    const char *names[S_N_FILES];
+    char bad[S_PATH_MAX + 8];
+    dataset_td ds;
+    size_t failed = S_N_FILES;
+    char what[64];
+
+    for (size_t i = 0; i < S_N_FILES; ++i) {
+        names[i] = paths[i];
+    }
+    if (missing < S_N_FILES) {
+        snprintf(bad, sizeof(bad), "%s.none", paths[missing]);
+        names[missing] = bad;
+    }
+
+    /* A point that must survive a failed load */
+    dataset_init(&ds);
+    dataset_add(&ds, -1.0, -1.0, 0.0);
+
+    int err = fileio_load_many(names, S_N_FILES, &ds, NULL, &failed);
+    if (missing < S_N_FILES) {
+        snprintf(what, sizeof(what), "file %zu missing: error", missing);
+        s_check(err == 1, what);
+        snprintf(what, sizeof(what), "file %zu missing: index", missing);
+        s_check(failed == missing, what);
+        snprintf(what, sizeof(what), "file %zu missing: kept", missing);
+        s_check(ds.size == 1 && dataset_get(&ds, 0).x == -1.0, what);
+    } else {
+        s_check(err == 0, "all files: error");
+        s_check(ds.size == S_N_FILES * S_N_POINTS, "all files: size");
+        s_check(ds.size > 0 && dataset_get(&ds, ds.size - 1).y ==
+                2 * S_N_POINTS - 1, "all files: order");
+    }
+
+    dataset_destroy(&ds);
+}
+
+
+/* Entry point of the tests */
+int main(void)
+{
+    char dir[] = "/tmp/regres-test-XXXXXX";
+    char paths[S_N_FILES][S_PATH_MAX];
+
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Cannot create a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < S_N_FILES; ++i) {
+        snprintf(paths[i], S_PATH_MAX, "%s/%02zu.dat", dir, i);
+        if (s_write(paths[i], i) != 0) {
+            fprintf(stderr, "Cannot write '%s'\n", paths[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    s_load(paths, S_N_FILES);
+    s_load(paths, 0);
+    s_load(paths, S_N_FILES / 2);
+    s_load(paths, S_N_FILES - 1);
+
+    for (size_t i = 0; i < S_N_FILES; ++i) {
+        remove(paths[i]);
+    }
+    rmdir(dir);
+
+    if (s_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_fileio: all checks passed\n");
+
+    return EXIT_SUCCESS;
+}